@@ -22,6 +22,7 @@
 #include "scripting/class.h"
 #include <algorithm>
 #include "compat.h"
+#include "cyclecollector.h"
 #include "parsing/amf3_generator.h"
 #include "scripting/argconv.h"
 #include "scripting/toplevel/Boolean.h"
@@ -494,7 +495,90 @@ bool ASObject::isConstructed() const
 {
 	return traitsInitialized && constructIndicator;
 }
-variables_map::variables_map(MemoryAccount *m):slotcount(0),cloneable(true)
+variables_storage::~variables_storage()
+{
+	clear();
+	if (declared)
+		::operator delete(declared);
+}
+
+void variables_storage::destroyDeclared()
+{
+	for (uint32_t i = declaredstart; i < declaredcount; i++)
+		declared[i].~value_type();
+	declaredstart=0;
+	declaredcount=0;
+	if (shape)
+	{
+		shape->decRef();
+		shape=nullptr;
+	}
+}
+
+variables_storage::iterator variables_storage::erase(iterator it)
+{
+	generation++;
+	if (!it.decl)
+		return iterator(this,nullptr,dynamicvars.erase(it.dyn),UINT32_MAX);
+	if (it.decl != declared+declaredstart)
+	{
+		// the shared layout can't change, so the declared traits are moved to the hash map before erasing
+		uint32_t name = it.decl->first;
+		nsNameAndKind ns = it.decl->second.ns;
+		unshare();
+		auto range = dynamicvars.equal_range(name);
+		for (auto dyn = range.first; dyn != range.second; ++dyn)
+		{
+			if (dyn->second.ns == ns)
+			{
+				dynamicvars.erase(dyn);
+				break;
+			}
+		}
+		// the order of the variables has changed, so the iteration has to restart
+		return begin();
+	}
+	it.decl->~value_type();
+	declaredstart++;
+	if (declaredstart == declaredcount)
+		destroyDeclared();
+	return begin();
+}
+
+void variables_storage::clear()
+{
+	generation++;
+	// the buffer of the declared traits is kept, objects from the free list will likely be cloned from the same class again
+	destroyDeclared();
+	dynamicvars.clear();
+}
+
+void variables_storage::initDeclared(variables_shape* s, const variables_storage& src)
+{
+	clear();
+	if (declaredcapacity < s->count)
+	{
+		if (declared)
+			::operator delete(declared);
+		declared = (value_type*)::operator new(sizeof(value_type)*s->count);
+		declaredcapacity = s->count;
+	}
+	for (auto it = src.cbegin(); it != src.cend(); ++it)
+		new (declared+declaredcount++) value_type(*it);
+	assert(declaredcount == s->count);
+	s->incRef();
+	shape = s;
+}
+
+void variables_storage::unshare()
+{
+	for (uint32_t i = declaredstart; i < declaredcount; i++)
+		dynamicvars.insert(declared[i]);
+	destroyDeclared();
+	generation++;
+}
+
+variables_map::variables_map(MemoryAccount *m):instanceshape(nullptr),slotcount(0),cloneable(true)
 {
 }
 
@@ -1011,6 +1095,18 @@ void variables_map::killObjVar(SystemState* sys,const multiname& mname)
 		const nsNameAndKind& ns=ret->second.ns;
 		if(ns==*nsIt)
 		{
+			if (Variables.isDeclared(ret))
+			{
+				// the shared layout can't change, so all declared traits of this object are moved to the hash map
+				Variables.unshare();
+				for (auto it = Variables.begin(); it != Variables.end(); ++it)
+				{
+					if (it->second.slotid)
+						initSlot(it->second.slotid,&(it->second));
+				}
+				killObjVar(sys,mname);
+				return;
+			}
 			Variables.erase(ret);
 			return;
 		}
@@ -1705,6 +1801,8 @@ void variables_map::dumpVariables()
 variables_map::~variables_map()
 {
 	destroyContents();
+	if (instanceshape)
+		instanceshape->decRef();
 }
 
 void variables_map::destroyContents()
@@ -1740,11 +1838,26 @@ void variables_map::prepareShutdown()
 		it++;
 	}
 }
+void variables_map::buildInstanceShape()
+{
+	if (instanceshape)
+		instanceshape->decRef();
+	instanceshape = new variables_shape(Variables.getGeneration());
+	for (auto it = Variables.cbegin(); it != Variables.cend(); ++it)
+	{
+		// variables with the same name are adjacent, so only the first position has to be stored
+		instanceshape->index.insert(make_pair(it->first,instanceshape->count));
+		instanceshape->count++;
+	}
+}
+
 bool variables_map::cloneInstance(variables_map &map)
 {
 	if (!cloneable)
 		return false;
-	map.Variables = Variables;
+	if (!instanceshape || instanceshape->generation != Variables.getGeneration())
+		buildInstanceShape();
+	map.Variables.initDeclared(instanceshape,Variables);
 	auto it = map.Variables.begin();
 	while (it !=map.Variables.end())
 	{
@@ -1757,6 +1870,7 @@ bool variables_map::cloneInstance(variables_map &map)
 
 void variables_map::removeAllDeclaredProperties()
 {
+	bool hadDeclared = Variables.hasDeclared();
 	var_iterator it=Variables.begin();
 	while(it!=Variables.cend())
 	{
@@ -1768,6 +1882,18 @@ void variables_map::removeAllDeclaredProperties()
 		else
 			it++;
 	}
+	// the remaining declared traits may have been moved to the hash map
+	if (hadDeclared && !Variables.hasDeclared())
+		initSlots();
+}
+
+void variables_map::initSlots()
+{
+	for (auto it = Variables.begin(); it != Variables.end(); ++it)
+	{
+		if (it->second.slotid)
+			initSlot(it->second.slotid,&(it->second));
+	}
 }
 
 #ifndef NDEBUG
@@ -1798,6 +1924,9 @@ ASObject::ASObject(ASWorker* wrk, Class_base* c, SWFOBJECT_TYPE t, CLASS_SUBTYPE
 	Variables(c?c->memoryAccount:nullptr),classdef(c),proxyMultiName(nullptr),sys(c?c->sys:nullptr),worker(wrk),
 	stringId(UINT32_MAX),type(t),subtype(st),traitsInitialized(false),constructIndicator(false),constructorCallComplete(false),preparedforshutdown(false),implEnable(true)
 {
+	// only objects that can hold references to other objects can be part of a reference cycle
+	if (sys && sys->cycleCollector && wrk == sys->worker && (t==T_OBJECT || t==T_ARRAY || t==T_FUNCTION))
+		setGCTracked();
 #ifndef NDEBUG
 	//Stuff only used in debugging
 	initialized=false;
@@ -1839,6 +1968,8 @@ ASObject::ASObject(MemoryAccount* m):objfreelist(nullptr),Variables(m),classdef(
 
 ASObject::~ASObject()
 {
+	if (getGCBuffered() && sys && sys->cycleCollector)
+		sys->cycleCollector->removeCandidate(this);
 #ifndef NDEBUG
 	memcheckmutex.lock();
 	memcheckset.erase(this);
@@ -1860,6 +1991,35 @@ bool ASObject::destruct()
 	return destructIntern();
 }
 
+void ASObject::gcCandidate()
+{
+	if (sys && sys->cycleCollector)
+		sys->cycleCollector->addCandidate(this);
+}
+
+void ASObject::gcChildren(std::vector<ASObject*>& children)
+{
+	for (auto it = Variables.Variables.begin(); it != Variables.Variables.end(); ++it)
+	{
+		if (!it->second.isrefcounted)
+			continue;
+		ASObject* o = asAtomHandler::getObject(it->second.var);
+		if (o)
+			children.push_back(o);
+		o = asAtomHandler::getObject(it->second.setter);
+		if (o)
+			children.push_back(o);
+		o = asAtomHandler::getObject(it->second.getter);
+		if (o)
+			children.push_back(o);
+	}
+}
+
+void ASObject::gcClearReferences()
+{
+	destroyContents();
+}
+
 bool ASObject::AVM1HandleKeyboardEvent(KeyboardEvent *e)
 { 
 	if (e->type =="keyDown")
@@ -3487,8 +3647,29 @@ bool asAtomHandler::Boolean_concrete_object(asAtom& a)
 	return lightspark::Boolean_concrete(getObject(a));
 }
 
+#ifdef LIGHTSPARK_INLINE_INTEGRAL_NUMBERS
+// integral values (except -0) are stored as int atoms, like avmplus does,
+// so most arithmetic results don't need a Number object
+static FORCE_INLINE bool isInlineIntegral(number_t val)
+{
+#ifdef LIGHTSPARK_64
+	if (val < INT32_MIN || val > INT32_MAX)
+#else
+	if (val < -(1<<28) || val > (1<<28))
+#endif
+		return false;
+	return (number_t)(int32_t)val == val && (val != 0 || !std::signbit(val));
+}
+#endif
 void asAtomHandler::setNumber(asAtom& a, ASWorker* w, number_t val)
 {
+#ifdef LIGHTSPARK_INLINE_INTEGRAL_NUMBERS
+	if (isInlineIntegral(val))
+	{
+		setInt(a,w,(int32_t)val);
+		return;
+	}
+#endif
 	if (std::isnan(val))
 		a.uintval = w->getSystemState()->nanAtom.uintval;
 	else
@@ -3501,6 +3682,13 @@ bool asAtomHandler::replaceNumber(asAtom& a, ASWorker* w, number_t val)
 		as<Number>(a)->setNumber(val);
 		return false;
 	}
+#ifdef LIGHTSPARK_INLINE_INTEGRAL_NUMBERS
+	if (isInlineIntegral(val))
+	{
+		setInt(a,w,(int32_t)val);
+		return true;
+	}
+#endif
 	if (std::isnan(val))
 		a.uintval = w->getSystemState()->nanAtom.uintval;
 	else
@@ -23,6 +23,7 @@
 #include "swftypes.h"
 #include <unordered_map>
 #include <limits>
+#include <type_traits>
 
 #define ASFUNCTION_ATOM(name) \
 	static void name(asAtom& ret,ASWorker* wrk, asAtom& , asAtom* args, const unsigned int argslen)
@@ -336,6 +337,8 @@ union asAtom
 // dddd d011: int
 // dddd d111: (U)Integer
 // dddd d100: ASObject
+// if LIGHTSPARK_INLINE_INTEGRAL_NUMBERS is defined, setNumber stores integral values as int,
+// fractional values are still boxed in Number objects (see tests/performance/Number_inline_test.mxml)
 enum ATOM_TYPE 
 { 
 	ATOM_INVALID_UNDEFINED_NULL_BOOL=0x0, 
@@ -643,14 +646,181 @@ struct varName
 	}
 };
 
+/*
+ * Layout of the declared traits of the instances of a sealed class, shared by
+ * all instances cloned from the same instance factory (see variables_map::cloneInstance)
+ */
+struct variables_shape
+{
+	// position of the first trait with a name, traits with the same name are adjacent
+	std::unordered_map<uint32_t,uint32_t> index;
+	uint32_t count;
+	// modification counter of the instance factory the shape was built from
+	uint32_t generation;
+	ATOMIC_INT32(refcount);
+	variables_shape(uint32_t _generation):count(0),generation(_generation),refcount(1) {}
+	void incRef() { ATOMIC_INCREMENT(refcount); }
+	void decRef() { if (ATOMIC_DECREMENT(refcount)==0) delete this; }
+};
+
+/*
+ * Storage of the variables of an object. Declared traits of cloned instances are
+ * kept in a flat array described by a variables_shape, all other variables are
+ * kept in a hash map. The interface is the subset of std::unordered_multimap
+ * used by variables_map, variables with the same name are adjacent when iterating.
+ */
+class variables_storage
+{
+public:
+	typedef std::pair<const uint32_t,variable> value_type;
+	typedef std::unordered_multimap<uint32_t,variable,std::hash<uint32_t>,std::equal_to<uint32_t>,slab_allocator<value_type>> dynamicType;
+	template<bool isconst>
+	class iterator_base
+	{
+	friend class variables_storage;
+	template<bool> friend class iterator_base;
+	public:
+		typedef typename std::conditional<isconst,const value_type,value_type>::type elem;
+		typedef typename std::conditional<isconst,dynamicType::const_iterator,dynamicType::iterator>::type dynamicIt;
+		typedef typename std::conditional<isconst,const variables_storage,variables_storage>::type storage;
+	private:
+		storage* s;
+		// position in the declared traits, nullptr if the iterator points into the hash map
+		elem* decl;
+		dynamicIt dyn;
+		// name passed to find(), UINT32_MAX if all variables are iterated
+		uint32_t findname;
+		iterator_base(storage* _s, elem* _decl, dynamicIt _dyn, uint32_t _findname):s(_s),decl(_decl),dyn(_dyn),findname(_findname) {}
+	public:
+		iterator_base():s(nullptr),decl(nullptr),findname(UINT32_MAX) {}
+		iterator_base(const iterator_base<false>& o):s(o.s),decl(o.decl),dyn(o.dyn),findname(o.findname) {}
+		FORCE_INLINE elem& operator*() const { return decl ? *decl : *dyn; }
+		FORCE_INLINE elem* operator->() const { return decl ? decl : &(*dyn); }
+		FORCE_INLINE iterator_base& operator++()
+		{
+			if (decl)
+			{
+				++decl;
+				if (decl == s->declared+s->declaredcount || (findname != UINT32_MAX && decl->first != findname))
+				{
+					decl = nullptr;
+					dyn = findname == UINT32_MAX ? s->dynamicvars.begin() : s->dynamicvars.find(findname);
+				}
+			}
+			else
+				++dyn;
+			return *this;
+		}
+		FORCE_INLINE iterator_base operator++(int)
+		{
+			iterator_base ret = *this;
+			++(*this);
+			return ret;
+		}
+		template<bool c>
+		FORCE_INLINE bool operator==(const iterator_base<c>& o) const
+		{
+			return decl == o.decl && (decl || dynamicType::const_iterator(dyn) == dynamicType::const_iterator(o.dyn));
+		}
+		template<bool c>
+		FORCE_INLINE bool operator!=(const iterator_base<c>& o) const
+		{
+			return !(*this == o);
+		}
+	};
+	typedef iterator_base<false> iterator;
+	typedef iterator_base<true> const_iterator;
+private:
+	variables_shape* shape;
+	value_type* declared;
+	// declared traits before declaredstart are already erased
+	uint32_t declaredstart;
+	uint32_t declaredcount;
+	uint32_t declaredcapacity;
+	dynamicType dynamicvars;
+	uint32_t generation;
+	void destroyDeclared();
+	template<class S, class I>
+	static FORCE_INLINE I findIntern(S* s, uint32_t name)
+	{
+		if (s->shape)
+		{
+			auto it = s->shape->index.find(name);
+			if (it != s->shape->index.end())
+			{
+				uint32_t pos = it->second < s->declaredstart ? s->declaredstart : it->second;
+				if (pos < s->declaredcount && s->declared[pos].first == name)
+					return I(s,s->declared+pos,typename I::dynamicIt(),name);
+			}
+		}
+		return I(s,nullptr,s->dynamicvars.find(name),name);
+	}
+public:
+	variables_storage():shape(nullptr),declared(nullptr),declaredstart(0),declaredcount(0),declaredcapacity(0),generation(0) {}
+	variables_storage(const variables_storage&) = delete;
+	variables_storage& operator=(const variables_storage&) = delete;
+	~variables_storage();
+	FORCE_INLINE iterator begin()
+	{
+		if (declaredstart < declaredcount)
+			return iterator(this,declared+declaredstart,dynamicType::iterator(),UINT32_MAX);
+		return iterator(this,nullptr,dynamicvars.begin(),UINT32_MAX);
+	}
+	FORCE_INLINE const_iterator begin() const { return cbegin(); }
+	FORCE_INLINE const_iterator cbegin() const
+	{
+		if (declaredstart < declaredcount)
+			return const_iterator(this,declared+declaredstart,dynamicType::const_iterator(),UINT32_MAX);
+		return const_iterator(this,nullptr,dynamicvars.cbegin(),UINT32_MAX);
+	}
+	FORCE_INLINE iterator end() { return iterator(this,nullptr,dynamicvars.end(),UINT32_MAX); }
+	FORCE_INLINE const_iterator end() const { return cend(); }
+	FORCE_INLINE const_iterator cend() const { return const_iterator(this,nullptr,dynamicvars.cend(),UINT32_MAX); }
+	FORCE_INLINE iterator find(uint32_t name) { return findIntern<variables_storage,iterator>(this,name); }
+	FORCE_INLINE const_iterator find(uint32_t name) const { return findIntern<const variables_storage,const_iterator>(this,name); }
+	// new variables are always added to the hash map
+	FORCE_INLINE iterator insert(const_iterator hint, const value_type& v)
+	{
+		generation++;
+		return iterator(this,nullptr,dynamicvars.insert(dynamicvars.cbegin(),v),UINT32_MAX);
+	}
+	FORCE_INLINE iterator insert(const value_type& v)
+	{
+		generation++;
+		return iterator(this,nullptr,dynamicvars.insert(v),UINT32_MAX);
+	}
+	/*
+	 * Erasing a declared trait other than the first one moves all declared traits to the hash map
+	 * and returns begin(), pointers to the variables have to be updated then
+	 */
+	iterator erase(iterator it);
+	FORCE_INLINE uint32_t size() const { return declaredcount-declaredstart+dynamicvars.size(); }
+	FORCE_INLINE bool empty() const { return size()==0; }
+	FORCE_INLINE void reserve(uint32_t n) { dynamicvars.reserve(n); }
+	FORCE_INLINE bool isDeclared(const_iterator it) const { return it.decl != nullptr; }
+	FORCE_INLINE bool hasDeclared() const { return declaredstart < declaredcount; }
+	FORCE_INLINE uint32_t getGeneration() const { return generation; }
+	void clear();
+	// copy all variables of src into the flat array, src must have the layout described by s
+	void initDeclared(variables_shape* s, const variables_storage& src);
+	// move the declared traits into the hash map
+	void unshare();
+};
+
 class variables_map
 {
+private:
+	// layout of the instances cloned from this map, see cloneInstance
+	variables_shape* instanceshape;
+	void buildInstanceShape();
+	// points the slots to the variables again after they have been moved
+	void initSlots();
 public:
 	//Names are represented by strings in the string and namespace pools
-	typedef std::unordered_multimap<uint32_t,variable> mapType;
+	typedef variables_storage mapType;
 	mapType Variables;
-	typedef std::unordered_multimap<uint32_t,variable>::iterator var_iterator;
-	typedef std::unordered_multimap<uint32_t,variable>::const_iterator const_var_iterator;
+	typedef variables_storage::iterator var_iterator;
+	typedef variables_storage::const_iterator const_var_iterator;
 	std::vector<variable*> slots_vars;
 	uint32_t slotcount;
 	// indicates if this map was initialized with no variables with non-primitive values
@@ -907,6 +1077,7 @@ protected:
 	   The destruct method must be callable multiple time with the same effects (no double frees).
 	*/
 	bool destruct() override;
+	void gcCandidate() override;
 
 	FORCE_INLINE bool destructIntern()
 	{
@@ -1272,6 +1443,10 @@ public:
 	}
 	// this is called when shutting down the application, removes all pointers to freelist to avoid any caching of ASObjects
 	virtual void prepareShutdown();
+	// adds all objects this object holds a counted reference to, used by the CycleCollector
+	virtual void gcChildren(std::vector<ASObject*>& children);
+	// releases all references reported by gcChildren, called by the CycleCollector on garbage objects
+	virtual void gcClearReferences();
 	CLASS_SUBTYPE getSubtype() const { return subtype;}
 	// copies all variables into the target
 	// returns false if cloning is not possible
@@ -25,8 +25,31 @@
 
 using namespace lightspark;
 
+namespace lightspark
+{
+class FLVDemuxJob: public IThreadJob
+{
+private:
+	BuiltinStreamDecoder* decoder;
+public:
+	FLVDemuxJob(BuiltinStreamDecoder* d):decoder(d) {}
+	void execute() override
+	{
+		decoder->demux();
+	}
+	void jobFence() override
+	{
+		decoder->demuxJobFinished();
+		delete this;
+	}
+	// it blocks while waiting for the download or for the decoders
+	JOB_PRIORITY getJobPriority() const override { return JOB_PRIORITY_LOW; }
+};
+}
+
 BuiltinStreamDecoder::BuiltinStreamDecoder(std::istream& _s, NetStream* _ns):
-	stream(_s),prevSize(0),decodedAudioBytes(0),decodedVideoFrames(0),decodedTime(0),frameRate(0.0),netstream(_ns),headerbuf(NULL),headerLen(0)
+	stream(_s),prevSize(0),decodedAudioBytes(0),decodedVideoFrames(0),decodedTime(0),frameRate(0.0),netstream(_ns),headerbuf(NULL),headerLen(0),
+	streamPosition(0),packetHead(0),packetCount(0),demuxStarted(false),demuxRunning(false),demuxFinished(false),demuxStopped(false)
 {
 	STREAM_TYPE t=classifyStream(stream);
 	if(t==FLV_STREAM)
@@ -41,6 +64,15 @@ BuiltinStreamDecoder::BuiltinStreamDecoder(std::istream& _s, NetStream* _ns):
 
 BuiltinStreamDecoder::~BuiltinStreamDecoder()
 {
+	{
+		Locker l(packetMutex);
+		demuxStopped=true;
+		packetCond.broadcast();
+		while(demuxRunning)
+			packetCond.wait(packetMutex);
+	}
+	for(uint32_t i=0;i<FLVPACKETQUEUESIZE;i++)
+		delete packets[i].tag;
 	if (headerLen)
 	{
 		delete headerbuf;
@@ -62,174 +94,331 @@ BuiltinStreamDecoder::STREAM_TYPE BuiltinStreamDecoder::classifyStream(std::istr
 	return ret;
 }
 
-bool BuiltinStreamDecoder::decodeNextFrame()
+void BuiltinStreamDecoder::demux()
 {
-	UI32_FLV PreviousTagSize;
-	stream >> PreviousTagSize;
-	// It seems that Adobe simply ignores invalid values for PreviousTagSize
-	//assert_and_throw(PreviousTagSize==prevSize);
-
-	//Check tag type and read it
-	UI8 TagType;
-	stream >> TagType;
-	switch(TagType)
+	while(true)
 	{
-		case 8:
+		Packet* p;
 		{
-			AudioDataTag tag(stream);
-			prevSize=tag.getTotalLen();
-			if (tag.packetLen == 0)
-				return false;
-			if (tag.isHeader() && tag.SoundFormat == AAC)
+			Locker l(packetMutex);
+			while(packetCount==FLVPACKETQUEUESIZE && !demuxStopped)
+				packetCond.wait(packetMutex);
+			if(demuxStopped)
+				break;
+			p=&packets[(packetHead+packetCount)%FLVPACKETQUEUESIZE];
+		}
+		//The free slots of the ring are only accessed by the demuxer
+		bool more=demuxPacket(*p);
+		Locker l(packetMutex);
+		if(p->type!=0 || !p->error.empty())
+		{
+			if(p->tag && p->type!=18)
 			{
-				if (audioDecoder)
-					break;
-				if (headerLen)
-					delete headerbuf;
-				// store the aac header, don't pass it as initData to the FFMpegAudioDecoder constructor
-				headerbuf = new uint8_t[tag.packetLen];
-				memcpy(headerbuf,tag.packetData,tag.packetLen);
-				headerLen = tag.packetLen;
+				if(p->tag->inPlace)
+					packetMetrics.inPlacePackets++;
+				else
+					packetMetrics.copiedPackets++;
 			}
-			if(audioDecoder==nullptr)
-			{
-				audioCodec=tag.SoundFormat;
-				switch(tag.SoundFormat)
-				{
-					case AAC:
+			packetCount++;
+			packetMetrics.maxQueuedPackets=max(packetMetrics.maxQueuedPackets,packetCount);
+			packetCond.broadcast();
+		}
+		if(!more)
+			break;
+	}
+	Locker l(packetMutex);
+	demuxFinished=true;
+	packetCond.broadcast();
+}
+
+bool BuiltinStreamDecoder::demuxPacket(Packet& p)
+{
+	p.type=0;
+	try
+	{
+		UI32_FLV PreviousTagSize;
+		stream >> PreviousTagSize;
+		// It seems that Adobe simply ignores invalid values for PreviousTagSize
+		//assert_and_throw(PreviousTagSize==prevSize);
+
+		//Check tag type and read it
+		UI8 TagType;
+		stream >> TagType;
+		if(stream.fail())
+			return false;
+		switch(TagType)
+		{
+			case 8:
+				p.tag=new AudioDataTag(stream,&p.buffer);
+				break;
+			case 9:
+				p.tag=new VideoDataTag(stream,&p.buffer);
+				break;
+			case 18:
+				p.tag=new ScriptDataTag(stream);
+				break;
+			default:
+				LOG(LOG_ERROR,"Unexpected tag type " << (int)TagType << " in FLV");
+				p.type=TagType;
+				p.position=stream.tellg();
+				return false;
+		}
+		p.type=TagType;
+		p.position=stream.tellg();
+		return true;
+	}
+	catch(LightsparkException& e)
+	{
+		p.error=e.cause;
+	}
+	catch(std::exception& e)
+	{
+		p.error=e.what();
+	}
+	return false;
+}
+
+void BuiltinStreamDecoder::demuxJobFinished()
+{
+	Locker l(packetMutex);
+	demuxRunning=false;
+	demuxFinished=true;
+	packetCond.broadcast();
+}
+
+void BuiltinStreamDecoder::releasePacket()
+{
+	Locker l(packetMutex);
+	Packet& p=packets[packetHead];
+	delete p.tag;
+	p.tag=nullptr;
+	p.error="";
+	packetHead=(packetHead+1)%FLVPACKETQUEUESIZE;
+	packetCount--;
+	packetCond.broadcast();
+}
+
+bool BuiltinStreamDecoder::decodeNextFrame()
+{
+	if(!demuxStarted)
+	{
+		demuxStarted=true;
+		demuxRunning=true;
+		netstream->getSystemState()->addJob(new FLVDemuxJob(this));
+	}
+	Packet* p;
+	{
+		Locker l(packetMutex);
+		while(packetCount==0 && !demuxFinished)
+			packetCond.wait(packetMutex);
+		if(packetCount==0)
+		{
+			streamPosition=-1;
+			return false;
+		}
+		p=&packets[packetHead];
+	}
+	//The demuxer does not touch the packets in the ring, the payload stays valid until releasePacket
+	streamPosition=p->position;
+	if(!p->error.empty())
+	{
+		tiny_string error=p->error;
+		releasePacket();
+		throw ParseException(error);
+	}
+	bool ret=true;
+	try
+	{
+		switch(p->type)
+		{
+			case 8:
+				ret=decodeAudioPacket(*static_cast<AudioDataTag*>(p->tag));
+				break;
+			case 9:
+				decodeVideoPacket(*static_cast<VideoDataTag*>(p->tag));
+				break;
+			case 18:
+				decodeScriptPacket(*static_cast<ScriptDataTag*>(p->tag));
+				break;
+			default:
+				ret=false;
+				break;
+		}
+	}
+	catch(...)
+	{
+		releasePacket();
+		throw;
+	}
+	if(!ret)
+		packetMetrics.droppedPackets++;
+	releasePacket();
+	return ret;
+}
+
+bool BuiltinStreamDecoder::decodeAudioPacket(AudioDataTag& tag)
+{
+	prevSize=tag.getTotalLen();
+	if (tag.packetLen == 0)
+		return false;
+	if (tag.isHeader() && tag.SoundFormat == AAC)
+	{
+		if (audioDecoder)
+			return true;
+		if (headerLen)
+			delete headerbuf;
+		// store the aac header, don't pass it as initData to the FFMpegAudioDecoder constructor
+		headerbuf = new uint8_t[tag.packetLen];
+		memcpy(headerbuf,tag.packetData,tag.packetLen);
+		headerLen = tag.packetLen;
+	}
+	if(audioDecoder==nullptr)
+	{
+		audioCodec=tag.SoundFormat;
+		switch(tag.SoundFormat)
+		{
+			case AAC:
 #ifdef ENABLE_LIBAVCODEC
-						audioDecoder=new FFMpegAudioDecoder(netstream->getSystemState()->getEngineData(), tag.SoundFormat,nullptr,0);// tag.packetData, tag.packetLen);
+				audioDecoder=new FFMpegAudioDecoder(netstream->getSystemState()->getEngineData(), tag.SoundFormat,nullptr,0);// tag.packetData, tag.packetLen);
 #else
-						audioDecoder=new NullAudioDecoder();
+				audioDecoder=new NullAudioDecoder();
 #endif
-						tag.releaseBuffer();
-						break;
-					case MP3:
+				tag.releaseBuffer();
+				break;
+			case MP3:
 #ifdef ENABLE_LIBAVCODEC
-						audioDecoder=new FFMpegAudioDecoder(netstream->getSystemState()->getEngineData(), tag.SoundFormat,nullptr,0);
+				audioDecoder=new FFMpegAudioDecoder(netstream->getSystemState()->getEngineData(), tag.SoundFormat,nullptr,0);
 #else
-						audioDecoder=new NullAudioDecoder();
+				audioDecoder=new NullAudioDecoder();
 #endif
-						decodedAudioBytes+=audioDecoder->decodeData(tag.packetData,tag.packetLen,decodedTime);
-						//Adjust timing
-						if (audioDecoder->getBytesPerMSec())
-							decodedTime=decodedAudioBytes/audioDecoder->getBytesPerMSec();
-						break;
-					default:
-						throw RunTimeException("Unsupported SoundFormat");
-				}
-			}
-			else
-			{
-				assert_and_throw(audioCodec==tag.SoundFormat);
-				if (headerLen)
-				{
-					// add aac header to this packet
-					uint8_t buf[headerLen+tag.packetLen];
-					memcpy(buf,headerbuf,headerLen);
-					memcpy(buf+headerLen,tag.packetData,tag.packetLen);
-					
-					decodedAudioBytes+=audioDecoder->decodeData(buf,tag.packetLen+headerLen,decodedTime);
-					delete headerbuf;
-					headerLen = 0;
-				}
-				else
-					decodedAudioBytes+=audioDecoder->decodeData(tag.packetData,tag.packetLen,decodedTime);
+				decodedAudioBytes+=audioDecoder->decodeData(tag.packetData,tag.packetLen,decodedTime);
 				//Adjust timing
 				if (audioDecoder->getBytesPerMSec())
 					decodedTime=decodedAudioBytes/audioDecoder->getBytesPerMSec();
-			}
-			break;
+				break;
+			default:
+				throw RunTimeException("Unsupported SoundFormat");
 		}
-		case 9:
+	}
+	else
+	{
+		assert_and_throw(audioCodec==tag.SoundFormat);
+		if (headerLen)
 		{
-			VideoDataTag tag(stream);
-			prevSize=tag.getTotalLen();
-			//If the framerate is known give the right timing, otherwise use decodedTime from audio
-			uint32_t frameTime=(frameRate!=0.0)?(decodedVideoFrames*1000/frameRate):decodedTime;
+			// add aac header to this packet
+			uint8_t buf[headerLen+tag.packetLen];
+			memcpy(buf,headerbuf,headerLen);
+			memcpy(buf+headerLen,tag.packetData,tag.packetLen);
+			
+			decodedAudioBytes+=audioDecoder->decodeData(buf,tag.packetLen+headerLen,decodedTime);
+			delete headerbuf;
+			headerLen = 0;
+		}
+		else
+			decodedAudioBytes+=audioDecoder->decodeData(tag.packetData,tag.packetLen,decodedTime);
+		//Adjust timing
+		if (audioDecoder->getBytesPerMSec())
+			decodedTime=decodedAudioBytes/audioDecoder->getBytesPerMSec();
+	}
+	return true;
+}
 
-			if(videoDecoder==nullptr)
-			{
-				//If the isHeader flag is on then the decoder becomes the owner of the data
-				if(tag.isHeader())
-				{
-					//The tag is the header, initialize decoding
+void BuiltinStreamDecoder::decodeVideoPacket(VideoDataTag& tag)
+{
+	prevSize=tag.getTotalLen();
+	//If the framerate is known give the right timing, otherwise use decodedTime from audio
+	uint32_t frameTime=(frameRate!=0.0)?(decodedVideoFrames*1000/frameRate):decodedTime;
+
+	if(videoDecoder==nullptr)
+	{
+		//If the isHeader flag is on then the decoder becomes the owner of the data
+		if(tag.isHeader())
+		{
+			//The tag is the header, initialize decoding
 #ifdef ENABLE_LIBAVCODEC
-					videoDecoder=new FFMpegVideoDecoder(tag.codec,tag.packetData,tag.packetLen, frameRate);
+			videoDecoder=new FFMpegVideoDecoder(tag.codec,tag.packetData,tag.packetLen, frameRate);
 #else
-					videoDecoder=new NullVideoDecoder();
+			videoDecoder=new NullVideoDecoder();
 #endif
-					tag.releaseBuffer();
-				}
-				else
-				{
-					//First packet but no special handling
+			tag.releaseBuffer();
+		}
+		else
+		{
+			//First packet but no special handling
 #ifdef ENABLE_LIBAVCODEC
-					videoDecoder=new FFMpegVideoDecoder(tag.codec,nullptr,0,frameRate);
+			videoDecoder=new FFMpegVideoDecoder(tag.codec,nullptr,0,frameRate);
 #else
-					videoDecoder=new NullVideoDecoder();
+			videoDecoder=new NullVideoDecoder();
 #endif
-					videoDecoder->decodeData(tag.packetData,tag.packetLen, frameTime);
-					videoDecoder->framesdecoded++;
-					if (videoDecoder->frameRate != 0)
-						frameRate = videoDecoder->frameRate;
-					decodedVideoFrames++;
-				}
-			}
-			else
-			{
-				if(tag.isHeader())
-				{
-					//The tag is the header, initialize decoding
-					videoDecoder->switchCodec(tag.codec,tag.packetData,tag.packetLen,frameRate);
-					tag.releaseBuffer();
-				}
-				else
-				{
-					videoDecoder->decodeData(tag.packetData,tag.packetLen, frameTime);
-					videoDecoder->framesdecoded++;
-					if (videoDecoder->frameRate != 0)
-						frameRate = videoDecoder->frameRate;
-					decodedVideoFrames++;
-				}
-			}
-			break;
+			videoDecoder->decodeData(tag.packetData,tag.packetLen, frameTime);
+			videoDecoder->framesdecoded++;
+			if (videoDecoder->frameRate != 0)
+				frameRate = videoDecoder->frameRate;
+			decodedVideoFrames++;
+		}
+	}
+	else
+	{
+		if(tag.isHeader())
+		{
+			//The tag is the header, initialize decoding
+			videoDecoder->switchCodec(tag.codec,tag.packetData,tag.packetLen,frameRate);
+			tag.releaseBuffer();
 		}
-		case 18:
+		else
+		{
+			videoDecoder->decodeData(tag.packetData,tag.packetLen, frameTime);
+			videoDecoder->framesdecoded++;
+			if (videoDecoder->frameRate != 0)
+				frameRate = videoDecoder->frameRate;
+			decodedVideoFrames++;
+		}
+	}
+}
+
+void BuiltinStreamDecoder::decodeScriptPacket(ScriptDataTag& tag)
+{
+	prevSize=tag.getTotalLen();
+	if (tag.methodName == "onMetaData")
+	{
+		// set framerate from metadata, if available
+		multiname m(nullptr);
+		m.name_type=multiname::NAME_STRING;
+		m.name_s_id=getSys()->getUniqueStringId("framerate");
+		m.ns.emplace_back(getSys(),BUILTIN_STRINGS::EMPTY,NAMESPACE);
+		m.isAttribute = false;
+		auto it = tag.dataobjectlist.begin();
+		while (it != tag.dataobjectlist.end())
 		{
-			ScriptDataTag tag(stream);
-			prevSize=tag.getTotalLen();
-			if (tag.methodName == "onMetaData")
+			ASObject* o = asAtomHandler::getObject((*it));
+			if(o && o->hasPropertyByMultiname(m,true,false,o->getInstanceWorker()))
 			{
-				// set framerate from metadata, if available
-				multiname m(nullptr);
-				m.name_type=multiname::NAME_STRING;
-				m.name_s_id=getSys()->getUniqueStringId("framerate");
-				m.ns.emplace_back(getSys(),BUILTIN_STRINGS::EMPTY,NAMESPACE);
-				m.isAttribute = false;
-				auto it = tag.dataobjectlist.begin();
-				while (it != tag.dataobjectlist.end())
-				{
-					ASObject* o = asAtomHandler::getObject((*it));
-					if(o && o->hasPropertyByMultiname(m,true,false,o->getInstanceWorker()))
-					{
-						asAtom v=asAtomHandler::invalidAtom;
-						o->getVariableByMultiname(v,m,GET_VARIABLE_OPTION::NONE,o->getInstanceWorker());
-						frameRate = asAtomHandler::toNumber(v);
-						break;
-					}
-					it++;
-				}
+				asAtom v=asAtomHandler::invalidAtom;
+				o->getVariableByMultiname(v,m,GET_VARIABLE_OPTION::NONE,o->getInstanceWorker());
+				frameRate = asAtomHandler::toNumber(v);
+				break;
 			}
-			
-			netstream->sendClientNotification(tag.methodName,tag.dataobjectlist);
-			break;
+			it++;
 		}
-		default:
-			LOG(LOG_ERROR,"Unexpected tag type " << (int)TagType << " in FLV");
-			return false;
 	}
-	return true;
+	
+	netstream->sendClientNotification(tag.methodName,tag.dataobjectlist);
+}
+
+int64_t BuiltinStreamDecoder::getStreamPosition()
+{
+	return streamPosition;
+}
+
+void BuiltinStreamDecoder::getMetrics(StreamDecoderMetrics& m) const
+{
+	StreamDecoder::getMetrics(m);
+	Locker l(packetMutex);
+	m.queuedPackets=packetCount;
+	m.maxQueuedPackets=packetMetrics.maxQueuedPackets;
+	m.droppedPackets=packetMetrics.droppedPackets;
+	m.inPlacePackets=packetMetrics.inPlacePackets;
+	m.copiedPackets=packetMetrics.copiedPackets;
 }
 
 void BuiltinStreamDecoder::jumpToPosition(number_t position)
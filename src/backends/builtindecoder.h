@@ -22,14 +22,37 @@
 
 #include "backends/decoder.h"
 #include "parsing/flv.h"
+#include "threading.h"
 
 namespace lightspark
 {
 class NetStream;
 
+// number of demuxed packets buffered ahead of the decoders
+#define FLVPACKETQUEUESIZE 64
+
+/*
+ * Decodes FLV streams. The tags are demuxed in a separate job into a bounded
+ * ring of packets, which decodeNextFrame consumes in order. The demuxer blocks
+ * while the ring is full, the decoders block while their frame buffers are full
+ */
 class BuiltinStreamDecoder: public StreamDecoder
 {
+friend class FLVDemuxJob;
 private:
+	struct Packet
+	{
+		// FLV tag type
+		uint8_t type;
+		VideoTag* tag;
+		// the payload of the tag if it was not used in place
+		FLVPacketBuffer buffer;
+		// stream position after the tag
+		int64_t position;
+		// set if demuxing failed at this packet
+		tiny_string error;
+		Packet():type(0),tag(nullptr),position(0) {}
+	};
 	std::istream& stream;
 	unsigned int prevSize;
 	LS_AUDIO_CODEC audioCodec;
@@ -44,11 +67,33 @@ private:
 	NetStream* netstream;
 	uint8_t* headerbuf;
 	uint32_t headerLen;
+	int64_t streamPosition;
+	// the packet ring, protected by packetMutex
+	Packet packets[FLVPACKETQUEUESIZE];
+	uint32_t packetHead;
+	uint32_t packetCount;
+	mutable Mutex packetMutex;
+	Cond packetCond;
+	bool demuxStarted;
+	bool demuxRunning;
+	bool demuxFinished;
+	bool demuxStopped;
+	StreamDecoderMetrics packetMetrics;
+	// runs in the FLVDemuxJob
+	void demux();
+	bool demuxPacket(Packet& p);
+	void demuxJobFinished();
+	void releasePacket();
+	bool decodeAudioPacket(AudioDataTag& tag);
+	void decodeVideoPacket(VideoDataTag& tag);
+	void decodeScriptPacket(ScriptDataTag& tag);
 public:
 	BuiltinStreamDecoder(std::istream& _s, NetStream* _ns);
 	~BuiltinStreamDecoder();
 	bool decodeNextFrame() override;
 	void jumpToPosition(number_t position) override;
+	int64_t getStreamPosition() override;
+	void getMetrics(StreamDecoderMetrics& m) const override;
 };
 
 }
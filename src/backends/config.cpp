@@ -85,7 +85,7 @@ Config::Config():
 	//DEFAULT SETTINGS
 	defaultCacheDirectory((string) g_get_user_cache_dir() + G_DIR_SEPARATOR_S + "lightspark"),
 	cacheDirectory(defaultCacheDirectory),cachePrefix("cache"),
-	renderingEnabled(true)
+	renderingEnabled(true),preloadCacheEnabled(false),cycleCollectorBudget(0),textureMemoryBudget(0),shapeTessellationEnabled(false)
 {
 #ifdef _WIN32
 	const char* exePath = getExectuablePath();
@@ -205,12 +205,24 @@ void Config::handleEntry()
 	//Rendering
 	if(group == "rendering" && key == "enabled")
 		renderingEnabled = atoi(value.c_str());
+	//Texture memory budget
+	else if(group == "rendering" && key == "texturememory")
+		textureMemoryBudget = max(0,atoi(value.c_str()));
+	//Tessellation of vector shapes
+	else if(group == "rendering" && key == "tessellation")
+		shapeTessellationEnabled = atoi(value.c_str());
 	//Cache directory
 	else if(group == "cache" && key == "directory")
 		cacheDirectory = value;
 	//Cache prefix
 	else if(group == "cache" && key == "prefix")
 		cachePrefix = value;
+	//Cache analysis of ActionScript methods
+	else if(group == "cache" && key == "preload")
+		preloadCacheEnabled = atoi(value.c_str());
+	//Time budget of the cycle collector
+	else if(group == "gc" && key == "budget")
+		cycleCollectorBudget = max(0,atoi(value.c_str()));
 	else
 		LOG(LOG_ERROR,"Invalid entry encountered in configuration file" << ": '" << group << "/" << key << "'='" << value << "'");
 }
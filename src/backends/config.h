@@ -51,6 +51,14 @@ namespace lightspark
 
 		//Specifies if rendering should be done
 		bool renderingEnabled;
+		//Specifies if the analysis of ActionScript methods is cached in the cache directory
+		bool preloadCacheEnabled;
+		//Time in milliseconds the cycle collector may use per frame, 0 disables it
+		uint32_t cycleCollectorBudget;
+		//Memory in megabytes used for cached textures before the least recently used are evicted, 0 means no limit
+		uint32_t textureMemoryBudget;
+		//Specifies if solid vector shapes are drawn as triangles instead of cairo textures
+		bool shapeTessellationEnabled;
 		Config();
 		~Config();
 	public:
@@ -64,6 +72,10 @@ namespace lightspark
 		const std::string& getGnashPath() const { return gnashPath; }
 
 		bool isRenderingEnabled() const { return renderingEnabled; }
+		bool isPreloadCacheEnabled() const { return preloadCacheEnabled; }
+		uint32_t getCycleCollectorBudget() const { return cycleCollectorBudget; }
+		uint32_t getTextureMemoryBudget() const { return textureMemoryBudget; }
+		bool isShapeTessellationEnabled() const { return shapeTessellationEnabled; }
 	};
 }
 
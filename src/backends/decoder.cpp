@@ -1294,6 +1294,17 @@ StreamDecoder::~StreamDecoder()
 	delete videoDecoder;
 }
 
+void StreamDecoder::getMetrics(StreamDecoderMetrics& m) const
+{
+	if (videoDecoder)
+	{
+		m.queuedVideoFrames = videoDecoder->getQueuedFrames();
+		m.droppedVideoFrames = videoDecoder->framesdropped;
+	}
+	if (audioDecoder)
+		m.queuedAudioFrames = audioDecoder->getFilled();
+}
+
 #ifdef ENABLE_LIBAVCODEC
 FFMpegStreamDecoder::FFMpegStreamDecoder(NetStream *ns, EngineData *eng, std::istream& s, AudioFormat* format, int streamsize, bool forExtraction)
  : netstream(ns),audioFound(false),videoFound(false),stream(s),formatCtx(nullptr),audioIndex(-1),
@@ -110,6 +110,8 @@ public:
 	virtual bool discardFrame()=0;
 	virtual uint32_t skipUntil(uint32_t time)=0;
 	virtual void skipAll()=0;
+	// number of decoded frames waiting to be rendered
+	virtual uint32_t getQueuedFrames() const { return 0; }
 	uint32_t getWidth()
 	{
 		return frameWidth;
@@ -243,6 +245,10 @@ public:
 	bool discardFrame() override;
 	uint32_t skipUntil(uint32_t time) override;
 	void skipAll() override;
+	uint32_t getQueuedFrames() const override
+	{
+		return embeddedvideotag ? embeddedbuffers.len() : streamingbuffers.len();
+	}
 	void setFlushing() override
 	{
 		flushing=true;
@@ -420,6 +426,26 @@ public:
 };
 #endif
 
+/*
+ * Backpressure statistics of a StreamDecoder, from the demuxed packets
+ * waiting for decoding to the decoded frames waiting for rendering
+ */
+struct StreamDecoderMetrics
+{
+	uint32_t queuedPackets;
+	uint32_t maxQueuedPackets;
+	uint32_t queuedVideoFrames;
+	uint32_t queuedAudioFrames;
+	uint32_t droppedVideoFrames;
+	// packets that were demuxed but never decoded
+	uint32_t droppedPackets;
+	// packets decoded in place from the stream cache and packets that had to be copied
+	uint32_t inPlacePackets;
+	uint32_t copiedPackets;
+	StreamDecoderMetrics():queuedPackets(0),maxQueuedPackets(0),queuedVideoFrames(0),queuedAudioFrames(0),
+		droppedVideoFrames(0),droppedPackets(0),inPlacePackets(0),copiedPackets(0) {}
+};
+
 class StreamDecoder
 {
 public:
@@ -427,6 +453,9 @@ public:
 	virtual ~StreamDecoder();
 	virtual bool decodeNextFrame() = 0;
 	virtual void jumpToPosition(number_t position) = 0;
+	// stream position after the last decoded frame, -1 at the end of the stream
+	virtual int64_t getStreamPosition() = 0;
+	virtual void getMetrics(StreamDecoderMetrics& m) const;
 	bool isValid() const { return valid; }
 	AudioDecoder* audioDecoder;
 	VideoDecoder* videoDecoder;
@@ -465,6 +494,7 @@ public:
 	~FFMpegStreamDecoder();
 	void jumpToPosition(number_t position) override;
 	bool decodeNextFrame() override;
+	int64_t getStreamPosition() override { return stream.tellg(); }
 	int getAudioSampleRate();
 };
 #endif
@@ -24,6 +24,7 @@
 #include <list>
 #include <vector>
 #include <map>
+#include <memory>
 
 namespace lightspark
 {
@@ -101,10 +102,56 @@ struct GeomToken
 	}
 };
 
+/*
+ * A list of tokens that is shared copy-on-write, so the tokens generated from a tag
+ * are not copied for every instance and every draw job. The non-const accessors make
+ * the list unique first, iterators obtained from them must not be kept across copies
+ */
+class tokenList
+{
+private:
+	std::shared_ptr<std::vector<uint64_t>> list;
+	std::vector<uint64_t>& unique()
+	{
+		if(!list)
+			list=std::make_shared<std::vector<uint64_t>>();
+		else if(list.use_count()>1)
+			list=std::make_shared<std::vector<uint64_t>>(*list);
+		return *list;
+	}
+public:
+	typedef std::vector<uint64_t>::iterator iterator;
+	typedef std::vector<uint64_t>::const_iterator const_iterator;
+	const std::vector<uint64_t>& getVector() const
+	{
+		static const std::vector<uint64_t> emptylist;
+		return list ? *list : emptylist;
+	}
+	operator const std::vector<uint64_t>&() const { return getVector(); }
+	operator std::vector<uint64_t>&() { return unique(); }
+	// true if both lists use the same storage
+	bool isSharedWith(const tokenList& o) const { return list && list==o.list; }
+	const_iterator begin() const { return getVector().begin(); }
+	const_iterator end() const { return getVector().end(); }
+	iterator begin() { return unique().begin(); }
+	iterator end() { return unique().end(); }
+	uint64_t operator[](size_t i) const { return (*list)[i]; }
+	uint64_t& operator[](size_t i) { return unique()[i]; }
+	size_t size() const { return list ? list->size() : 0; }
+	bool empty() const { return !list || list->empty(); }
+	void clear() { list.reset(); }
+	void reserve(size_t n) { unique().reserve(n); }
+	void push_back(uint64_t v) { unique().push_back(v); }
+	template<class... Args>
+	void emplace_back(Args&&... args) { unique().emplace_back(std::forward<Args>(args)...); }
+	template<class It>
+	void assign(It first, It last) { unique().assign(first,last); }
+};
+
 struct tokensVector
 {
-	std::vector<uint64_t> filltokens;
-	std::vector<uint64_t> stroketokens;
+	tokenList filltokens;
+	tokenList stroketokens;
 	RECT boundsRect;
 	bool canRenderToGL;
 	tokensVector():canRenderToGL(false) {}
@@ -27,6 +27,7 @@
 #include "backends/rendering.h"
 #include "backends/config.h"
 #include "compat.h"
+#include "platforms/pixelkernels.h"
 #include "scripting/flash/geom/flashgeom.h"
 #include "scripting/flash/text/flashtext.h"
 #include "scripting/flash/display/BitmapData.h"
@@ -67,6 +68,9 @@ TextureChunk& TextureChunk::operator=(const TextureChunk& r)
 	uint32_t blocksW=(width+CHUNKSIZE_REAL-1)/CHUNKSIZE_REAL;
 	uint32_t blocksH=(height+CHUNKSIZE_REAL-1)/CHUNKSIZE_REAL;
 	texId=r.texId;
+	allocatedChunks=r.allocatedChunks;
+	generation=r.generation;
+	contentVersion=r.contentVersion;
 	if(r.chunks)
 	{
 		chunks=new uint32_t[blocksW*blocksH];
@@ -93,6 +97,7 @@ void TextureChunk::makeEmpty()
 	width=0;
 	height=0;
 	texId=0;
+	allocatedChunks=0;
 	if (chunks)
 		delete[] chunks;
 	chunks=nullptr;
@@ -121,6 +126,124 @@ bool TextureChunk::resizeIfLargeEnough(uint32_t w, uint32_t h)
 	return false;
 }
 
+ATOMIC_INT32(ShapeRasterCache::hits);
+ATOMIC_INT32(ShapeRasterCache::misses);
+
+bool ShapeRasterCache::Key::operator<(const Key& r) const
+{
+	if(ratio!=r.ratio)
+		return ratio<r.ratio;
+	if(xbucket!=r.xbucket)
+		return xbucket<r.xbucket;
+	if(ybucket!=r.ybucket)
+		return ybucket<r.ybucket;
+	return smoothing<r.smoothing;
+}
+
+int32_t ShapeRasterCache::getScaleBucket(float scale)
+{
+	if(!(scale>0))
+		return INT16_MIN;
+	return std::max(int32_t(ceilf(log2f(scale)*4)),int32_t(INT16_MIN));
+}
+
+float ShapeRasterCache::getBucketScale(int32_t bucket)
+{
+	return exp2f(bucket/4.0f);
+}
+
+ShapeRasterCache::Entry* ShapeRasterCache::acquire(uint32_t ratio, float& xscale, float& yscale, bool smoothing, Entry* previous, RenderThread* rt, bool& rasterNeeded)
+{
+	Key k;
+	k.ratio=ratio;
+	k.xbucket=getScaleBucket(xscale);
+	k.ybucket=getScaleBucket(yscale);
+	k.smoothing=smoothing;
+	xscale=getBucketScale(k.xbucket);
+	yscale=getBucketScale(k.ybucket);
+	Locker l(mutex);
+	Entry* e=&entries[k];
+	if(e!=previous)
+	{
+		e->users++;
+		if(previous)
+			previous->users--;
+	}
+	//The chunks may have been evicted to make room for other surfaces
+	rasterNeeded=!e->rasterPending && (!e->chunk.isValid() || rt->isEvicted(e->chunk));
+	if(rasterNeeded)
+	{
+		e->rasterPending=true;
+		misses++;
+	}
+	else if(e!=previous)
+		hits++;
+	return e;
+}
+
+void ShapeRasterCache::release(Entry* e)
+{
+	Locker l(mutex);
+	assert(e->users);
+	e->users--;
+}
+
+TextureChunk& ShapeRasterCache::allocateChunk(Entry* e, uint32_t w, uint32_t h, RenderThread* rt)
+{
+	Locker l(mutex);
+	releaseUnusedLocked(rt,e);
+	e->rasterPending=false;
+	if(rt->isEvicted(e->chunk))
+		e->chunk.makeEmpty();
+	if(!e->chunk.resizeIfLargeEnough(w, h))
+		e->chunk=rt->allocateTexture(w, h,false,true);
+	return e->chunk;
+}
+
+void ShapeRasterCache::rasterFailed(Entry* e)
+{
+	Locker l(mutex);
+	e->rasterPending=false;
+}
+
+void ShapeRasterCache::releaseUnused(RenderThread* rt)
+{
+	Locker l(mutex);
+	releaseUnusedLocked(rt,nullptr);
+}
+
+void ShapeRasterCache::releaseUnusedLocked(RenderThread* rt, const Entry* keep)
+{
+	for(auto it=entries.begin();it!=entries.end();it++)
+	{
+		Entry& e=it->second;
+		if(&e==keep || e.users || e.rasterPending || !e.chunk.isValid())
+			continue;
+		//The entry is kept, so that stale pointers to the chunk only see an empty texture
+		rt->releaseTexture(e.chunk);
+		e.chunk.makeEmpty();
+	}
+}
+
+void ShapeRasterCache::logStatistics()
+{
+	if(hits || misses)
+		LOG(LOG_INFO,"shared shape rasters: "<<hits<<" reused, "<<misses<<" rasterized");
+}
+
+void CachedSurface::setSharedTexture(TextureChunk* t, RenderThread* rt)
+{
+	if(tex==t)
+		return;
+	if(isChunkOwner && tex)
+	{
+		rt->releaseTexture(*tex);
+		delete tex;
+	}
+	tex=t;
+	isChunkOwner=false;
+}
+
 CairoRenderer::CairoRenderer(const MATRIX& _m, int32_t _x, int32_t _y, int32_t _w, int32_t _h, int32_t _rx, int32_t _ry, int32_t _rw, int32_t _rh, float _r, float _xs, float _ys, bool _im, _NR<DisplayObject> _mask,
 		float _s, float _a, const std::vector<MaskData>& _ms,
 		float _redMultiplier,float _greenMultiplier,float _blueMultiplier,float _alphaMultiplier,
@@ -701,6 +824,14 @@ bool CairoTokenRenderer::hitTest(const tokensVector& tokens, float scaleFactor,
 	return ret;
 }
 
+void CairoTokenRenderer::drawTokens(cairo_t* cr, const tokensVector& tokens, float scaleFactor)
+{
+	cairo_save(cr);
+	cairo_set_fill_rule(cr, CAIRO_FILL_RULE_EVEN_ODD);
+	cairoPathFromTokens(cr, tokens, scaleFactor, false,false,0,0);
+	cairo_restore(cr);
+}
+
 void CairoTokenRenderer::applyCairoMask(cairo_t* cr,int32_t xOffset,int32_t yOffset) const
 {
 	cairo_matrix_t mat;
@@ -736,39 +867,15 @@ void CairoRenderer::convertBitmapWithAlphaToCairo(std::vector<uint8_t, reporter_
 
 	for(uint32_t i = 0; i < height; i++)
 	{
-		for(uint32_t j = 0; j < width; j++)
-		{
-			uint32_t* outDataPos = (uint32_t*)(outData+i*(*stride)) + j;
-			// PNGs are always decoded in RGBA
-			*outDataPos = frompng ? inData[i*(*stride)+j*4+3]<<24 | inData[i*(*stride)+j*4  ]<<16 | inData[i*(*stride)+j*4+1]<<8 | inData[i*(*stride)+j*4+2]
-								  : inData[i*(*stride)+j*4  ]<<24 | inData[i*(*stride)+j*4+1]<<16 | inData[i*(*stride)+j*4+2]<<8 | inData[i*(*stride)+j*4+3];
-		}
+		uint32_t* outRow = (uint32_t*)(outData+i*(*stride));
+		// PNGs are always decoded in RGBA
+		if (frompng)
+			pixelConvertRGBAToNative(outRow, inData+i*(*stride), width);
+		else
+			pixelConvertARGBToNative(outRow, inData+i*(*stride), width, false);
 	}
 }
 
-inline void CairoRenderer::copyRGB15To24(uint32_t& dest, uint8_t* src)
-{
-	// highest bit is ignored
-	uint8_t r = (src[0] & 0x7C) >> 2;
-	uint8_t g = ((src[0] & 0x03) << 3) + (src[1] & 0xE0 >> 5);
-	uint8_t b = src[1] & 0x1F;
-
-	r = r*255/31;
-	g = g*255/31;
-	b = b*255/31;
-
-	dest |= uint32_t(r)<<16;
-	dest |= uint32_t(g)<<8;
-	dest |= uint32_t(b);
-}
-
-inline void CairoRenderer::copyRGB24To24(uint32_t& dest, uint8_t* src)
-{
-	dest |= uint32_t(src[0])<<16;
-	dest |= uint32_t(src[1])<<8;
-	dest |= uint32_t(src[2]);
-}
-
 void CairoRenderer::convertBitmapToCairo(std::vector<uint8_t, reporter_allocator<uint8_t>>& data, uint8_t* inData, uint32_t width,
 					 uint32_t height, size_t* dataSize, size_t* stride, uint32_t bpp)
 {
@@ -778,25 +885,19 @@ void CairoRenderer::convertBitmapToCairo(std::vector<uint8_t, reporter_allocator
 	uint8_t* outData = &data[0];
 	for(uint32_t i = 0; i < height; i++)
 	{
-		for(uint32_t j = 0; j < width; j++)
+		uint32_t* outRow = (uint32_t*)(outData+i*(*stride));
+		// the alpha channel is set to opaque
+		switch (bpp)
 		{
-			uint32_t* outDataPos = (uint32_t*)(outData+i*(*stride)) + j;
-			// set the alpha channel to opaque
-			uint32_t pdata = uint32_t(0xFF)<<24;
-			// copy the RGB bytes to pdata
-			switch (bpp)
-			{
-				case 2:
-					copyRGB15To24(pdata, inData+(i*width+j)*2);
-					break;
-				case 3:
-					copyRGB24To24(pdata, inData+(i*width+j)*3);
-					break;
-				case 4:
-					copyRGB24To24(pdata, inData+(i*width+j)*4+1);
-					break;
-			}
-			*outDataPos = pdata;
+			case 2:
+				pixelConvertRGB15ToNative(outRow, inData+i*width*2, width);
+				break;
+			case 3:
+				pixelConvertRGB24ToNative(outRow, inData+i*width*3, width);
+				break;
+			case 4:
+				pixelConvertARGBToNative(outRow, inData+i*width*4, width, true);
+				break;
 		}
 	}
 }
@@ -1006,13 +1107,19 @@ void CairoPangoRenderer::applyCairoMask(cairo_t* cr, int32_t xOffset, int32_t yO
 	assert(false);
 }
 
-AsyncDrawJob::AsyncDrawJob(IDrawable* d, _R<DisplayObject> o):drawable(d),owner(o),surfaceBytes(nullptr),uploadNeeded(false),isBufferOwner(true)
+AsyncDrawJob::AsyncDrawJob(IDrawable* d, _R<DisplayObject> o):drawable(d),owner(o),surfaceBytes(nullptr),uploadNeeded(false),isBufferOwner(true),
+	ownerUpdateNeeded(true),chunkAllocated(false),benchmarkFrame(FrameBenchmark::NO_FRAME)
 {
+	if (owner->getSystemState()->benchmark)
+		benchmarkFrame=owner->getSystemState()->benchmark->getCurrentFrame();
 }
 
 AsyncDrawJob::~AsyncDrawJob()
 {
 	owner->getSystemState()->AsyncDrawJobCompleted(this);
+	//Let the next user of the entry schedule the rasterization again
+	if(drawable->getRasterEntry() && !chunkAllocated)
+		drawable->getRasterCache()->rasterFailed(drawable->getRasterEntry());
 	delete drawable;
 	if (surfaceBytes && isBufferOwner)
 		delete[] surfaceBytes;
@@ -1020,12 +1127,22 @@ AsyncDrawJob::~AsyncDrawJob()
 
 void AsyncDrawJob::execute()
 {
+	//Superseded while queued, don't waste time on the rasterization
+	if(threadAborting)
+	{
+		owner->getSystemState()->AsyncDrawJobSuperseded(false);
+		return;
+	}
+	Chronometer chronometer;
 	owner->startDrawJob();
-	if(!threadAborting)
-		surfaceBytes=drawable->getPixelBuffer(&isBufferOwner);
+	surfaceBytes=drawable->getPixelBuffer(&isBufferOwner);
 	if(!threadAborting && surfaceBytes)
 		uploadNeeded=true;
+	else if(threadAborting)
+		owner->getSystemState()->AsyncDrawJobSuperseded(true);
 	owner->endDrawJob();
+	if (owner->getSystemState()->benchmark)
+		owner->getSystemState()->benchmark->accountTime(FrameBenchmark::RENDER,chronometer.checkpoint(),benchmarkFrame);
 }
 
 void AsyncDrawJob::threadAbort()
@@ -1065,14 +1182,29 @@ TextureChunk& AsyncDrawJob::getTexture()
 	CachedSurface& surface=owner->cachedSurface;
 	uint32_t width=drawable->getWidth();
 	uint32_t height=drawable->getHeight();
-	//Verify that the texture is large enough
-	if (!surface.tex)
+	RenderThread* rt=owner->getSystemState()->getRenderThread();
+	if (drawable->getRasterEntry())
 	{
-		surface.tex=new TextureChunk();
-		surface.isChunkOwner=true;
+		chunkAllocated=true;
+		TextureChunk& chunk=drawable->getRasterCache()->allocateChunk(drawable->getRasterEntry(),width,height,rt);
+		if (!ownerUpdateNeeded)
+			return chunk;
+		surface.setSharedTexture(&chunk,rt);
+	}
+	else
+	{
+		//Verify that the texture is large enough
+		if (!surface.tex)
+		{
+			surface.tex=new TextureChunk();
+			surface.isChunkOwner=true;
+		}
+		//The chunks may have been evicted to make room for other surfaces
+		if(rt->isEvicted(*surface.tex))
+			surface.tex->makeEmpty();
+		if(!surface.tex->resizeIfLargeEnough(width, height))
+			*surface.tex=rt->allocateTexture(width, height,false,true);
 	}
-	if(!surface.tex->resizeIfLargeEnough(width, height))
-		*surface.tex=owner->getSystemState()->getRenderThread()->allocateTexture(width, height,false);
 	surface.xOffset=drawable->getXOffset();
 	surface.yOffset=drawable->getYOffset();
 	surface.xOffsetTransformed=drawable->getXOffsetTransformed();
@@ -25,6 +25,7 @@
 
 #include "compat.h"
 #include <vector>
+#include <map>
 #include "swftypes.h"
 #include "threading.h"
 #include <cairo.h>
@@ -38,6 +39,7 @@ namespace lightspark
 class DisplayObject;
 class InvalidateQueue;
 class ColorTransform;
+class RenderThread;
 
 class TextureChunk
 {
@@ -53,6 +55,12 @@ private:
 	 */
 	uint32_t* chunks = nullptr;
 	uint32_t texId = 0;
+	// number of chunks reserved in the texture, width and height may shrink afterwards
+	uint32_t allocatedChunks = 0;
+	// generation of the texture when the chunks were reserved, see GLRenderContext::LargeTexture
+	uint32_t generation = 0;
+	// changed by the RenderThread whenever new content is uploaded to the chunks
+	uint32_t contentVersion = 0;
 	TextureChunk(uint32_t w, uint32_t h);
 public:
 	TextureChunk() {}
@@ -107,6 +115,64 @@ public:
 	bool smoothing;
 	bool isChunkOwner;
 	bool isValid;
+	// points tex to a chunk owned by someone else, the own chunk is released (RenderThread only)
+	void setSharedTexture(TextureChunk* t, RenderThread* rt);
+};
+
+/*
+ * Rasterizations of a DefineShape or DefineMorphShape tag that are shared by all
+ * instances drawn at a similar scale. Rotation, alpha and color transforms are
+ * applied when the texture is drawn, so an entry only depends on the morph ratio,
+ * the smoothing flag and the scale, rounded up to the next quarter of an octave
+ */
+class ShapeRasterCache
+{
+public:
+	class Entry
+	{
+	friend class ShapeRasterCache;
+	private:
+		// number of instances whose cached surface uses the chunk
+		uint32_t users;
+		// an AsyncDrawJob is currently drawing the chunk
+		bool rasterPending;
+	public:
+		Entry():users(0),rasterPending(false) {}
+		TextureChunk chunk;
+	};
+private:
+	struct Key
+	{
+		uint32_t ratio;
+		int32_t xbucket;
+		int32_t ybucket;
+		bool smoothing;
+		bool operator<(const Key& r) const;
+	};
+	Mutex mutex;
+	// std::map keeps the entries at stable addresses
+	std::map<Key,Entry> entries;
+	static ATOMIC_INT32(hits);
+	static ATOMIC_INT32(misses);
+	void releaseUnusedLocked(RenderThread* rt, const Entry* keep);
+public:
+	// bucket of a scale factor, getBucketScale(getScaleBucket(s))>=s
+	static int32_t getScaleBucket(float scale);
+	static float getBucketScale(int32_t bucket);
+	/*
+	 * Called by the main thread when an instance is invalidated. Rounds xscale and yscale to the
+	 * scale of the entry, moves the user of the previous entry of the instance to the returned one and
+	 * sets rasterNeeded if the caller has to schedule an AsyncDrawJob to draw the chunk
+	 */
+	Entry* acquire(uint32_t ratio, float& xscale, float& yscale, bool smoothing, Entry* previous, RenderThread* rt, bool& rasterNeeded);
+	void release(Entry* e);
+	// called by the RenderThread before the rasterization of an entry is uploaded
+	TextureChunk& allocateChunk(Entry* e, uint32_t w, uint32_t h, RenderThread* rt);
+	// called if a scheduled rasterization was never uploaded
+	void rasterFailed(Entry* e);
+	// called by the RenderThread, frees the textures of entries without users
+	void releaseUnused(RenderThread* rt);
+	static void logStatistics();
 };
 
 
@@ -129,6 +195,8 @@ public:
 		NOTE: fence may be called on shutdown even if the upload has not happen, so be ready for this event
 	*/
 	virtual void uploadFence()=0;
+	// index of the benchmarked frame that requested the upload, UINT32_MAX for the frame laid out last
+	virtual uint32_t getBenchmarkFrame() const { return UINT32_MAX; }
 };
 
 class IDrawable
@@ -181,6 +249,10 @@ protected:
 	  The whole transformation matrix that is applied to the rendered object
 	*/
 	MATRIX matrix;
+	// set if the raster is shared with other instances of the same tag
+	ShapeRasterCache* rasterCache;
+	ShapeRasterCache::Entry* rasterEntry;
+	bool rasterNeeded;
 public:
 	IDrawable(int32_t w, int32_t h, int32_t x, int32_t y,
 		int32_t rw, int32_t rh, int32_t rx, int32_t ry, float r,
@@ -194,7 +266,8 @@ public:
 		alpha(a), xscale(xs), yscale(ys), xContentScale(xcs), yContentScale(ycs),
 		redMultiplier(_redMultiplier),greenMultiplier(_greenMultiplier),blueMultiplier(_blueMultiplier),alphaMultiplier(_alphaMultiplier),
 		redOffset(_redOffset),greenOffset(_greenOffset),blueOffset(_blueOffset),alphaOffset(_alphaOffset),
-		isMask(im),mask(_mask),smoothing(_smoothing), matrix(_m) {}
+		isMask(im),mask(_mask),smoothing(_smoothing), matrix(_m),
+		rasterCache(nullptr),rasterEntry(nullptr),rasterNeeded(false) {}
 	virtual ~IDrawable();
 	/*
 	 * This method returns a raster buffer of the image
@@ -234,6 +307,15 @@ public:
 	float getBlueOffset() const { return blueOffset; }
 	float getAlphaOffset() const { return alphaOffset; }
 	MATRIX& getMatrix() { return matrix; }
+	void setSharedRaster(ShapeRasterCache* c, ShapeRasterCache::Entry* e, bool needed)
+	{
+		rasterCache=c;
+		rasterEntry=e;
+		rasterNeeded=needed;
+	}
+	ShapeRasterCache* getRasterCache() const { return rasterCache; }
+	ShapeRasterCache::Entry* getRasterEntry() const { return rasterEntry; }
+	bool isRasterNeeded() const { return rasterNeeded; }
 };
 
 class AsyncDrawJob: public IThreadJob, public ITextureUploadable
@@ -248,6 +330,11 @@ private:
 	uint8_t* surfaceBytes;
 	bool uploadNeeded;
 	bool isBufferOwner;
+	// cleared when a newer job or refresh of the owner supersedes this one
+	volatile bool ownerUpdateNeeded;
+	bool chunkAllocated;
+	// the frame of the FrameBenchmark that created the job, the rasterization is charged to it
+	uint32_t benchmarkFrame;
 public:
 	/*
 	 * @param o The DisplayObject that is being rendered. It is a reference to
@@ -261,14 +348,22 @@ public:
 	void execute() override;
 	void threadAbort() override;
 	void jobFence() override;
+	JOB_PRIORITY getJobPriority() const override { return JOB_PRIORITY_HIGH; }
 	//ITextureUploadable interface
 	uint8_t* upload(bool refresh) override;
 	void sizeNeeded(uint32_t& w, uint32_t& h) const override;
 	TextureChunk& getTexture() override;
 	void uploadFence() override;
+	uint32_t getBenchmarkFrame() const override { return benchmarkFrame; }
 	void contentScale(float& x, float& y) const override;
 	void contentOffset(float& x, float& y) const override;
 	DisplayObject* getOwner() { return owner.getPtr(); }
+	bool isSharedRaster() const { return drawable->getRasterEntry(); }
+	/*
+	 * Shared rasterizations are still needed by the other users of the
+	 * entry, so they are completed without touching the owner's surface
+	 */
+	void detachOwner() { ownerUpdateNeeded=false; }
 };
 
 /**
@@ -286,8 +381,6 @@ protected:
 	static void cairoClean(cairo_t* cr);
 	cairo_surface_t* allocateSurface(uint8_t*& buf);
 	virtual void executeDraw(cairo_t* cr)=0;
-	static void copyRGB15To24(uint32_t& dest, uint8_t* src);
-	static void copyRGB24To24(uint32_t& dest, uint8_t* src);
 public:
 	CairoRenderer(const MATRIX& _m, int32_t _x, int32_t _y, int32_t _w, int32_t _h
 				  , int32_t _rx, int32_t _ry, int32_t _rw, int32_t _rh, float _r
@@ -360,6 +453,11 @@ public:
 	   @param y The Y in local coordinates
 	*/
 	static bool hitTest(const tokensVector& tokens, float scaleFactor, number_t x, number_t y);
+	/*
+	   Draws the tokens with the current transformation of cr, without masks
+	   and color transformation. Used to compare other renderers with cairo
+	*/
+	static void drawTokens(cairo_t* cr, const tokensVector& tokens, float scaleFactor);
 };
 struct textline
 {
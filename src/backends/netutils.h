@@ -176,8 +176,9 @@ private:
 	ACQUIRE_RELEASE_FLAG(fenceState);
 public:
 	void enableFencingWaiting();
-	void jobFence();
+	void jobFence() override;
 	void waitFencing();
+	JOB_PRIORITY getJobPriority() const override { return JOB_PRIORITY_LOW; }
 protected:
 	//Abstract base class, can not be constructed
 	ThreadedDownloader(const tiny_string& url, _R<StreamCache> cache, ILoadable* o);
@@ -247,11 +248,12 @@ protected:
 			      _NR<EventDispatcher> dispatcher=NullRef,
 			      ILoadable* owner=NULL,
 			      bool checkPolicyFile=true);
-	void jobFence();
+	void jobFence() override;
 public:
 	DownloaderThreadBase(_NR<URLRequest> request, IDownloaderThreadListener* listener);
-	void execute()=0;
-	void threadAbort();
+	void execute() override =0;
+	void threadAbort() override;
+	JOB_PRIORITY getJobPriority() const override { return JOB_PRIORITY_LOW; }
 };
 
 };
@@ -22,6 +22,7 @@
 #include "parsing/textfile.h"
 #include "backends/rendering.h"
 #include "backends/input.h"
+#include "backends/config.h"
 #include "compat.h"
 #include <sstream>
 #include <unistd.h>
@@ -34,6 +35,8 @@
 using namespace lightspark;
 using namespace std;
 
+//Memory used by the vertices of tessellated shapes before the least recently used are dropped
+#define SHAPE_MESH_CACHE_BUDGET (32*1024*1024)
 
 DEFINE_AND_INITIALIZE_TLS(renderThread);
 RenderThread* lightspark::getRenderThread()
@@ -58,11 +61,14 @@ void RenderThread::wait()
 
 RenderThread::RenderThread(SystemState* s):GLRenderContext(),
 	m_sys(s),status(CREATED),
-	prevUploadJob(nullptr),
 	renderNeeded(false),uploadNeeded(false),resizeNeeded(false),newTextureNeeded(false),event(0),newWidth(0),newHeight(0),scaleX(1),scaleY(1),
-	offsetX(0),offsetY(0),tempBufferAcquired(false),frameCount(0),secsCount(0),initialized(0),refreshNeeded(false),screenshotneeded(false),inSettings(false),canrender(false),
+	offsetX(0),offsetY(0),tempBufferAcquired(false),frameCount(0),secsCount(0),stageframebuffer(0),stageTextureID(0),uploadSerial(0),fullRedrawNeeded(true),
+	shapeMeshes(SHAPE_MESH_CACHE_BUDGET),initialized(0),refreshNeeded(false),screenshotneeded(false),inSettings(false),canrender(false),
 	cairoTextureContextSettings(nullptr),cairoTextureContext(nullptr)
 {
+	textureMemoryBudget=uint64_t(Config::getConfig()->getTextureMemoryBudget())*1024*1024;
+	evictionCount=0;
+	texturesEvicted=false;
 	LOG(LOG_INFO,"RenderThread this=" << this);
 #ifdef _WIN32
 	fontPath = "TimesNewRoman.ttf";
@@ -104,29 +110,39 @@ void RenderThread::handleNewTexture()
 
 void RenderThread::finalizeUpload()
 {
-	ITextureUploadable* u=prevUploadJob;
-	uint32_t w,h;
-	u->sizeNeeded(w,h);
-	TextureChunk& tex=u->getTexture();
-	u->contentScale(tex.xContentScale, tex.yContentScale);
-	u->contentOffset(tex.xOffset, tex.yOffset);
-	loadChunkBGRA(tex, w, h, u->upload(false));
-	u->uploadFence();
-	prevUploadJob=nullptr;
+	Chronometer chronometer;
+	for(auto it=prevUploadJobs.begin();it!=prevUploadJobs.end();it++)
+	{
+		ITextureUploadable* u=*it;
+		uint32_t w,h;
+		u->sizeNeeded(w,h);
+		TextureChunk& tex=u->getTexture();
+		u->contentScale(tex.xContentScale, tex.yContentScale);
+		u->contentOffset(tex.xOffset, tex.yOffset);
+		tex.contentVersion=++uploadSerial;
+		loadChunkBGRA(tex, w, h, u->upload(false));
+		uint32_t benchmarkFrame=u->getBenchmarkFrame();
+		u->uploadFence();
+		if (m_sys->benchmark)
+			m_sys->benchmark->accountTime(FrameBenchmark::UPLOAD,chronometer.checkpoint(),benchmarkFrame);
+	}
+	prevUploadJobs.clear();
 }
 
 void RenderThread::handleUpload()
 {
-	ITextureUploadable* u=getUploadJob();
-	assert(u);
-	uint32_t w,h;
-	u->sizeNeeded(w,h);
-	
-	//force creation of buffer if neccessary
-	u->upload(true);
-	//Get the texture to be sure it's allocated when the upload comes
-	u->getTexture();
-	prevUploadJob=u;
+	Chronometer chronometer;
+	//All pending jobs are handled in the same iteration
+	getUploadJobs(prevUploadJobs);
+	for(auto it=prevUploadJobs.begin();it!=prevUploadJobs.end();it++)
+	{
+		//force creation of buffer if neccessary
+		(*it)->upload(true);
+		//Get the texture to be sure it's allocated when the upload comes
+		(*it)->getTexture();
+		if (m_sys->benchmark)
+			m_sys->benchmark->accountTime(FrameBenchmark::UPLOAD,chronometer.checkpoint(),(*it)->getBenchmarkFrame());
+	}
 }
 
 /*
@@ -188,8 +204,9 @@ int RenderThread::worker(void* d)
 	th->status=TERMINATED;
 	//Fence existing jobs
 	th->mutexUploadJobs.lock();
-	if(th->prevUploadJob)
-		th->prevUploadJob->uploadFence();
+	for(auto i=th->prevUploadJobs.begin(); i != th->prevUploadJobs.end(); ++i)
+		(*i)->uploadFence();
+	th->prevUploadJobs.clear();
 	for(auto i=th->uploadJobs.begin(); i != th->uploadJobs.end(); ++i)
 		(*i)->uploadFence();
 	th->mutexUploadJobs.unlock();
@@ -221,8 +238,14 @@ bool RenderThread::doRender(ThreadProfile* profile,Chronometer* chronometer)
 	}
 	if(newTextureNeeded)
 		handleNewTexture();
+	if(texturesEvicted)
+	{
+		//Draw the owners of the evicted chunks again
+		texturesEvicted=false;
+		m_sys->stage->requestInvalidation(m_sys,true);
+	}
 
-	if(prevUploadJob)
+	if(!prevUploadJobs.empty())
 		finalizeUpload();
 	if (refreshNeeded)
 	{
@@ -512,14 +535,18 @@ void RenderThread::commonGLDeinit()
 {
 	engineData->exec_glBindFramebuffer_GL_FRAMEBUFFER(0);
 	engineData->exec_glFrontFace(false);
+	logTextureStatistics();
+	ShapeRasterCache::logStatistics();
 	for(uint32_t i=0;i<largeTextures.size();i++)
 	{
 		engineData->exec_glDeleteTextures(1,&largeTextures[i].id);
 		delete[] largeTextures[i].bitmap;
 	}
+	solidColorTexture.makeEmpty();
 	engineData->exec_glDeleteTextures(1, &cairoTextureID);
 	engineData->exec_glDeleteTextures(1, &cairoTextureIDSettings);
 	engineData->exec_glDeleteTextures(1, &maskTextureID);
+	engineData->exec_glDeleteTextures(1, &stageTextureID);
 }
 
 void RenderThread::commonGLInit(int width, int height)
@@ -576,6 +603,10 @@ void RenderThread::commonGLInit(int width, int height)
 	maskframebuffer = engineData->exec_glGenFramebuffer();
 	engineData->exec_glGenTextures(1, &maskTextureID);
 
+	// create framebuffer for the stage
+	stageframebuffer = engineData->exec_glGenFramebuffer();
+	engineData->exec_glGenTextures(1, &stageTextureID);
+
 	if(handleGLErrors())
 	{
 		LOG(LOG_ERROR,"GL errors during initialization");
@@ -613,8 +644,19 @@ void RenderThread::commonGLResize()
 	engineData->exec_glFramebufferTexture2D_GL_FRAMEBUFFER(maskTextureID);
 	engineData->exec_glTexImage2D_GL_TEXTURE_2D_GL_UNSIGNED_BYTE(0, windowWidth,windowHeight, 0, nullptr,true);
 	engineData->exec_glViewport(0,0,windowWidth,windowHeight);
-	engineData->exec_glBindFramebuffer_GL_FRAMEBUFFER(0);
 	engineData->exec_glActiveTexture_GL_TEXTURE0(0);
+
+	// setup stage framebuffer, its content is lost
+	engineData->exec_glBindTexture_GL_TEXTURE_2D(stageTextureID);
+	engineData->exec_glBindFramebuffer_GL_FRAMEBUFFER(stageframebuffer);
+	engineData->exec_glTexParameteri_GL_TEXTURE_2D_GL_TEXTURE_MIN_FILTER_GL_NEAREST();
+	engineData->exec_glTexParameteri_GL_TEXTURE_2D_GL_TEXTURE_MAG_FILTER_GL_NEAREST();
+	engineData->exec_glFramebufferTexture2D_GL_FRAMEBUFFER(stageTextureID);
+	engineData->exec_glTexImage2D_GL_TEXTURE_2D_GL_UNSIGNED_BYTE(0, windowWidth,windowHeight, 0, nullptr,true);
+	engineData->exec_glViewport(0,0,windowWidth,windowHeight);
+	fullRedrawNeeded=true;
+
+	engineData->exec_glBindFramebuffer_GL_FRAMEBUFFER(0);
 	engineData->exec_glBindTexture_GL_TEXTURE_2D(0);
 	engineData->exec_glDisable_GL_DEPTH_TEST();
 	engineData->exec_glDisable_GL_STENCIL_TEST();
@@ -763,26 +805,179 @@ void RenderThread::plotProfilingData()
 
 }
 
-bool RenderThread::coreRendering()
+bool RenderThread::computeDamage(int32_t& xmin, int32_t& ymin, int32_t& xmax, int32_t& ymax) const
+{
+	bool damaged=false;
+	auto addDamage=[&](const renderedQuad& q)
+	{
+		xmin=damaged ? min(xmin,q.xmin) : q.xmin;
+		ymin=damaged ? min(ymin,q.ymin) : q.ymin;
+		xmax=damaged ? max(xmax,q.xmax) : q.xmax;
+		ymax=damaged ? max(ymax,q.ymax) : q.ymax;
+		damaged=true;
+	};
+	//Quads are drawn in the same order in every frame, so both lists are walked in parallel.
+	//Quads inserted or removed in the current frame are found by looking a few quads ahead
+	const uint32_t resyncWindow=8;
+	uint32_t i=0,j=0;
+	while(i<prevRenderedQuads.size() && j<renderedQuads.size())
+	{
+		if(memcmp(&prevRenderedQuads[i],&renderedQuads[j],sizeof(renderedQuad))==0)
+		{
+			i++;
+			j++;
+			continue;
+		}
+		bool resynced=false;
+		for(uint32_t k=1;k<=resyncWindow && !resynced;k++)
+		{
+			if(j+k<renderedQuads.size() && memcmp(&prevRenderedQuads[i],&renderedQuads[j+k],sizeof(renderedQuad))==0)
+			{
+				//Quads were added
+				for(uint32_t n=j;n<j+k;n++)
+					addDamage(renderedQuads[n]);
+				j+=k;
+				resynced=true;
+			}
+			else if(i+k<prevRenderedQuads.size() && memcmp(&prevRenderedQuads[i+k],&renderedQuads[j],sizeof(renderedQuad))==0)
+			{
+				//Quads were removed
+				for(uint32_t n=i;n<i+k;n++)
+					addDamage(prevRenderedQuads[n]);
+				i+=k;
+				resynced=true;
+			}
+		}
+		if(!resynced)
+		{
+			//The quad was changed
+			addDamage(prevRenderedQuads[i++]);
+			addDamage(renderedQuads[j++]);
+		}
+	}
+	for(;i<prevRenderedQuads.size();i++)
+		addDamage(prevRenderedQuads[i]);
+	for(;j<renderedQuads.size();j++)
+		addDamage(renderedQuads[j]);
+	return damaged;
+}
+
+void RenderThread::blitStageFramebuffer()
 {
-	Locker l(mutexRendering);
 	engineData->exec_glBindFramebuffer_GL_FRAMEBUFFER(0);
-	engineData->exec_glFrontFace(false);
 	engineData->exec_glDrawBuffer_GL_BACK();
-	//Clear the back buffer
-	RGB bg=m_sys->mainClip->getBackground();
-	engineData->exec_glClearColor(bg.Red/255.0F,bg.Green/255.0F,bg.Blue/255.0F,1);
-	engineData->exec_glClear_GL_COLOR_BUFFER_BIT();
-	engineData->exec_glUseProgram(gpu_program);
+	engineData->exec_glBlendFunc(BLEND_ONE,BLEND_ONE_MINUS_SRC_ALPHA);
+	engineData->exec_glUniform1f(yuvUniform, 0);
+	engineData->exec_glUniform1f(alphaUniform, 1);
+	engineData->exec_glUniform1f(maskUniform, 0);
+	engineData->exec_glUniform1f(directUniform, 0);
+	engineData->exec_glUniform4f(colortransMultiplyUniform, 1.0,1.0,1.0,1.0);
+	engineData->exec_glUniform4f(colortransAddUniform, 0.0,0.0,0.0,0.0);
 	lsglLoadIdentity();
 	setMatrixUniform(LSGL_MODELVIEW);
+	engineData->exec_glBindTexture_GL_TEXTURE_2D(stageTextureID);
+
+	//The projection matrix maps the stage to the window, the texture has the GL orientation
+	float x0=-offsetX;
+	float y0=-offsetY;
+	float x1=float(windowWidth)-offsetX;
+	float y1=float(windowHeight)-offsetY;
+	float vertex_coords[] = {x0,y0, x1,y0, x0,y1, x1,y1};
+	float texture_coords[] = {0,1, 1,1, 0,0, 1,0};
+	engineData->exec_glVertexAttribPointer(VERTEX_ATTRIB, 0, vertex_coords,FLOAT_2);
+	engineData->exec_glVertexAttribPointer(TEXCOORD_ATTRIB, 0, texture_coords,FLOAT_2);
+	engineData->exec_glEnableVertexAttribArray(VERTEX_ATTRIB);
+	engineData->exec_glEnableVertexAttribArray(TEXCOORD_ATTRIB);
+	engineData->exec_glDrawArrays_GL_TRIANGLE_STRIP(0, 4);
+	engineData->exec_glDisableVertexAttribArray(VERTEX_ATTRIB);
+	engineData->exec_glDisableVertexAttribArray(TEXCOORD_ATTRIB);
+}
 
+bool RenderThread::renderStageFramebuffer(const RGB& bg)
+{
+	//Collect the quads of the frame without drawing anything
+	renderedQuads.clear();
+	directDrawingUsed=false;
+	collectingQuads=true;
+	currentMask=nullptr;
+	lsglLoadIdentity();
 	bool ret = m_sys->stage->Render(*this);
+	collectingQuads=false;
+
+	//Objects drawn directly (i.e. with nanovg) are not known to the comparison
+	bool fullRedraw=fullRedrawNeeded || directDrawingUsed || bg.toUInt()!=lastBackground.toUInt();
+	int32_t xmin=0,ymin=0,xmax=0,ymax=0;
+	if(fullRedraw || computeDamage(xmin,ymin,xmax,ymax))
+	{
+		targetFramebuffer=stageframebuffer;
+		engineData->exec_glBindFramebuffer_GL_FRAMEBUFFER(stageframebuffer);
+		if(!fullRedraw)
+		{
+			//Only draw the damaged area, in window coordinates with the GL orientation
+			int32_t x=max(int32_t(offsetX)+xmin,0);
+			int32_t y=max(int32_t(windowHeight)-(int32_t(offsetY)+ymax),0);
+			int32_t w=min(int32_t(offsetX)+xmax,int32_t(windowWidth))-x;
+			int32_t h=min(int32_t(windowHeight)-(int32_t(offsetY)+ymin),int32_t(windowHeight))-y;
+			engineData->exec_glScissor(x,y,max(w,0),max(h,0));
+		}
+		//Clear the stage
+		engineData->exec_glClearColor(bg.Red/255.0F,bg.Green/255.0F,bg.Blue/255.0F,1);
+		engineData->exec_glClear_GL_COLOR_BUFFER_BIT();
+		setProperties(BLENDMODE_NORMAL);
+		currentMask=nullptr;
+		lsglLoadIdentity();
+		setMatrixUniform(LSGL_MODELVIEW);
+		ret = m_sys->stage->Render(*this);
+		if(!fullRedraw)
+			engineData->exec_glDisable_GL_SCISSOR_TEST();
+		targetFramebuffer=0;
+		prevRenderedQuads.swap(renderedQuads);
+		fullRedrawNeeded=false;
+		lastBackground=bg;
+	}
+	blitStageFramebuffer();
+	return ret;
+}
+
+bool RenderThread::coreRendering()
+{
+	Chronometer chronometer;
+	//The display list drawn is the one of the frame laid out last
+	uint32_t benchmarkFrame=m_sys->benchmark ? m_sys->benchmark->getLayoutFrame() : FrameBenchmark::NO_FRAME;
+	Locker l(mutexRendering);
+	currentFrame++;
+	engineData->exec_glFrontFace(false);
+	engineData->exec_glUseProgram(gpu_program);
+	RGB bg=m_sys->mainClip->getBackground();
+	bool ret;
+	if (m_sys->stage->renderStage3D())
+	{
+		//Stage3D draws directly to the window, the stage framebuffer is drawn completely in the next frame without it
+		fullRedrawNeeded=true;
+		engineData->exec_glBindFramebuffer_GL_FRAMEBUFFER(0);
+		engineData->exec_glDrawBuffer_GL_BACK();
+		//Clear the back buffer
+		engineData->exec_glClearColor(bg.Red/255.0F,bg.Green/255.0F,bg.Blue/255.0F,1);
+		engineData->exec_glClear_GL_COLOR_BUFFER_BIT();
+		currentMask=nullptr;
+		lsglLoadIdentity();
+		setMatrixUniform(LSGL_MODELVIEW);
+		ret = m_sys->stage->Render(*this);
+	}
+	else
+		ret = renderStageFramebuffer(bg);
 
 	if(m_sys->showProfilingData)
 		plotProfilingData();
 
 	handleGLErrors();
+	if (m_sys->benchmark)
+	{
+		m_sys->benchmark->accountTime(FrameBenchmark::RENDER,chronometer.checkpoint(),benchmarkFrame);
+		TextureStatistics stats;
+		getTextureStatistics(stats);
+		m_sys->benchmark->setTextureStatistics(benchmarkFrame,stats);
+	}
 	return ret;
 }
 
@@ -858,16 +1053,14 @@ void RenderThread::addUploadJob(ITextureUploadable* u)
 	event.signal();
 }
 
-ITextureUploadable* RenderThread::getUploadJob()
+void RenderThread::getUploadJobs(std::vector<ITextureUploadable*>& jobs)
 {
 	mutexUploadJobs.lock();
 	assert(!uploadJobs.empty());
-	ITextureUploadable* ret=uploadJobs.front();
-	uploadJobs.pop_front();
-	if(uploadJobs.empty())
-		uploadNeeded=false;
+	jobs.insert(jobs.end(),uploadJobs.begin(),uploadJobs.end());
+	uploadJobs.clear();
+	uploadNeeded=false;
 	mutexUploadJobs.unlock();
-	return ret;
 }
 
 void RenderThread::draw(bool force)
@@ -901,17 +1094,28 @@ void RenderThread::tickFence()
 
 void RenderThread::releaseTexture(const TextureChunk& chunk)
 {
-	uint32_t blocksW=(chunk.width+CHUNKSIZE-1)/CHUNKSIZE;
-	uint32_t blocksH=(chunk.height+CHUNKSIZE-1)/CHUNKSIZE;
-	uint32_t numberOfBlocks=blocksW*blocksH;
 	Locker l(mutexLargeTexture);
+	if(chunk.chunks==nullptr || chunk.texId>=largeTextures.size())
+		return;
 	LargeTexture& tex=largeTextures[chunk.texId];
-	for(uint32_t i=0;i<numberOfBlocks;i++)
-	{
-		uint32_t bitOffset=chunk.chunks[i];
-		assert(tex.bitmap[bitOffset/8]&(1<<(bitOffset%8)));
-		tex.bitmap[bitOffset/8]^=(1<<(bitOffset%8));
-	}
+	//The chunks were already reclaimed by an eviction
+	if(chunk.generation!=tex.generation)
+		return;
+	for(uint32_t i=0;i<chunk.allocatedChunks;i++)
+		tex.setFree(chunk.chunks[i]);
+}
+
+const TextureChunk& RenderThread::getSolidColorTexture()
+{
+	if(!solidColorTexture.isValid())
+		solidColorTexture=allocateTexture(1, 1, true);
+	return solidColorTexture;
+}
+
+bool RenderThread::isEvicted(const TextureChunk& chunk)
+{
+	Locker l(mutexLargeTexture);
+	return chunk.chunks && chunk.texId<largeTextures.size() && chunk.generation!=largeTextures[chunk.texId].generation;
 }
 
 uint32_t RenderThread::allocateNewGLTexture() const
@@ -934,105 +1138,112 @@ uint32_t RenderThread::allocateNewGLTexture() const
 	return tmp;
 }
 
-RenderThread::LargeTexture& RenderThread::allocateNewTexture()
+RenderThread::LargeTexture& RenderThread::allocateNewTexture(bool evictable)
 {
 	//Signal that a new texture is needed
 	newTextureNeeded=true;
 	//Let's allocate the bitmap for the texture blocks, minumum block size is CHUNKSIZE
-	uint32_t bitmapSize=(largeTextureSize/CHUNKSIZE)*(largeTextureSize/CHUNKSIZE)/8;
+	uint32_t blocks=(largeTextureSize/CHUNKSIZE)*(largeTextureSize/CHUNKSIZE);
+	uint32_t bitmapSize=blocks/8;
 	uint8_t* bitmap=new uint8_t[bitmapSize];
 	memset(bitmap,0,bitmapSize);
-	largeTextures.emplace_back(bitmap);
+	largeTextures.emplace_back(bitmap,blocks,evictable);
+	largeTextures.back().lastUsedFrame=currentFrame;
 	return largeTextures.back();
 }
 
+int32_t RenderThread::findEvictableTexture() const
+{
+	int32_t ret=-1;
+	for(uint32_t i=0;i<largeTextures.size();i++)
+	{
+		const LargeTexture& tex=largeTextures[i];
+		//Textures used in this frame may still be uploaded or drawn
+		if(!tex.evictable || tex.lastUsedFrame==currentFrame)
+			continue;
+		if(ret==-1 || tex.lastUsedFrame<largeTextures[ret].lastUsedFrame)
+			ret=i;
+	}
+	return ret;
+}
+
+void RenderThread::evictTexture(LargeTexture& tex)
+{
+	uint32_t blocks=(largeTextureSize/CHUNKSIZE)*(largeTextureSize/CHUNKSIZE);
+	memset(tex.bitmap,0,blocks/8);
+	tex.freeBlocks=blocks;
+	tex.generation++;
+	evictionCount++;
+	texturesEvicted=true;
+	LOG(LOG_CALLS,"evicting cached surfaces from texture " << tex.id);
+}
+
 bool RenderThread::allocateChunkOnTextureCompact(LargeTexture& tex, TextureChunk& ret, uint32_t blocksW, uint32_t blocksH)
 {
-	//Find a contiguos set of blocks
-	uint32_t start;
+	//Find a free rectangle of blocks, it must not wrap around the border of the texture
 	uint32_t blockPerSide=largeTextureSize/CHUNKSIZE;
-	uint32_t bitmapSize=blockPerSide*blockPerSide;
-	for(start=0;start<bitmapSize;start++)
+	if(tex.freeBlocks<blocksW*blocksH || blocksW>blockPerSide || blocksH>blockPerSide)
+		return false;
+	for(uint32_t y=0;y+blocksH<=blockPerSide;y++)
 	{
-		bool badRect=false;
-		//TODO: correct rect lookup
-		for(uint32_t i=0;i<blocksH;i++)
+		uint32_t x=0;
+		while(x+blocksW<=blockPerSide)
 		{
-			for(uint32_t j=0;j<blocksW;j++)
+			//Skip past the rightmost used block of the candidate rectangle
+			uint32_t nextX=x;
+			for(uint32_t i=0;i<blocksH;i++)
 			{
-				uint32_t bitOffset=start+i*blockPerSide+j;
-				if(bitOffset>=bitmapSize)
+				for(uint32_t j=blocksW;j>nextX-x;j--)
 				{
-					badRect=true;
-					break;
+					if(tex.isUsed((y+i)*blockPerSide+x+j-1))
+					{
+						nextX=x+j;
+						break;
+					}
 				}
-				if(tex.bitmap[bitOffset/8]&(1<<(bitOffset%8)))
+			}
+			if(nextX==x)
+			{
+				//Now set all those blocks are used
+				for(uint32_t i=0;i<blocksH;i++)
 				{
-					badRect=true;
-					break;
+					for(uint32_t j=0;j<blocksW;j++)
+					{
+						uint32_t bitOffset=(y+i)*blockPerSide+x+j;
+						tex.setUsed(bitOffset);
+						ret.chunks[i*blocksW+j]=bitOffset;
+					}
 				}
+				return true;
 			}
-			if(badRect)
-				break;
-		}
-		if(!badRect)
-			break;
-	}
-	if(start==bitmapSize)
-		return false;
-	//Now set all those blocks are used
-	for(uint32_t i=0;i<blocksH;i++)
-	{
-		for(uint32_t j=0;j<blocksW;j++)
-		{
-			uint32_t bitOffset=start+i*blockPerSide+j;
-			tex.bitmap[bitOffset/8]|=1<<(bitOffset%8);
-			ret.chunks[i*blocksW+j]=bitOffset;
+			x=nextX;
 		}
 	}
-	return true;
+	return false;
 }
 
 bool RenderThread::allocateChunkOnTextureSparse(LargeTexture& tex, TextureChunk& ret, uint32_t blocksW, uint32_t blocksH)
 {
 	//Allocate a sparse set of texture chunks
-	uint32_t found=0;
+	uint32_t needed=blocksW*blocksH;
+	if(tex.freeBlocks<needed)
+		return false;
 	uint32_t blockPerSide=largeTextureSize/CHUNKSIZE;
 	uint32_t bitmapSize=blockPerSide*blockPerSide;
-	//TODO: use the already allocated array
-	uint32_t* tmp=new uint32_t[blocksW*blocksH];
-	for(uint32_t i=0;i<bitmapSize;i++)
-	{
-		if((tex.bitmap[i/8]&(1<<(i%8)))==0)
-		{
-			tex.bitmap[i/8]|=1<<(i%8);
-			tmp[found]=i;
-			found++;
-			if(found==(blocksW*blocksH))
-				break;
-		}
-	}
-	if(found<blocksW*blocksH)
+	uint32_t found=0;
+	for(uint32_t i=0;i<bitmapSize && found<needed;i++)
 	{
-		//This is considered the unfrequent case
-		for(uint32_t i=0;i<found;i++)
+		if(!tex.isUsed(i))
 		{
-			uint32_t bitOffset=tmp[i];
-			assert(tex.bitmap[bitOffset/8]&(1<<(bitOffset%8)));
-			tex.bitmap[bitOffset/8]^=(1<<(bitOffset%8));
+			tex.setUsed(i);
+			ret.chunks[found++]=i;
 		}
-		delete[] tmp;
-		return false;
-	}
-	else
-	{
-		delete[] ret.chunks;
-		ret.chunks=tmp;
-		return true;
 	}
+	assert(found==needed);
+	return true;
 }
 
-TextureChunk RenderThread::allocateTexture(uint32_t w, uint32_t h, bool compact)
+TextureChunk RenderThread::allocateTexture(uint32_t w, uint32_t h, bool compact, bool evictable)
 {
 	assert(w && h);
 	Locker l(mutexLargeTexture);
@@ -1040,29 +1251,43 @@ TextureChunk RenderThread::allocateTexture(uint32_t w, uint32_t h, bool compact)
 	TextureChunk ret(w, h);
 	uint32_t blocksW=(ret.width+CHUNKSIZE_REAL-1)/CHUNKSIZE_REAL;
 	uint32_t blocksH=(ret.height+CHUNKSIZE_REAL-1)/CHUNKSIZE_REAL;
-	//Try to find a good place in the available textures
+	//Try to find a good place in the available textures, evictable chunks are kept apart from the others
 	uint32_t index=0;
 	for(index=0;index<largeTextures.size();index++)
 	{
-		if(compact)
+		LargeTexture& tex=largeTextures[index];
+		if(tex.evictable!=evictable)
+			continue;
+		if(compact ? allocateChunkOnTextureCompact(tex, ret, blocksW, blocksH) : allocateChunkOnTextureSparse(tex, ret, blocksW, blocksH))
 		{
-			if(allocateChunkOnTextureCompact(largeTextures[index], ret, blocksW, blocksH))
-			{
-				ret.texId=index;
-				return ret;
-			}
+			ret.texId=index;
+			ret.allocatedChunks=blocksW*blocksH;
+			ret.generation=tex.generation;
+			tex.lastUsedFrame=currentFrame;
+			return ret;
 		}
-		else
+	}
+	//No place found, reuse the least recently used texture if the budget is exhausted, otherwise allocate a new one
+	int32_t evictIndex=-1;
+	if(evictable && textureMemoryBudget)
+	{
+		uint64_t used=0;
+		for(auto it=largeTextures.begin();it!=largeTextures.end();it++)
 		{
-			if(allocateChunkOnTextureSparse(largeTextures[index], ret, blocksW, blocksH))
-			{
-				ret.texId=index;
-				return ret;
-			}
+			if(it->evictable)
+				used+=uint64_t(largeTextureSize)*largeTextureSize*4;
 		}
+		if(used>=textureMemoryBudget)
+			evictIndex=findEvictableTexture();
 	}
-	//No place found, allocate a new one and try on that
-	LargeTexture& tex=allocateNewTexture();
+	if(evictIndex>=0)
+	{
+		index=evictIndex;
+		evictTexture(largeTextures[index]);
+	}
+	else
+		allocateNewTexture(evictable);
+	LargeTexture& tex=largeTextures[index];
 	bool done;
 	if(compact)
 		done=allocateChunkOnTextureCompact(tex, ret, blocksW, blocksH);
@@ -1075,56 +1300,114 @@ TextureChunk RenderThread::allocateTexture(uint32_t w, uint32_t h, bool compact)
 		ret.makeEmpty();
 	}
 	else
+	{
 		ret.texId=index;
+		ret.allocatedChunks=blocksW*blocksH;
+		ret.generation=tex.generation;
+		tex.lastUsedFrame=currentFrame;
+	}
 	return ret;
 }
 
+void RenderThread::getTextureStatistics(TextureStatistics& stats)
+{
+	Locker l(mutexLargeTexture);
+	stats=TextureStatistics();
+	stats.evictions=evictionCount;
+	if(largeTextures.empty())
+		return;
+	uint32_t blockPerSide=largeTextureSize/CHUNKSIZE;
+	uint32_t totalBlocks=0;
+	uint32_t freeBlocks=0;
+	uint32_t freeRuns=0;
+	for(auto it=largeTextures.begin();it!=largeTextures.end();it++)
+	{
+		stats.textures++;
+		if(it->evictable)
+			stats.evictableTextures++;
+		totalBlocks+=blockPerSide*blockPerSide;
+		freeBlocks+=it->freeBlocks;
+		//Count the horizontal runs of free blocks, many short runs mean a fragmented texture
+		for(uint32_t y=0;y<blockPerSide;y++)
+		{
+			for(uint32_t x=0;x<blockPerSide;x++)
+			{
+				uint32_t b=y*blockPerSide+x;
+				if(!it->isUsed(b) && (x==0 || it->isUsed(b-1)))
+					freeRuns++;
+			}
+		}
+	}
+	uint32_t minRuns=(freeBlocks+blockPerSide-1)/blockPerSide;
+	stats.occupancy=100.0*(totalBlocks-freeBlocks)/totalBlocks;
+	stats.fragmentation=freeBlocks>minRuns ? 100.0*(freeRuns-minRuns)/(freeBlocks-minRuns) : 0;
+}
+
+void RenderThread::logTextureStatistics()
+{
+	TextureStatistics stats;
+	getTextureStatistics(stats);
+	if(stats.textures==0)
+		return;
+	LOG(LOG_INFO,"textures: " << stats.textures << " of " << largeTextureSize << "x" << largeTextureSize <<
+		", occupancy " << stats.occupancy << "%, fragmentation " << stats.fragmentation << "%, " <<
+		stats.evictions << " evictions");
+}
+
 void RenderThread::loadChunkBGRA(const TextureChunk& chunk, uint32_t w, uint32_t h, uint8_t* data)
 {
 	//Fast bailout if the TextureChunk is not valid
 	if(chunk.chunks==nullptr || data == nullptr)
 		return;
-	engineData->exec_glBindTexture_GL_TEXTURE_2D(largeTextures[chunk.texId].id);
-	//TODO: Detect continuos
+	LargeTexture& tex=largeTextures[chunk.texId];
+	if(chunk.generation!=tex.generation)
+		return;
+	tex.lastUsedFrame=currentFrame;
+	engineData->exec_glBindTexture_GL_TEXTURE_2D(tex.id);
 	//The size is ok if doesn't grow over the allocated size
 	//this allows some alignment freedom
 	const uint32_t numberOfChunks=chunk.getNumberOfChunks();
 	const uint32_t blocksPerSide=largeTextureSize/CHUNKSIZE;
 	const uint32_t blocksW=((w+CHUNKSIZE_REAL-1)/CHUNKSIZE_REAL);
-	uint8_t data_clamp[4*CHUNKSIZE*CHUNKSIZE];
-	for(uint32_t i=0;i<numberOfChunks;i++)
+	uint32_t i=0;
+	while(i<numberOfChunks)
 	{
 		uint32_t curX=(i%blocksW)*CHUNKSIZE_REAL;
 		uint32_t curY=(i/blocksW)*CHUNKSIZE_REAL;
-		if (curX > w || curY > h)
+		if (curX >= w || curY >= h)
 			break;
-		uint32_t sizeX=min(int(w-curX),CHUNKSIZE_REAL)+2;
-		uint32_t sizeY=min(int(h-curY),CHUNKSIZE_REAL)+2;
+		const uint32_t sizeY=min(int(h-curY),CHUNKSIZE_REAL)+2;
 		const uint32_t blockX=((chunk.chunks[i]%blocksPerSide)*CHUNKSIZE);
 		const uint32_t blockY=((chunk.chunks[i]/blocksPerSide)*CHUNKSIZE);
 
-		// copy chunk data
-		for(uint32_t j=1;j<sizeY-1;j++) {
-			memcpy(data_clamp+4*j*sizeX+4, data+4*w*((j-1)+curY)+4*curX, (sizeX-2)*4);
-		}
-		for (uint32_t j = 0; j < sizeY; j++)
+		//Chunks of the same row that are also adjacent in the texture are uploaded with one call,
+		//all of them but the last one have the full width
+		uint32_t spanEnd=i+1;
+		while(spanEnd<numberOfChunks && spanEnd%blocksW!=0 &&
+			chunk.chunks[spanEnd]==chunk.chunks[spanEnd-1]+1 && chunk.chunks[spanEnd]%blocksPerSide!=0)
+			spanEnd++;
+		const uint32_t lastX=((spanEnd-1)%blocksW)*CHUNKSIZE_REAL;
+		const uint32_t spanWidth=(spanEnd-1-i)*CHUNKSIZE+min(int(w-lastX),CHUNKSIZE_REAL)+2;
+		if(uploadStaging.size()<4*spanWidth*sizeY)
+			uploadStaging.resize(4*spanWidth*sizeY);
+
+		//Copy the data and clamp the borders to the edge in one pass
+		uint8_t* dst=uploadStaging.data();
+		for(uint32_t j=0;j<sizeY;j++)
 		{
-			// clamp left border to edge
-			data_clamp[j*sizeX*4  ] = data_clamp[j*sizeX*4+4  ];
-			data_clamp[j*sizeX*4+1] = data_clamp[j*sizeX*4+4+1];
-			data_clamp[j*sizeX*4+2] = data_clamp[j*sizeX*4+4+2];
-			data_clamp[j*sizeX*4+3] = data_clamp[j*sizeX*4+4+3];
-	
-			// clamp right border to edge
-			data_clamp[j*sizeX*4 + (sizeX-1)*4  ] = data_clamp[j*sizeX*4 + (sizeX-2)*4  ];
-			data_clamp[j*sizeX*4 + (sizeX-1)*4+1] = data_clamp[j*sizeX*4 + (sizeX-2)*4+1];
-			data_clamp[j*sizeX*4 + (sizeX-1)*4+2] = data_clamp[j*sizeX*4 + (sizeX-2)*4+2];
-			data_clamp[j*sizeX*4 + (sizeX-1)*4+3] = data_clamp[j*sizeX*4 + (sizeX-2)*4+3];
+			const uint32_t srcY=curY+min(max(int(j)-1,0),int(sizeY)-3);
+			const uint8_t* srcrow=data+4*w*srcY;
+			for(uint32_t k=i;k<spanEnd;k++)
+			{
+				const uint32_t x=(k%blocksW)*CHUNKSIZE_REAL;
+				const uint32_t n=min(int(w-x),CHUNKSIZE_REAL);
+				memcpy(dst,srcrow+4*x,4);
+				memcpy(dst+4,srcrow+4*x,4*n);
+				memcpy(dst+4*(n+1),srcrow+4*(x+n-1),4);
+				dst+=4*(n+2);
+			}
 		}
-		// clamp top border to edge
-		memcpy(data_clamp, data_clamp+4*sizeX, sizeX*4);
-		// clamp bottom border to edge
-		memcpy(data_clamp+(sizeY-1)*sizeX*4, data_clamp+(sizeY-2)*sizeX*4, sizeX*4);
-		engineData->exec_glTexSubImage2D_GL_TEXTURE_2D(0, blockX, blockY, sizeX, sizeY, data_clamp);
+		engineData->exec_glTexSubImage2D_GL_TEXTURE_2D(0, blockX, blockY, spanWidth, sizeY, uploadStaging.data());
+		i=spanEnd;
 	}
 }
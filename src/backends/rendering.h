@@ -21,6 +21,7 @@
 #define BACKENDS_RENDERING_H 1
 
 #include "backends/rendering_context.h"
+#include "backends/tessellator.h"
 #include "timer.h"
 #include <SDL2/SDL.h>
 #include <sys/time.h>
@@ -32,6 +33,21 @@ namespace lightspark
 {
 class ThreadProfile;
 
+/*
+ * Usage of the large textures the texture chunks are allocated in
+ */
+struct TextureStatistics
+{
+	uint32_t textures;
+	uint32_t evictableTextures;
+	// used blocks in percent of all blocks
+	float occupancy;
+	// 0 if the free blocks are in as few runs as possible, 100 if every free block is isolated
+	float fragmentation;
+	uint32_t evictions;
+	TextureStatistics():textures(0),evictableTextures(0),occupancy(0),fragmentation(0),evictions(0) {}
+};
+
 class DLL_PUBLIC RenderThread: public ITickJob, public GLRenderContext
 {
 friend class DisplayObject;
@@ -47,9 +63,22 @@ private:
 	void commonGLInit(int width, int height);
 	void commonGLResize();
 	void commonGLDeinit();
-	ITextureUploadable* prevUploadJob;
+	// jobs prepared by handleUpload, they are loaded into their textures on the next iteration
+	std::vector<ITextureUploadable*> prevUploadJobs;
+	// reused by loadChunkBGRA to build the clamped texture data
+	std::vector<uint8_t> uploadStaging;
 	uint32_t allocateNewGLTexture() const;
-	LargeTexture& allocateNewTexture();
+	LargeTexture& allocateNewTexture(bool evictable);
+	// returns the index of the least recently used evictable texture that was not used in this frame, or -1
+	int32_t findEvictableTexture() const;
+	void evictTexture(LargeTexture& tex);
+	// maximum memory used by evictable textures, 0 means no limit
+	uint64_t textureMemoryBudget;
+	uint32_t evictionCount;
+	// set when textures were evicted, the stage has to be drawn again
+	volatile bool texturesEvicted;
+	// see getSolidColorTexture
+	TextureChunk solidColorTexture;
 	bool allocateChunkOnTextureCompact(LargeTexture& tex, TextureChunk& ret, uint32_t blocksW, uint32_t blocksH);
 	bool allocateChunkOnTextureSparse(LargeTexture& tex, TextureChunk& ret, uint32_t blocksW, uint32_t blocksH);
 	//Possible events to be handled
@@ -81,14 +110,31 @@ private:
 	Mutex mutexUploadJobs;
 	std::deque<ITextureUploadable*> uploadJobs;
 	/*
-		Utility to get a job to do
+		Utility to get all pending jobs
 	*/
-	ITextureUploadable* getUploadJob();
+	void getUploadJobs(std::vector<ITextureUploadable*>& jobs);
 	/*
 		Common code to handle the core of the rendering
 		returns true if at least one of the displayobjects on the stage couldn't be rendered becaus of an AsyncDrawJob not done yet
 	*/
 	bool coreRendering();
+	/*
+		The stage is drawn to stageframebuffer, which is copied to the window in every frame.
+		Only the area covered by quads that changed since the last frame is drawn again
+	*/
+	uint32_t stageframebuffer;
+	uint32_t stageTextureID;
+	// quads drawn to the stage framebuffer in the last frame
+	std::vector<renderedQuad> prevRenderedQuads;
+	// incremented on every texture upload, see TextureChunk::contentVersion
+	uint32_t uploadSerial;
+	bool fullRedrawNeeded;
+	RGB lastBackground;
+	bool renderStageFramebuffer(const RGB& bg);
+	// computes the bounds of all quads that differ between the last and the current frame, returns false if nothing changed
+	bool computeDamage(int32_t& xmin, int32_t& ymin, int32_t& xmax, int32_t& ymax) const;
+	void blitStageFramebuffer();
+	ShapeMeshCache shapeMeshes;
 	void plotProfilingData();
 	Semaphore initialized;
 	volatile bool refreshNeeded;
@@ -146,12 +192,25 @@ public:
 	}
 	/**
 		Allocates a chunk from the shared texture
+		Evictable chunks may be reclaimed when the texture memory budget is exceeded,
+		their owner has to check isEvicted() before using them
 	*/
-	TextureChunk allocateTexture(uint32_t w, uint32_t h, bool compact);
+	TextureChunk allocateTexture(uint32_t w, uint32_t h, bool compact, bool evictable=false);
 	/**
 		Release texture
 	*/
 	void releaseTexture(const TextureChunk& chunk);
+	bool isEvicted(const TextureChunk& chunk);
+	/**
+		1x1 chunk for the quads that are drawn with a direct color (borders, backgrounds, carets).
+		It is allocated once, so these quads are identical in every frame
+	*/
+	const TextureChunk& getSolidColorTexture();
+	/**
+		Occupancy and fragmentation of the shared textures
+	*/
+	void getTextureStatistics(TextureStatistics& stats);
+	void logTextureStatistics();
 	/**
 		Load the given data in the given texture chunk
 	*/
@@ -160,6 +219,13 @@ public:
 		Enqueue something to be uploaded to texture
 	*/
 	void addUploadJob(ITextureUploadable* u);
+	/**
+		Get the cached mesh of the tokens, returns nullptr if they can't be tessellated
+	*/
+	const ShapeMesh* getShapeMesh(const tokensVector& tokens, float scaling, float scale)
+	{
+		return shapeMeshes.getMesh(tokens,scaling,scale,currentFrame);
+	}
 
 	void requestResize(uint32_t w, uint32_t h, bool force);
 	void waitForInitialization()
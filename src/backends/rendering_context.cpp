@@ -32,7 +32,10 @@
 #include <cstring>
 #include <stack>
 #include "backends/rendering_context.h"
+#include "backends/tessellator.h"
 #include "logger.h"
+#include "swf.h"
+#include "thread_pool.h"
 #include "scripting/flash/display/flashdisplay.h"
 
 using namespace std;
@@ -126,6 +129,9 @@ const CachedSurface& GLRenderContext::getCachedSurface(const DisplayObject* d) c
 
 void GLRenderContext::setProperties(AS_BLENDMODE blendmode)
 {
+	currentBlendMode=blendmode;
+	if (collectingQuads)
+		return;
 	// TODO handle other blend modes ,maybe with shaders ? (see https://github.com/jamieowen/glsl-blend)
 	switch (blendmode)
 	{
@@ -151,6 +157,69 @@ void GLRenderContext::renderTextured(const TextureChunk& chunk, float alpha, COL
 									 float redOffset, float greenOffset, float blueOffset, float alphaOffset,
 									 bool isMask, bool hasMask, float directMode, RGB directColor, bool smooth, const MATRIX& matrix)
 {
+	LargeTexture& tex=largeTextures[chunk.texId];
+	//The chunks were evicted, the owner will be drawn again
+	if (chunk.generation!=tex.generation)
+		return;
+	tex.lastUsedFrame=currentFrame;
+	if (collectingQuads)
+	{
+		renderedQuad q;
+		//The quads are compared with memcmp, so the padding has to be cleared too
+		memset(&q,0,sizeof(q));
+		q.texId=chunk.texId;
+		q.generation=chunk.generation;
+		q.contentVersion=chunk.contentVersion;
+		q.firstChunk=chunk.chunks[0];
+		q.width=chunk.width;
+		q.height=chunk.height;
+		q.xOffset=chunk.xOffset;
+		q.yOffset=chunk.yOffset;
+		q.xContentScale=chunk.xContentScale;
+		q.yContentScale=chunk.yContentScale;
+		q.matrix[0]=matrix.xx;
+		q.matrix[1]=matrix.yx;
+		q.matrix[2]=matrix.xy;
+		q.matrix[3]=matrix.yy;
+		q.matrix[4]=matrix.x0;
+		q.matrix[5]=matrix.y0;
+		q.colorTransform[0]=redMultiplier;
+		q.colorTransform[1]=greenMultiplier;
+		q.colorTransform[2]=blueMultiplier;
+		q.colorTransform[3]=alphaMultiplier;
+		q.colorTransform[4]=redOffset;
+		q.colorTransform[5]=greenOffset;
+		q.colorTransform[6]=blueOffset;
+		q.colorTransform[7]=alphaOffset;
+		q.alpha=alpha;
+		q.directMode=directMode;
+		q.directColor=directColor.toUInt();
+		q.colorMode=colorMode;
+		q.blendMode=currentBlendMode;
+		q.flags=(isMask ? 1 : 0)|(hasMask ? 2 : 0)|(smooth ? 4 : 0);
+		//Bounds of the transformed quad, with a margin for the filtering of the texture
+		number_t xmin=0,ymin=0,xmax=0,ymax=0;
+		for(uint32_t i=0;i<4;i++)
+		{
+			number_t x=((i&1) ? chunk.width : 0)+chunk.xOffset;
+			number_t y=((i&2) ? chunk.height : 0)+chunk.yOffset;
+			matrix.multiply2D(x/chunk.xContentScale,y/chunk.yContentScale,x,y);
+			if(i==0 || x<xmin)
+				xmin=x;
+			if(i==0 || x>xmax)
+				xmax=x;
+			if(i==0 || y<ymin)
+				ymin=y;
+			if(i==0 || y>ymax)
+				ymax=y;
+		}
+		q.xmin=floor(xmin)-2;
+		q.ymin=floor(ymin)-2;
+		q.xmax=ceil(xmax)+2;
+		q.ymax=ceil(ymax)+2;
+		renderedQuads.push_back(q);
+		return;
+	}
 	if (isMask)
 	{
 		engineData->exec_glBindFramebuffer_GL_FRAMEBUFFER(maskframebuffer);
@@ -186,7 +255,7 @@ void GLRenderContext::renderTextured(const TextureChunk& chunk, float alpha, COL
 	lsglLoadMatrixf(fmatrix);
 	setMatrixUniform(LSGL_MODELVIEW);
 
-	engineData->exec_glBindTexture_GL_TEXTURE_2D(largeTextures[chunk.texId].id);
+	engineData->exec_glBindTexture_GL_TEXTURE_2D(tex.id);
 	const uint32_t blocksPerSide=largeTextureSize/CHUNKSIZE;
 	float startX, startY, endX, endY;
 	assert(chunk.getNumberOfChunks()==((chunk.width+CHUNKSIZE_REAL-1)/CHUNKSIZE_REAL)*((chunk.height+CHUNKSIZE_REAL-1)/CHUNKSIZE_REAL));
@@ -272,7 +341,7 @@ void GLRenderContext::renderTextured(const TextureChunk& chunk, float alpha, COL
 	engineData->exec_glDisableVertexAttribArray(VERTEX_ATTRIB);
 	engineData->exec_glDisableVertexAttribArray(TEXCOORD_ATTRIB);
 	if (isMask)
-		engineData->exec_glBindFramebuffer_GL_FRAMEBUFFER(0);
+		engineData->exec_glBindFramebuffer_GL_FRAMEBUFFER(targetFramebuffer);
 	if (!smooth)
 	{
 		engineData->exec_glTexParameteri_GL_TEXTURE_2D_GL_TEXTURE_MIN_FILTER_GL_LINEAR();
@@ -280,6 +349,79 @@ void GLRenderContext::renderTextured(const TextureChunk& chunk, float alpha, COL
 	}
 }
 
+void GLRenderContext::renderMesh(const ShapeMesh& mesh, float alpha,
+								 float redMultiplier, float greenMultiplier, float blueMultiplier, float alphaMultiplier,
+								 float redOffset, float greenOffset, float blueOffset, float alphaOffset, const MATRIX& matrix)
+{
+	if (mesh.getVertexCount()==0)
+		return;
+	if (collectingQuads)
+	{
+		//Meshes are never modified, so the id identifies the content
+		renderedQuad q;
+		memset(&q,0,sizeof(q));
+		q.texId=UINT32_MAX;
+		q.contentVersion=mesh.id;
+		q.firstChunk=mesh.getVertexCount();
+		q.matrix[0]=matrix.xx;
+		q.matrix[1]=matrix.yx;
+		q.matrix[2]=matrix.xy;
+		q.matrix[3]=matrix.yy;
+		q.matrix[4]=matrix.x0;
+		q.matrix[5]=matrix.y0;
+		q.colorTransform[0]=redMultiplier;
+		q.colorTransform[1]=greenMultiplier;
+		q.colorTransform[2]=blueMultiplier;
+		q.colorTransform[3]=alphaMultiplier;
+		q.colorTransform[4]=redOffset;
+		q.colorTransform[5]=greenOffset;
+		q.colorTransform[6]=blueOffset;
+		q.colorTransform[7]=alphaOffset;
+		q.alpha=alpha;
+		q.directMode=4;
+		q.blendMode=currentBlendMode;
+		number_t xmin=0,ymin=0,xmax=0,ymax=0;
+		for(uint32_t i=0;i<4;i++)
+		{
+			number_t x,y;
+			matrix.multiply2D((i&1) ? mesh.xmax : mesh.xmin,(i&2) ? mesh.ymax : mesh.ymin,x,y);
+			if(i==0 || x<xmin)
+				xmin=x;
+			if(i==0 || x>xmax)
+				xmax=x;
+			if(i==0 || y<ymin)
+				ymin=y;
+			if(i==0 || y>ymax)
+				ymax=y;
+		}
+		q.xmin=floor(xmin)-2;
+		q.ymin=floor(ymin)-2;
+		q.xmax=ceil(xmax)+2;
+		q.ymax=ceil(ymax)+2;
+		renderedQuads.push_back(q);
+		return;
+	}
+	engineData->exec_glUniform1f(maskUniform, 0);
+	engineData->exec_glUniform1f(yuvUniform, 0);
+	engineData->exec_glUniform1f(alphaUniform, alpha);
+	engineData->exec_glUniform4f(colortransMultiplyUniform, redMultiplier,greenMultiplier,blueMultiplier,alphaMultiplier);
+	engineData->exec_glUniform4f(colortransAddUniform, redOffset/255.0,greenOffset/255.0,blueOffset/255.0,alphaOffset/255.0);
+	// 4.0: use the vertex colors instead of the texture
+	engineData->exec_glUniform1f(directUniform, 4);
+	float fmatrix[16];
+	matrix.get4DMatrix(fmatrix);
+	lsglLoadMatrixf(fmatrix);
+	setMatrixUniform(LSGL_MODELVIEW);
+
+	engineData->exec_glVertexAttribPointer(VERTEX_ATTRIB, 0, mesh.vertices.data(),FLOAT_2);
+	engineData->exec_glVertexAttribPointer(COLOR_ATTRIB, 0, mesh.colors.data(),FLOAT_4);
+	engineData->exec_glEnableVertexAttribArray(VERTEX_ATTRIB);
+	engineData->exec_glEnableVertexAttribArray(COLOR_ATTRIB);
+	engineData->exec_glDrawArrays_GL_TRIANGLES(0, mesh.getVertexCount());
+	engineData->exec_glDisableVertexAttribArray(VERTEX_ATTRIB);
+	engineData->exec_glDisableVertexAttribArray(COLOR_ATTRIB);
+}
+
 int GLRenderContext::errorCount = 0;
 bool GLRenderContext::handleGLErrors() const
 {
@@ -309,20 +451,106 @@ void GLRenderContext::setMatrixUniform(LSGL_MATRIX m) const
 	engineData->exec_glUniformMatrix4fv(uni, 1, false, lsMVPMatrix);
 }
 
-CairoRenderContext::CairoRenderContext(uint8_t* buf, uint32_t width, uint32_t height, bool smoothing):RenderContext(CAIRO)
+//Tiles are not made smaller than this number of rows
+#define CAIRO_MIN_TILE_HEIGHT 64
+
+CairoRenderContext::CairoRenderContext(uint8_t* buf, uint32_t width, uint32_t height, bool smoothing):RenderContext(CAIRO),
+	buffer(buf),width(width),height(height),clip(0,width,0,height)
 {
 	cairo_surface_t* cairoSurface=getCairoSurfaceForData(buf, width, height);
 	cr=cairo_create(cairoSurface);
 	cairo_surface_destroy(cairoSurface); /* cr has an reference to it */
 	cairo_set_antialias(cr,smoothing ? CAIRO_ANTIALIAS_DEFAULT : CAIRO_ANTIALIAS_NONE);
-	masksurface=nullptr;
 }
 
 CairoRenderContext::~CairoRenderContext()
 {
+	flush();
 	cairo_destroy(cr);
+}
+
+void CairoRenderContext::flush()
+{
+	if(ops.empty())
+		return;
+	const int32_t clipHeight=clip.Ymax-clip.Ymin;
+	if(clipHeight<=0 || clip.Xmax<=clip.Xmin)
+	{
+		ops.clear();
+		return;
+	}
+	uint32_t tileCount=min(max(SDL_GetCPUCount(),1),clipHeight/CAIRO_MIN_TILE_HEIGHT);
+	if(tileCount<=1 || ops.size()<2)
+		compositeTile(clip.Ymin,clip.Ymax);
+	else
+	{
+		parallelFor(clipHeight,tileCount,[this](uint32_t begin, uint32_t end)
+		{
+			compositeTile(clip.Ymin+int32_t(begin),clip.Ymin+int32_t(end));
+		});
+	}
+	ops.clear();
+}
+
+void CairoRenderContext::compositeTile(int32_t y0, int32_t y1) const
+{
+	cairo_surface_t* tileSurface=getCairoSurfaceForData(buffer+y0*width*4, width, y1-y0);
+	cairo_t* tilecr=cairo_create(tileSurface);
+	cairo_surface_destroy(tileSurface);
+	if(clip.Xmin>0 || clip.Xmax<int32_t(width))
+	{
+		cairo_rectangle(tilecr,clip.Xmin,0,clip.Xmax-clip.Xmin,y1-y0);
+		cairo_clip(tilecr);
+	}
+	cairo_surface_t* masksurface=nullptr;
+	cairo_matrix_t maskmatrix;
+	for(auto it=ops.begin();it!=ops.end();it++)
+	{
+		if(it->chunk==nullptr)
+		{
+			cairo_set_operator(tilecr,it->op);
+			continue;
+		}
+		//Masks are needed by later surfaces even if they don't overlap this tile
+		if(!it->isMask && (it->ymax<=y0 || it->ymin>=y1))
+			continue;
+		cairo_surface_t* chunkSurface = getCairoSurfaceForData((uint8_t*)it->chunk->chunks, it->chunk->width, it->chunk->height);
+		cairo_matrix_t m=it->matrix;
+		m.y0-=y0;
+		cairo_save(tilecr);
+		cairo_set_antialias(tilecr,it->smooth && !it->isMask ? CAIRO_ANTIALIAS_DEFAULT : CAIRO_ANTIALIAS_NONE);
+		cairo_set_matrix(tilecr, &m);
+		if(it->isMask)
+		{
+			if (masksurface) // reset previous mask
+				cairo_surface_destroy(masksurface);
+			masksurface = chunkSurface;
+			maskmatrix = m;
+		}
+		cairo_set_source_surface(tilecr, chunkSurface, 0,0);
+		if (it->hasMask)
+		{
+			if (masksurface)
+			{
+				// apply mask
+				cairo_save(tilecr);
+				cairo_set_matrix(tilecr,&maskmatrix);
+				cairo_mask_surface(tilecr,masksurface,0,0);
+				cairo_restore(tilecr);
+			}
+			else
+				LOG(LOG_ERROR,"surface has mask without a mask");
+		}
+		else if(!it->isMask)
+			cairo_paint(tilecr);
+
+		if (!it->isMask)
+			cairo_surface_destroy(chunkSurface);
+		cairo_restore(tilecr);
+	}
 	if (masksurface)
 		cairo_surface_destroy(masksurface);
+	cairo_destroy(tilecr);
 }
 
 cairo_surface_t* CairoRenderContext::getCairoSurfaceForData(uint8_t* buf, uint32_t width, uint32_t height)
@@ -335,6 +563,7 @@ cairo_surface_t* CairoRenderContext::getCairoSurfaceForData(uint8_t* buf, uint32
 void CairoRenderContext::simpleBlit(int32_t destX, int32_t destY, uint8_t* sourceBuf, uint32_t sourceTotalWidth, uint32_t sourceTotalHeight,
 		int32_t sourceX, int32_t sourceY, uint32_t sourceWidth, uint32_t sourceHeight)
 {
+	flush();
 	cairo_surface_t* sourceSurface = getCairoSurfaceForData(sourceBuf, sourceTotalWidth, sourceTotalHeight);
 	cairo_pattern_t* sourcePattern = cairo_pattern_create_for_surface(sourceSurface);
 	cairo_surface_destroy(sourceSurface);
@@ -352,6 +581,7 @@ void CairoRenderContext::simpleBlit(int32_t destX, int32_t destY, uint8_t* sourc
 void CairoRenderContext::transformedBlit(const MATRIX& m, uint8_t* sourceBuf, uint32_t sourceTotalWidth, uint32_t sourceTotalHeight,
 		FILTER_MODE filterMode)
 {
+	flush();
 	cairo_surface_t* sourceSurface = getCairoSurfaceForData(sourceBuf, sourceTotalWidth, sourceTotalHeight);
 	cairo_pattern_t* sourcePattern = cairo_pattern_create_for_surface(sourceSurface);
 	cairo_surface_destroy(sourceSurface);
@@ -373,42 +603,44 @@ void CairoRenderContext::renderTextured(const TextureChunk& chunk, float alpha,
 		LOG(LOG_NOT_IMPLEMENTED,"CairoRenderContext.renderTextured alpha not implemented:"<<alpha);
 	if (colorMode != RGB_MODE)
 		LOG(LOG_NOT_IMPLEMENTED,"CairoRenderContext.renderTextured colorMode not implemented:"<<(int)colorMode);
-	uint8_t* buf=(uint8_t*)chunk.chunks;
-	cairo_surface_t* chunkSurface = getCairoSurfaceForData(buf, chunk.width, chunk.height);
-	cairo_save(cr);
-	cairo_set_antialias(cr,smooth && !isMask ? CAIRO_ANTIALIAS_DEFAULT : CAIRO_ANTIALIAS_NONE);
-
+	compositeOp o;
 	MATRIX m = matrix.multiplyMatrix(MATRIX(1, 1, 0, 0, chunk.xOffset / chunk.xContentScale, chunk.yOffset / chunk.yContentScale));
-	cairo_set_matrix(cr, &m);
-	cairo_scale(cr, 1 / chunk.xContentScale, 1 / chunk.yContentScale);
-
-	if(isMask)
-	{
-		if (masksurface) // reset previous mask
-			cairo_surface_destroy(masksurface);
-		masksurface = chunkSurface;
-		cairo_get_matrix(cr, &maskmatrix);
-	}
-	cairo_set_source_surface(cr, chunkSurface, 0,0);
-	if (hasMask)
+	cairo_matrix_scale(&m, 1 / chunk.xContentScale, 1 / chunk.yContentScale);
+	o.matrix=m;
+	o.chunk=&chunk;
+	o.op=CAIRO_OPERATOR_OVER;
+	o.isMask=isMask;
+	o.hasMask=hasMask;
+	o.smooth=smooth;
+	//Compute the vertical bounds to find the tiles the surface is drawn on, with a margin for antialiasing
+	double ymin=0,ymax=0;
+	for(uint32_t i=0;i<4;i++)
 	{
-		if (masksurface)
-		{
-			// apply mask
-			cairo_save(cr);
-			cairo_set_matrix(cr,&maskmatrix);
-			cairo_mask_surface(cr,masksurface,0,0);
-			cairo_restore(cr);
-		}
-		else
-			LOG(LOG_ERROR,"surface has mask without a mask");
+		double x=(i&1) ? chunk.width : 0;
+		double y=(i&2) ? chunk.height : 0;
+		cairo_matrix_transform_point(&m,&x,&y);
+		if(i==0 || y<ymin)
+			ymin=y;
+		if(i==0 || y>ymax)
+			ymax=y;
 	}
-	else if(!isMask)
-		cairo_paint(cr);
+	o.ymin=floor(ymin)-1;
+	o.ymax=ceil(ymax)+1;
+	ops.push_back(o);
+}
 
-	if (!isMask)
-		cairo_surface_destroy(chunkSurface);
-	cairo_restore(cr);
+void CairoRenderContext::setClipRect(const RECT& r)
+{
+	flush();
+	clip.Xmin=max(r.Xmin,0);
+	clip.Ymin=max(r.Ymin,0);
+	clip.Xmax=max(min(r.Xmax,int(width)),clip.Xmin);
+	clip.Ymax=max(min(r.Ymax,int(height)),clip.Ymin);
+	//The blits draw directly to the buffer
+	cairo_reset_clip(cr);
+	cairo_identity_matrix(cr);
+	cairo_rectangle(cr,clip.Xmin,clip.Ymin,clip.Xmax-clip.Xmin,clip.Ymax-clip.Ymin);
+	cairo_clip(cr);
 }
 
 const CachedSurface& CairoRenderContext::getCachedSurface(const DisplayObject* d) const
@@ -424,41 +656,44 @@ const CachedSurface& CairoRenderContext::getCachedSurface(const DisplayObject* d
 
 void CairoRenderContext::setProperties(AS_BLENDMODE blendmode)
 {
+	compositeOp o;
+	o.chunk=nullptr;
 	switch (blendmode)
 	{
 		case BLENDMODE_NORMAL:
-			break;
+			return;
 		case BLENDMODE_MULTIPLY:
-			cairo_set_operator(cr,CAIRO_OPERATOR_MULTIPLY);
+			o.op=CAIRO_OPERATOR_MULTIPLY;
 			break;
 		case BLENDMODE_ADD:
-			cairo_set_operator(cr,CAIRO_OPERATOR_ADD);
+			o.op=CAIRO_OPERATOR_ADD;
 			break;
 		case BLENDMODE_SCREEN:
-			cairo_set_operator(cr,CAIRO_OPERATOR_SCREEN);
+			o.op=CAIRO_OPERATOR_SCREEN;
 			break;
 		case BLENDMODE_LAYER:
-			cairo_set_operator(cr,CAIRO_OPERATOR_OVER);
+			o.op=CAIRO_OPERATOR_OVER;
 			break;
 		case BLENDMODE_DARKEN:
-			cairo_set_operator(cr,CAIRO_OPERATOR_DARKEN);
+			o.op=CAIRO_OPERATOR_DARKEN;
 			break;
 		case BLENDMODE_DIFFERENCE:
-			cairo_set_operator(cr,CAIRO_OPERATOR_DIFFERENCE);
+			o.op=CAIRO_OPERATOR_DIFFERENCE;
 			break;
 		case BLENDMODE_HARDLIGHT:
-			cairo_set_operator(cr,CAIRO_OPERATOR_HARD_LIGHT);
+			o.op=CAIRO_OPERATOR_HARD_LIGHT;
 			break;
 		case BLENDMODE_LIGHTEN:
-			cairo_set_operator(cr,CAIRO_OPERATOR_LIGHTEN);
+			o.op=CAIRO_OPERATOR_LIGHTEN;
 			break;
 		case BLENDMODE_OVERLAY:
-			cairo_set_operator(cr,CAIRO_OPERATOR_OVERLAY);
+			o.op=CAIRO_OPERATOR_OVERLAY;
 			break;
 		default:
 			LOG(LOG_NOT_IMPLEMENTED,"renderTextured of blend mode "<<(int)blendmode);
-			break;
+			return;
 	}
+	ops.push_back(o);
 }
 
 CachedSurface& CairoRenderContext::allocateCustomSurface(const DisplayObject* d, uint8_t* texBuf, bool isBufferOwner)
@@ -27,6 +27,8 @@
 namespace lightspark
 {
 
+class ShapeMesh;
+
 enum VertexAttrib { VERTEX_ATTRIB=0, COLOR_ATTRIB, TEXCOORD_ATTRIB};
 
 /*
@@ -89,6 +91,8 @@ protected:
 	int directColorUniform;
 	uint32_t maskframebuffer;
 	uint32_t maskTextureID;
+	// framebuffer the stage is rendered to, it is restored after a mask has been drawn
+	uint32_t targetFramebuffer;
 
 	/* Textures */
 	Mutex mutexLargeTexture;
@@ -98,10 +102,69 @@ protected:
 	public:
 		uint32_t id;
 		uint8_t* bitmap;
-		LargeTexture(uint8_t* b):id(-1),bitmap(b){}
+		uint32_t freeBlocks;
+		// incremented when all chunks are evicted, chunks reserved in an older generation are stale
+		uint32_t generation;
+		// last frame the texture was used in, to find the least recently used one
+		uint32_t lastUsedFrame;
+		// only contains cached surfaces, which can be evicted and drawn again
+		bool evictable;
+		LargeTexture(uint8_t* b, uint32_t blocks, bool e):id(-1),bitmap(b),freeBlocks(blocks),generation(0),lastUsedFrame(0),evictable(e){}
 		~LargeTexture(){/*delete[] bitmap;*/}
+		bool isUsed(uint32_t block) const { return bitmap[block/8]&(1<<(block%8)); }
+		void setUsed(uint32_t block)
+		{
+			assert(!isUsed(block));
+			bitmap[block/8]|=1<<(block%8);
+			freeBlocks--;
+		}
+		void setFree(uint32_t block)
+		{
+			assert(isUsed(block));
+			bitmap[block/8]^=1<<(block%8);
+			freeBlocks++;
+		}
 	};
 	std::vector<LargeTexture> largeTextures;
+	// number of frames rendered, used for the LRU eviction of textures
+	uint32_t currentFrame;
+
+	/*
+	 * Everything that affects the pixels of a quad drawn by renderTextured.
+	 * The quads of two frames are compared to find the areas of the stage that changed
+	 */
+	struct renderedQuad
+	{
+		uint32_t texId;
+		uint32_t generation;
+		uint32_t contentVersion;
+		uint32_t firstChunk;
+		uint32_t width;
+		uint32_t height;
+		float xOffset;
+		float yOffset;
+		float xContentScale;
+		float yContentScale;
+		float matrix[6];
+		float colorTransform[8];
+		float alpha;
+		float directMode;
+		uint32_t directColor;
+		uint32_t colorMode;
+		uint32_t blendMode;
+		uint32_t flags;
+		// bounds in stage coordinates, including a margin for filtering
+		int32_t xmin;
+		int32_t ymin;
+		int32_t xmax;
+		int32_t ymax;
+	};
+	// when set renderTextured only records the quads in renderedQuads
+	bool collectingQuads;
+	// set when something was drawn without renderTextured while collecting, so the frame can't be compared
+	bool directDrawingUsed;
+	std::vector<renderedQuad> renderedQuads;
+	AS_BLENDMODE currentBlendMode;
 
 	~GLRenderContext(){}
 
@@ -111,7 +174,8 @@ public:
 	 * Uploads the current matrix as the specified type.
 	 */
 	void setMatrixUniform(LSGL_MATRIX m) const;
-	GLRenderContext() : RenderContext(GL),engineData(nullptr), largeTextureSize(0)
+	GLRenderContext() : RenderContext(GL),engineData(nullptr),targetFramebuffer(0),largeTextureSize(0),currentFrame(0),
+		collectingQuads(false),directDrawingUsed(false),currentBlendMode(BLENDMODE_NORMAL)
 	{
 	}
 	void SetEngineData(EngineData* data) { engineData = data;}
@@ -127,19 +191,58 @@ public:
 	 */
 	const CachedSurface& getCachedSurface(const DisplayObject* obj) const override;
 	void setProperties(AS_BLENDMODE blendmode) override;
+	/*
+	 * Draws the triangles of a tessellated shape, the vertex colors are
+	 * modified by alpha and the color transformation like a texture
+	 */
+	void renderMesh(const ShapeMesh& mesh, float alpha,
+			float redMultiplier, float greenMultiplier, float blueMultiplier, float alphaMultiplier,
+			float redOffset, float greenOffset, float blueOffset, float alphaOffset, const MATRIX& matrix);
+
+	/*
+	 * While the quads of a frame are collected nothing must be drawn to the framebuffer,
+	 * objects drawing without renderTextured have to call markDirectDrawing instead
+	 */
+	bool isCollectingQuads() const { return collectingQuads; }
+	void markDirectDrawing() { directDrawingUsed=true; }
 
 	/* Utility */
 	bool handleGLErrors() const;
 };
 
+/*
+ * renderTextured and setProperties calls are recorded and composited in flush().
+ * The buffer is split in horizontal tiles that are composited concurrently on the
+ * thread pool, every tile only draws the surfaces overlapping it
+ */
 class CairoRenderContext: public RenderContext
 {
 private:
+	struct compositeOp
+	{
+		// device space matrix of the surface
+		cairo_matrix_t matrix;
+		// nullptr if only the operator is changed
+		const TextureChunk* chunk;
+		cairo_operator_t op;
+		// vertical device space bounds of the surface
+		int32_t ymin;
+		int32_t ymax;
+		bool isMask;
+		bool hasMask;
+		bool smooth;
+	};
 	std::map<const DisplayObject*, CachedSurface> customSurfaces;
+	std::vector<compositeOp> ops;
 	cairo_t* cr;
-	cairo_surface_t* masksurface;
-	MATRIX maskmatrix;
+	uint8_t* buffer;
+	uint32_t width;
+	uint32_t height;
+	// only this part of the buffer is drawn to
+	RECT clip;
 	static cairo_surface_t* getCairoSurfaceForData(uint8_t* buf, uint32_t width, uint32_t height);
+	// composites the recorded operations into the rows y0 to y1 of the buffer
+	void compositeTile(int32_t y0, int32_t y1) const;
 	/*
 	 * An invalid surface to be returned for objects with no content
 	 */
@@ -157,12 +260,21 @@ public:
 	 */
 	const CachedSurface& getCachedSurface(const DisplayObject* obj) const override;
 	void setProperties(AS_BLENDMODE blendmode) override;
+	/**
+	 * Restrict all following drawing to the given rectangle of the buffer,
+	 * tiles outside of it are not composited at all
+	 */
+	void setClipRect(const RECT& r);
 
 	/**
 	 * The CairoRenderContext acquires the ownership of the buffer
 	 * it will be freed on destruction
 	 */
 	CachedSurface& allocateCustomSurface(const DisplayObject* d, uint8_t* texBuf, bool isBufferOwner);
+	/**
+	 * Composite all recorded operations into the buffer
+	 */
+	void flush();
 	/**
 	 * Do a fast non filtered, non scaled blit of ARGB data
 	 */
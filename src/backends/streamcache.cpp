@@ -191,6 +191,12 @@ void MemoryStreamCache::openForWriting()
 	LOG(LOG_ERROR,"openForWriting not implemented in MemoryStreamCache");
 }
 
+const unsigned char* MemoryStreamCache::readContiguous(std::streambuf* reader, size_t length, size_t padding)
+{
+	Reader* r = dynamic_cast<Reader*>(reader);
+	return r ? r->readContiguous(length, padding) : nullptr;
+}
+
 MemoryStreamCache::Reader::Reader(_R<MemoryStreamCache> b) :
 	buffer(b), chunkIndex(0), chunkStartOffset(0)
 {
@@ -270,6 +276,28 @@ int MemoryStreamCache::Reader::underflow()
 	return (int)cursor[0];
 }
 
+const unsigned char* MemoryStreamCache::Reader::readContiguous(size_t length, size_t padding)
+{
+	if (gptr() == nullptr)
+		return nullptr;
+
+	if ((size_t)(egptr() - gptr()) < length + padding)
+	{
+		// The current chunk may have grown since the last underflow
+		Locker locker(buffer->chunkListMutex);
+		if (chunkIndex >= buffer->chunks.size() || buffer->chunks[chunkIndex]->buffer != (unsigned char*)eback())
+			return nullptr;
+		MemoryChunk *chunk = buffer->chunks[chunkIndex];
+		setg(eback(), gptr(), (char *)chunk->buffer + ACQUIRE_READ(chunk->used));
+		if ((size_t)(egptr() - gptr()) < length + padding)
+			return nullptr;
+	}
+
+	const unsigned char* ret = (const unsigned char*)gptr();
+	setg(eback(), gptr() + length, egptr());
+	return ret;
+}
+
 /**
  * \brief Called by the streambuf API
  *
@@ -127,6 +127,7 @@ private:
 		std::streampos getOffset() const;
 	public:
 		Reader(_R<MemoryStreamCache> b);
+		const unsigned char* readContiguous(size_t length, size_t padding);
 	};
 
 	// Stream is stored into a sequence of memory chunks. The
@@ -157,6 +158,11 @@ public:
 	std::streambuf *createReader() override;
 	
 	void openForWriting() override;
+
+	// If reader was created by a MemoryStreamCache and the next length bytes, followed by
+	// at least padding readable bytes, are stored in one chunk, skips them and returns a
+	// pointer to them. The pointer stays valid as long as the cache. Returns nullptr otherwise
+	static const unsigned char* readContiguous(std::streambuf* reader, size_t length, size_t padding);
 };
 
 /*
@@ -0,0 +1,776 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "backends/tessellator.h"
+#include "logger.h"
+#include "swftypes.h"
+
+using namespace std;
+using namespace lightspark;
+
+//Maximum distance in device pixels between a flattened curve or round join and the real one
+#define TESSELLATION_TOLERANCE 0.2
+
+namespace
+{
+struct point
+{
+	double x;
+	double y;
+	point(double a=0, double b=0):x(a),y(b) {}
+	point operator+(const point& r) const { return point(x+r.x,y+r.y); }
+	point operator-(const point& r) const { return point(x-r.x,y-r.y); }
+	point operator*(double f) const { return point(x*f,y*f); }
+	bool operator==(const point& r) const { return x==r.x && y==r.y; }
+};
+
+double cross(const point& a, const point& b)
+{
+	return a.x*b.y-a.y*b.x;
+}
+
+double dot(const point& a, const point& b)
+{
+	return a.x*b.x+a.y*b.y;
+}
+
+point normalize(const point& p)
+{
+	double l=sqrt(dot(p,p));
+	return l>0 ? p*(1.0/l) : point();
+}
+
+//A non horizontal edge of a polygon, y0 is always smaller than y1
+struct edge
+{
+	double x0;
+	double y0;
+	double x1;
+	double y1;
+	double xAt(double y) const { return x0+(x1-x0)*(y-y0)/(y1-y0); }
+};
+
+struct activeEdge
+{
+	double xtop;
+	double xbottom;
+	// x slightly below the top, edges meeting at the top are ordered by their direction
+	double xsort;
+	const edge* e;
+	bool operator<(const activeEdge& r) const { return xsort<r.xsort; }
+};
+
+//Converts the path of the tokens to triangles, keeping the state like the cairo context in cairoPathFromTokens
+class tessellation
+{
+private:
+	ShapeMesh& mesh;
+	//converts token coordinates to pixels
+	double scaling;
+	//flattening tolerance in token coordinates
+	double tolerance;
+	vector<vector<point>> contours;
+	//false while the cairo operator is DEST, nothing is drawn then
+	bool hasSource;
+	float color[4];
+	//line parameters with the cairo defaults
+	double lineWidth;
+	int lineCap;
+	int lineJoin;
+	double miterLimit;
+	void addVertex(const point& p)
+	{
+		float x=p.x*scaling;
+		float y=p.y*scaling;
+		if(mesh.vertices.empty())
+		{
+			mesh.xmin=mesh.xmax=x;
+			mesh.ymin=mesh.ymax=y;
+		}
+		else
+		{
+			mesh.xmin=min(mesh.xmin,x);
+			mesh.xmax=max(mesh.xmax,x);
+			mesh.ymin=min(mesh.ymin,y);
+			mesh.ymax=max(mesh.ymax,y);
+		}
+		mesh.vertices.push_back(x);
+		mesh.vertices.push_back(y);
+		mesh.colors.insert(mesh.colors.end(),color,color+4);
+	}
+	void addTriangle(const point& a, const point& b, const point& c)
+	{
+		addVertex(a);
+		addVertex(b);
+		addVertex(c);
+	}
+	void addQuad(const point& a, const point& b, const point& c, const point& d)
+	{
+		addTriangle(a,b,c);
+		addTriangle(a,c,d);
+	}
+	void addDisc(const point& center, double radius);
+	void addJoin(const point& p, const point& d0, const point& d1, double hw);
+	void addCap(const point& p, const point& d, double hw);
+	void fillContours();
+	void strokeContours();
+	point currentPoint() const { return contours.empty() || contours.back().empty() ? point() : contours.back().back(); }
+public:
+	tessellation(ShapeMesh& m, double s, double scale):mesh(m),scaling(s),tolerance(TESSELLATION_TOLERANCE/(scale*s)),
+		hasSource(false),lineWidth(2),lineCap(1),lineJoin(2),miterLimit(10)
+	{
+		color[0]=color[1]=color[2]=0;
+		color[3]=1;
+	}
+	void moveTo(const point& p)
+	{
+		if(contours.empty() || !contours.back().empty())
+			contours.emplace_back();
+		contours.back().push_back(p);
+	}
+	void lineTo(const point& p)
+	{
+		//cairo handles a line_to without current point as a move_to
+		if(contours.empty())
+			contours.emplace_back();
+		contours.back().push_back(p);
+	}
+	void curveTo(const point& c1, const point& c2, const point& p)
+	{
+		if(contours.empty() || contours.back().empty())
+			moveTo(c1);
+		const point p0=currentPoint();
+		//The distance of the flattened curve to the real one is bounded by the second differences of the control points
+		point dd1=p0-c1*2+c2;
+		point dd2=c1-c2*2+p;
+		double dd=sqrt(max(dot(dd1,dd1),dot(dd2,dd2)));
+		uint32_t n=max(1.0,min(ceil(sqrt(0.75*dd/tolerance)),256.0));
+		for(uint32_t i=1;i<=n;i++)
+		{
+			double t=double(i)/n;
+			double mt=1-t;
+			contours.back().push_back(p0*(mt*mt*mt)+c1*(3*mt*mt*t)+c2*(3*mt*t*t)+p*(t*t*t));
+		}
+	}
+	void quadraticTo(const point& c, const point& p)
+	{
+		//same conversion to a cubic curve as CairoTokenRenderer::quadraticBezier
+		const point p0=currentPoint();
+		curveTo(c*(2.0/3.0)+p0*(1.0/3.0),c*(2.0/3.0)+p*(1.0/3.0),p);
+	}
+	void setColor(const RGBA& c)
+	{
+		float a=c.af();
+		color[0]=c.rf()*a;
+		color[1]=c.gf()*a;
+		color[2]=c.bf()*a;
+		color[3]=a;
+		hasSource=true;
+	}
+	void clearSource() { hasSource=false; }
+	void setLine(const LINESTYLE2& style, double scale);
+	void fill()
+	{
+		if(hasSource)
+			fillContours();
+		contours.clear();
+	}
+	void stroke()
+	{
+		if(hasSource)
+			strokeContours();
+		contours.clear();
+	}
+};
+
+void tessellation::setLine(const LINESTYLE2& style, double scale)
+{
+	// same widths as cairoPathFromTokens
+	if (style.Width == 0)
+		lineWidth=1.0/(scale*scaling);
+	else if (style.Width < 20)
+		lineWidth=5;
+	else
+		lineWidth=style.Width/20.0/scaling;
+	if (style.StartCapStyle == 0)
+		lineCap=0;
+	else if (style.StartCapStyle == 1)
+		lineCap=1;
+	else if (style.StartCapStyle == 2)
+		lineCap=2;
+	if (style.JointStyle == 0)
+		lineJoin=0;
+	else if (style.JointStyle == 1)
+		lineJoin=1;
+	else if (style.JointStyle == 2)
+	{
+		lineJoin=2;
+		miterLimit=style.MiterLimitFactor;
+	}
+}
+
+void tessellation::fillContours()
+{
+	vector<edge> edges;
+	vector<double> ys;
+	for(auto it=contours.begin();it!=contours.end();++it)
+	{
+		const vector<point>& c=*it;
+		//Subpaths are closed implicitly
+		for(uint32_t i=0;i<c.size();i++)
+		{
+			const point& a=c[i];
+			const point& b=c[(i+1)%c.size()];
+			ys.push_back(a.y);
+			if(a.y==b.y)
+				continue;
+			edge e;
+			if(a.y<b.y)
+			{
+				e.x0=a.x; e.y0=a.y; e.x1=b.x; e.y1=b.y;
+			}
+			else
+			{
+				e.x0=b.x; e.y0=b.y; e.x1=a.x; e.y1=a.y;
+			}
+			edges.push_back(e);
+		}
+	}
+	if(edges.empty())
+		return;
+	sort(ys.begin(),ys.end());
+	ys.erase(unique(ys.begin(),ys.end()),ys.end());
+	sort(edges.begin(),edges.end(),[](const edge& a, const edge& b) { return a.y0<b.y0; });
+
+	//Sweep the bands between the vertices from top to bottom. Inside of a band the
+	//edges don't end, bands are split where edges intersect, so every pair of edges
+	//(even-odd rule) bounds a trapezoid
+	vector<const edge*> active;
+	vector<activeEdge> sorted;
+	uint32_t nextEdge=0;
+	for(uint32_t k=0;k+1<ys.size();k++)
+	{
+		const double ya=ys[k];
+		const double yb=ys[k+1];
+		active.erase(remove_if(active.begin(),active.end(),[ya](const edge* e) { return e->y1<=ya; }),active.end());
+		while(nextEdge<edges.size() && edges[nextEdge].y0<=ya)
+			active.push_back(&edges[nextEdge++]);
+		if(active.size()<2)
+			continue;
+		//Intersections closer than this to the top of the band are ignored
+		const double minStep=(yb-ya)*1e-6;
+		double y=ya;
+		while(y<yb)
+		{
+			sorted.clear();
+			for(auto it=active.begin();it!=active.end();++it)
+			{
+				activeEdge a;
+				a.xtop=(*it)->xAt(y);
+				a.xbottom=(*it)->xAt(yb);
+				a.xsort=(*it)->xAt(y+minStep);
+				a.e=*it;
+				sorted.push_back(a);
+			}
+			sort(sorted.begin(),sorted.end());
+			//The first intersection is always between neighbours
+			double ycut=yb;
+			for(uint32_t i=0;i+1<sorted.size();i++)
+			{
+				double dtop=sorted[i+1].xtop-sorted[i].xtop;
+				double dbottom=sorted[i].xbottom-sorted[i+1].xbottom;
+				if(dbottom<=0)
+					continue;
+				double yc=y+(yb-y)*dtop/(dtop+dbottom);
+				if(yc>y+minStep && yc<ycut)
+					ycut=yc;
+			}
+			for(uint32_t i=0;i+1<sorted.size();i+=2)
+			{
+				const activeEdge& l=sorted[i];
+				const activeEdge& r=sorted[i+1];
+				double lbottom=ycut==yb ? l.xbottom : l.e->xAt(ycut);
+				double rbottom=ycut==yb ? r.xbottom : r.e->xAt(ycut);
+				if(r.xtop-l.xtop<=0 && rbottom-lbottom<=0)
+					continue;
+				addQuad(point(l.xtop,y),point(r.xtop,y),point(rbottom,ycut),point(lbottom,ycut));
+			}
+			y=ycut;
+		}
+	}
+}
+
+void tessellation::addDisc(const point& center, double radius)
+{
+	double step=radius>tolerance ? 2*acos(1-tolerance/radius) : M_PI/4;
+	uint32_t n=max(8.0,min(ceil(2*M_PI/step),128.0));
+	point prev(center.x+radius,center.y);
+	for(uint32_t i=1;i<=n;i++)
+	{
+		double a=2*M_PI*i/n;
+		point cur(center.x+radius*cos(a),center.y+radius*sin(a));
+		addTriangle(center,prev,cur);
+		prev=cur;
+	}
+}
+
+void tessellation::addJoin(const point& p, const point& d0, const point& d1, double hw)
+{
+	double c=cross(d0,d1);
+	if(fabs(c)<1e-9 && dot(d0,d1)>0)
+		return;
+	if(lineJoin==0)
+	{
+		addDisc(p,hw);
+		return;
+	}
+	//Only the outer side of the corner has a gap
+	double side=c>0 ? -1 : 1;
+	point n0=point(-d0.y,d0.x)*(side*hw);
+	point n1=point(-d1.y,d1.x)*(side*hw);
+	if(lineJoin==2)
+	{
+		point m=normalize(n0+n1);
+		double cosHalf=dot(m,n0)/hw;
+		//cairo uses a bevel when the ratio of the miter length and the line width is above the limit
+		if(cosHalf>1e-6 && 1.0/cosHalf<=miterLimit)
+		{
+			point tip=p+m*(hw/cosHalf);
+			addTriangle(p,p+n0,tip);
+			addTriangle(p,tip,p+n1);
+			return;
+		}
+	}
+	addTriangle(p,p+n0,p+n1);
+}
+
+void tessellation::addCap(const point& p, const point& d, double hw)
+{
+	if(lineCap==0)
+		addDisc(p,hw);
+	else if(lineCap==2)
+	{
+		point n(-d.y*hw,d.x*hw);
+		point e=d*hw;
+		addQuad(p+n,p+n+e,p-n+e,p-n);
+	}
+}
+
+void tessellation::strokeContours()
+{
+	const double hw=lineWidth/2;
+	for(auto it=contours.begin();it!=contours.end();++it)
+	{
+		vector<point> c;
+		for(auto itp=it->begin();itp!=it->end();++itp)
+		{
+			if(c.empty() || !(c.back()==*itp))
+				c.push_back(*itp);
+		}
+		if(c.empty())
+			continue;
+		if(c.size()==1)
+		{
+			//cairo draws degenerate subpaths as dots for round and square caps
+			addCap(c[0],point(1,0),hw);
+			if(lineCap==2)
+				addCap(c[0],point(-1,0),hw);
+			continue;
+		}
+		point dprev;
+		for(uint32_t i=0;i+1<c.size();i++)
+		{
+			point d=normalize(c[i+1]-c[i]);
+			point n(-d.y*hw,d.x*hw);
+			addQuad(c[i]+n,c[i+1]+n,c[i+1]-n,c[i]-n);
+			if(i==0)
+				addCap(c[0],d*-1,hw);
+			else
+				addJoin(c[i],dprev,d,hw);
+			dprev=d;
+		}
+		addCap(c.back(),dprev,hw);
+	}
+}
+
+//FNV-1a
+void hashValue(uint64_t& h, uint64_t v)
+{
+	for(uint32_t i=0;i<8;i++)
+	{
+		h^=(v>>(i*8))&0xff;
+		h*=0x100000001b3ULL;
+	}
+}
+
+uint64_t colorBits(const RGBA& c)
+{
+	return (uint64_t(c.Red)<<24)|(uint64_t(c.Green)<<16)|(uint64_t(c.Blue)<<8)|uint64_t(c.Alpha);
+}
+
+//Calls f for every token with the number of following arguments
+template<class F>
+void walkTokens(const tokensVector& tokens, F f)
+{
+	const vector<uint64_t>* lists[2]={&tokens.filltokens.getVector(),&tokens.stroketokens.getVector()};
+	for(uint32_t l=0;l<2;l++)
+	{
+		const vector<uint64_t>& v=*lists[l];
+		for(uint32_t i=0;i<v.size();)
+		{
+			GeomToken p(v[i],false);
+			uint32_t args=0;
+			switch(p.type)
+			{
+				case STRAIGHT:
+				case MOVE:
+				case SET_FILL:
+				case SET_STROKE:
+					args=1;
+					break;
+				case CURVE_QUADRATIC:
+					args=2;
+					break;
+				case CURVE_CUBIC:
+					args=3;
+					break;
+				case FILL_TRANSFORM_TEXTURE:
+					args=6;
+					break;
+				default:
+					break;
+			}
+			if(i+args>=v.size() && args)
+				return;
+			if(!f(l==1,p.type,&v[i+1]))
+				return;
+			i+=args+1;
+		}
+	}
+}
+}
+
+bool ShapeTessellator::canTessellate(const tokensVector& tokens)
+{
+	bool ret=true;
+	walkTokens(tokens,[&ret](bool, GEOM_TOKEN_TYPE type, const uint64_t* args)
+	{
+		if(type==SET_FILL)
+			ret=GeomToken(args[0],false).fillStyle->FillStyleType==SOLID_FILL;
+		else if(type==SET_STROKE)
+		{
+			const LINESTYLE2* style=GeomToken(args[0],false).lineStyle;
+			if(style->HasFillFlag)
+				ret=style->FillType.FillStyleType==SOLID_FILL && style->FillType.Color.Alpha==255;
+			else
+				ret=style->Color.Alpha==255;
+		}
+		else if(type==FILL_TRANSFORM_TEXTURE)
+			ret=false;
+		return ret;
+	});
+	return ret;
+}
+
+bool ShapeTessellator::tessellate(const tokensVector& tokens, float scaling, float scale, ShapeMesh& mesh)
+{
+	tessellation t(mesh,scaling,scale);
+	bool ret=true;
+	bool instroke=false;
+	bool inStrokeTokens=false;
+	const bool hasFill=!tokens.filltokens.empty();
+	walkTokens(tokens,[&](bool strokeTokens, GEOM_TOKEN_TYPE type, const uint64_t* args)
+	{
+		if(strokeTokens && !inStrokeTokens)
+			inStrokeTokens=true;
+		switch(type)
+		{
+			case MOVE:
+			{
+				GeomToken p1(args[0],false);
+				t.moveTo(point(p1.vec.x,p1.vec.y));
+				break;
+			}
+			case STRAIGHT:
+			{
+				GeomToken p1(args[0],false);
+				t.lineTo(point(p1.vec.x,p1.vec.y));
+				break;
+			}
+			case CURVE_QUADRATIC:
+			{
+				GeomToken p1(args[0],false);
+				GeomToken p2(args[1],false);
+				t.quadraticTo(point(p1.vec.x,p1.vec.y),point(p2.vec.x,p2.vec.y));
+				break;
+			}
+			case CURVE_CUBIC:
+			{
+				GeomToken p1(args[0],false);
+				GeomToken p2(args[1],false);
+				GeomToken p3(args[2],false);
+				t.curveTo(point(p1.vec.x,p1.vec.y),point(p2.vec.x,p2.vec.y),point(p3.vec.x,p3.vec.y));
+				break;
+			}
+			case SET_FILL:
+			{
+				if(instroke)
+					t.stroke();
+				else if(hasFill)
+					t.fill();
+				instroke=false;
+				const FILLSTYLE* style=GeomToken(args[0],false).fillStyle;
+				if(style->FillStyleType!=SOLID_FILL)
+				{
+					ret=false;
+					return false;
+				}
+				t.setColor(style->Color);
+				break;
+			}
+			case SET_STROKE:
+			{
+				if(instroke)
+					t.stroke();
+				else if(hasFill)
+					t.fill();
+				instroke=true;
+				const LINESTYLE2* style=GeomToken(args[0],false).lineStyle;
+				if(style->HasFillFlag)
+				{
+					if(style->FillType.FillStyleType!=SOLID_FILL)
+					{
+						ret=false;
+						return false;
+					}
+					t.setColor(style->FillType.Color);
+				}
+				else
+					t.setColor(style->Color);
+				t.setLine(*style,scale);
+				break;
+			}
+			case CLEAR_FILL:
+			case FILL_KEEP_SOURCE:
+				t.fill();
+				if(type==CLEAR_FILL)
+					t.clearSource();
+				break;
+			case CLEAR_STROKE:
+				instroke=false;
+				t.stroke();
+				t.clearSource();
+				break;
+			default:
+				ret=false;
+				return false;
+		}
+		return true;
+	});
+	if(!ret)
+		return false;
+	if(instroke)
+		t.stroke();
+	else if(hasFill)
+		t.fill();
+	return true;
+}
+
+void ShapeTessellator::serializeTokens(const tokensVector& tokens, float scaling, vector<uint64_t>& data)
+{
+	data.clear();
+	uint32_t s;
+	memcpy(&s,&scaling,4);
+	data.push_back(s);
+	data.push_back(tokens.filltokens.size());
+	walkTokens(tokens,[&data](bool, GEOM_TOKEN_TYPE type, const uint64_t* args)
+	{
+		data.push_back(type);
+		switch(type)
+		{
+			case SET_FILL:
+			{
+				//Styles are stored by their content, so equal shapes share the mesh
+				const FILLSTYLE* style=GeomToken(args[0],false).fillStyle;
+				data.push_back(style->FillStyleType);
+				data.push_back(colorBits(style->Color));
+				break;
+			}
+			case SET_STROKE:
+			{
+				const LINESTYLE2* style=GeomToken(args[0],false).lineStyle;
+				data.push_back((uint64_t(style->Width)<<32)|uint64_t(style->MiterLimitFactor));
+				data.push_back((uint64_t(style->StartCapStyle)<<32)|uint64_t(style->JointStyle));
+				data.push_back(style->HasFillFlag ? colorBits(style->FillType.Color)|(uint64_t(style->FillType.FillStyleType+1)<<32) : colorBits(style->Color));
+				break;
+			}
+			case MOVE:
+			case STRAIGHT:
+				data.push_back(args[0]);
+				break;
+			case CURVE_QUADRATIC:
+				data.push_back(args[0]);
+				data.push_back(args[1]);
+				break;
+			case CURVE_CUBIC:
+				data.push_back(args[0]);
+				data.push_back(args[1]);
+				data.push_back(args[2]);
+				break;
+			case FILL_TRANSFORM_TEXTURE:
+				for(uint32_t i=0;i<6;i++)
+					data.push_back(args[i]);
+				break;
+			default:
+				break;
+		}
+		return true;
+	});
+}
+
+int32_t ShapeTessellator::getScaleBucket(float scale)
+{
+	return ceil(log2(max(scale,1e-3f))*2);
+}
+
+float ShapeTessellator::getBucketScale(int32_t bucket)
+{
+	return exp2(bucket*0.5);
+}
+
+void ShapeMesh::rasterize(uint8_t* buf, uint32_t width, uint32_t height, uint32_t stride, const MATRIX& m) const
+{
+	for(uint32_t t=0;t+2<getVertexCount();t+=3)
+	{
+		point p[3];
+		for(uint32_t i=0;i<3;i++)
+			m.multiply2D(vertices[(t+i)*2],vertices[(t+i)*2+1],p[i].x,p[i].y);
+		double area=cross(p[1]-p[0],p[2]-p[0]);
+		if(area==0)
+			continue;
+		if(area<0)
+			swap(p[1],p[2]);
+		int32_t x0=max(0.0,floor(min(min(p[0].x,p[1].x),p[2].x)));
+		int32_t y0=max(0.0,floor(min(min(p[0].y,p[1].y),p[2].y)));
+		int32_t x1=min(double(width),ceil(max(max(p[0].x,p[1].x),p[2].x)));
+		int32_t y1=min(double(height),ceil(max(max(p[0].y,p[1].y),p[2].y)));
+		const float* c=&colors[t*4];
+		for(int32_t y=y0;y<y1;y++)
+		{
+			uint32_t* row=(uint32_t*)(buf+y*stride);
+			for(int32_t x=x0;x<x1;x++)
+			{
+				point s(x+0.5,y+0.5);
+				bool inside=true;
+				for(uint32_t i=0;i<3 && inside;i++)
+				{
+					const point& a=p[i];
+					const point& b=p[(i+1)%3];
+					double w=cross(b-a,s-a);
+					//A pixel center on an edge shared by two triangles belongs to only one of them
+					inside=w>0 || (w==0 && (b.y>a.y || (b.y==a.y && b.x<a.x)));
+				}
+				if(!inside)
+					continue;
+				uint32_t d=row[x];
+				float ia=1-c[3];
+				uint32_t a=min(255.0f,c[3]*255+(d>>24)*ia+0.5f);
+				uint32_t r=min(255.0f,c[0]*255+((d>>16)&0xff)*ia+0.5f);
+				uint32_t g=min(255.0f,c[1]*255+((d>>8)&0xff)*ia+0.5f);
+				uint32_t b=min(255.0f,c[2]*255+(d&0xff)*ia+0.5f);
+				row[x]=(a<<24)|(r<<16)|(g<<8)|b;
+			}
+		}
+	}
+}
+
+ShapeMeshCache::ShapeMeshCache(size_t budget):memoryUsed(0),memoryBudget(budget),nextId(1),hits(0),misses(0)
+{
+}
+
+ShapeMeshCache::~ShapeMeshCache()
+{
+	if(hits || misses)
+		LOG(LOG_INFO,"shape mesh cache: "<<meshes.size()<<" meshes, "<<memoryUsed/1024<<" KiB, "<<hits<<" hits, "<<misses<<" misses");
+}
+
+size_t ShapeMeshCache::getEntrySize(const meshKey& k, const meshEntry& e)
+{
+	return k.data.capacity()*sizeof(uint64_t)+(e.mesh ? e.mesh->getMemorySize() : 0);
+}
+
+const ShapeMesh* ShapeMeshCache::getMesh(const tokensVector& tokens, float scaling, float scale, uint32_t frame)
+{
+	ShapeTessellator::serializeTokens(tokens,scaling,lookupKey.data);
+	lookupKey.hash=0xcbf29ce484222325ULL;
+	for(uint32_t i=0;i<lookupKey.data.size();i++)
+		hashValue(lookupKey.hash,lookupKey.data[i]);
+	lookupKey.bucket=ShapeTessellator::getScaleBucket(scale);
+	auto it=meshes.find(lookupKey);
+	if(it!=meshes.end())
+	{
+		hits++;
+		it->second.lastUsedFrame=frame;
+		return it->second.mesh.get();
+	}
+	misses++;
+	meshEntry entry;
+	entry.mesh.reset(new ShapeMesh());
+	entry.lastUsedFrame=frame;
+	if(ShapeTessellator::tessellate(tokens,scaling,ShapeTessellator::getBucketScale(lookupKey.bucket),*entry.mesh))
+		entry.mesh->id=nextId++;
+	else
+		entry.mesh.reset();
+	const ShapeMesh* ret=entry.mesh.get();
+	lookupKey.data.shrink_to_fit();
+	memoryUsed+=getEntrySize(lookupKey,entry);
+	meshes.emplace(std::move(lookupKey),std::move(entry));
+	lookupKey.data.clear();
+	if(memoryUsed>memoryBudget)
+		evict(frame);
+	return ret;
+}
+
+void ShapeMeshCache::evict(uint32_t frame)
+{
+	//Entries of tokens that can't be tessellated expire like the meshes
+	typedef decltype(meshes)::iterator entryIterator;
+	vector<pair<uint32_t,entryIterator>> candidates;
+	for(auto it=meshes.begin();it!=meshes.end();++it)
+	{
+		if(it->second.lastUsedFrame!=frame)
+			candidates.push_back(make_pair(it->second.lastUsedFrame,it));
+	}
+	sort(candidates.begin(),candidates.end(),[](const pair<uint32_t,entryIterator>& a, const pair<uint32_t,entryIterator>& b) { return a.first<b.first; });
+	//Free some more memory, so the next mesh doesn't cause an eviction again
+	for(auto it=candidates.begin();it!=candidates.end() && memoryUsed>memoryBudget*3/4;++it)
+	{
+		memoryUsed-=getEntrySize(it->second->first,it->second->second);
+		meshes.erase(it->second);
+	}
+}
+
+void ShapeMeshCache::clear()
+{
+	meshes.clear();
+	memoryUsed=0;
+}
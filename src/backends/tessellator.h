@@ -0,0 +1,128 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#ifndef BACKENDS_TESSELLATOR_H
+#define BACKENDS_TESSELLATOR_H 1
+
+#include "compat.h"
+#include "backends/geometry.h"
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace lightspark
+{
+
+/*
+ * Triangles of a tessellated shape. Vertices are in pixels of the coordinate
+ * system of the shape, colors are premultiplied RGBA
+ */
+class ShapeMesh
+{
+public:
+	std::vector<float> vertices;
+	std::vector<float> colors;
+	// bounds of the vertices
+	float xmin;
+	float ymin;
+	float xmax;
+	float ymax;
+	// unique for every mesh created by a ShapeMeshCache
+	uint32_t id;
+	ShapeMesh():xmin(0),ymin(0),xmax(0),ymax(0),id(0) {}
+	uint32_t getVertexCount() const { return vertices.size()/2; }
+	size_t getMemorySize() const { return (vertices.size()+colors.size())*sizeof(float); }
+	/*
+	 * Draws the triangles transformed by m into a premultiplied ARGB32 buffer,
+	 * sampling the pixel centers like the GPU does. This allows checking the
+	 * tessellation against the cairo renderer without a GPU
+	 */
+	void rasterize(uint8_t* buf, uint32_t width, uint32_t height, uint32_t stride, const MATRIX& m) const;
+};
+
+class ShapeTessellator
+{
+public:
+	/*
+	 * Only solid fills and opaque solid strokes can be tessellated,
+	 * the triangles of a stroke may overlap
+	 */
+	static bool canTessellate(const tokensVector& tokens);
+	/*
+	 * Converts the tokens to triangles with the same even-odd fill and stroke semantics as
+	 * CairoTokenRenderer::cairoPathFromTokens. scaling converts the token coordinates to pixels,
+	 * curves are flattened precisely enough for drawing the mesh scaled by scale
+	 */
+	static bool tessellate(const tokensVector& tokens, float scaling, float scale, ShapeMesh& mesh);
+	/*
+	 * Replaces data with the geometry and the content of the styles used by the tokens,
+	 * so tokens of equal shapes produce equal data even if their styles are different objects
+	 */
+	static void serializeTokens(const tokensVector& tokens, float scaling, std::vector<uint64_t>& data);
+	// meshes are created for scales in steps of sqrt(2)
+	static int32_t getScaleBucket(float scale);
+	static float getBucketScale(int32_t bucket);
+};
+
+/*
+ * Meshes of shapes, keyed by the contents of the tokens and the scale bucket,
+ * so they are shared by all instances of a shape. Only used by the render thread
+ */
+class ShapeMeshCache
+{
+private:
+	struct meshKey
+	{
+		// the serialized tokens, compared so a hash collision can't return the mesh of another shape
+		std::vector<uint64_t> data;
+		uint64_t hash;
+		int32_t bucket;
+		bool operator==(const meshKey& r) const { return hash==r.hash && bucket==r.bucket && data==r.data; }
+	};
+	struct meshKeyHash
+	{
+		size_t operator()(const meshKey& k) const { return k.hash^(uint64_t(k.bucket)*0x9e3779b97f4a7c15ULL); }
+	};
+	struct meshEntry
+	{
+		// nullptr marks tokens that can't be tessellated
+		std::unique_ptr<ShapeMesh> mesh;
+		uint32_t lastUsedFrame;
+	};
+	std::unordered_map<meshKey,meshEntry,meshKeyHash> meshes;
+	// the key of the last lookup, reused to avoid an allocation for every hit
+	meshKey lookupKey;
+	size_t memoryUsed;
+	size_t memoryBudget;
+	uint32_t nextId;
+	uint32_t hits;
+	uint32_t misses;
+	static size_t getEntrySize(const meshKey& k, const meshEntry& e);
+	// removes the least recently used entries that were not used in frame
+	void evict(uint32_t frame);
+public:
+	ShapeMeshCache(size_t budget);
+	~ShapeMeshCache();
+	// returns nullptr if the tokens can't be tessellated
+	const ShapeMesh* getMesh(const tokensVector& tokens, float scaling, float scale, uint32_t frame);
+	void clear();
+};
+
+}
+#endif /* BACKENDS_TESSELLATOR_H */
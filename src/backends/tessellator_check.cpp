@@ -0,0 +1,248 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+/*
+ * Compares shapes drawn from tessellated meshes with the cairo renderer.
+ * Both are rasterized on the cpu without antialiasing at several scales,
+ * the tool fails if too many pixels differ.
+ * Usage: tessellator_check [max mismatch percentage]
+ */
+
+#include <cairo.h>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <list>
+#include <vector>
+#include "swf.h"
+#include "backends/graphics.h"
+#include "backends/tessellator.h"
+
+using namespace std;
+using namespace lightspark;
+
+// the styles have to outlive the tokens pointing to them
+static list<FILLSTYLE> fillStyles;
+static list<LINESTYLE2> lineStyles;
+
+static void addPoint(vector<uint64_t>& v, int32_t x, int32_t y)
+{
+	v.push_back(GeomToken(Vector2(x,y)).uval);
+}
+
+static void addFill(vector<uint64_t>& v, const RGBA& color)
+{
+	fillStyles.emplace_back(0xff);
+	fillStyles.back().FillStyleType=SOLID_FILL;
+	fillStyles.back().Color=color;
+	v.push_back(GeomToken(SET_FILL).uval);
+	v.push_back(GeomToken(fillStyles.back()).uval);
+}
+
+static void addStroke(vector<uint64_t>& v, uint16_t width, int cap, int join, uint16_t miterLimit, const RGBA& color)
+{
+	lineStyles.emplace_back(0xff);
+	LINESTYLE2& style=lineStyles.back();
+	style.Width=width;
+	style.StartCapStyle=cap;
+	style.JointStyle=join;
+	style.MiterLimitFactor=miterLimit;
+	style.Color=color;
+	v.push_back(GeomToken(SET_STROKE).uval);
+	v.push_back(GeomToken(style).uval);
+}
+
+static void addPolygon(vector<uint64_t>& v, const vector<pair<int32_t,int32_t>>& points)
+{
+	v.push_back(GeomToken(MOVE).uval);
+	addPoint(v,points[0].first,points[0].second);
+	for (uint32_t i = 1; i < points.size(); i++)
+	{
+		v.push_back(GeomToken(STRAIGHT).uval);
+		addPoint(v,points[i].first,points[i].second);
+	}
+	v.push_back(GeomToken(STRAIGHT).uval);
+	addPoint(v,points[0].first,points[0].second);
+}
+
+struct testShape
+{
+	const char* name;
+	tokensVector tokens;
+};
+
+static vector<testShape> createShapes()
+{
+	vector<testShape> shapes;
+	testShape s;
+
+	s.name="rectangle";
+	addFill(s.tokens.filltokens,RGBA(255,0,0,255));
+	addPolygon(s.tokens.filltokens,{{200,200},{1800,200},{1800,1200},{200,1200}});
+	shapes.push_back(s);
+
+	s=testShape();
+	s.name="hole";
+	addFill(s.tokens.filltokens,RGBA(0,128,255,255));
+	addPolygon(s.tokens.filltokens,{{100,100},{1900,100},{1900,1900},{100,1900}});
+	addPolygon(s.tokens.filltokens,{{600,600},{1400,700},{1300,1400},{700,1300}});
+	shapes.push_back(s);
+
+	s=testShape();
+	s.name="star";
+	addFill(s.tokens.filltokens,RGBA(0,200,0,128));
+	vector<pair<int32_t,int32_t>> star;
+	for (uint32_t i = 0; i < 5; i++)
+	{
+		double a=M_PI*2*(i*2%5)/5-M_PI/2;
+		star.push_back(make_pair(int32_t(1000+900*cos(a)),int32_t(1000+900*sin(a))));
+	}
+	addPolygon(s.tokens.filltokens,star);
+	shapes.push_back(s);
+
+	s=testShape();
+	s.name="curves";
+	addFill(s.tokens.filltokens,RGBA(200,100,0,255));
+	s.tokens.filltokens.push_back(GeomToken(MOVE).uval);
+	addPoint(s.tokens.filltokens,200,1000);
+	s.tokens.filltokens.push_back(GeomToken(CURVE_QUADRATIC).uval);
+	addPoint(s.tokens.filltokens,200,200);
+	addPoint(s.tokens.filltokens,1000,200);
+	s.tokens.filltokens.push_back(GeomToken(CURVE_QUADRATIC).uval);
+	addPoint(s.tokens.filltokens,1800,200);
+	addPoint(s.tokens.filltokens,1800,1000);
+	s.tokens.filltokens.push_back(GeomToken(CURVE_CUBIC).uval);
+	addPoint(s.tokens.filltokens,1800,2200);
+	addPoint(s.tokens.filltokens,200,-200);
+	addPoint(s.tokens.filltokens,200,1000);
+	shapes.push_back(s);
+
+	s=testShape();
+	s.name="two fills";
+	addFill(s.tokens.filltokens,RGBA(255,255,0,255));
+	addPolygon(s.tokens.filltokens,{{100,100},{1200,100},{1200,1200},{100,1200}});
+	addFill(s.tokens.filltokens,RGBA(0,0,255,160));
+	addPolygon(s.tokens.filltokens,{{800,800},{1900,800},{1900,1900},{800,1900}});
+	shapes.push_back(s);
+
+	// joins: 0 round, 1 bevel, 2 miter; caps: 0 round, 1 none, 2 square
+	const char* strokeNames[]={"round stroke","bevel stroke","miter stroke","hairline"};
+	for (int i = 0; i < 4; i++)
+	{
+		s=testShape();
+		s.name=strokeNames[i];
+		addStroke(s.tokens.stroketokens,i==3 ? 0 : 120,i==3 ? 1 : i,i==3 ? 2 : i,3,RGBA(0,0,0,255));
+		s.tokens.stroketokens.push_back(GeomToken(MOVE).uval);
+		addPoint(s.tokens.stroketokens,300,1700);
+		s.tokens.stroketokens.push_back(GeomToken(STRAIGHT).uval);
+		addPoint(s.tokens.stroketokens,700,300);
+		s.tokens.stroketokens.push_back(GeomToken(STRAIGHT).uval);
+		addPoint(s.tokens.stroketokens,1000,1500);
+		s.tokens.stroketokens.push_back(GeomToken(CURVE_QUADRATIC).uval);
+		addPoint(s.tokens.stroketokens,1700,1900);
+		addPoint(s.tokens.stroketokens,1700,300);
+		s.tokens.stroketokens.push_back(GeomToken(CLEAR_STROKE).uval);
+		shapes.push_back(s);
+	}
+
+	s=testShape();
+	s.name="filled and stroked";
+	addFill(s.tokens.filltokens,RGBA(100,200,255,255));
+	addPolygon(s.tokens.filltokens,{{300,300},{1700,500},{1500,1700},{400,1500}});
+	addStroke(s.tokens.stroketokens,80,0,0,3,RGBA(50,50,50,255));
+	addPolygon(s.tokens.stroketokens,{{300,300},{1700,500},{1500,1700},{400,1500}});
+	shapes.push_back(s);
+	return shapes;
+}
+
+static bool pixelsDiffer(uint32_t a, uint32_t b)
+{
+	for (uint32_t i = 0; i < 32; i += 8)
+	{
+		if (abs(int((a>>i)&0xff)-int((b>>i)&0xff)) > 2)
+			return true;
+	}
+	return false;
+}
+
+int main(int argc, char* argv[])
+{
+	double maxMismatch = argc > 1 ? atof(argv[1]) : 2.0;
+	const float scaling = 1.0f/20.0f;
+	const double scales[] = { 0.5, 1.0, 2.3, 6.0 };
+	vector<testShape> shapes = createShapes();
+	bool failed = false;
+	for (auto it = shapes.begin(); it != shapes.end(); it++)
+	{
+		if (!ShapeTessellator::canTessellate(it->tokens))
+		{
+			cout << it->name << ": can't be tessellated" << endl;
+			failed = true;
+			continue;
+		}
+		for (double scale : scales)
+		{
+			ShapeMesh mesh;
+			if (!ShapeTessellator::tessellate(it->tokens,scaling,scale,mesh))
+			{
+				cout << it->name << ": tessellation failed" << endl;
+				failed = true;
+				break;
+			}
+			// the shapes are 100x100 pixels at scale 1, with a border for strokes
+			const uint32_t size = ceil(120*scale);
+			const double offset = 10*scale;
+			cairo_surface_t* surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,size,size);
+			cairo_t* cr = cairo_create(surface);
+			cairo_set_antialias(cr,CAIRO_ANTIALIAS_NONE);
+			cairo_translate(cr,offset,offset);
+			cairo_scale(cr,scale,scale);
+			CairoTokenRenderer::drawTokens(cr,it->tokens,scaling);
+			cairo_destroy(cr);
+			cairo_surface_flush(surface);
+
+			const uint32_t stride = cairo_image_surface_get_stride(surface);
+			vector<uint8_t> buf(stride*size,0);
+			mesh.rasterize(buf.data(),size,size,stride,MATRIX(scale,scale,0,0,offset,offset));
+
+			const uint8_t* reference = cairo_image_surface_get_data(surface);
+			uint32_t covered = 0;
+			uint32_t mismatched = 0;
+			for (uint32_t y = 0; y < size; y++)
+			{
+				const uint32_t* r = (const uint32_t*)(reference+y*stride);
+				const uint32_t* m = (const uint32_t*)(buf.data()+y*stride);
+				for (uint32_t x = 0; x < size; x++)
+				{
+					if (r[x] || m[x])
+						covered++;
+					if (pixelsDiffer(r[x],m[x]))
+						mismatched++;
+				}
+			}
+			cairo_surface_destroy(surface);
+			double percent = covered ? 100.0*mismatched/covered : 0;
+			bool ok = percent <= maxMismatch;
+			cout << it->name << " at scale " << scale << ": " << mesh.getVertexCount()/3 << " triangles, "
+			     << mismatched << " of " << covered << " pixels differ (" << percent << "%)" << (ok ? "" : " FAILED") << endl;
+			failed |= !ok;
+		}
+	}
+	return failed ? 1 : 0;
+}
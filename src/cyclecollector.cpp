@@ -0,0 +1,257 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+
+#include "cyclecollector.h"
+#include "asobject.h"
+#include "logger.h"
+
+using namespace std;
+using namespace lightspark;
+
+// scans of object graphs bigger than this are abandoned
+#define CYCLECOLLECTOR_MAX_NODES 200000
+
+CycleCollector::CycleCollector(uint32_t _budget):budget(_budget),scannedobjects(0),collectedobjects(0),scansteps(0)
+{
+}
+
+CycleCollector::~CycleCollector()
+{
+	releaseNodes();
+	Locker l(mutex);
+	for (auto it = candidates.begin(); it != candidates.end(); it++)
+		(*it)->setGCBuffered(false);
+	LOG(LOG_INFO,"cycle collector: scanned "<<scannedobjects<<" objects in "<<scansteps<<" steps, collected "<<collectedobjects<<" objects");
+}
+
+void CycleCollector::addCandidate(ASObject* o)
+{
+	Locker l(mutex);
+	if (o->getGCBuffered())
+		return;
+	o->setGCBuffered(true);
+	candidates.insert(o);
+}
+
+void CycleCollector::removeCandidate(ASObject* o)
+{
+	Locker l(mutex);
+	if (!o->getGCBuffered())
+		return;
+	o->setGCBuffered(false);
+	candidates.erase(o);
+}
+
+bool CycleCollector::isScannable(ASObject* o) const
+{
+	// objects of other workers and objects in a free list are never collected
+	return o->getGCTracked() && !o->getConstant() && !o->getCached() && !o->getInDestruction();
+}
+
+void CycleCollector::addNode(ASObject* o)
+{
+	node& n = nodes[o];
+	n.count = o->getRefCount();
+	// keep the object alive until the scan is finished, this reference is not part of count
+	o->incRef();
+	graystack.push_back(o);
+}
+
+void CycleCollector::release(ASObject* o)
+{
+	if (o->getGCBuffered() || o->isLastRef())
+	{
+		o->decRef();
+		return;
+	}
+	// dropping this reference should not make the object a candidate again
+	o->decRef();
+	removeCandidate(o);
+}
+
+void CycleCollector::releaseNodes()
+{
+	vector<ASObject*> scanned;
+	scanned.reserve(nodes.size());
+	for (auto it = nodes.begin(); it != nodes.end(); it++)
+		scanned.push_back(it->first);
+	nodes.clear();
+	graystack.clear();
+	for (auto it = scanned.begin(); it != scanned.end(); it++)
+		release(*it);
+}
+
+bool CycleCollector::markGray(gint64 endtime)
+{
+	uint32_t visited = 0;
+	while (!graystack.empty())
+	{
+		if ((++visited & 0x3f) == 0 && g_get_monotonic_time() >= endtime)
+			return false;
+		ASObject* o = graystack.back();
+		graystack.pop_back();
+		vector<ASObject*> children;
+		o->gcChildren(children);
+		for (auto it = children.begin(); it != children.end(); it++)
+		{
+			if (!isScannable(*it))
+				continue;
+			if (nodes.find(*it) == nodes.end())
+			{
+				if (nodes.size() >= CYCLECOLLECTOR_MAX_NODES)
+				{
+					LOG(LOG_CALLS,"cycle collector: object graph too big, scan abandoned");
+					releaseNodes();
+					return true;
+				}
+				addNode(*it);
+			}
+			// trial deletion of the reference
+			nodes[*it].count--;
+		}
+		nodes[o].children.swap(children);
+	}
+	return true;
+}
+
+void CycleCollector::finishScan()
+{
+	scannedobjects += nodes.size();
+	// everything reachable from an object with references from outside the scanned graph is alive
+	vector<ASObject*> stack;
+	for (auto it = nodes.begin(); it != nodes.end(); it++)
+	{
+		if (it->second.count > 0)
+		{
+			it->second.alive = true;
+			stack.push_back(it->first);
+		}
+	}
+	while (!stack.empty())
+	{
+		node& n = nodes[stack.back()];
+		stack.pop_back();
+		for (auto it = n.children.begin(); it != n.children.end(); it++)
+		{
+			auto itn = nodes.find(*it);
+			if (itn != nodes.end() && !itn->second.alive)
+			{
+				itn->second.alive = true;
+				stack.push_back(*it);
+			}
+		}
+	}
+	// the counts and children were taken over several steps, so the trial deletion is repeated
+	// for the garbage only, using the current references. This is a single step, but the garbage
+	// is usually a small part of the scanned graph
+	unordered_map<ASObject*,node> garbage;
+	for (auto it = nodes.begin(); it != nodes.end(); it++)
+	{
+		if (!it->second.alive && isScannable(it->first))
+			garbage[it->first].count = it->first->getRefCount()-1;
+	}
+	for (auto it = garbage.begin(); it != garbage.end(); it++)
+	{
+		it->first->gcChildren(it->second.children);
+		for (auto itc = it->second.children.begin(); itc != it->second.children.end(); itc++)
+		{
+			auto itg = garbage.find(*itc);
+			if (itg != garbage.end())
+				itg->second.count--;
+		}
+	}
+	for (auto it = garbage.begin(); it != garbage.end(); it++)
+	{
+		if (it->second.count > 0)
+		{
+			it->second.alive = true;
+			stack.push_back(it->first);
+		}
+	}
+	while (!stack.empty())
+	{
+		node& n = garbage[stack.back()];
+		stack.pop_back();
+		for (auto it = n.children.begin(); it != n.children.end(); it++)
+		{
+			auto itg = garbage.find(*it);
+			if (itg != garbage.end() && !itg->second.alive)
+			{
+				itg->second.alive = true;
+				stack.push_back(*it);
+			}
+		}
+	}
+	// the reference taken while scanning is kept for the garbage until the references between the objects are released
+	vector<ASObject*> freed;
+	for (auto it = garbage.begin(); it != garbage.end(); it++)
+	{
+		if (!it->second.alive)
+		{
+			freed.push_back(it->first);
+			nodes.erase(it->first);
+		}
+	}
+	releaseNodes();
+	if (freed.empty())
+		return;
+	LOG(LOG_CALLS,"cycle collector: freeing "<<freed.size()<<" objects");
+	collectedobjects += freed.size();
+	// references from activation objects to closures are not counted in the activation count anymore,
+	// all of them are released by gcClearReferences
+	for (auto it = freed.begin(); it != freed.end(); it++)
+		(*it)->setActivationCount(1);
+	for (auto it = freed.begin(); it != freed.end(); it++)
+		(*it)->gcClearReferences();
+	for (auto it = freed.begin(); it != freed.end(); it++)
+	{
+		removeCandidate(*it);
+		(*it)->decRef();
+	}
+}
+
+void CycleCollector::collect()
+{
+	gint64 endtime = g_get_monotonic_time()+budget;
+	while (g_get_monotonic_time() < endtime)
+	{
+		if (nodes.empty())
+		{
+			ASObject* root = nullptr;
+			{
+				Locker l(mutex);
+				auto it = candidates.begin();
+				if (it == candidates.end())
+					break;
+				root = *it;
+				root->setGCBuffered(false);
+				candidates.erase(it);
+			}
+			if (!isScannable(root))
+				continue;
+			addNode(root);
+		}
+		scansteps++;
+		if (!markGray(endtime))
+			return;
+		if (!nodes.empty())
+			finishScan();
+	}
+}
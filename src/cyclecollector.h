@@ -0,0 +1,90 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+
+#ifndef CYCLECOLLECTOR_H
+#define CYCLECOLLECTOR_H 1
+
+#include "compat.h"
+#include "threading.h"
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace lightspark
+{
+class ASObject;
+class SystemState;
+
+/*
+ * Collects reference cycles between ASObjects of the main worker, which are
+ * never freed by reference counting alone.
+ * Objects whose reference count is decremented to a nonzero value are candidates
+ * for the root of a garbage cycle. For every candidate the collector does a trial
+ * deletion of all references between the objects reachable from it (see
+ * ASObject::gcChildren). Objects whose reference count is not explained by these
+ * references are alive, as is everything reachable from them, all other objects
+ * are garbage and are freed.
+ * collect() runs on the VM thread once per frame and stops after the time budget is used up.
+ * A scan that is not finished is continued by the next call. Scanned objects are kept
+ * alive by a reference until the scan is finished, and as the mutator may change the
+ * graph between two steps, the garbage found is checked again against the current
+ * references before it is freed.
+ */
+class CycleCollector
+{
+private:
+	struct node
+	{
+		// reference count minus the references from other scanned objects
+		int32_t count;
+		bool alive;
+		std::vector<ASObject*> children;
+		node():count(0),alive(false) {}
+	};
+	Mutex mutex;
+	std::unordered_set<ASObject*> candidates;
+	// state of the scan in progress, only used on the VM thread
+	std::unordered_map<ASObject*,node> nodes;
+	// scanned objects whose children were not visited yet
+	std::vector<ASObject*> graystack;
+	// time budget per call of collect() in microseconds
+	uint32_t budget;
+	uint64_t scannedobjects;
+	uint64_t collectedobjects;
+	uint64_t scansteps;
+	bool isScannable(ASObject* o) const;
+	void addNode(ASObject* o);
+	// returns false if the time budget is used up before all objects reachable from the root were visited
+	bool markGray(gint64 endtime);
+	// checks the garbage found by the scan against the current references and frees it
+	void finishScan();
+	// drops the references to all scanned objects
+	void releaseNodes();
+	void release(ASObject* o);
+public:
+	CycleCollector(uint32_t _budget);
+	~CycleCollector();
+	void addCandidate(ASObject* o);
+	void removeCandidate(ASObject* o);
+	void collect();
+};
+
+}
+#endif /* CYCLECOLLECTOR_H */
@@ -20,13 +20,19 @@ const mat3 YUVtoRGB = mat3(1.164383, 1.164383, 1.164383, //First column
 
 void main()
 {
-	vec4 vbase = texture2D(g_tex1,ls_TexCoords[0].xy);
+	vec4 vbase;
+	// direct mode 4 draws the premultiplied vertex colors of tessellated shapes
+	if (direct == 4.0) {
+		vbase = ls_FrontColor;
+	} else {
+		vbase = texture2D(g_tex1,ls_TexCoords[0].xy);
+#ifdef GL_ES
+		vbase.rgb = vbase.bgr;
+#endif
+	}
 	// discard everything that doesn't fit the mask
 	if (mask != 0.0 && texture2D(g_tex2,ls_TexCoords[1].xy).a == 0.0)
 		discard;
-#ifdef GL_ES
-	vbase.rgb = vbase.bgr;
-#endif
 	vbase *= alpha;
 	// add colortransformation
 	if (colorTransformMultiply != vec4(1,1,1,1) || colorTransformAdd != vec4(0,0,0,0))
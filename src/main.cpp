@@ -334,10 +334,15 @@ int main(int argc, char* argv[])
 	char* profilingFileName=nullptr;
 #endif
 	char *HTTPcookie=nullptr;
+	uint32_t benchmarkFrames=0;
+	char* benchmarkFileName=nullptr;
+	char* tieringProfileFileName=nullptr;
+	int32_t gcBudget=-1;
 	SecurityManager::SANDBOXTYPE sandboxType=SecurityManager::LOCAL_WITH_FILE;
 	bool useInterpreter=true;
 	bool useFastInterpreter=false;
 	bool useJit=false;
+	bool usePreloadCache=false;
 	bool ignoreUnhandledExceptions = false;
 	SystemState::ERROR_TYPE exitOnError=SystemState::ERROR_PARSING;
 	LOG_LEVEL log_level=LOG_INFO;
@@ -370,6 +375,8 @@ int main(int argc, char* argv[])
 			useFastInterpreter=true;
 		else if(strcmp(argv[i],"-j")==0 || strcmp(argv[i],"--enable-jit")==0)
 			useJit=true;
+		else if(strcmp(argv[i],"-pc")==0 || strcmp(argv[i],"--enable-preload-cache")==0)
+			usePreloadCache=true;
 		else if(strcmp(argv[i],"-ne")==0 || strcmp(argv[i],"--ignore-unhandled-exceptions")==0)
 			ignoreUnhandledExceptions=true;
 		else if(strcmp(argv[i],"-l")==0 || strcmp(argv[i],"--log-level")==0)
@@ -450,6 +457,46 @@ int main(int argc, char* argv[])
 		{
 			EngineData::enablerendering = false;
 		}
+		else if(strcmp(argv[i],"--benchmark-frames")==0)
+		{
+			i++;
+			if(i==argc)
+			{
+				fileName=nullptr;
+				break;
+			}
+			benchmarkFrames=max(0, atoi(argv[i]));
+		}
+		else if(strcmp(argv[i],"--benchmark-output")==0)
+		{
+			i++;
+			if(i==argc)
+			{
+				fileName=nullptr;
+				break;
+			}
+			benchmarkFileName=argv[i];
+		}
+		else if(strcmp(argv[i],"--tiering-profile")==0)
+		{
+			i++;
+			if(i==argc)
+			{
+				fileName=nullptr;
+				break;
+			}
+			tieringProfileFileName=argv[i];
+		}
+		else if(strcmp(argv[i],"--gc-budget")==0)
+		{
+			i++;
+			if(i==argc)
+			{
+				fileName=nullptr;
+				break;
+			}
+			gcBudget=max(0, atoi(argv[i]));
+		}
 		
 		else if(strcmp(argv[i],"--HTTP-cookies")==0)
 		{
@@ -476,12 +523,14 @@ int main(int argc, char* argv[])
 	if(fileName==nullptr)
 	{
 		LOG(LOG_ERROR, "Usage: " << argv[0] << " [--url|-u http://loader.url/file.swf]" <<
-			" [--disable-interpreter|-ni] [--enable-fast-interpreter|-fi]" <<
+			" [--disable-interpreter|-ni] [--enable-fast-interpreter|-fi] [--enable-preload-cache|-pc]" <<
 #ifdef LLVM_ENABLED
 			" [--enable-jit|-j]" <<
 #endif
 			" [--log-level|-l 0-4] [--parameters-file|-p params-file] [--security-sandbox|-s sandbox]" <<
 			" [--exit-on-error] [--HTTP-cookies cookie] [--air] [--avmplus] [--disable-rendering]" <<
+			" [--benchmark-frames frames] [--benchmark-output file.csv|file.json] [--tiering-profile file]" <<
+			" [--gc-budget milliseconds]" <<
 #ifdef PROFILING_SUPPORT
 			" [--profiling-output|-o profiling-file]" <<
 #endif
@@ -493,8 +542,11 @@ int main(int argc, char* argv[])
 	}
 
 	Log::setLogLevel(log_level);
-	lsfilereader r(fileName);
-	istream f(&r);
+	// local files are mapped into memory, so the parser doesn't copy them and the tags can keep views of their data
+	unique_ptr<streambuf> r(bytes_buf::fromMappedFile(fileName));
+	if(!r)
+		r.reset(new lsfilereader(fileName));
+	istream f(r.get());
 	f.seekg(0, ios::end);
 	uint32_t fileSize=f.tellg();
 	f.seekg(0, ios::beg);
@@ -563,6 +615,7 @@ int main(int argc, char* argv[])
 	sys->useInterpreter=useInterpreter;
 	sys->useFastInterpreter=useFastInterpreter;
 	sys->useJit=useJit;
+	sys->usePreloadCache=usePreloadCache || Config::getConfig()->isPreloadCacheEnabled();
 	sys->ignoreUnhandledExceptions=ignoreUnhandledExceptions;
 	sys->exitOnError=exitOnError;
 	if(paramsFileName)
@@ -573,6 +626,11 @@ int main(int argc, char* argv[])
 #endif
 	if(HTTPcookie)
 		sys->setCookies(HTTPcookie);
+	if(tieringProfileFileName)
+		sys->tieringProfileOutput=tieringProfileFileName;
+	if(benchmarkFrames)
+		sys->enableBenchmark(benchmarkFrames,benchmarkFileName ? benchmarkFileName : "");
+	sys->setCycleCollectorBudget(gcBudget >= 0 ? gcBudget : Config::getConfig()->getCycleCollectorBudget());
 
 	// create path for shared object local storage
 	char absolutepath[PATH_MAX];
@@ -17,7 +17,10 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 **************************************************************************/
 
+#include <cstring>
+#include <vector>
 #include "memory_support.h"
+#include "logger.h"
 #include "swf.h"
 
 using namespace lightspark;
@@ -30,3 +33,280 @@ MemoryAccount* lightspark::getUnaccountedMemoryAccount()
 		return NULL;
 }
 #endif
+
+namespace
+{
+struct slab_pool;
+// header at the start of every chunk
+struct slab_chunk
+{
+	slab_pool* owner;
+	uint32_t sizeclass;
+	char padding[SLAB_GRANULARITY-sizeof(slab_pool*)-sizeof(uint32_t)];
+};
+
+/*
+ * Bitmap of the addresses of all chunks, so that slab_free can tell slab objects from
+ * malloc'ed ones without knowing their size. The first level is indexed by the bits
+ * 32-47 of the address, the second level has one bit for each chunk in 4GB. Chunks are
+ * never given back to the system, so the bits are never cleared.
+ */
+#define SLAB_CHUNKMAP_ROOT_SIZE (sizeof(void*) > 4 ? 0x10000 : 1)
+#define SLAB_CHUNKMAP_LEAF_SIZE (0x10000/64)
+std::atomic<std::atomic<uint64_t>*> chunkmap[SLAB_CHUNKMAP_ROOT_SIZE];
+
+bool isSlabChunk(uintptr_t chunk)
+{
+	uint64_t root = uint64_t(chunk)>>32;
+	if (root >= SLAB_CHUNKMAP_ROOT_SIZE)
+		return false;
+	std::atomic<uint64_t>* leaf = chunkmap[root].load(std::memory_order_acquire);
+	if (!leaf)
+		return false;
+	uint32_t index = (chunk>>16)&0xffff;
+	return leaf[index/64].load(std::memory_order_acquire) & (uint64_t(1)<<(index%64));
+}
+
+bool registerChunk(uintptr_t chunk)
+{
+	uint64_t root = uint64_t(chunk)>>32;
+	if (root >= SLAB_CHUNKMAP_ROOT_SIZE)
+		return false;
+	std::atomic<uint64_t>* leaf = chunkmap[root].load(std::memory_order_acquire);
+	if (!leaf)
+	{
+		std::atomic<uint64_t>* newleaf = new std::atomic<uint64_t>[SLAB_CHUNKMAP_LEAF_SIZE]();
+		if (chunkmap[root].compare_exchange_strong(leaf,newleaf))
+			leaf = newleaf;
+		else
+			delete[] newleaf;
+	}
+	uint32_t index = (chunk>>16)&0xffff;
+	leaf[index/64].fetch_or(uint64_t(1)<<(index%64),std::memory_order_release);
+	return true;
+}
+
+/*
+ * Objects freed by a thread not owning their chunk, or by a thread whose pool is already
+ * gone, are pushed to a global list per size class. Pools take the whole list when their
+ * own free list is empty.
+ */
+std::atomic<void*> depot[SLAB_SIZE_CLASS_COUNT];
+std::atomic<int64_t> depotcount[SLAB_SIZE_CLASS_COUNT];
+
+void depotPush(void* p, uint32_t c)
+{
+	void* head = depot[c].load();
+	do
+	{
+		*(void**)p = head;
+	}
+	while (!depot[c].compare_exchange_weak(head,p));
+	depotcount[c]++;
+}
+
+struct slab_sizeclass
+{
+	void* freelist;
+	// unused space at the end of the newest chunk
+	char* bumpptr;
+	char* bumpend;
+	uint32_t chunks;
+	// objects allocated minus objects put in the free list, objects taken from the depot
+	// may make it negative
+	int64_t inuse;
+	slab_sizeclass():freelist(nullptr),bumpptr(nullptr),bumpend(nullptr),chunks(0),inuse(0) {}
+};
+struct slab_pool
+{
+	slab_sizeclass classes[SLAB_SIZE_CLASS_COUNT];
+	void drainDepot(uint32_t c)
+	{
+		void* list = depot[c].exchange(nullptr);
+		if (!list)
+			return;
+		void* last = list;
+		int64_t n = 1;
+		while (*(void**)last)
+		{
+			last = *(void**)last;
+			n++;
+		}
+		*(void**)last = classes[c].freelist;
+		classes[c].freelist = list;
+		classes[c].inuse -= n;
+		depotcount[c] -= n;
+	}
+	void* allocate(uint32_t c)
+	{
+		slab_sizeclass& sc = classes[c];
+		if (!sc.freelist)
+			drainDepot(c);
+		void* ret = sc.freelist;
+		if (ret)
+			sc.freelist = *(void**)ret;
+		else
+		{
+			size_t objsize = (c+1)*SLAB_GRANULARITY;
+			if (sc.bumpptr+objsize > sc.bumpend)
+			{
+				void* chunk;
+				aligned_malloc(&chunk,SLAB_CHUNK_SIZE,SLAB_CHUNK_SIZE);
+				if (!registerChunk((uintptr_t)chunk))
+				{
+					// outside of the address range covered by the chunk map
+					aligned_free(chunk);
+					return malloc(objsize);
+				}
+				((slab_chunk*)chunk)->owner = this;
+				((slab_chunk*)chunk)->sizeclass = c;
+				sc.bumpptr = (char*)chunk+sizeof(slab_chunk);
+				sc.bumpend = (char*)chunk+SLAB_CHUNK_SIZE;
+				sc.chunks++;
+			}
+			ret = sc.bumpptr;
+			sc.bumpptr += objsize;
+		}
+		sc.inuse++;
+		return ret;
+	}
+	void free(void* p, uint32_t c)
+	{
+		*(void**)p = classes[c].freelist;
+		classes[c].freelist = p;
+		classes[c].inuse--;
+	}
+};
+
+// all pools ever created, pools of finished threads are reused by new threads
+std::atomic_flag poolslock = ATOMIC_FLAG_INIT;
+std::vector<slab_pool*>* allpools = nullptr;
+std::vector<slab_pool*>* unusedpools = nullptr;
+// serves allocations of threads whose pool is already gone, protected by poolslock
+slab_pool* fallbackpool = nullptr;
+
+struct slab_pool_locker
+{
+	slab_pool_locker() { while (poolslock.test_and_set(std::memory_order_acquire)) {} }
+	~slab_pool_locker() { poolslock.clear(std::memory_order_release); }
+};
+
+slab_pool* newPool()
+{
+	if (!allpools)
+	{
+		allpools = new std::vector<slab_pool*>();
+		unusedpools = new std::vector<slab_pool*>();
+	}
+	slab_pool* pool = new slab_pool();
+	allpools->push_back(pool);
+	return pool;
+}
+
+// set when the pool of this thread is handed back, objects freed by the destructors of
+// thread_local or static objects running later must not touch it
+thread_local bool threadpoolreleased = false;
+
+struct slab_thread_pool
+{
+	slab_pool* pool;
+	slab_thread_pool():pool(nullptr) {}
+	~slab_thread_pool()
+	{
+		threadpoolreleased = true;
+		// the objects of this pool may still be in use, so it is kept for the next thread
+		if (!pool)
+			return;
+		slab_pool_locker l;
+		unusedpools->push_back(pool);
+		pool = nullptr;
+	}
+	slab_pool* get()
+	{
+		if (pool)
+			return pool;
+		slab_pool_locker l;
+		if (!unusedpools || unusedpools->empty())
+			pool = newPool();
+		else
+		{
+			pool = unusedpools->back();
+			unusedpools->pop_back();
+		}
+		return pool;
+	}
+};
+thread_local slab_thread_pool threadpool;
+}
+
+void* lightspark::slab_alloc(size_t size)
+{
+	if (size > SLAB_MAX_SIZE || size == 0)
+		return malloc(size);
+	uint32_t c = (size-1)/SLAB_GRANULARITY;
+	if (threadpoolreleased)
+	{
+		slab_pool_locker l;
+		if (!fallbackpool)
+			fallbackpool = newPool();
+		return fallbackpool->allocate(c);
+	}
+	return threadpool.get()->allocate(c);
+}
+
+void lightspark::slab_free(void* p)
+{
+	if (!p)
+		return;
+	uintptr_t chunk = (uintptr_t)p & ~(uintptr_t)(SLAB_CHUNK_SIZE-1);
+	if (!isSlabChunk(chunk))
+	{
+		free(p);
+		return;
+	}
+	uint32_t c = ((slab_chunk*)chunk)->sizeclass;
+	if (!threadpoolreleased && ((slab_chunk*)chunk)->owner == threadpool.pool)
+		threadpool.pool->free(p,c);
+	else
+		depotPush(p,c);
+}
+
+void lightspark::slab_get_statistics(slab_statistics& stats)
+{
+	memset(&stats,0,sizeof(stats));
+	slab_pool_locker l;
+	if (!allpools)
+		return;
+	stats.pools = allpools->size();
+	for (uint32_t i = 0; i < SLAB_SIZE_CLASS_COUNT; i++)
+	{
+		uint64_t chunks = 0;
+		int64_t inuse = -depotcount[i].load();
+		for (auto it = allpools->begin(); it != allpools->end(); it++)
+		{
+			chunks += (*it)->classes[i].chunks;
+			inuse += (*it)->classes[i].inuse;
+		}
+		uint64_t reserved = chunks*SLAB_CHUNK_SIZE;
+		uint64_t used = inuse > 0 ? uint64_t(inuse)*(i+1)*SLAB_GRANULARITY : 0;
+		stats.reservedbytesperclass[i] = reserved;
+		stats.usedbytesperclass[i] = used;
+		stats.reservedbytes += reserved;
+		stats.usedbytes += used;
+	}
+}
+
+void lightspark::slab_log_statistics()
+{
+	slab_statistics stats;
+	slab_get_statistics(stats);
+	if (!stats.reservedbytes)
+		return;
+	LOG(LOG_INFO,"slab allocator: "<<stats.pools<<" pools, "<<stats.reservedbytes/1024<<" KB reserved, "<<stats.usedbytes/1024<<" KB used, "
+		<<(100*(stats.reservedbytes-stats.usedbytes))/stats.reservedbytes<<"% fragmentation");
+	for (uint32_t i = 0; i < SLAB_SIZE_CLASS_COUNT; i++)
+	{
+		if (stats.reservedbytesperclass[i])
+			LOG(LOG_TRACE,"slab allocator: size "<<(i+1)*SLAB_GRANULARITY<<": "<<stats.reservedbytesperclass[i]/1024<<" KB reserved, "<<stats.usedbytesperclass[i]/1024<<" KB used");
+	}
+}
@@ -27,6 +27,63 @@
 namespace lightspark
 {
 
+/*
+ * Allocator for small objects. Every thread has its own pool with a free list per
+ * size class, the memory is taken from chunks of SLAB_CHUNK_SIZE bytes aligned to
+ * their size, so the pool that owns an object can be found from its address.
+ * Objects freed by another thread, or after the pool of the freeing thread was
+ * released at thread exit, go to a global list per size class that pools refill from.
+ * Sizes above SLAB_MAX_SIZE are passed to malloc. slab_free doesn't need the size,
+ * the size class is stored in the chunk header and malloc'ed memory is recognized
+ * by its address.
+ */
+#define SLAB_CHUNK_SIZE (64*1024)
+#define SLAB_GRANULARITY 16
+#define SLAB_SIZE_CLASS_COUNT 32
+#define SLAB_MAX_SIZE (SLAB_GRANULARITY*SLAB_SIZE_CLASS_COUNT)
+DLL_PUBLIC void* slab_alloc(size_t size);
+DLL_PUBLIC void slab_free(void* p);
+struct slab_statistics
+{
+	// memory taken from the system for the chunks
+	uint64_t reservedbytes;
+	// memory of the objects currently allocated
+	uint64_t usedbytes;
+	uint64_t reservedbytesperclass[SLAB_SIZE_CLASS_COUNT];
+	uint64_t usedbytesperclass[SLAB_SIZE_CLASS_COUNT];
+	uint32_t pools;
+};
+DLL_PUBLIC void slab_get_statistics(slab_statistics& stats);
+// logs the fragmentation of the slab allocator, i.e. the part of the reserved memory not used by objects
+void slab_log_statistics();
+
+template<class T>
+class slab_allocator
+{
+public:
+	typedef T value_type;
+	template<class U>
+	struct rebind
+	{
+		typedef slab_allocator<U> other;
+	};
+	slab_allocator() {}
+	template<class U>
+	slab_allocator(const slab_allocator<U>&) {}
+	T* allocate(std::size_t n)
+	{
+		return (T*)slab_alloc(n*sizeof(T));
+	}
+	void deallocate(T* p, std::size_t)
+	{
+		slab_free(p);
+	}
+};
+template<class T, class U>
+bool operator==(const slab_allocator<T>&, const slab_allocator<U>&) { return true; }
+template<class T, class U>
+bool operator!=(const slab_allocator<T>&, const slab_allocator<U>&) { return false; }
+
 #ifdef MEMORY_USAGE_PROFILING
 class MemoryAccount;
 DLL_PUBLIC MemoryAccount* getUnaccountedMemoryAccount();
@@ -75,7 +132,7 @@ public:
 		//Prepend some internal data.
 		//Adding the data to the object itself would not work
 		//since it can be reset by the constructors
-		objData* ret=reinterpret_cast<objData*>(malloc(size+sizeof(objData)));
+		objData* ret=reinterpret_cast<objData*>(slab_alloc(size+sizeof(objData)));
 		if(!m)
 			m = getUnaccountedMemoryAccount();
 		m->addBytes(size);
@@ -88,7 +145,12 @@ public:
 		//Get back the metadata
 		objData* th=reinterpret_cast<objData*>(obj)-1;
 		th->memoryAccount->removeBytes(th->objSize);
-		free(th);
+		slab_free(th);
+	}
+	//Called if a constructor throws
+	inline void operator delete( void* obj, MemoryAccount* )
+	{
+		operator delete(obj);
 	}
 };
 
@@ -183,11 +245,16 @@ public:
 	//Regular allocator
 	inline void* operator new( size_t size, MemoryAccount* m)
 	{
-		return malloc(size);
+		return slab_alloc(size);
 	}
 	inline void operator delete( void* obj )
 	{
-		free(obj);
+		slab_free(obj);
+	}
+	//Called if a constructor throws
+	inline void operator delete( void* obj, MemoryAccount* )
+	{
+		slab_free(obj);
 	}
 };
 
@@ -0,0 +1,160 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+/*
+ * Checks the slab allocator with objects freed by other threads than the allocating
+ * one, after the allocating thread has exited and after the pool of the freeing thread
+ * was released at thread exit. The freed memory has to be reused and the statistics
+ * have to be back to their initial value at the end.
+ * Usage: slab_allocator_check
+ */
+
+#include <cstring>
+#include <iostream>
+#include <set>
+#include <thread>
+#include <vector>
+#include "memory_support.h"
+#include "threading.h"
+
+using namespace std;
+using namespace lightspark;
+
+static const uint32_t OBJECT_COUNT = 10000;
+static const size_t OBJECT_SIZE = 48;
+
+static bool failed = false;
+
+static void check(bool ok, const char* name)
+{
+	cout << name << (ok ? "" : " FAILED") << endl;
+	failed |= !ok;
+}
+
+static uint64_t usedBytes()
+{
+	slab_statistics stats;
+	slab_get_statistics(stats);
+	return stats.usedbytes;
+}
+
+static vector<void*> allocateObjects(size_t size)
+{
+	vector<void*> objects;
+	for (uint32_t i = 0; i < OBJECT_COUNT; i++)
+	{
+		objects.push_back(slab_alloc(size));
+		// the memory must be writable without corrupting the pool
+		memset(objects.back(),0xab,size);
+	}
+	return objects;
+}
+
+static void freeObjects(const vector<void*>& objects)
+{
+	for (auto it = objects.begin(); it != objects.end(); it++)
+		slab_free(*it);
+}
+
+// counts how many of the freed objects are handed out again
+static uint32_t countReused(const vector<void*>& freed, const vector<void*>& allocated)
+{
+	set<void*> f(freed.begin(),freed.end());
+	uint32_t reused = 0;
+	for (auto it = allocated.begin(); it != allocated.end(); it++)
+	{
+		if (f.count(*it))
+			reused++;
+	}
+	return reused;
+}
+
+// frees its objects when destroyed after the pool of its thread was released
+struct lateFree
+{
+	vector<void*> objects;
+	~lateFree()
+	{
+		freeObjects(objects);
+		// allocations after the release are served by the fallback pool
+		freeObjects(allocateObjects(OBJECT_SIZE));
+	}
+};
+static thread_local lateFree lateObjects;
+
+int main()
+{
+	const uint64_t initialUsed = usedBytes();
+
+	// allocated by a thread that exits before they are freed
+	vector<void*> objects;
+	thread([&objects]() { objects = allocateObjects(OBJECT_SIZE); }).join();
+	check(usedBytes() >= initialUsed+OBJECT_COUNT*OBJECT_SIZE,"objects of exited thread accounted");
+	freeObjects(objects);
+	check(usedBytes() == initialUsed,"objects of exited thread freed");
+	vector<void*> reallocated = allocateObjects(OBJECT_SIZE);
+	check(countReused(objects,reallocated) == OBJECT_COUNT,"objects of exited thread reused");
+	freeObjects(reallocated);
+
+	// allocated by a thread that is still running while they are freed here
+	vector<void*> first;
+	vector<void*> second;
+	bool freedByMain = false;
+	Mutex mutex;
+	Cond cond;
+	thread worker([&]()
+	{
+		vector<void*> objects = allocateObjects(OBJECT_SIZE);
+		{
+			Locker l(mutex);
+			first = objects;
+			cond.signal();
+			while (!freedByMain)
+				cond.wait(mutex);
+		}
+		second = allocateObjects(OBJECT_SIZE);
+	});
+	{
+		Locker l(mutex);
+		while (first.empty())
+			cond.wait(mutex);
+		freeObjects(first);
+		freedByMain = true;
+		cond.signal();
+	}
+	worker.join();
+	check(countReused(first,second) == OBJECT_COUNT,"objects freed by another thread reused");
+	freeObjects(second);
+	check(usedBytes() == initialUsed,"objects freed by another thread accounted");
+
+	// freed by the destructor of a thread_local object running after the pool of the thread was released
+	thread([]()
+	{
+		// constructed before the pool, so it's destroyed after it
+		lateObjects.objects.clear();
+		lateObjects.objects = allocateObjects(OBJECT_SIZE);
+	}).join();
+	check(usedBytes() == initialUsed,"objects freed after thread exit");
+
+	// sizes above SLAB_MAX_SIZE are passed to malloc and recognized without the size
+	objects = allocateObjects(SLAB_MAX_SIZE*4);
+	check(usedBytes() == initialUsed,"large objects not in the pools");
+	freeObjects(objects);
+	return failed ? 1 : 0;
+}
@@ -25,6 +25,7 @@
 #include "scripting/class.h"
 #include "scripting/toplevel/toplevel.h"
 #include "amf3_generator.h"
+#include "backends/streamcache.h"
 
 using namespace lightspark;
 using namespace std;
@@ -71,7 +72,26 @@ FLV_HEADER::FLV_HEADER(std::istream& in):dataOffset(0),_hasAudio(false),_hasVide
 	assert_and_throw(dataOffset==9);
 }
 
-VideoTag::VideoTag(istream& s)
+FLVPacketBuffer::~FLVPacketBuffer()
+{
+	if(data)
+		aligned_free(data);
+}
+
+uint8_t* FLVPacketBuffer::get(uint32_t len)
+{
+	if(len>capacity)
+	{
+		if(data)
+			aligned_free(data);
+		aligned_malloc((void**)&data, 16, len+FLV_PAYLOAD_PADDING); //Ensure no overrun happens when doing aligned reads
+		capacity=len;
+	}
+	memset(data+len,0,FLV_PAYLOAD_PADDING);
+	return data;
+}
+
+VideoTag::VideoTag(istream& s):ownsData(false),inPlace(false)
 {
 	//Read dataSize
 	UI24_FLV DataSize;
@@ -90,6 +110,46 @@ VideoTag::VideoTag(istream& s)
 	assert_and_throw(StreamID==0);
 }
 
+static bool isZeroed(const uint8_t* data, uint32_t len)
+{
+	for(uint32_t i=0;i<len;i++)
+	{
+		if(data[i])
+			return false;
+	}
+	return true;
+}
+
+uint8_t* VideoTag::readPayload(istream& s, uint32_t len, FLVPacketBuffer* buffer)
+{
+	uint8_t* ret;
+	if(buffer)
+	{
+		const uint8_t* inStream=MemoryStreamCache::readContiguous(s.rdbuf(),len,FLV_PAYLOAD_PADDING);
+		// the decoders may read the padding, so the payload can only be used in place
+		// if it is followed by zeros and not by the next tag
+		if(inStream && isZeroed(inStream+len,FLV_PAYLOAD_PADDING))
+		{
+			inPlace=true;
+			return (uint8_t*)inStream;
+		}
+		ret=buffer->get(len);
+		if(inStream)
+		{
+			memcpy(ret,inStream,len);
+			return ret;
+		}
+	}
+	else
+	{
+		aligned_malloc((void**)&ret, 16, len+FLV_PAYLOAD_PADDING); //Ensure no overrun happens when doing aligned reads
+		memset(ret+len,0,FLV_PAYLOAD_PADDING);
+		ownsData=true;
+	}
+	s.read((char*)ret,len);
+	return ret;
+}
+
 ScriptDataTag::ScriptDataTag(istream& s):VideoTag(s)
 {
 	unsigned int start=s.tellg();
@@ -121,7 +181,7 @@ ScriptDataTag::ScriptDataTag(istream& s):VideoTag(s)
 }
 
 
-VideoDataTag::VideoDataTag(istream& s):VideoTag(s),_isHeader(false),packetData(nullptr)
+VideoDataTag::VideoDataTag(istream& s, FLVPacketBuffer* buffer):VideoTag(s),_isHeader(false),packetData(nullptr)
 {
 	unsigned int start=s.tellg();
 	UI8 typeAndCodec;
@@ -142,10 +202,7 @@ VideoDataTag::VideoDataTag(istream& s):VideoTag(s),_isHeader(false),packetData(n
 		//Compute lenght of raw data
 		packetLen=dataSize-1;
 
-		aligned_malloc((void**)&packetData, 16, packetLen+16); //Ensure no overrun happens when doing aligned reads
-
-		s.read((char*)packetData,packetLen);
-		memset(packetData+packetLen,0,16);
+		packetData=readPayload(s,packetLen,buffer);
 	}
 	else if(codecId==4)
 	{
@@ -158,10 +215,7 @@ VideoDataTag::VideoDataTag(istream& s):VideoTag(s),_isHeader(false),packetData(n
 		//Compute lenght of raw data
 		packetLen=dataSize-2;
 
-		aligned_malloc((void**)&packetData, 16, packetLen+16); //Ensure no overrun happens when doing aligned reads
-
-		s.read((char*)packetData,packetLen);
-		memset(packetData+packetLen,0,16);
+		packetData=readPayload(s,packetLen,buffer);
 	}
 	else if(codecId==7)
 	{
@@ -188,10 +242,7 @@ VideoDataTag::VideoDataTag(istream& s):VideoTag(s),_isHeader(false),packetData(n
 		//Compute lenght of raw data
 		packetLen=dataSize-5;
 
-		aligned_malloc((void**)&packetData, 16, packetLen+16); //Ensure no overrun happens when doing aligned reads
-
-		s.read((char*)packetData,packetLen);
-		memset(packetData+packetLen,0,16);
+		packetData=readPayload(s,packetLen,_isHeader ? nullptr : buffer);
 	}
 
 	//Compute totalLen
@@ -201,10 +252,11 @@ VideoDataTag::VideoDataTag(istream& s):VideoTag(s),_isHeader(false),packetData(n
 
 VideoDataTag::~VideoDataTag()
 {
-	aligned_free(packetData);
+	if (ownsData && packetData)
+		aligned_free(packetData);
 }
 
-AudioDataTag::AudioDataTag(std::istream& s):VideoTag(s),_isHeader(false),packetData(nullptr),packetLen(0)
+AudioDataTag::AudioDataTag(std::istream& s, FLVPacketBuffer* buffer):VideoTag(s),_isHeader(false),packetData(nullptr),packetLen(0)
 {
 	unsigned int start=s.tellg();
 	BitStream bs(s);
@@ -239,11 +291,7 @@ AudioDataTag::AudioDataTag(std::istream& s):VideoTag(s),_isHeader(false),packetD
 	if (dataSize > headerConsumed)
 	{
 		packetLen=dataSize-headerConsumed;
-	
-		aligned_malloc((void**)&packetData, 16, packetLen+16); //Ensure no overrun happens when doing aligned reads
-	
-		s.read((char*)packetData,packetLen);
-		memset(packetData+packetLen,0,16);
+		packetData=readPayload(s,packetLen,buffer);
 	}
 	//Compute totalLen
 	unsigned int end=s.tellg();
@@ -252,6 +300,6 @@ AudioDataTag::AudioDataTag(std::istream& s):VideoTag(s),_isHeader(false),packetD
 
 AudioDataTag::~AudioDataTag()
 {
-	if (packetData)
+	if (ownsData && packetData)
 		aligned_free(packetData);
 }
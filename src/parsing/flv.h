@@ -46,17 +46,50 @@ public:
 	bool hasVideo() const { return _hasVideo; }
 };
 
+// zeroed bytes after every payload, at least the padding required by FFmpeg
+#define FLV_PAYLOAD_PADDING (AV_INPUT_BUFFER_PADDING_SIZE > 16 ? AV_INPUT_BUFFER_PADDING_SIZE : 16)
+
+/*
+ * Reusable, 16 byte aligned buffer for the payload of FLV tags. The payload is
+ * followed by FLV_PAYLOAD_PADDING zero bytes, as the decoders may read beyond its end
+ */
+class FLVPacketBuffer
+{
+private:
+	uint8_t* data;
+	uint32_t capacity;
+	FLVPacketBuffer(const FLVPacketBuffer&); /* no impl */
+	FLVPacketBuffer& operator=(const FLVPacketBuffer&); /* no impl */
+public:
+	FLVPacketBuffer():data(nullptr),capacity(0) {}
+	~FLVPacketBuffer();
+	// returns a buffer for len bytes, the previous content is lost
+	uint8_t* get(uint32_t len);
+};
+
 class VideoTag
 {
 protected:
 	uint32_t dataSize;
 	uint32_t timestamp;
 	uint32_t totalLen;
+	/*
+	 * Reads the len bytes of payload, followed by FLV_PAYLOAD_PADDING zeroed bytes. If they
+	 * are contiguous in a MemoryStreamCache they are used in place, otherwise they are copied
+	 * to buffer or, without a buffer, to memory owned by the tag
+	 */
+	uint8_t* readPayload(std::istream& s, uint32_t len, FLVPacketBuffer* buffer);
 public:
-	VideoTag() {}
+	// true if the payload is owned by the tag and freed with it
+	bool ownsData;
+	// true if the payload points into the stream cache
+	bool inPlace;
+	VideoTag():ownsData(false),inPlace(false) {}
 	VideoTag(std::istream& s);
+	virtual ~VideoTag() {}
 	uint32_t getDataSize() const { return dataSize; }
 	uint32_t getTotalLen() const { return totalLen; }
+	uint32_t getTimestamp() const { return timestamp; }
 };
 
 class ScriptDataTag: public VideoTag
@@ -77,7 +110,8 @@ public:
 	LS_VIDEO_CODEC codec;
 	uint8_t* packetData;
 	uint32_t packetLen;
-	VideoDataTag(std::istream& s);
+	// header packets are always owned by the tag, as the decoders take them over
+	VideoDataTag(std::istream& s, FLVPacketBuffer* buffer=nullptr);
 	void releaseBuffer()
 	{
 		packetData=NULL;
@@ -98,7 +132,7 @@ public:
 	bool isStereo;
 	uint8_t* packetData;
 	uint32_t packetLen;
-	AudioDataTag(std::istream& s);
+	AudioDataTag(std::istream& s, FLVPacketBuffer* buffer=nullptr);
 	~AudioDataTag();
 	void releaseBuffer()
 	{
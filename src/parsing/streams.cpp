@@ -48,13 +48,42 @@ int uncompressing_filter::underflow()
 	//First of all we add the length of the buffer to the consumed variable
 	consumed+=(gptr()-eback());
 
-	int available=fillBuffer();
+	int available=fillBuffer(buffer,BUFFER_LENGTH);
 	setg(buffer,buffer,buffer+available);
-	
+	if(available==0)
+		return -1;
+
 	//Cast to unsigned, otherwise 0xff would become eof
 	return (unsigned char)buffer[0];
 }
 
+streamsize uncompressing_filter::xsgetn(char* s, streamsize n)
+{
+	streamsize done=min(n,streamsize(egptr()-gptr()));
+	memcpy(s,gptr(),done);
+	gbump(done);
+	while(done<n && !eof)
+	{
+		if(n-done<BUFFER_LENGTH)
+		{
+			if(underflow()==-1)
+				break;
+			streamsize count=min(n-done,streamsize(egptr()-gptr()));
+			memcpy(s+done,gptr(),count);
+			gbump(count);
+			done+=count;
+			continue;
+		}
+		//Skip the copy through buffer, the bytes before the empty buffer are consumed
+		consumed+=(gptr()-eback());
+		setg(buffer,buffer,buffer);
+		int available=fillBuffer(s+done,min(n-done,streamsize(INT32_MAX)));
+		consumed+=available;
+		done+=available;
+	}
+	return done;
+}
+
 streampos uncompressing_filter::seekoff(off_type off, ios_base::seekdir dir,ios_base::openmode mode)
 {
 	assert(off==0);
@@ -83,10 +112,10 @@ zlib_filter::~zlib_filter()
 	inflateEnd(&strm);
 }
 
-int zlib_filter::fillBuffer()
+int zlib_filter::fillBuffer(char* out, int size)
 {
-	strm.avail_out = sizeof(buffer);
-	strm.next_out = (unsigned char*)buffer;
+	strm.avail_out = size;
+	strm.next_out = (unsigned char*)out;
 	do
 	{
 		if(strm.avail_in==0)
@@ -112,19 +141,88 @@ int zlib_filter::fillBuffer()
 	}
 	while(strm.avail_out!=0);
 
-	return sizeof(buffer) - strm.avail_out;
+	return size - strm.avail_out;
+}
+
+bytes_buf::bytes_buf(const uint8_t* b, int l):buf(b),len(l),filebacked(false)
+{
+	setg((char*)buf,(char*)buf,(char*)buf+len);
+}
+
+bytes_buf::bytes_buf(std::shared_ptr<const uint8_t> b, int l, bool _filebacked):buf(b.get()),len(l),owner(b),filebacked(_filebacked)
+{
+	setg((char*)buf,(char*)buf,(char*)buf+len);
 }
 
-bytes_buf::bytes_buf(const uint8_t* b, int l):buf(b),len(l)
+bytes_buf::bytes_buf(const bytes_buf& parent, uint32_t offset, int l):buf(parent.buf+offset),len(l),filebacked(parent.filebacked)
 {
+	if(parent.owner)
+		owner=std::shared_ptr<const uint8_t>(parent.owner,buf);
 	setg((char*)buf,(char*)buf,(char*)buf+len);
 }
 
 bytes_buf::pos_type bytes_buf::seekoff(off_type off, ios_base::seekdir dir,ios_base::openmode mode)
 {
-	assert(off==0);
-	//The current offset is the amount used in the buffer
-	int ret=(gptr()-eback());
+	off_type pos;
+	switch(dir)
+	{
+		case ios_base::beg:
+			pos=off;
+			break;
+		case ios_base::end:
+			pos=len+off;
+			break;
+		default:
+			pos=(gptr()-eback())+off;
+			break;
+	}
+	if(pos<0 || pos>len)
+		return pos_type(off_type(-1));
+	setg(eback(),eback()+pos,egptr());
+	return pos;
+}
+
+bytes_buf::pos_type bytes_buf::seekpos(pos_type pos, ios_base::openmode mode)
+{
+	return seekoff(off_type(pos),ios_base::beg,mode);
+}
+
+bytes_buf* bytes_buf::fromMappedFile(const char* filepath)
+{
+	GMappedFile* file=g_mapped_file_new(filepath,FALSE,nullptr);
+	if(!file)
+		return nullptr;
+	gsize size=g_mapped_file_get_length(file);
+	if(size==0 || size>INT32_MAX)
+	{
+		g_mapped_file_unref(file);
+		return nullptr;
+	}
+	std::shared_ptr<const uint8_t> data((const uint8_t*)g_mapped_file_get_contents(file),[file](const uint8_t*) { g_mapped_file_unref(file); });
+	return new bytes_buf(data,size,true);
+}
+
+std::shared_ptr<const uint8_t> bytes_buf::view(int l)
+{
+	if(!owner || !filebacked || l<0 || egptr()-gptr()<l)
+		return nullptr;
+	std::shared_ptr<const uint8_t> ret(owner,(const uint8_t*)gptr());
+	gbump(l);
+	return ret;
+}
+
+std::shared_ptr<const uint8_t> readShared(std::istream& in, uint32_t len)
+{
+	bytes_buf* b=dynamic_cast<bytes_buf*>(in.rdbuf());
+	if(b && len<=INT32_MAX)
+	{
+		std::shared_ptr<const uint8_t> ret=b->view(len);
+		if(ret)
+			return ret;
+	}
+	uint8_t* data=new uint8_t[len];
+	std::shared_ptr<const uint8_t> ret(data,std::default_delete<uint8_t[]>());
+	in.read((char*)data,len);
 	return ret;
 }
 
@@ -171,10 +269,10 @@ liblzma_filter::~liblzma_filter()
 	lzma_end(&strm);
 }
 
-int liblzma_filter::fillBuffer()
+int liblzma_filter::fillBuffer(char* out, int size)
 {
-	strm.avail_out = sizeof(buffer);
-	strm.next_out = (uint8_t *)buffer;
+	strm.avail_out = size;
+	strm.next_out = (uint8_t *)out;
 	do
 	{
 		if(strm.avail_in==0)
@@ -206,7 +304,7 @@ int liblzma_filter::fillBuffer()
 	}
 	while(strm.avail_out!=0);
 
-	return sizeof(buffer) - strm.avail_out;
+	return size - strm.avail_out;
 }
 
 void memorystream::handleError(const char* msg)
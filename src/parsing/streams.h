@@ -26,6 +26,7 @@
 #include <streambuf>
 #include <fstream>
 #include <cinttypes>
+#include <memory>
 #include <zlib.h>
 #include <lzma.h>
 
@@ -44,11 +45,13 @@ protected:
 	int consumed;
 	bool eof;
 	virtual int underflow();
+	// Large reads are uncompressed directly into the destination
+	virtual std::streamsize xsgetn(char* s, std::streamsize n);
 	virtual std::streampos seekoff(off_type, std::ios_base::seekdir, std::ios_base::openmode);
-	// Abstract function that fills buffer by uncompressing bytes
-	// from backend. buffer is empty when this is called. Returns
-	// number of bytes written to buffer.
-	virtual int fillBuffer()=0;
+	// Abstract function that fills out by uncompressing bytes
+	// from backend. Returns number of bytes written to out, which
+	// is less than size only at the end of the stream.
+	virtual int fillBuffer(char* out, int size)=0;
 public:
 	uncompressing_filter(std::streambuf* b);
 };
@@ -61,7 +64,7 @@ private:
 	// Temporary buffer for data before it is uncompressed
 	char compressed_buffer[BUFFER_LENGTH];
 protected:
-	virtual int fillBuffer();
+	virtual int fillBuffer(char* out, int size);
 public:
 	zlib_filter(std::streambuf* b);
 	~zlib_filter();
@@ -74,7 +77,7 @@ private:
 	// Temporary buffer for data before it is uncompressed
 	uint8_t compressed_buffer[BUFFER_LENGTH];
 protected:
-	virtual int fillBuffer();
+	virtual int fillBuffer(char* out, int size);
 public:
 	liblzma_filter(std::streambuf* b);
 	~liblzma_filter();
@@ -85,11 +88,32 @@ class bytes_buf:public std::streambuf
 private:
 	const uint8_t* buf;
 	int len;
+	// keeps buf alive for the views returned by view(), null if buf is owned by someone else
+	std::shared_ptr<const uint8_t> owner;
+	// true if buf is a mapping of a file, see view()
+	bool filebacked;
 public:
 	bytes_buf(const uint8_t* b, int l);
+	bytes_buf(std::shared_ptr<const uint8_t> b, int l, bool _filebacked=false);
+	// the l bytes at offset of parent, views of it are shared with parent
+	bytes_buf(const bytes_buf& parent, uint32_t offset, int l);
+	const uint8_t* getBuffer() const { return buf; }
+	int getLength() const { return len; }
 	virtual pos_type seekoff(off_type, std::ios_base::seekdir, std::ios_base::openmode);
+	virtual pos_type seekpos(pos_type, std::ios_base::openmode);
+	// Maps a file into memory, returns nullptr if it can't be mapped
+	static bytes_buf* fromMappedFile(const char* filepath);
+	// Returns the next l bytes without copying them and skips them,
+	// or null if the buffer is not a shared file mapping or too short.
+	// Views of other buffers would keep all of it alive for as long as any
+	// tag keeps its data, i.e. the whole inflated file for a DefineBinaryData tag
+	std::shared_ptr<const uint8_t> view(int l);
 };
 
+// Reads len bytes from in. If in reads from a mapped file, the
+// result points into the mapping instead of a copy
+std::shared_ptr<const uint8_t> readShared(std::istream& in, uint32_t len);
+
 // A lightweight, istream-like interface for reading from a memory
 // buffer.
 // 
@@ -0,0 +1,217 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#include <fstream>
+#include <algorithm>
+#include "parsing/tagindex.h"
+#include "parsing/tags.h"
+#include "parsing/streams.h"
+#include <SDL2/SDL_cpuinfo.h>
+#include "swf.h"
+#include "logger.h"
+
+using namespace std;
+using namespace lightspark;
+
+void TagIndex::build(const uint8_t* data, uint32_t start, uint32_t len)
+{
+	entries.clear();
+	uint32_t frame=0;
+	uint32_t pos=start;
+	while(pos+2<=len)
+	{
+		// RECORDHEADER: UI16 with the tag type in the upper 10 bits, followed
+		// by an UI32 length if the short length is 0x3f
+		uint16_t code=data[pos]|(data[pos+1]<<8);
+		uint32_t headerSize=2;
+		uint32_t taglen=code&0x3f;
+		if(taglen==0x3f)
+		{
+			if(pos+6>len)
+				break;
+			taglen=data[pos+2]|(data[pos+3]<<8)|(data[pos+4]<<16)|(uint32_t(data[pos+5])<<24);
+			headerSize=6;
+		}
+		// truncated tags are left to the ParseThread
+		if(taglen>len-pos-headerSize)
+			break;
+		TagIndexEntry e;
+		e.offset=pos;
+		e.length=headerSize+taglen;
+		e.frame=frame;
+		e.type=code>>6;
+		entries.push_back(e);
+		if(e.type==0)
+			break;
+		if(e.type==1)
+			frame++;
+		pos+=e.length;
+	}
+}
+
+namespace lightspark
+{
+class TagPrefetchJob: public IThreadJob
+{
+private:
+	TagPrefetcher* prefetcher;
+public:
+	TagPrefetchJob(TagPrefetcher* p):prefetcher(p) {}
+	void execute() override
+	{
+		prefetcher->runHelper(this);
+	}
+	void jobFence() override
+	{
+		prefetcher->helperFinished();
+		delete this;
+	}
+};
+}
+
+TagPrefetcher::TagPrefetcher(bytes_buf* b, uint32_t start, RootMovieClip* r):buffer(b),root(r),nextSlot(0),cursor(0),runningHelpers(0),stopped(false)
+{
+	index.build(buffer->getBuffer(),start,buffer->getLength());
+	for(uint32_t i=0;i<index.entries.size();i++)
+	{
+		if(TagFactory::isIndependentTag(index.entries[i].type))
+			slots.emplace_back(i);
+	}
+	LOG(LOG_INFO,"indexed "<<index.entries.size()<<" tags, "<<slots.size()<<" can be constructed in parallel");
+	if(slots.empty())
+		return;
+	uint32_t helpers=min(uint32_t(max(1,SDL_GetCPUCount()-1)),uint32_t(slots.size()));
+	runningHelpers=helpers;
+	for(uint32_t i=0;i<helpers;i++)
+		root->getSystemState()->addJob(new TagPrefetchJob(this));
+}
+
+TagPrefetcher::~TagPrefetcher()
+{
+	Locker l(mutex);
+	stopped=true;
+	while(runningHelpers)
+		cond.wait(mutex);
+	for(auto it=slots.begin();it!=slots.end();it++)
+		delete it->tag;
+}
+
+void TagPrefetcher::runHelper(const IThreadJob* job)
+{
+	while(!stopped && !job->threadAborting)
+	{
+		uint32_t i=nextSlot++;
+		if(i>=slots.size())
+			break;
+		Slot& s=slots[i];
+		int expected=SLOT_PENDING;
+		// the ParseThread claims the slots it reaches first
+		if(!s.state.compare_exchange_strong(expected,SLOT_RUNNING))
+			continue;
+		const TagIndexEntry& e=index.entries[s.entry];
+		gint64 starttime=g_get_monotonic_time();
+		Tag* tag=nullptr;
+		try
+		{
+			bytes_buf sub(*buffer,e.offset,e.length);
+			istream in(&sub);
+			in.exceptions(istream::eofbit|istream::failbit|istream::badbit);
+			RECORDHEADER h;
+			in >> h;
+			tag=TagFactory::readIndependentTag(h,in,root,true);
+			// leave malformed tags to the ParseThread, which reports and skips them
+			if(uint32_t(in.tellg())!=e.length)
+			{
+				delete tag;
+				tag=nullptr;
+			}
+		}
+		catch(LightsparkException& ex)
+		{
+			tag=nullptr;
+		}
+		catch(std::exception& ex)
+		{
+			tag=nullptr;
+		}
+		Locker l(mutex);
+		s.tag=tag;
+		s.time=g_get_monotonic_time()-starttime;
+		s.prefetched=tag!=nullptr;
+		s.state=SLOT_DONE;
+		cond.broadcast();
+	}
+}
+
+void TagPrefetcher::helperFinished()
+{
+	Locker l(mutex);
+	runningHelpers--;
+	cond.broadcast();
+}
+
+Tag* TagPrefetcher::take(uint32_t offset, uint32_t& length)
+{
+	// tags the ParseThread skipped (i.e. after an AdditionalDataTag) are not constructed any more
+	while(cursor<slots.size() && index.entries[slots[cursor].entry].offset<offset)
+	{
+		int expected=SLOT_PENDING;
+		slots[cursor++].state.compare_exchange_strong(expected,SLOT_CLAIMED);
+	}
+	if(cursor==slots.size() || index.entries[slots[cursor].entry].offset!=offset)
+		return nullptr;
+	Slot& s=slots[cursor++];
+	length=index.entries[s.entry].length;
+	int expected=SLOT_PENDING;
+	if(s.state.compare_exchange_strong(expected,SLOT_CLAIMED))
+		return nullptr;
+	gint64 starttime=g_get_monotonic_time();
+	Locker l(mutex);
+	while(s.state!=SLOT_DONE)
+		cond.wait(mutex);
+	s.waited=g_get_monotonic_time()-starttime;
+	Tag* ret=s.tag;
+	s.tag=nullptr;
+	return ret;
+}
+
+void TagPrefetcher::dump(const char* filename) const
+{
+	ofstream f(filename,ios::out|ios::trunc);
+	if(!f.is_open())
+	{
+		LOG(LOG_ERROR,"could not write tag index to "<<filename);
+		return;
+	}
+	f << "index\toffset\ttype\tlength\tframe\tindependent\tprefetched\ttime_us\twait_us\n";
+	auto it=slots.begin();
+	for(uint32_t i=0;i<index.entries.size();i++)
+	{
+		const TagIndexEntry& e=index.entries[i];
+		f << i << '\t' << e.offset << '\t' << e.type << '\t' << e.length << '\t' << e.frame;
+		if(it!=slots.end() && it->entry==i)
+		{
+			f << "\t1\t" << (it->prefetched ? 1 : 0) << '\t' << it->time << '\t' << it->waited << '\n';
+			++it;
+		}
+		else
+			f << "\t0\t0\t0\t0\n";
+	}
+	LOG(LOG_INFO,"tag index written to "<<filename);
+}
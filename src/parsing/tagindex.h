@@ -0,0 +1,109 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#ifndef PARSING_TAGINDEX_H
+#define PARSING_TAGINDEX_H 1
+
+#include "compat.h"
+#include "threading.h"
+#include <atomic>
+#include <vector>
+
+class bytes_buf;
+
+namespace lightspark
+{
+class Tag;
+class RootMovieClip;
+
+struct TagIndexEntry
+{
+	// offset of the RECORDHEADER in the uncompressed file
+	uint32_t offset;
+	// length of the tag, including the RECORDHEADER
+	uint32_t length;
+	// number of ShowFrame tags before this tag
+	uint32_t frame;
+	uint16_t type;
+};
+
+/*
+ * Directory of the top level tags of a SWF file that is completely in memory,
+ * built by a pass over the RECORDHEADERs only. The tags nested in a DefineSprite
+ * are part of the sprite's entry
+ */
+class TagIndex
+{
+public:
+	std::vector<TagIndexEntry> entries;
+	// indexes the tags of data from start until the EndTag or the end of data
+	void build(const uint8_t* data, uint32_t start, uint32_t len);
+};
+
+/*
+ * Constructs the independent dictionary tags (see TagFactory::isIndependentTag)
+ * of a TagIndex on the ThreadPool, ahead of the ParseThread. The ParseThread
+ * still handles all tags in file order and takes the constructed ones with take()
+ */
+class TagPrefetcher
+{
+friend class TagPrefetchJob;
+private:
+	enum SLOT_STATE { SLOT_PENDING=0, SLOT_RUNNING, SLOT_DONE, SLOT_CLAIMED };
+	struct Slot
+	{
+		std::atomic<int> state;
+		uint32_t entry;
+		Tag* tag;
+		// for dump(): construction time by a helper and time the ParseThread waited for it, in microseconds
+		uint32_t time;
+		uint32_t waited;
+		bool prefetched;
+		Slot(uint32_t e):state(SLOT_PENDING),entry(e),tag(nullptr),time(0),waited(0),prefetched(false) {}
+		Slot(const Slot& s):state(s.state.load()),entry(s.entry),tag(s.tag),time(s.time),waited(s.waited),prefetched(s.prefetched) {}
+	};
+	TagIndex index;
+	std::vector<Slot> slots;
+	bytes_buf* buffer;
+	RootMovieClip* root;
+	Mutex mutex;
+	Cond cond;
+	std::atomic<uint32_t> nextSlot;
+	// next slot take() looks at, only used by the ParseThread
+	uint32_t cursor;
+	uint32_t runningHelpers;
+	std::atomic<bool> stopped;
+	void runHelper(const IThreadJob* job);
+	void helperFinished();
+public:
+	// indexes buffer from start and starts the helper jobs
+	TagPrefetcher(bytes_buf* buffer, uint32_t start, RootMovieClip* root);
+	// waits for the helper jobs and deletes the tags that were not taken
+	~TagPrefetcher();
+	/*
+	 * Returns the tag at offset and its length (including the RECORDHEADER) if a helper
+	 * constructed it, nullptr if the ParseThread has to read it itself. Offsets have to be increasing
+	 */
+	Tag* take(uint32_t offset, uint32_t& length);
+	// writes the index and the construction statistics as tab separated values
+	void dump(const char* filename) const;
+};
+
+}
+#endif /* PARSING_TAGINDEX_H */
@@ -26,6 +26,7 @@
 #else
 #include <alloca.h>
 #endif
+#include <SDL2/SDL_cpuinfo.h>
 #include "scripting/abc.h"
 #include "parsing/tags.h"
 #include "backends/geometry.h"
@@ -329,6 +330,64 @@ Tag* TagFactory::readTag(RootMovieClip* root, DefineSpriteTag *sprite)
 	return ret;
 }
 
+bool TagFactory::isIndependentTag(uint32_t type)
+{
+	switch(type)
+	{
+		case 2:
+		case 14:
+		case 20:
+		case 21:
+		case 22:
+		case 32:
+		case 35:
+		case 36:
+		case 46:
+		case 83:
+		case 84:
+		case 87:
+			return true;
+		default:
+			// fonts register themselves in the RootMovieClip, DefineBits depends on the JPEGTables tag
+			return false;
+	}
+}
+
+DictionaryTag* TagFactory::readIndependentTag(RECORDHEADER h, std::istream& f, RootMovieClip* root, bool offParseThread)
+{
+	if(offParseThread)
+		setOffParseThread(f);
+	switch(h.getTagType())
+	{
+		case 2:
+			return new DefineShapeTag(h,f,root);
+		case 14:
+			return new DefineSoundTag(h,f,root);
+		case 20:
+			return new DefineBitsLosslessTag(h,f,1,root);
+		case 21:
+			return new DefineBitsJPEG2Tag(h,f,root);
+		case 22:
+			return new DefineShape2Tag(h,f,root);
+		case 32:
+			return new DefineShape3Tag(h,f,root);
+		case 35:
+			return new DefineBitsJPEG3Tag(h,f,root);
+		case 36:
+			return new DefineBitsLosslessTag(h,f,2,root);
+		case 46:
+			return new DefineMorphShapeTag(h,f,root);
+		case 83:
+			return new DefineShape4Tag(h,f,root);
+		case 84:
+			return new DefineMorphShape2Tag(h,f,root);
+		case 87:
+			return new DefineBinaryDataTag(h,f,root);
+		default:
+			return nullptr;
+	}
+}
+
 RemoveObject2Tag::RemoveObject2Tag(RECORDHEADER h, std::istream& in):DisplayListTag(h)
 {
 	in >> Depth;
@@ -1293,6 +1352,69 @@ ASObject* DefineFont4Tag::instance(Class_base* c)
 	return ret;
 }
 
+namespace lightspark
+{
+class BitmapTagDecoder
+{
+private:
+	Mutex mutex;
+	_NR<BitmapContainer> bitmap;
+	// compressed data, either a copy or a view into the mapped SWF file
+	std::shared_ptr<const uint8_t> data;
+	uint32_t len;
+	std::function<void(BitmapContainer*,const uint8_t*,uint32_t)> decode;
+public:
+	BitmapTagDecoder(_NR<BitmapContainer> b, std::shared_ptr<const uint8_t> d, uint32_t l, const std::function<void(BitmapContainer*,const uint8_t*,uint32_t)>& f):bitmap(b),data(d),len(l),decode(f)
+	{
+	}
+	void run()
+	{
+		Locker l(mutex);
+		if (!decode)
+			return;
+		decode(bitmap.getPtr(),data.get(),len);
+		decode = nullptr;
+		data.reset();
+	}
+};
+
+class BitmapTagDecodeJob: public IThreadJob
+{
+private:
+	// the job only keeps the decoder alive, the tag may be destroyed before it runs
+	std::shared_ptr<BitmapTagDecoder> decoder;
+public:
+	/*
+	 * number of queued or running jobs, tags are left for decoding on first use beyond
+	 * max so that the decoding doesn't delay other jobs. The slot is reserved before the
+	 * job is created, since tags are constructed concurrently by the prefetch helpers
+	 */
+	static ATOMIC_INT32(count);
+	static bool reserveSlot(int32_t max)
+	{
+		int32_t cur = count;
+		do
+		{
+			if (cur >= max)
+				return false;
+		}
+		while (!count.compare_exchange_weak(cur,cur+1));
+		return true;
+	}
+	BitmapTagDecodeJob(std::shared_ptr<BitmapTagDecoder> d):decoder(d) {}
+	~BitmapTagDecodeJob() { count--; }
+	void execute() override
+	{
+		decoder->run();
+	}
+	void jobFence() override
+	{
+		delete this;
+	}
+};
+ATOMIC_INT32(BitmapTagDecodeJob::count);
+}
+
 BitmapTag::BitmapTag(RECORDHEADER h,RootMovieClip* root):DictionaryTag(h,root),bitmap(_MR(new BitmapContainer(root->getSystemState()->tagsMemory)))
 {
 }
@@ -1302,26 +1424,42 @@ BitmapTag::~BitmapTag()
 	bitmap.reset();
 }
 
+void BitmapTag::waitForDecoding() const
+{
+	if (decoder)
+		decoder->run();
+}
+
 _NR<BitmapContainer> BitmapTag::getBitmap() const {
+	waitForDecoding();
 	return bitmap;
 }
-void BitmapTag::loadBitmap(uint8_t* inData, int datasize, const uint8_t *tablesData, int tablesLen)
+
+void BitmapTag::decodeLater(std::shared_ptr<const uint8_t> data, uint32_t len, const std::function<void(BitmapContainer*,const uint8_t*,uint32_t)>& decode)
 {
+	decoder = std::make_shared<BitmapTagDecoder>(bitmap,data,len,decode);
+	if (BitmapTagDecodeJob::reserveSlot(max(1,SDL_GetCPUCount()-1)))
+		loadedFrom->getSystemState()->addJob(new BitmapTagDecodeJob(decoder));
+}
+
+void BitmapTag::loadBitmap(BitmapContainer* bitmap, int id, const uint8_t* inData, int datasize, const uint8_t *tablesData, int tablesLen)
+{
+	// the decoders don't write to the data
 	if (datasize < 4)
 		return;
 	else if((inData[0]&0x80) && inData[1]=='P' && inData[2]=='N' && inData[3]=='G')
-		bitmap->fromPNG(inData,datasize);
+		bitmap->fromPNG(const_cast<uint8_t*>(inData),datasize);
 	else if(inData[0]==0xff && inData[1]==0xd8 && inData[2]==0xff)
-		bitmap->fromJPEG(inData,datasize,tablesData,tablesLen);
+		bitmap->fromJPEG(const_cast<uint8_t*>(inData),datasize,tablesData,tablesLen);
 	else if(inData[0]=='G' && inData[1]=='I' && inData[2]=='F' && inData[3]=='8')
-		LOG(LOG_ERROR,"GIF image found, not yet supported, ID :"<<getId());
+		LOG(LOG_ERROR,"GIF image found, not yet supported, ID :"<<id);
 	else if(inData[0]==0xff && inData[1]==0xd9)
 		// I've found swf files with broken jpegs that start with the jpeg "end of file" magic bytes and two times the "begin of file" magic bytes
 		// so we just ignore the first 4 bytes
 		// TODO check if libjpeg has a better common way to deal with invalid headers
-		loadBitmap(inData+4, datasize-4, tablesData, tablesLen);
+		loadBitmap(bitmap, id, inData+4, datasize-4, tablesData, tablesLen);
 	else
-		LOG(LOG_ERROR,"unknown image format for ID "<<getId());
+		LOG(LOG_ERROR,"unknown image format for ID "<<id);
 }
 DefineBitsLosslessTag::DefineBitsLosslessTag(RECORDHEADER h, istream& in, int version, RootMovieClip* root):BitmapTag(h,root),BitmapColorTableSize(0)
 {
@@ -1332,65 +1470,68 @@ DefineBitsLosslessTag::DefineBitsLosslessTag(RECORDHEADER h, istream& in, int ve
 	if(BitmapFormat==LOSSLESS_BITMAP_PALETTE)
 		in >> BitmapColorTableSize;
 
-	string cData;
-	size_t cSize = dest-in.tellg(); //rest of this tag
-	cData.resize(cSize);
-	in.read(&cData[0], cSize);
-	istringstream cDataStream(cData);
-	zlib_filter zf(cDataStream.rdbuf());
-	istream zfstream(&zf);
-
-	if (BitmapFormat == LOSSLESS_BITMAP_RGB15 ||
-	    BitmapFormat == LOSSLESS_BITMAP_RGB24)
-	{
-		size_t size = BitmapWidth * BitmapHeight * 4;
-		uint8_t* inData=new(nothrow) uint8_t[size];
-		zfstream.read((char*)inData,size);
-		assert(!zfstream.fail() && !zfstream.eof());
-
-		BitmapContainer::BITMAP_FORMAT format;
-		if (BitmapFormat == LOSSLESS_BITMAP_RGB15)
-			format = BitmapContainer::RGB15;
-		else if (version == 1)
-			format = BitmapContainer::RGB32;
-		else
-			format = BitmapContainer::ARGB32;
+	uint32_t cSize = dest-in.tellg(); //rest of this tag
+	std::shared_ptr<const uint8_t> cData = readShared(in, cSize);
 
-		bitmap->fromRGB(inData, BitmapWidth, BitmapHeight, format);
-	}
-	else if (BitmapFormat == LOSSLESS_BITMAP_PALETTE)
+	uint8_t format = BitmapFormat;
+	uint32_t width = BitmapWidth;
+	uint32_t height = BitmapHeight;
+	unsigned numColors = BitmapColorTableSize+1;
+	decodeLater(cData,cSize,[format,width,height,numColors,version](BitmapContainer* bitmap, const uint8_t* cData, uint32_t cSize)
 	{
-		unsigned numColors = BitmapColorTableSize+1;
+		bytes_buf cDataBuf(cData,cSize);
+		zlib_filter zf(&cDataBuf);
+		istream zfstream(&zf);
 
-		/* Bitmap rows are 32 bit aligned */
-		uint32_t stride = BitmapWidth;
-		while (stride % 4 != 0)
-			stride++;
+		if (format == LOSSLESS_BITMAP_RGB15 ||
+		    format == LOSSLESS_BITMAP_RGB24)
+		{
+			size_t size = width * height * 4;
+			uint8_t* inData=new(nothrow) uint8_t[size];
+			zfstream.read((char*)inData,size);
+			assert(!zfstream.fail() && !zfstream.eof());
 
-		unsigned int paletteBPP;
-		if (version == 1)
-			paletteBPP = 3;
-		else
-			paletteBPP = 4;
+			BitmapContainer::BITMAP_FORMAT bitmapformat;
+			if (format == LOSSLESS_BITMAP_RGB15)
+				bitmapformat = BitmapContainer::RGB15;
+			else if (version == 1)
+				bitmapformat = BitmapContainer::RGB32;
+			else
+				bitmapformat = BitmapContainer::ARGB32;
 
-		size_t size = paletteBPP*numColors + stride*BitmapHeight;
-		uint8_t* inData=new(nothrow) uint8_t[size];
-		zfstream.read((char*)inData,size);
-		assert(!zfstream.fail() && !zfstream.eof());
+			bitmap->fromRGB(inData, width, height, bitmapformat);
+		}
+		else if (format == LOSSLESS_BITMAP_PALETTE)
+		{
+			/* Bitmap rows are 32 bit aligned */
+			uint32_t stride = width;
+			while (stride % 4 != 0)
+				stride++;
 
-		uint8_t *palette = inData;
-		uint8_t *pixelData = inData + paletteBPP*numColors;
-		bitmap->fromPalette(pixelData, BitmapWidth, BitmapHeight, stride, palette, numColors, paletteBPP);
-		delete[] inData;
-	}
-	else
-	{
+			unsigned int paletteBPP;
+			if (version == 1)
+				paletteBPP = 3;
+			else
+				paletteBPP = 4;
+
+			size_t size = paletteBPP*numColors + stride*height;
+			uint8_t* inData=new(nothrow) uint8_t[size];
+			zfstream.read((char*)inData,size);
+			assert(!zfstream.fail() && !zfstream.eof());
+
+			uint8_t *palette = inData;
+			uint8_t *pixelData = inData + paletteBPP*numColors;
+			bitmap->fromPalette(pixelData, width, height, stride, palette, numColors, paletteBPP);
+			delete[] inData;
+		}
+	});
+	if (BitmapFormat != LOSSLESS_BITMAP_RGB15 && BitmapFormat != LOSSLESS_BITMAP_RGB24 && BitmapFormat != LOSSLESS_BITMAP_PALETTE)
 		LOG(LOG_NOT_IMPLEMENTED,"DefineBitsLossless(2)Tag with unsupported BitmapFormat " << BitmapFormat);
-	}
 }
 
 ASObject* BitmapTag::instance(Class_base* c)
 {
+	waitForDecoding();
 	//Flex imports bitmaps using BitmapAsset as the base class, which is derived from bitmap
 	//Also BitmapData is used in the wild though, so support both cases
 
@@ -1600,7 +1741,8 @@ ASObject *DefineShapeTag::instance(Class_base *c)
 
 void DefineShapeTag::resizeCompleted()
 {
-	this->chunk.makeEmpty();
+	// the instances are drawn again at the new stage scale
+	rasterCache.releaseUnused(loadedFrom->getSystemState()->getRenderThread());
 }
 
 DefineShape2Tag::DefineShape2Tag(RECORDHEADER h, std::istream& in,RootMovieClip* root):DefineShapeTag(h,2,root)
@@ -1660,8 +1802,14 @@ void DefineMorphShapeTag::getTokensForRatio(tokensVector& tokens, uint32_t ratio
 		it = tokensmap.insert(make_pair(ratio,tokensVector())).first;
 		TokenContainer::FromDefineMorphShapeTagToShapeVector(this,it->second,ratio);
 	}
-	tokens.filltokens.assign(it->second.filltokens.begin(),it->second.filltokens.end());
-	tokens.stroketokens.assign(it->second.stroketokens.begin(),it->second.stroketokens.end());
+	// the instances share the cached tokens until they change them
+	tokens.filltokens=it->second.filltokens;
+	tokens.stroketokens=it->second.stroketokens;
+}
+
+void DefineMorphShapeTag::resizeCompleted()
+{
+	rasterCache.releaseUnused(loadedFrom->getSystemState()->getRenderThread());
 }
 
 DefineMorphShape2Tag::DefineMorphShape2Tag(RECORDHEADER h, std::istream& in, RootMovieClip* root):DefineMorphShapeTag(h, root, 2)
@@ -2417,15 +2565,14 @@ DefineBinaryDataTag::DefineBinaryDataTag(RECORDHEADER h,std::istream& s,RootMovi
 	int size=h.getLength();
 	s >> Tag >> Reserved;
 	size -= sizeof(Tag)+sizeof(Reserved);
-	bytes=new uint8_t[size];
 	len=size;
-	s.read((char*)bytes,size);
+	bytes=readShared(s,len);
 }
 
 ASObject* DefineBinaryDataTag::instance(Class_base* c)
 {
 	uint8_t* b = new uint8_t[len];
-	memcpy(b,bytes,len);
+	memcpy(b,bytes.get(),len);
 
 	Class_base* classRet = nullptr;
 	if(c)
@@ -2464,11 +2611,10 @@ DefineSoundTag::DefineSoundTag(RECORDHEADER h, std::istream& in, RootMovieClip*
 	SoundType=UB(1,bs);
 	in >> SoundSampleCount;
 
-	//TODO: get rid of the temporary copy
 	unsigned int soundDataLength = h.getLength()-7;
-	unsigned char *tmp = new unsigned char [soundDataLength];
-	in.read((char *)tmp, soundDataLength);
-	unsigned char *tmpp = tmp;
+	// this is only a temporary copy if the file is not in memory
+	std::shared_ptr<const uint8_t> tmp = readShared(in, soundDataLength);
+	const unsigned char *tmpp = tmp.get();
 	// it seems that adobe allows zeros at the beginning of the sound data
 	// at least for MP3 we ignore them, otherwise ffmpeg will not work properly
 	if (SoundFormat == LS_AUDIO_CODEC::MP3)
@@ -2494,7 +2640,6 @@ DefineSoundTag::DefineSoundTag(RECORDHEADER h, std::istream& in, RootMovieClip*
 		delete sbuf;
 	}
 #endif
-	delete[] tmp;
 }
 
 ASObject* DefineSoundTag::instance(Class_base* c)
@@ -2757,11 +2902,16 @@ DefineBitsTag::DefineBitsTag(RECORDHEADER h, std::istream& in,RootMovieClip* roo
 
 	in >> CharacterId;
 	//Read image data
-	int dataSize=Header.getLength()-2;
-	uint8_t *inData=new(nothrow) uint8_t[dataSize];
-	in.read((char*)inData,dataSize);
-	loadBitmap(inData,dataSize,JPEGTablesTag::getJPEGTables(),JPEGTablesTag::getJPEGTableSize());
-	delete[] inData;
+	uint32_t dataSize=max(int(Header.getLength())-2,0);
+	std::shared_ptr<const uint8_t> inData=readShared(in,dataSize);
+	int id = CharacterId;
+	// the tables are never released once they are read
+	const uint8_t* tables = JPEGTablesTag::getJPEGTables();
+	int tablesLen = JPEGTablesTag::getJPEGTableSize();
+	decodeLater(inData,dataSize,[id,tables,tablesLen](BitmapContainer* bitmap, const uint8_t* inData, uint32_t dataSize)
+	{
+		loadBitmap(bitmap,id,inData,dataSize,tables,tablesLen);
+	});
 }
 
 DefineBitsJPEG2Tag::DefineBitsJPEG2Tag(RECORDHEADER h, std::istream& in, RootMovieClip* root):BitmapTag(h,root)
@@ -2769,11 +2919,13 @@ DefineBitsJPEG2Tag::DefineBitsJPEG2Tag(RECORDHEADER h, std::istream& in, RootMov
 	LOG(LOG_TRACE,"DefineBitsJPEG2Tag Tag");
 	in >> CharacterId;
 	//Read image data
-	int dataSize=Header.getLength()-2;
-	uint8_t* inData=new(nothrow) uint8_t[dataSize];
-	in.read((char*)inData,dataSize);
-	loadBitmap(inData,dataSize);
-	delete[] inData;
+	uint32_t dataSize=max(int(Header.getLength())-2,0);
+	std::shared_ptr<const uint8_t> inData=readShared(in,dataSize);
+	int id = CharacterId;
+	decodeLater(inData,dataSize,[id](BitmapContainer* bitmap, const uint8_t* inData, uint32_t dataSize)
+	{
+		loadBitmap(bitmap,id,inData,dataSize);
+	});
 }
 
 DefineBitsJPEG3Tag::DefineBitsJPEG3Tag(RECORDHEADER h, std::istream& in, RootMovieClip* root):BitmapTag(h,root),alphaData(NULL)
@@ -2781,29 +2933,27 @@ DefineBitsJPEG3Tag::DefineBitsJPEG3Tag(RECORDHEADER h, std::istream& in, RootMov
 	LOG(LOG_TRACE,"DefineBitsJPEG3Tag Tag");
 	UI32_SWF dataSize;
 	in >> CharacterId >> dataSize;
-	//Read image data
-	uint8_t* inData=new(nothrow) uint8_t[dataSize];
-	in.read((char*)inData,dataSize);
-
-	loadBitmap(inData,dataSize);
-	delete[] inData;
-
-	//Read alpha data (if any)
+	//Read image data, followed by the compressed alpha data (if any)
 	int alphaSize=Header.getLength()-dataSize-6;
-	if(alphaSize>0) //If less that 0 the consistency check on tag size will stop later
-	{
+	//If less that 0 the consistency check on tag size will stop later
+	uint32_t imageSize = dataSize;
+	uint32_t totalSize = imageSize+max(alphaSize,0);
+	std::shared_ptr<const uint8_t> inData=readShared(in,totalSize);
+	int id = CharacterId;
+	decodeLater(inData,totalSize,[id,imageSize](BitmapContainer* bitmap, const uint8_t* inData, uint32_t totalSize)
+	{
+		loadBitmap(bitmap,id,inData,imageSize);
+		if(totalSize <= imageSize)
+			return;
 		//Create a zlib filter
-		string alphaData;
-		alphaData.resize(alphaSize);
-		in.read(&alphaData[0], alphaSize);
-		istringstream alphaStream(alphaData);
-		zlib_filter zf(alphaStream.rdbuf());
+		bytes_buf alphaBuf(inData+imageSize,totalSize-imageSize);
+		zlib_filter zf(&alphaBuf);
 		istream zfstream(&zf);
 		zfstream.exceptions ( istream::eofbit | istream::failbit | istream::badbit );
 
 		vector<char> alphaDataUncompressed;
 		alphaDataUncompressed.resize(bitmap->getHeight()*bitmap->getWidth());
-		
+
 		//Catch the exception if the stream ends
 		try
 		{
@@ -2819,7 +2969,7 @@ DefineBitsJPEG3Tag::DefineBitsJPEG3Tag(RECORDHEADER h, std::istream& in, RootMov
 		{
 			d[i*4+3]=alphaDataUncompressed[i];
 		}
-	}
+	});
 }
 
 DefineBitsJPEG3Tag::~DefineBitsJPEG3Tag()
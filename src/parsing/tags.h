@@ -23,6 +23,8 @@
 #include "compat.h"
 #include <vector>
 #include <iostream>
+#include <functional>
+#include <memory>
 #include "swftypes.h"
 #include "backends/geometry.h"
 #include "backends/decoder.h"
@@ -35,6 +37,7 @@ class RootMovieClip;
 class DisplayObjectContainer;
 class DefineSpriteTag;
 class AdditionalDataTag;
+class BitmapTagDecoder;
 
 enum TAGTYPE {TAG=0,DISPLAY_LIST_TAG,SHOW_TAG,CONTROL_TAG,DICT_TAG,FRAMELABEL_TAG,SYMBOL_CLASS_TAG,ACTION_TAG,ABC_TAG,END_TAG,
 			  AVM1ACTION_TAG,AVM1INITACTION_TAG,BUTTONSOUND_TAG, FILEATTRIBUTES_TAG,METADATA_TAG,BACKGROUNDCOLOR_TAG,ENABLEDEBUGGER_TAG};
@@ -148,7 +151,7 @@ protected:
 	RECT ShapeBounds;
 	SHAPEWITHSTYLE Shapes;
 	tokensVector* tokens;
-	TextureChunk chunk;
+	ShapeRasterCache rasterCache;
 	DefineShapeTag(RECORDHEADER h,int v,RootMovieClip* root);
 public:
 	DefineShapeTag(RECORDHEADER h,std::istream& in, RootMovieClip* root);
@@ -200,12 +203,14 @@ protected:
 	SHAPE StartEdges;
 	SHAPE EndEdges;
 	std::map<uint32_t,tokensVector> tokensmap;
+	ShapeRasterCache rasterCache;
 	DefineMorphShapeTag(RECORDHEADER h, RootMovieClip* root, int version):DictionaryTag(h,root),MorphLineStyles(version){}
 public:
 	DefineMorphShapeTag(RECORDHEADER h, std::istream& in, RootMovieClip* root);
 	int getId() const override { return CharacterId; }
 	ASObject* instance(Class_base* c=nullptr) override;
 	void getTokensForRatio(tokensVector& tokens, uint32_t ratio);
+	void resizeCompleted() override;
 };
 
 class DefineMorphShape2Tag: public DefineMorphShapeTag
@@ -463,11 +468,10 @@ class DefineBinaryDataTag: public DictionaryTag
 private:
 	UI16_SWF Tag;
 	UI32_SWF Reserved;
-	uint8_t* bytes;
+	std::shared_ptr<const uint8_t> bytes;
 	uint32_t len;
 public:
 	DefineBinaryDataTag(RECORDHEADER h,std::istream& s,RootMovieClip* root);
-	~DefineBinaryDataTag() { delete[] bytes; }
 	int getId() const override {return Tag;}
 	ASObject* instance(Class_base* c=nullptr) override;
 };
@@ -662,13 +666,24 @@ class BitmapContainer;
 
 class BitmapTag: public DictionaryTag
 {
+private:
+	// compressed image data, shared with the job decoding it
+	std::shared_ptr<BitmapTagDecoder> decoder;
+	void waitForDecoding() const;
 protected:
 	_NR<BitmapContainer> bitmap;
-	void loadBitmap(uint8_t* inData, int datasize, const uint8_t *tablesData=nullptr, int tablesLen=0);
+	static void loadBitmap(BitmapContainer* bitmap, int id, const uint8_t* inData, int datasize, const uint8_t *tablesData=nullptr, int tablesLen=0);
+	/*
+	 * Keeps the compressed data of the tag and starts decoding it on the ThreadPool,
+	 * so the parser does not wait for the image decoders. The first user of the
+	 * bitmap decodes it itself if the job did not run yet
+	 */
+	void decodeLater(std::shared_ptr<const uint8_t> data, uint32_t len, const std::function<void(BitmapContainer*,const uint8_t*,uint32_t)>& decode);
 public:
 	BitmapTag(RECORDHEADER h,RootMovieClip* root);
 	~BitmapTag();
 	ASObject* instance(Class_base* c=nullptr) override;
+	// returns the decoded bitmap, waits for the decoding if necessary
 	_NR<BitmapContainer> getBitmap() const;
 };
 
@@ -917,6 +932,14 @@ public:
 	 * It is needed to solve references to other tags during construction
 	 */
 	Tag* readTag(RootMovieClip* root,DefineSpriteTag* sprite=nullptr);
+	/*
+	 * Dictionary tags whose construction neither depends on nor changes other tags
+	 * or the RootMovieClip, so they may be constructed on any thread. Bitmap fills
+	 * of shapes are the exception, they throw a ParseException if offParseThread is set
+	 */
+	static bool isIndependentTag(uint32_t type);
+	// returns nullptr if the tag type is not independent
+	static DictionaryTag* readIndependentTag(RECORDHEADER h, std::istream& f, RootMovieClip* root, bool offParseThread);
 };
 
 
@@ -1373,6 +1373,11 @@ void EngineData::exec_glScissor(int32_t x, int32_t y, int32_t width, int32_t hei
 	glScissor(x,y,width,height);
 }
 
+void EngineData::exec_glDisable_GL_SCISSOR_TEST()
+{
+	glDisable(GL_SCISSOR_TEST);
+}
+
 void EngineData::exec_glColorMask(bool red, bool green, bool blue, bool alpha)
 {
 	glColorMask(red,green,blue,alpha);
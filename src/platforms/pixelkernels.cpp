@@ -0,0 +1,981 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include "platforms/pixelkernels.h"
+
+#if (defined(__i386__) || defined(__x86_64__)) && defined(__GNUC__)
+#define PIXELKERNELS_X86 1
+#include <immintrin.h>
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#if defined(__ARM_NEON) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define PIXELKERNELS_NEON 1
+#include <arm_neon.h>
+#endif
+
+using namespace lightspark;
+
+namespace
+{
+
+struct pixelKernelTable
+{
+	PIXELKERNEL_LEVEL level;
+	void (*premultiply)(uint32_t* dst, const uint32_t* src, uint32_t count);
+	void (*unpremultiply)(uint32_t* dst, const uint32_t* src, uint32_t count);
+	void (*convertARGB)(uint32_t* dst, const uint8_t* src, uint32_t count, bool opaque);
+	void (*convertRGBA)(uint32_t* dst, const uint8_t* src, uint32_t count);
+	void (*convertRGB24)(uint32_t* dst, const uint8_t* src, uint32_t count);
+	void (*convertRGB15)(uint32_t* dst, const uint8_t* src, uint32_t count);
+	void (*colorTransform)(uint32_t* dst, const uint32_t* src, uint32_t count, const pixelColorTransform& ct);
+	void (*blendOver)(uint32_t* dst, const uint32_t* src, uint32_t count);
+	void (*boxBlurRow)(uint32_t* dst, const uint32_t* src, uint32_t count, uint32_t radius);
+	void (*boxBlurColumns)(uint32_t* dst, const uint32_t* src, uint32_t stride, uint32_t count, uint32_t rows, uint32_t radius, int32_t* sums);
+};
+
+// c*a/255, correctly rounded for all 8 bit values
+inline uint32_t mul255(uint32_t c, uint32_t a)
+{
+	uint32_t t = c*a+128;
+	return (t+(t>>8))>>8;
+}
+
+// expands a 5 bit channel to 8 bit, same as c*255/31
+inline uint32_t expand5(uint32_t c)
+{
+	return (c*1053)>>7;
+}
+
+inline uint32_t transformChannel(uint32_t c, int32_t mult, int32_t add)
+{
+	int32_t v = ((int32_t(c)*mult)>>8)+add;
+	return uint32_t(std::max(0,std::min(255,v)));
+}
+
+struct unpremultiplyTable
+{
+	// 255/alpha, the vectorized versions use the same float arithmetic
+	float recip[256];
+	unpremultiplyTable()
+	{
+		recip[0] = 0;
+		for (uint32_t a = 1; a < 256; a++)
+			recip[a] = 255.0f/a;
+	}
+};
+const unpremultiplyTable unpremultiplytable;
+
+inline uint32_t unpremultiplyChannel(uint32_t c, float recip)
+{
+	return std::min(255u,uint32_t(float(c)*recip+0.5f));
+}
+
+void premultiply_scalar(uint32_t* dst, const uint32_t* src, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t p = src[i];
+		uint32_t a = p>>24;
+		if (a == 0xff)
+			dst[i] = p;
+		else
+			dst[i] = a<<24 | mul255((p>>16)&0xff,a)<<16 | mul255((p>>8)&0xff,a)<<8 | mul255(p&0xff,a);
+	}
+}
+
+void unpremultiply_scalar(uint32_t* dst, const uint32_t* src, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t p = src[i];
+		uint32_t a = p>>24;
+		if (a == 0xff)
+			dst[i] = p;
+		else
+		{
+			float r = unpremultiplytable.recip[a];
+			dst[i] = a<<24
+				| unpremultiplyChannel((p>>16)&0xff,r)<<16
+				| unpremultiplyChannel((p>>8)&0xff,r)<<8
+				| unpremultiplyChannel(p&0xff,r);
+		}
+	}
+}
+
+void convertARGB_scalar(uint32_t* dst, const uint8_t* src, uint32_t count, bool opaque)
+{
+	uint32_t alphamask = opaque ? 0xff000000 : 0;
+	for (uint32_t i = 0; i < count; i++, src+=4)
+		dst[i] = (uint32_t(src[0])<<24 | uint32_t(src[1])<<16 | uint32_t(src[2])<<8 | uint32_t(src[3])) | alphamask;
+}
+
+void convertRGBA_scalar(uint32_t* dst, const uint8_t* src, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++, src+=4)
+		dst[i] = uint32_t(src[3])<<24 | uint32_t(src[0])<<16 | uint32_t(src[1])<<8 | uint32_t(src[2]);
+}
+
+void convertRGB24_scalar(uint32_t* dst, const uint8_t* src, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++, src+=3)
+		dst[i] = 0xff000000 | uint32_t(src[0])<<16 | uint32_t(src[1])<<8 | uint32_t(src[2]);
+}
+
+void convertRGB15_scalar(uint32_t* dst, const uint8_t* src, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++, src+=2)
+	{
+		uint32_t v = uint32_t(src[0])<<8 | src[1];
+		dst[i] = 0xff000000 | expand5((v>>10)&0x1f)<<16 | expand5((v>>5)&0x1f)<<8 | expand5(v&0x1f);
+	}
+}
+
+void colorTransform_scalar(uint32_t* dst, const uint32_t* src, uint32_t count, const pixelColorTransform& ct)
+{
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t p = src[i];
+		dst[i] = transformChannel(p>>24,ct.mult[3],ct.add[3])<<24
+			| transformChannel((p>>16)&0xff,ct.mult[2],ct.add[2])<<16
+			| transformChannel((p>>8)&0xff,ct.mult[1],ct.add[1])<<8
+			| transformChannel(p&0xff,ct.mult[0],ct.add[0]);
+	}
+}
+
+void blendOver_scalar(uint32_t* dst, const uint32_t* src, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t s = src[i];
+		uint32_t inv = 0xff-(s>>24);
+		if (inv == 0)
+			dst[i] = s;
+		else if (s)
+		{
+			uint32_t d = dst[i];
+			uint32_t res = 0;
+			for (uint32_t shift = 0; shift < 32; shift += 8)
+				res |= std::min(255u,((s>>shift)&0xff)+mul255((d>>shift)&0xff,inv))<<shift;
+			dst[i] = res;
+		}
+	}
+}
+
+// sum/(2*radius+1), the vectorized versions use the same float arithmetic
+inline uint32_t boxBlurChannel(int32_t sum, float recip)
+{
+	return std::min(255u,uint32_t(float(sum)*recip+0.5f));
+}
+
+void boxBlurRow_scalar(uint32_t* dst, const uint32_t* src, uint32_t count, uint32_t radius)
+{
+	if (count == 0)
+		return;
+	const float recip = 1.0f/(2*radius+1);
+	const int32_t last = count-1;
+	const uint8_t* s = (const uint8_t*)src;
+	uint8_t* d = (uint8_t*)dst;
+	// the window is clamped at the edges of the row
+	int32_t sum[4];
+	for (uint32_t c = 0; c < 4; c++)
+	{
+		sum[c] = (radius+1)*s[c];
+		for (uint32_t i = 1; i <= radius; i++)
+			sum[c] += s[std::min(int32_t(i),last)*4+c];
+	}
+	for (int32_t x = 0; x <= last; x++)
+	{
+		const uint8_t* add = s+std::min(x+int32_t(radius)+1,last)*4;
+		const uint8_t* sub = s+std::max(x-int32_t(radius),0)*4;
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			d[x*4+c] = boxBlurChannel(sum[c],recip);
+			sum[c] += add[c]-sub[c];
+		}
+	}
+}
+
+// initializes the column sums for the first row, with the window clamped at the top edge
+void boxBlurColumnSums(int32_t* sums, const uint32_t* src, uint32_t stride, uint32_t count, uint32_t rows, uint32_t radius)
+{
+	const uint8_t* s = (const uint8_t*)src;
+	for (uint32_t i = 0; i < count*4; i++)
+		sums[i] = (radius+1)*s[i];
+	for (uint32_t r = 1; r <= radius; r++)
+	{
+		s = (const uint8_t*)(src+std::min(r,rows-1)*stride);
+		for (uint32_t i = 0; i < count*4; i++)
+			sums[i] += s[i];
+	}
+}
+
+// blurs the columns from first to count of one row and advances the sums to the next row
+void boxBlurColumnsRow_scalar(uint32_t* dst, const uint32_t* add, const uint32_t* sub, uint32_t first, uint32_t count, int32_t* sums, float recip)
+{
+	const uint8_t* a = (const uint8_t*)add;
+	const uint8_t* s = (const uint8_t*)sub;
+	for (uint32_t x = first; x < count; x++)
+	{
+		uint8_t* d = (uint8_t*)(dst+x);
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			uint32_t i = x*4+c;
+			d[c] = boxBlurChannel(sums[i],recip);
+			sums[i] += a[i]-s[i];
+		}
+		// pixels that became fully transparent must not keep any color
+		if ((dst[x]>>24) == 0)
+			dst[x] = 0;
+	}
+}
+
+void boxBlurColumns_scalar(uint32_t* dst, const uint32_t* src, uint32_t stride, uint32_t count, uint32_t rows, uint32_t radius, int32_t* sums)
+{
+	if (count == 0 || rows == 0)
+		return;
+	const float recip = 1.0f/(2*radius+1);
+	boxBlurColumnSums(sums,src,stride,count,rows,radius);
+	for (uint32_t y = 0; y < rows; y++)
+	{
+		const uint32_t* add = src+std::min(y+radius+1,rows-1)*stride;
+		const uint32_t* sub = src+(y > radius ? y-radius : 0)*stride;
+		boxBlurColumnsRow_scalar(dst+y*stride,add,sub,0,count,sums,recip);
+	}
+}
+
+const pixelKernelTable scalarKernels =
+{
+	PIXELKERNEL_SCALAR, premultiply_scalar, unpremultiply_scalar, convertARGB_scalar, convertRGBA_scalar,
+	convertRGB24_scalar, convertRGB15_scalar, colorTransform_scalar, blendOver_scalar,
+	boxBlurRow_scalar, boxBlurColumns_scalar
+};
+
+#ifdef PIXELKERNELS_X86
+/*
+ * SSE2 versions. The 8 bit channels are widened to 16 bit lanes, so each
+ * 128 bit register holds two pixels in the order blue, green, red, alpha
+ */
+TARGET_SSE2 inline __m128i mul255_sse2(__m128i c, __m128i a)
+{
+	__m128i t = _mm_add_epi16(_mm_mullo_epi16(c,a),_mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(t,_mm_srli_epi16(t,8)),8);
+}
+
+TARGET_SSE2 inline __m128i broadcastAlpha_sse2(__m128i p)
+{
+	return _mm_shufflehi_epi16(_mm_shufflelo_epi16(p,_MM_SHUFFLE(3,3,3,3)),_MM_SHUFFLE(3,3,3,3));
+}
+
+TARGET_SSE2 void premultiply_sse2(uint32_t* dst, const uint32_t* src, uint32_t count)
+{
+	const __m128i zero = _mm_setzero_si128();
+	// keep the alpha channel by multiplying it with 255
+	const __m128i rgbmask = _mm_set_epi16(0,-1,-1,-1,0,-1,-1,-1);
+	const __m128i alpha255 = _mm_set_epi16(255,0,0,0,255,0,0,0);
+	uint32_t i = 0;
+	for (; i+4 <= count; i+=4)
+	{
+		__m128i p = _mm_loadu_si128((const __m128i*)(src+i));
+		__m128i lo = _mm_unpacklo_epi8(p,zero);
+		__m128i hi = _mm_unpackhi_epi8(p,zero);
+		__m128i alo = _mm_or_si128(_mm_and_si128(broadcastAlpha_sse2(lo),rgbmask),alpha255);
+		__m128i ahi = _mm_or_si128(_mm_and_si128(broadcastAlpha_sse2(hi),rgbmask),alpha255);
+		_mm_storeu_si128((__m128i*)(dst+i),_mm_packus_epi16(mul255_sse2(lo,alo),mul255_sse2(hi,ahi)));
+	}
+	premultiply_scalar(dst+i,src+i,count-i);
+}
+
+TARGET_SSE2 inline __m128i unpremultiplyPixel_sse2(__m128i c, uint32_t p)
+{
+	// the alpha channel is multiplied by 1
+	const __m128 recip = _mm_set_ps(1.0f,unpremultiplytable.recip[p>>24],unpremultiplytable.recip[p>>24],unpremultiplytable.recip[p>>24]);
+	return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(c),recip),_mm_set1_ps(0.5f)));
+}
+
+TARGET_SSE2 void unpremultiply_sse2(uint32_t* dst, const uint32_t* src, uint32_t count)
+{
+	const __m128i zero = _mm_setzero_si128();
+	uint32_t i = 0;
+	for (; i+4 <= count; i+=4)
+	{
+		__m128i p = _mm_loadu_si128((const __m128i*)(src+i));
+		__m128i lo = _mm_unpacklo_epi8(p,zero);
+		__m128i hi = _mm_unpackhi_epi8(p,zero);
+		__m128i p0 = unpremultiplyPixel_sse2(_mm_unpacklo_epi16(lo,zero),src[i]);
+		__m128i p1 = unpremultiplyPixel_sse2(_mm_unpackhi_epi16(lo,zero),src[i+1]);
+		__m128i p2 = unpremultiplyPixel_sse2(_mm_unpacklo_epi16(hi,zero),src[i+2]);
+		__m128i p3 = unpremultiplyPixel_sse2(_mm_unpackhi_epi16(hi,zero),src[i+3]);
+		_mm_storeu_si128((__m128i*)(dst+i),_mm_packus_epi16(_mm_packs_epi32(p0,p1),_mm_packs_epi32(p2,p3)));
+	}
+	unpremultiply_scalar(dst+i,src+i,count-i);
+}
+
+TARGET_SSE2 inline __m128i bswap32_sse2(__m128i p)
+{
+	const __m128i mask = _mm_set1_epi32(0x00ff00ff);
+	// swap the bytes in each 16 bit word, then the words in each 32 bit pixel
+	p = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(p,8),mask),_mm_andnot_si128(mask,_mm_slli_epi16(p,8)));
+	return _mm_shufflehi_epi16(_mm_shufflelo_epi16(p,_MM_SHUFFLE(2,3,0,1)),_MM_SHUFFLE(2,3,0,1));
+}
+
+TARGET_SSE2 void convertARGB_sse2(uint32_t* dst, const uint8_t* src, uint32_t count, bool opaque)
+{
+	const __m128i alphamask = _mm_set1_epi32(opaque ? 0xff000000 : 0);
+	uint32_t i = 0;
+	for (; i+4 <= count; i+=4)
+	{
+		__m128i p = _mm_loadu_si128((const __m128i*)(src+i*4));
+		_mm_storeu_si128((__m128i*)(dst+i),_mm_or_si128(bswap32_sse2(p),alphamask));
+	}
+	convertARGB_scalar(dst+i,src+i*4,count-i,opaque);
+}
+
+TARGET_SSE2 void convertRGBA_sse2(uint32_t* dst, const uint8_t* src, uint32_t count)
+{
+	const __m128i keep = _mm_set1_epi32(0xff00ff00);
+	const __m128i mask = _mm_set1_epi32(0x000000ff);
+	uint32_t i = 0;
+	for (; i+4 <= count; i+=4)
+	{
+		__m128i p = _mm_loadu_si128((const __m128i*)(src+i*4));
+		__m128i rb = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(p,16),mask),_mm_slli_epi32(_mm_and_si128(p,mask),16));
+		_mm_storeu_si128((__m128i*)(dst+i),_mm_or_si128(_mm_and_si128(p,keep),rb));
+	}
+	convertRGBA_scalar(dst+i,src+i*4,count-i);
+}
+
+TARGET_SSE2 void convertRGB15_sse2(uint32_t* dst, const uint8_t* src, uint32_t count)
+{
+	const __m128i mask5 = _mm_set1_epi16(0x1f);
+	const __m128i mult = _mm_set1_epi16(1053);
+	const __m128i alpha = _mm_set1_epi16((short)0xff00);
+	uint32_t i = 0;
+	for (; i+8 <= count; i+=8)
+	{
+		__m128i p = _mm_loadu_si128((const __m128i*)(src+i*2));
+		// the 16 bit values are stored big endian
+		p = _mm_or_si128(_mm_srli_epi16(p,8),_mm_slli_epi16(p,8));
+		__m128i r = _mm_srli_epi16(_mm_mullo_epi16(_mm_and_si128(_mm_srli_epi16(p,10),mask5),mult),7);
+		__m128i g = _mm_srli_epi16(_mm_mullo_epi16(_mm_and_si128(_mm_srli_epi16(p,5),mask5),mult),7);
+		__m128i b = _mm_srli_epi16(_mm_mullo_epi16(_mm_and_si128(p,mask5),mult),7);
+		__m128i bg = _mm_or_si128(b,_mm_slli_epi16(g,8));
+		__m128i ra = _mm_or_si128(r,alpha);
+		_mm_storeu_si128((__m128i*)(dst+i),_mm_unpacklo_epi16(bg,ra));
+		_mm_storeu_si128((__m128i*)(dst+i+4),_mm_unpackhi_epi16(bg,ra));
+	}
+	convertRGB15_scalar(dst+i,src+i*2,count-i);
+}
+
+TARGET_SSE2 inline __m128i transformPixel_sse2(__m128i c, __m128i mult, __m128i add)
+{
+	// the upper half of each 32 bit lane of c is zero, so madd is a plain 16x16->32 bit multiplication
+	return _mm_add_epi32(_mm_srai_epi32(_mm_madd_epi16(c,mult),8),add);
+}
+
+TARGET_SSE2 void colorTransform_sse2(uint32_t* dst, const uint32_t* src, uint32_t count, const pixelColorTransform& ct)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i mult = _mm_set_epi32(ct.mult[3]&0xffff,ct.mult[2]&0xffff,ct.mult[1]&0xffff,ct.mult[0]&0xffff);
+	const __m128i add = _mm_set_epi32(ct.add[3],ct.add[2],ct.add[1],ct.add[0]);
+	uint32_t i = 0;
+	for (; i+4 <= count; i+=4)
+	{
+		__m128i p = _mm_loadu_si128((const __m128i*)(src+i));
+		__m128i lo = _mm_unpacklo_epi8(p,zero);
+		__m128i hi = _mm_unpackhi_epi8(p,zero);
+		__m128i p0 = transformPixel_sse2(_mm_unpacklo_epi16(lo,zero),mult,add);
+		__m128i p1 = transformPixel_sse2(_mm_unpackhi_epi16(lo,zero),mult,add);
+		__m128i p2 = transformPixel_sse2(_mm_unpacklo_epi16(hi,zero),mult,add);
+		__m128i p3 = transformPixel_sse2(_mm_unpackhi_epi16(hi,zero),mult,add);
+		// the saturating packs clamp the channels to 0..255
+		_mm_storeu_si128((__m128i*)(dst+i),_mm_packus_epi16(_mm_packs_epi32(p0,p1),_mm_packs_epi32(p2,p3)));
+	}
+	colorTransform_scalar(dst+i,src+i,count-i,ct);
+}
+
+TARGET_SSE2 void blendOver_sse2(uint32_t* dst, const uint32_t* src, uint32_t count)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i c255 = _mm_set1_epi16(255);
+	uint32_t i = 0;
+	for (; i+4 <= count; i+=4)
+	{
+		__m128i s = _mm_loadu_si128((const __m128i*)(src+i));
+		__m128i d = _mm_loadu_si128((const __m128i*)(dst+i));
+		__m128i invlo = _mm_sub_epi16(c255,broadcastAlpha_sse2(_mm_unpacklo_epi8(s,zero)));
+		__m128i invhi = _mm_sub_epi16(c255,broadcastAlpha_sse2(_mm_unpackhi_epi8(s,zero)));
+		__m128i dlo = mul255_sse2(_mm_unpacklo_epi8(d,zero),invlo);
+		__m128i dhi = mul255_sse2(_mm_unpackhi_epi8(d,zero),invhi);
+		_mm_storeu_si128((__m128i*)(dst+i),_mm_adds_epu8(s,_mm_packus_epi16(dlo,dhi)));
+	}
+	blendOver_scalar(dst+i,src+i,count-i);
+}
+
+TARGET_SSE2 inline __m128i loadPixel_sse2(const uint32_t* p)
+{
+	const __m128i zero = _mm_setzero_si128();
+	return _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(int32_t(*p)),zero),zero);
+}
+
+TARGET_SSE2 inline __m128i boxBlurChannels_sse2(__m128i sum, __m128 recip)
+{
+	return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(sum),recip),_mm_set1_ps(0.5f)));
+}
+
+// the running sums of the four channels of a pixel are kept in one register
+TARGET_SSE2 void boxBlurRow_sse2(uint32_t* dst, const uint32_t* src, uint32_t count, uint32_t radius)
+{
+	if (count == 0)
+		return;
+	const __m128 recip = _mm_set1_ps(1.0f/(2*radius+1));
+	const int32_t last = count-1;
+	const __m128i first = loadPixel_sse2(src);
+	__m128i sum = first;
+	for (uint32_t i = 1; i <= radius; i++)
+		sum = _mm_add_epi32(sum,_mm_add_epi32(first,loadPixel_sse2(src+std::min(int32_t(i),last))));
+	for (int32_t x = 0; x <= last; x++)
+	{
+		__m128i c = boxBlurChannels_sse2(sum,recip);
+		c = _mm_packs_epi32(c,c);
+		dst[x] = uint32_t(_mm_cvtsi128_si32(_mm_packus_epi16(c,c)));
+		__m128i add = loadPixel_sse2(src+std::min(x+int32_t(radius)+1,last));
+		__m128i sub = loadPixel_sse2(src+std::max(x-int32_t(radius),0));
+		sum = _mm_add_epi32(sum,_mm_sub_epi32(add,sub));
+	}
+}
+
+// adds the signed 16 bit differences in d to two registers of 32 bit sums
+TARGET_SSE2 inline void addDifferences_sse2(__m128i& lo, __m128i& hi, __m128i d)
+{
+	__m128i sign = _mm_srai_epi16(d,15);
+	lo = _mm_add_epi32(lo,_mm_unpacklo_epi16(d,sign));
+	hi = _mm_add_epi32(hi,_mm_unpackhi_epi16(d,sign));
+}
+
+// the columns are blurred four pixels at a time, with one 32 bit sum per channel
+TARGET_SSE2 void boxBlurColumns_sse2(uint32_t* dst, const uint32_t* src, uint32_t stride, uint32_t count, uint32_t rows, uint32_t radius, int32_t* sums)
+{
+	if (count == 0 || rows == 0)
+		return;
+	const float r = 1.0f/(2*radius+1);
+	const __m128 recip = _mm_set1_ps(r);
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i alphamask = _mm_set1_epi32(0xff000000);
+	const uint32_t vcount = count&~3u;
+	boxBlurColumnSums(sums,src,stride,count,rows,radius);
+	for (uint32_t y = 0; y < rows; y++)
+	{
+		const uint32_t* add = src+std::min(y+radius+1,rows-1)*stride;
+		const uint32_t* sub = src+(y > radius ? y-radius : 0)*stride;
+		uint32_t* d = dst+y*stride;
+		for (uint32_t x = 0; x < vcount; x+=4)
+		{
+			__m128i* s = (__m128i*)(sums+x*4);
+			__m128i s0 = _mm_loadu_si128(s);
+			__m128i s1 = _mm_loadu_si128(s+1);
+			__m128i s2 = _mm_loadu_si128(s+2);
+			__m128i s3 = _mm_loadu_si128(s+3);
+			__m128i p = _mm_packus_epi16(_mm_packs_epi32(boxBlurChannels_sse2(s0,recip),boxBlurChannels_sse2(s1,recip)),
+						     _mm_packs_epi32(boxBlurChannels_sse2(s2,recip),boxBlurChannels_sse2(s3,recip)));
+			// pixels that became fully transparent must not keep any color
+			p = _mm_andnot_si128(_mm_cmpeq_epi32(_mm_and_si128(p,alphamask),zero),p);
+			_mm_storeu_si128((__m128i*)(d+x),p);
+			__m128i a = _mm_loadu_si128((const __m128i*)(add+x));
+			__m128i b = _mm_loadu_si128((const __m128i*)(sub+x));
+			addDifferences_sse2(s0,s1,_mm_sub_epi16(_mm_unpacklo_epi8(a,zero),_mm_unpacklo_epi8(b,zero)));
+			addDifferences_sse2(s2,s3,_mm_sub_epi16(_mm_unpackhi_epi8(a,zero),_mm_unpackhi_epi8(b,zero)));
+			_mm_storeu_si128(s,s0);
+			_mm_storeu_si128(s+1,s1);
+			_mm_storeu_si128(s+2,s2);
+			_mm_storeu_si128(s+3,s3);
+		}
+		boxBlurColumnsRow_scalar(d,add,sub,vcount,count,sums,r);
+	}
+}
+
+const pixelKernelTable sse2Kernels =
+{
+	PIXELKERNEL_SSE2, premultiply_sse2, unpremultiply_sse2, convertARGB_sse2, convertRGBA_sse2,
+	convertRGB24_scalar, convertRGB15_sse2, colorTransform_sse2, blendOver_sse2,
+	boxBlurRow_sse2, boxBlurColumns_sse2
+};
+
+/*
+ * AVX2 versions. Unpacking and packing work on the two 128 bit halves
+ * independently, so the pixel order is preserved like in the SSE2 versions
+ */
+TARGET_AVX2 inline __m256i mul255_avx2(__m256i c, __m256i a)
+{
+	__m256i t = _mm256_add_epi16(_mm256_mullo_epi16(c,a),_mm256_set1_epi16(128));
+	return _mm256_srli_epi16(_mm256_add_epi16(t,_mm256_srli_epi16(t,8)),8);
+}
+
+TARGET_AVX2 inline __m256i broadcastAlpha_avx2(__m256i p)
+{
+	return _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(p,_MM_SHUFFLE(3,3,3,3)),_MM_SHUFFLE(3,3,3,3));
+}
+
+TARGET_AVX2 void premultiply_avx2(uint32_t* dst, const uint32_t* src, uint32_t count)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i rgbmask = _mm256_set_epi16(0,-1,-1,-1,0,-1,-1,-1,0,-1,-1,-1,0,-1,-1,-1);
+	const __m256i alpha255 = _mm256_set_epi16(255,0,0,0,255,0,0,0,255,0,0,0,255,0,0,0);
+	uint32_t i = 0;
+	for (; i+8 <= count; i+=8)
+	{
+		__m256i p = _mm256_loadu_si256((const __m256i*)(src+i));
+		__m256i lo = _mm256_unpacklo_epi8(p,zero);
+		__m256i hi = _mm256_unpackhi_epi8(p,zero);
+		__m256i alo = _mm256_or_si256(_mm256_and_si256(broadcastAlpha_avx2(lo),rgbmask),alpha255);
+		__m256i ahi = _mm256_or_si256(_mm256_and_si256(broadcastAlpha_avx2(hi),rgbmask),alpha255);
+		_mm256_storeu_si256((__m256i*)(dst+i),_mm256_packus_epi16(mul255_avx2(lo,alo),mul255_avx2(hi,ahi)));
+	}
+	premultiply_sse2(dst+i,src+i,count-i);
+}
+
+TARGET_AVX2 void convertARGB_avx2(uint32_t* dst, const uint8_t* src, uint32_t count, bool opaque)
+{
+	const __m256i shuffle = _mm256_set_epi8(12,13,14,15,8,9,10,11,4,5,6,7,0,1,2,3,
+						12,13,14,15,8,9,10,11,4,5,6,7,0,1,2,3);
+	const __m256i alphamask = _mm256_set1_epi32(opaque ? 0xff000000 : 0);
+	uint32_t i = 0;
+	for (; i+8 <= count; i+=8)
+	{
+		__m256i p = _mm256_loadu_si256((const __m256i*)(src+i*4));
+		_mm256_storeu_si256((__m256i*)(dst+i),_mm256_or_si256(_mm256_shuffle_epi8(p,shuffle),alphamask));
+	}
+	convertARGB_sse2(dst+i,src+i*4,count-i,opaque);
+}
+
+TARGET_AVX2 void convertRGBA_avx2(uint32_t* dst, const uint8_t* src, uint32_t count)
+{
+	const __m256i shuffle = _mm256_set_epi8(15,12,13,14,11,8,9,10,7,4,5,6,3,0,1,2,
+						15,12,13,14,11,8,9,10,7,4,5,6,3,0,1,2);
+	uint32_t i = 0;
+	for (; i+8 <= count; i+=8)
+	{
+		__m256i p = _mm256_loadu_si256((const __m256i*)(src+i*4));
+		_mm256_storeu_si256((__m256i*)(dst+i),_mm256_shuffle_epi8(p,shuffle));
+	}
+	convertRGBA_sse2(dst+i,src+i*4,count-i);
+}
+
+TARGET_AVX2 void convertRGB24_avx2(uint32_t* dst, const uint8_t* src, uint32_t count)
+{
+	// four pixels are taken from the first 12 bytes of each load, -1 clears the alpha byte
+	const __m128i shuffle = _mm_set_epi8(-1,9,10,11,-1,6,7,8,-1,3,4,5,-1,0,1,2);
+	const __m128i alpha = _mm_set1_epi32(0xff000000);
+	uint32_t i = 0;
+	// stop early enough that the 16 byte loads stay within the source buffer
+	for (; i+6 <= count; i+=4)
+	{
+		__m128i p = _mm_loadu_si128((const __m128i*)(src+i*3));
+		_mm_storeu_si128((__m128i*)(dst+i),_mm_or_si128(_mm_shuffle_epi8(p,shuffle),alpha));
+	}
+	convertRGB24_scalar(dst+i,src+i*3,count-i);
+}
+
+TARGET_AVX2 inline __m256i transformPixel_avx2(__m256i c, __m256i mult, __m256i add)
+{
+	return _mm256_add_epi32(_mm256_srai_epi32(_mm256_madd_epi16(c,mult),8),add);
+}
+
+TARGET_AVX2 void colorTransform_avx2(uint32_t* dst, const uint32_t* src, uint32_t count, const pixelColorTransform& ct)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i mult = _mm256_set_epi32(ct.mult[3]&0xffff,ct.mult[2]&0xffff,ct.mult[1]&0xffff,ct.mult[0]&0xffff,
+					      ct.mult[3]&0xffff,ct.mult[2]&0xffff,ct.mult[1]&0xffff,ct.mult[0]&0xffff);
+	const __m256i add = _mm256_set_epi32(ct.add[3],ct.add[2],ct.add[1],ct.add[0],ct.add[3],ct.add[2],ct.add[1],ct.add[0]);
+	uint32_t i = 0;
+	for (; i+8 <= count; i+=8)
+	{
+		__m256i p = _mm256_loadu_si256((const __m256i*)(src+i));
+		__m256i lo = _mm256_unpacklo_epi8(p,zero);
+		__m256i hi = _mm256_unpackhi_epi8(p,zero);
+		__m256i p0 = transformPixel_avx2(_mm256_unpacklo_epi16(lo,zero),mult,add);
+		__m256i p1 = transformPixel_avx2(_mm256_unpackhi_epi16(lo,zero),mult,add);
+		__m256i p2 = transformPixel_avx2(_mm256_unpacklo_epi16(hi,zero),mult,add);
+		__m256i p3 = transformPixel_avx2(_mm256_unpackhi_epi16(hi,zero),mult,add);
+		_mm256_storeu_si256((__m256i*)(dst+i),_mm256_packus_epi16(_mm256_packs_epi32(p0,p1),_mm256_packs_epi32(p2,p3)));
+	}
+	colorTransform_sse2(dst+i,src+i,count-i,ct);
+}
+
+TARGET_AVX2 void blendOver_avx2(uint32_t* dst, const uint32_t* src, uint32_t count)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i c255 = _mm256_set1_epi16(255);
+	uint32_t i = 0;
+	for (; i+8 <= count; i+=8)
+	{
+		__m256i s = _mm256_loadu_si256((const __m256i*)(src+i));
+		__m256i d = _mm256_loadu_si256((const __m256i*)(dst+i));
+		__m256i invlo = _mm256_sub_epi16(c255,broadcastAlpha_avx2(_mm256_unpacklo_epi8(s,zero)));
+		__m256i invhi = _mm256_sub_epi16(c255,broadcastAlpha_avx2(_mm256_unpackhi_epi8(s,zero)));
+		__m256i dlo = mul255_avx2(_mm256_unpacklo_epi8(d,zero),invlo);
+		__m256i dhi = mul255_avx2(_mm256_unpackhi_epi8(d,zero),invhi);
+		_mm256_storeu_si256((__m256i*)(dst+i),_mm256_adds_epu8(s,_mm256_packus_epi16(dlo,dhi)));
+	}
+	blendOver_sse2(dst+i,src+i,count-i);
+}
+
+TARGET_AVX2 inline __m256i boxBlurChannels_avx2(__m256i sum, __m256 recip)
+{
+	return _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(sum),recip),_mm256_set1_ps(0.5f)));
+}
+
+// the columns are blurred eight pixels at a time, every register holds the sums of two pixels
+TARGET_AVX2 void boxBlurColumns_avx2(uint32_t* dst, const uint32_t* src, uint32_t stride, uint32_t count, uint32_t rows, uint32_t radius, int32_t* sums)
+{
+	if (count == 0 || rows == 0)
+		return;
+	const float r = 1.0f/(2*radius+1);
+	const __m256 recip = _mm256_set1_ps(r);
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i alphamask = _mm256_set1_epi32(0xff000000);
+	// packing interleaves the 128 bit halves, this restores the pixel order
+	const __m256i order = _mm256_setr_epi32(0,4,1,5,2,6,3,7);
+	const uint32_t vcount = count&~7u;
+	boxBlurColumnSums(sums,src,stride,count,rows,radius);
+	for (uint32_t y = 0; y < rows; y++)
+	{
+		const uint32_t* add = src+std::min(y+radius+1,rows-1)*stride;
+		const uint32_t* sub = src+(y > radius ? y-radius : 0)*stride;
+		uint32_t* d = dst+y*stride;
+		for (uint32_t x = 0; x < vcount; x+=8)
+		{
+			__m256i* s = (__m256i*)(sums+x*4);
+			__m256i s0 = _mm256_loadu_si256(s);
+			__m256i s1 = _mm256_loadu_si256(s+1);
+			__m256i s2 = _mm256_loadu_si256(s+2);
+			__m256i s3 = _mm256_loadu_si256(s+3);
+			__m256i p = _mm256_packus_epi16(_mm256_packs_epi32(boxBlurChannels_avx2(s0,recip),boxBlurChannels_avx2(s1,recip)),
+							_mm256_packs_epi32(boxBlurChannels_avx2(s2,recip),boxBlurChannels_avx2(s3,recip)));
+			p = _mm256_permutevar8x32_epi32(p,order);
+			// pixels that became fully transparent must not keep any color
+			p = _mm256_andnot_si256(_mm256_cmpeq_epi32(_mm256_and_si256(p,alphamask),zero),p);
+			_mm256_storeu_si256((__m256i*)(d+x),p);
+			__m128i a0 = _mm_loadu_si128((const __m128i*)(add+x));
+			__m128i a1 = _mm_loadu_si128((const __m128i*)(add+x+4));
+			__m128i b0 = _mm_loadu_si128((const __m128i*)(sub+x));
+			__m128i b1 = _mm_loadu_si128((const __m128i*)(sub+x+4));
+			s0 = _mm256_add_epi32(s0,_mm256_sub_epi32(_mm256_cvtepu8_epi32(a0),_mm256_cvtepu8_epi32(b0)));
+			s1 = _mm256_add_epi32(s1,_mm256_sub_epi32(_mm256_cvtepu8_epi32(_mm_srli_si128(a0,8)),_mm256_cvtepu8_epi32(_mm_srli_si128(b0,8))));
+			s2 = _mm256_add_epi32(s2,_mm256_sub_epi32(_mm256_cvtepu8_epi32(a1),_mm256_cvtepu8_epi32(b1)));
+			s3 = _mm256_add_epi32(s3,_mm256_sub_epi32(_mm256_cvtepu8_epi32(_mm_srli_si128(a1,8)),_mm256_cvtepu8_epi32(_mm_srli_si128(b1,8))));
+			_mm256_storeu_si256(s,s0);
+			_mm256_storeu_si256(s+1,s1);
+			_mm256_storeu_si256(s+2,s2);
+			_mm256_storeu_si256(s+3,s3);
+		}
+		boxBlurColumnsRow_scalar(d,add,sub,vcount,count,sums,r);
+	}
+}
+
+const pixelKernelTable avx2Kernels =
+{
+	PIXELKERNEL_AVX2, premultiply_avx2, unpremultiply_sse2, convertARGB_avx2, convertRGBA_avx2,
+	convertRGB24_avx2, convertRGB15_sse2, colorTransform_avx2, blendOver_avx2,
+	boxBlurRow_sse2, boxBlurColumns_avx2
+};
+#endif
+
+#ifdef PIXELKERNELS_NEON
+/*
+ * NEON versions. vld4/vst4 split 16 pixels into one register per channel
+ * (blue, green, red, alpha on little endian)
+ */
+inline uint8x16_t mul255_neon(uint8x16_t c, uint8x16_t a)
+{
+	uint16x8_t lo = vmull_u8(vget_low_u8(c),vget_low_u8(a));
+	uint16x8_t hi = vmull_u8(vget_high_u8(c),vget_high_u8(a));
+	return vcombine_u8(vrshrn_n_u16(vrsraq_n_u16(lo,lo,8),8),vrshrn_n_u16(vrsraq_n_u16(hi,hi,8),8));
+}
+
+void premultiply_neon(uint32_t* dst, const uint32_t* src, uint32_t count)
+{
+	uint32_t i = 0;
+	for (; i+16 <= count; i+=16)
+	{
+		uint8x16x4_t p = vld4q_u8((const uint8_t*)(src+i));
+		p.val[0] = mul255_neon(p.val[0],p.val[3]);
+		p.val[1] = mul255_neon(p.val[1],p.val[3]);
+		p.val[2] = mul255_neon(p.val[2],p.val[3]);
+		vst4q_u8((uint8_t*)(dst+i),p);
+	}
+	premultiply_scalar(dst+i,src+i,count-i);
+}
+
+void convertARGB_neon(uint32_t* dst, const uint8_t* src, uint32_t count, bool opaque)
+{
+	const uint32x4_t alphamask = vdupq_n_u32(opaque ? 0xff000000 : 0);
+	uint32_t i = 0;
+	for (; i+4 <= count; i+=4)
+	{
+		uint32x4_t p = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(src+i*4)));
+		vst1q_u32(dst+i,vorrq_u32(p,alphamask));
+	}
+	convertARGB_scalar(dst+i,src+i*4,count-i,opaque);
+}
+
+void convertRGBA_neon(uint32_t* dst, const uint8_t* src, uint32_t count)
+{
+	uint32_t i = 0;
+	for (; i+16 <= count; i+=16)
+	{
+		uint8x16x4_t p = vld4q_u8(src+i*4);
+		uint8x16_t r = p.val[0];
+		p.val[0] = p.val[2];
+		p.val[2] = r;
+		vst4q_u8((uint8_t*)(dst+i),p);
+	}
+	convertRGBA_scalar(dst+i,src+i*4,count-i);
+}
+
+void convertRGB24_neon(uint32_t* dst, const uint8_t* src, uint32_t count)
+{
+	uint32_t i = 0;
+	for (; i+16 <= count; i+=16)
+	{
+		uint8x16x3_t p = vld3q_u8(src+i*3);
+		uint8x16x4_t res;
+		res.val[0] = p.val[2];
+		res.val[1] = p.val[1];
+		res.val[2] = p.val[0];
+		res.val[3] = vdupq_n_u8(0xff);
+		vst4q_u8((uint8_t*)(dst+i),res);
+	}
+	convertRGB24_scalar(dst+i,src+i*3,count-i);
+}
+
+inline uint8x16_t transformChannel_neon(uint8x16_t c, int16_t mult, int32x4_t add)
+{
+	int16x8_t lo = vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(c)));
+	int16x8_t hi = vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(c)));
+	int32x4_t v0 = vaddq_s32(vshrq_n_s32(vmull_n_s16(vget_low_s16(lo),mult),8),add);
+	int32x4_t v1 = vaddq_s32(vshrq_n_s32(vmull_n_s16(vget_high_s16(lo),mult),8),add);
+	int32x4_t v2 = vaddq_s32(vshrq_n_s32(vmull_n_s16(vget_low_s16(hi),mult),8),add);
+	int32x4_t v3 = vaddq_s32(vshrq_n_s32(vmull_n_s16(vget_high_s16(hi),mult),8),add);
+	// the saturating narrowing clamps the channels to 0..255
+	int16x8_t res0 = vcombine_s16(vqmovn_s32(v0),vqmovn_s32(v1));
+	int16x8_t res1 = vcombine_s16(vqmovn_s32(v2),vqmovn_s32(v3));
+	return vcombine_u8(vqmovun_s16(res0),vqmovun_s16(res1));
+}
+
+void colorTransform_neon(uint32_t* dst, const uint32_t* src, uint32_t count, const pixelColorTransform& ct)
+{
+	uint32_t i = 0;
+	for (; i+16 <= count; i+=16)
+	{
+		uint8x16x4_t p = vld4q_u8((const uint8_t*)(src+i));
+		for (int c = 0; c < 4; c++)
+			p.val[c] = transformChannel_neon(p.val[c],ct.mult[c],vdupq_n_s32(ct.add[c]));
+		vst4q_u8((uint8_t*)(dst+i),p);
+	}
+	colorTransform_scalar(dst+i,src+i,count-i,ct);
+}
+
+void blendOver_neon(uint32_t* dst, const uint32_t* src, uint32_t count)
+{
+	uint32_t i = 0;
+	for (; i+16 <= count; i+=16)
+	{
+		uint8x16x4_t s = vld4q_u8((const uint8_t*)(src+i));
+		uint8x16x4_t d = vld4q_u8((const uint8_t*)(dst+i));
+		uint8x16_t inv = vmvnq_u8(s.val[3]);
+		for (int c = 0; c < 4; c++)
+			d.val[c] = vqaddq_u8(s.val[c],mul255_neon(d.val[c],inv));
+		vst4q_u8((uint8_t*)(dst+i),d);
+	}
+	blendOver_scalar(dst+i,src+i,count-i);
+}
+
+const pixelKernelTable neonKernels =
+{
+	PIXELKERNEL_NEON, premultiply_neon, unpremultiply_scalar, convertARGB_neon, convertRGBA_neon,
+	convertRGB24_neon, convertRGB15_scalar, colorTransform_neon, blendOver_neon,
+	boxBlurRow_scalar, boxBlurColumns_scalar
+};
+#endif
+
+const pixelKernelTable* kernelsForLevel(PIXELKERNEL_LEVEL level)
+{
+	switch (level)
+	{
+		case PIXELKERNEL_SCALAR:
+			return &scalarKernels;
+#ifdef PIXELKERNELS_X86
+		case PIXELKERNEL_SSE2:
+			return __builtin_cpu_supports("sse2") ? &sse2Kernels : nullptr;
+		case PIXELKERNEL_AVX2:
+			return __builtin_cpu_supports("avx2") ? &avx2Kernels : nullptr;
+#endif
+#ifdef PIXELKERNELS_NEON
+		case PIXELKERNEL_NEON:
+			return &neonKernels;
+#endif
+		default:
+			return nullptr;
+	}
+}
+
+const pixelKernelTable* detectKernels()
+{
+#ifdef PIXELKERNELS_X86
+	__builtin_cpu_init();
+#endif
+	const PIXELKERNEL_LEVEL preferred[] = { PIXELKERNEL_AVX2, PIXELKERNEL_NEON, PIXELKERNEL_SSE2 };
+	for (PIXELKERNEL_LEVEL level : preferred)
+	{
+		const pixelKernelTable* k = kernelsForLevel(level);
+		if (k)
+			return k;
+	}
+	return &scalarKernels;
+}
+
+std::atomic<const pixelKernelTable*> activeKernels(nullptr);
+
+inline const pixelKernelTable* kernels()
+{
+	const pixelKernelTable* k = activeKernels.load(std::memory_order_acquire);
+	if (!k)
+	{
+		// detection is idempotent, so concurrent first calls don't need to be serialized
+		k = detectKernels();
+		activeKernels.store(k,std::memory_order_release);
+	}
+	return k;
+}
+
+}
+
+pixelColorTransform::pixelColorTransform(double redMultiplier, double greenMultiplier, double blueMultiplier, double alphaMultiplier,
+					 double redOffset, double greenOffset, double blueOffset, double alphaOffset)
+{
+	const double multipliers[4] = { blueMultiplier, greenMultiplier, redMultiplier, alphaMultiplier };
+	const double offsets[4] = { blueOffset, greenOffset, redOffset, alphaOffset };
+	for (int i = 0; i < 4; i++)
+	{
+		// the vectorized versions use 16 bit multipliers
+		mult[i] = std::isnan(multipliers[i]) ? 0 : int32_t(std::max(-32768.0,std::min(32767.0,std::round(multipliers[i]*256.0))));
+		add[i] = std::isnan(offsets[i]) ? 0 : int32_t(std::max(-65536.0,std::min(65536.0,std::round(offsets[i]))));
+	}
+}
+
+PIXELKERNEL_LEVEL lightspark::getPixelKernelLevel()
+{
+	return kernels()->level;
+}
+
+const char* lightspark::getPixelKernelLevelName(PIXELKERNEL_LEVEL level)
+{
+	switch (level)
+	{
+		case PIXELKERNEL_SCALAR:
+			return "scalar";
+		case PIXELKERNEL_SSE2:
+			return "sse2";
+		case PIXELKERNEL_AVX2:
+			return "avx2";
+		case PIXELKERNEL_NEON:
+			return "neon";
+	}
+	return "unknown";
+}
+
+bool lightspark::setPixelKernelLevel(PIXELKERNEL_LEVEL level)
+{
+#ifdef PIXELKERNELS_X86
+	__builtin_cpu_init();
+#endif
+	const pixelKernelTable* k = kernelsForLevel(level);
+	if (!k)
+		return false;
+	activeKernels.store(k,std::memory_order_release);
+	return true;
+}
+
+void lightspark::pixelPremultiply(uint32_t* dst, const uint32_t* src, uint32_t count)
+{
+	kernels()->premultiply(dst,src,count);
+}
+
+void lightspark::pixelUnpremultiply(uint32_t* dst, const uint32_t* src, uint32_t count)
+{
+	kernels()->unpremultiply(dst,src,count);
+}
+
+void lightspark::pixelConvertARGBToNative(uint32_t* dst, const uint8_t* src, uint32_t count, bool opaque)
+{
+	kernels()->convertARGB(dst,src,count,opaque);
+}
+
+void lightspark::pixelConvertRGBAToNative(uint32_t* dst, const uint8_t* src, uint32_t count)
+{
+	kernels()->convertRGBA(dst,src,count);
+}
+
+void lightspark::pixelConvertRGB24ToNative(uint32_t* dst, const uint8_t* src, uint32_t count)
+{
+	kernels()->convertRGB24(dst,src,count);
+}
+
+void lightspark::pixelConvertRGB15ToNative(uint32_t* dst, const uint8_t* src, uint32_t count)
+{
+	kernels()->convertRGB15(dst,src,count);
+}
+
+void lightspark::pixelColorTransformStraight(uint32_t* dst, const uint32_t* src, uint32_t count, const pixelColorTransform& ct)
+{
+	kernels()->colorTransform(dst,src,count,ct);
+}
+
+void lightspark::pixelColorTransformPremultiplied(uint32_t* dst, const uint32_t* src, uint32_t count, const pixelColorTransform& ct)
+{
+	const pixelKernelTable* k = kernels();
+	// work in small blocks, so the intermediate straight pixels stay in the cache
+	uint32_t block[256];
+	for (uint32_t i = 0; i < count; i += 256)
+	{
+		uint32_t n = std::min(256u,count-i);
+		k->unpremultiply(block,src+i,n);
+		k->colorTransform(block,block,n,ct);
+		k->premultiply(dst+i,block,n);
+	}
+}
+
+void lightspark::pixelBlendOver(uint32_t* dst, const uint32_t* src, uint32_t count)
+{
+	kernels()->blendOver(dst,src,count);
+}
+
+void lightspark::pixelBoxBlurRow(uint32_t* dst, const uint32_t* src, uint32_t count, uint32_t radius)
+{
+	kernels()->boxBlurRow(dst,src,count,radius);
+}
+
+void lightspark::pixelBoxBlurColumns(uint32_t* dst, const uint32_t* src, uint32_t stride, uint32_t count, uint32_t rows, uint32_t radius, int32_t* sums)
+{
+	kernels()->boxBlurColumns(dst,src,stride,count,rows,radius,sums);
+}
@@ -0,0 +1,82 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#ifndef PLATFORMS_PIXELKERNELS_H
+#define PLATFORMS_PIXELKERNELS_H 1
+
+#include <cinttypes>
+
+namespace lightspark
+{
+
+/*
+ * Bulk pixel conversions used by the bitmap and rendering code. All 32 bit
+ * pixels are in cairo's native-endian ARGB32 layout (alpha in the highest
+ * byte). Each kernel has a scalar version and vectorized versions, the best
+ * one supported by the cpu is selected the first time a kernel is called.
+ * Unless noted otherwise dst may be the same buffer as src
+ */
+enum PIXELKERNEL_LEVEL { PIXELKERNEL_SCALAR=0, PIXELKERNEL_SSE2, PIXELKERNEL_AVX2, PIXELKERNEL_NEON };
+
+/*
+ * Multipliers are 8.8 fixed point, offsets are added after the multiplication.
+ * The entries are ordered like the bytes of a little endian pixel: blue, green, red, alpha
+ */
+struct pixelColorTransform
+{
+	int32_t mult[4];
+	int32_t add[4];
+	pixelColorTransform(double redMultiplier, double greenMultiplier, double blueMultiplier, double alphaMultiplier,
+			    double redOffset, double greenOffset, double blueOffset, double alphaOffset);
+};
+
+PIXELKERNEL_LEVEL getPixelKernelLevel();
+const char* getPixelKernelLevelName(PIXELKERNEL_LEVEL level);
+// returns false if the level is not supported by this build or cpu
+bool setPixelKernelLevel(PIXELKERNEL_LEVEL level);
+
+void pixelPremultiply(uint32_t* dst, const uint32_t* src, uint32_t count);
+void pixelUnpremultiply(uint32_t* dst, const uint32_t* src, uint32_t count);
+// converts from A,R,G,B bytes, optionally ignoring the alpha byte
+void pixelConvertARGBToNative(uint32_t* dst, const uint8_t* src, uint32_t count, bool opaque);
+// converts from R,G,B,A bytes (i.e. decoded PNGs)
+void pixelConvertRGBAToNative(uint32_t* dst, const uint8_t* src, uint32_t count);
+// converts from R,G,B bytes to opaque pixels, dst must not overlap src
+void pixelConvertRGB24ToNative(uint32_t* dst, const uint8_t* src, uint32_t count);
+// converts from big endian 16 bit 0RRRRRGGGGGBBBBB to opaque pixels, dst must not overlap src
+void pixelConvertRGB15ToNative(uint32_t* dst, const uint8_t* src, uint32_t count);
+// applies the transformation to straight (not premultiplied) pixels
+void pixelColorTransformStraight(uint32_t* dst, const uint32_t* src, uint32_t count, const pixelColorTransform& ct);
+// applies the transformation to premultiplied pixels, the result is premultiplied again
+void pixelColorTransformPremultiplied(uint32_t* dst, const uint32_t* src, uint32_t count, const pixelColorTransform& ct);
+// composites premultiplied src over dst (cairo's OVER operator), dst must not overlap src
+void pixelBlendOver(uint32_t* dst, const uint32_t* src, uint32_t count);
+/*
+ * Box blurs with a window of 2*radius+1 pixels, the window is clamped at the
+ * edges of the image. dst must not overlap src.
+ * pixelBoxBlurRow blurs count pixels of a single row.
+ * pixelBoxBlurColumns blurs the first count pixels of rows rows that are
+ * stride pixels apart, sums must have room for 4*count entries. Pixels that
+ * end up with an alpha of 0 are cleared
+ */
+void pixelBoxBlurRow(uint32_t* dst, const uint32_t* src, uint32_t count, uint32_t radius);
+void pixelBoxBlurColumns(uint32_t* dst, const uint32_t* src, uint32_t stride, uint32_t count, uint32_t rows, uint32_t radius, int32_t* sums);
+
+};
+#endif /* PLATFORMS_PIXELKERNELS_H */
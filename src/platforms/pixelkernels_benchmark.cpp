@@ -0,0 +1,143 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+/*
+ * Micro benchmark of the pixel kernels. Every kernel level supported by the
+ * cpu is timed on the same random input and its output is compared with the
+ * scalar version.
+ * Usage: pixelkernels_benchmark [pixels] [iterations]
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "platforms/pixelkernels.h"
+
+using namespace std;
+using namespace lightspark;
+
+// the blurs treat the pixels as an image of this width, it is not a multiple of the vector sizes to cover the remainders
+#define BLUR_WIDTH 1021
+#define BLUR_RADIUS 7
+
+struct kernelResult
+{
+	vector<uint32_t> output;
+	double mpixelspersecond;
+};
+
+template<class F>
+static kernelResult runKernel(uint32_t pixels, uint32_t iterations, const vector<uint32_t>& init, F kernel)
+{
+	kernelResult res;
+	res.output = init;
+	// first call is not timed, it also provides the output used for comparison
+	kernel(res.output.data());
+	vector<uint32_t> work = init;
+	auto start = chrono::steady_clock::now();
+	for (uint32_t i = 0; i < iterations; i++)
+		kernel(work.data());
+	double seconds = chrono::duration<double>(chrono::steady_clock::now()-start).count();
+	res.mpixelspersecond = seconds > 0 ? double(pixels)*iterations/seconds/1e6 : 0;
+	return res;
+}
+
+int main(int argc, char* argv[])
+{
+	uint32_t pixels = argc > 1 ? atoi(argv[1]) : 1024*1024;
+	uint32_t iterations = argc > 2 ? atoi(argv[2]) : 50;
+	if (pixels == 0 || iterations == 0)
+	{
+		cerr << "usage: " << argv[0] << " [pixels] [iterations]" << endl;
+		return 1;
+	}
+
+	mt19937 rng(42);
+	vector<uint8_t> bytes(pixels*4);
+	for (auto& b : bytes)
+		b = rng();
+	vector<uint32_t> straight(pixels);
+	memcpy(straight.data(),bytes.data(),pixels*4);
+	// make sure the fast paths for opaque and transparent pixels are covered
+	for (uint32_t i = 0; i < pixels; i += 7)
+		straight[i] |= 0xff000000;
+	for (uint32_t i = 3; i < pixels; i += 11)
+		straight[i] &= 0x00ffffff;
+	vector<uint32_t> premultiplied(pixels);
+	setPixelKernelLevel(PIXELKERNEL_SCALAR);
+	pixelPremultiply(premultiplied.data(),straight.data(),pixels);
+	pixelColorTransform ct(0.8,1.2,0.5,0.75,10,-20,30,0);
+	vector<uint32_t> destination(pixels,0x80402010);
+
+	struct benchmark
+	{
+		const char* name;
+		const vector<uint32_t>* init;
+		void (*kernel)(uint32_t* data, const vector<uint8_t>& bytes, const vector<uint32_t>& src, const pixelColorTransform& ct, uint32_t pixels);
+	};
+	const benchmark benchmarks[] =
+	{
+		{ "premultiply", &straight, [](uint32_t* d, const vector<uint8_t>&, const vector<uint32_t>&, const pixelColorTransform&, uint32_t n) { pixelPremultiply(d,d,n); } },
+		{ "unpremultiply", &premultiplied, [](uint32_t* d, const vector<uint8_t>&, const vector<uint32_t>&, const pixelColorTransform&, uint32_t n) { pixelUnpremultiply(d,d,n); } },
+		{ "argb to native", &straight, [](uint32_t* d, const vector<uint8_t>& b, const vector<uint32_t>&, const pixelColorTransform&, uint32_t n) { pixelConvertARGBToNative(d,b.data(),n,false); } },
+		{ "rgba to native", &straight, [](uint32_t* d, const vector<uint8_t>& b, const vector<uint32_t>&, const pixelColorTransform&, uint32_t n) { pixelConvertRGBAToNative(d,b.data(),n); } },
+		{ "rgb24 to native", &straight, [](uint32_t* d, const vector<uint8_t>& b, const vector<uint32_t>&, const pixelColorTransform&, uint32_t n) { pixelConvertRGB24ToNative(d,b.data(),n); } },
+		{ "rgb15 to native", &straight, [](uint32_t* d, const vector<uint8_t>& b, const vector<uint32_t>&, const pixelColorTransform&, uint32_t n) { pixelConvertRGB15ToNative(d,b.data(),n); } },
+		{ "color transform", &straight, [](uint32_t* d, const vector<uint8_t>&, const vector<uint32_t>&, const pixelColorTransform& c, uint32_t n) { pixelColorTransformStraight(d,d,n,c); } },
+		{ "color transform premultiplied", &premultiplied, [](uint32_t* d, const vector<uint8_t>&, const vector<uint32_t>&, const pixelColorTransform& c, uint32_t n) { pixelColorTransformPremultiplied(d,d,n,c); } },
+		{ "blend over", &destination, [](uint32_t* d, const vector<uint8_t>&, const vector<uint32_t>& s, const pixelColorTransform&, uint32_t n) { pixelBlendOver(d,s.data(),n); } },
+		{ "box blur rows", &destination, [](uint32_t* d, const vector<uint8_t>&, const vector<uint32_t>& s, const pixelColorTransform&, uint32_t n)
+			{
+				for (uint32_t i = 0; i+BLUR_WIDTH <= n; i += BLUR_WIDTH)
+					pixelBoxBlurRow(d+i,s.data()+i,BLUR_WIDTH,BLUR_RADIUS);
+			} },
+		{ "box blur columns", &destination, [](uint32_t* d, const vector<uint8_t>&, const vector<uint32_t>& s, const pixelColorTransform&, uint32_t n)
+			{
+				static vector<int32_t> sums(BLUR_WIDTH*4);
+				pixelBoxBlurColumns(d,s.data(),BLUR_WIDTH,BLUR_WIDTH,n/BLUR_WIDTH,BLUR_RADIUS,sums.data());
+			} },
+	};
+
+	bool failed = false;
+	cout << "kernel,level,mpixels/s,speedup" << endl;
+	for (const benchmark& b : benchmarks)
+	{
+		kernelResult scalar;
+		for (int l = PIXELKERNEL_SCALAR; l <= PIXELKERNEL_NEON; l++)
+		{
+			PIXELKERNEL_LEVEL level = PIXELKERNEL_LEVEL(l);
+			if (!setPixelKernelLevel(level))
+				continue;
+			kernelResult res = runKernel(pixels,iterations,*b.init,[&](uint32_t* d) { b.kernel(d,bytes,premultiplied,ct,pixels); });
+			if (level == PIXELKERNEL_SCALAR)
+				scalar = res;
+			cout << b.name << "," << getPixelKernelLevelName(level) << "," << res.mpixelspersecond << ","
+			     << (scalar.mpixelspersecond > 0 ? res.mpixelspersecond/scalar.mpixelspersecond : 0) << endl;
+			if (res.output != scalar.output)
+			{
+				cerr << b.name << ": " << getPixelKernelLevelName(level) << " output differs from scalar output" << endl;
+				failed = true;
+			}
+		}
+	}
+	return failed ? 1 : 0;
+}
@@ -73,6 +73,7 @@
 #include <limits>
 #include <cmath>
 #include "swf.h"
+#include "cyclecollector.h"
 #include "scripting/class.h"
 #include "exceptions.h"
 #include "scripting/abc.h"
@@ -554,7 +555,7 @@ ABCContext::ABCContext(_R<RootMovieClip> r, istream& in, ABCVm* vm):scriptsdecla
 	instances(reporter_allocator<instance_info>(vm->vmDataMemory)),
 	classes(reporter_allocator<class_info>(vm->vmDataMemory)),
 	scripts(reporter_allocator<script_info>(vm->vmDataMemory)),
-	method_body(reporter_allocator<method_body_info>(vm->vmDataMemory))
+	method_body(reporter_allocator<method_body_info>(vm->vmDataMemory)),preloadcache(nullptr)
 {
 	in >> minor >> major;
 	LOG(LOG_CALLS,"ABCVm version " << major << '.' << minor);
@@ -701,6 +702,8 @@ ABCContext::ABCContext(_R<RootMovieClip> r, istream& in, ABCVm* vm):scriptsdecla
 	}
 
 	hasRunScriptInit.resize(scripts.size(),false);
+	if (root->getSystemState()->usePreloadCache)
+		preloadcache = new ABCPreloadCache(this);
 #ifdef PROFILING_SUPPORT
 	root->getSystemState()->contextes.push_back(this);
 #endif
@@ -708,6 +711,36 @@ ABCContext::ABCContext(_R<RootMovieClip> r, istream& in, ABCVm* vm):scriptsdecla
 
 ABCContext::~ABCContext()
 {
+	if (preloadcache)
+	{
+		preloadcache->save();
+		delete preloadcache;
+	}
+}
+
+void ABCContext::dumpTieringProfile(ostream& f) const
+{
+	const char* tiernames[] = { "generic", "specialized", "final" };
+	SystemState* sys = root->getSystemState();
+	for(uint32_t i=0;i<method_body.size();i++)
+	{
+		const method_body_info& body = method_body[i];
+		if (body.hit_count == 0)
+			continue;
+		f << sys->getStringFromUniqueId(body.functionname) << ';' << body.hit_count << ';' << tiernames[body.tier]
+		  << ';' << body.promotions << ';' << body.deoptimizations
+		  << ';' << body.inlinecachehits << ';' << body.inlinecachemisses << ';';
+		for (uint32_t j = 0; j < body.argumenttypes.size(); j++)
+		{
+			if (j)
+				f << ',';
+			if (body.argumenttypes[j].type)
+				f << body.argumenttypes[j].type->getQualifiedClassName();
+			else if (body.argumenttypes[j].polymorphic)
+				f << '*';
+		}
+		f << endl;
+	}
 }
 
 #ifdef PROFILING_SUPPORT
@@ -790,6 +823,26 @@ void ABCVm::finalize()
 
 ABCVm::~ABCVm()
 {
+	uint64_t inlinecachehits=0;
+	uint64_t inlinecachemisses=0;
+	for(size_t i=0;i<contexts.size();++i)
+	{
+		for(size_t j=0;j<contexts[i]->method_body.size();++j)
+		{
+			inlinecachehits += contexts[i]->method_body[j].inlinecachehits;
+			inlinecachemisses += contexts[i]->method_body[j].inlinecachemisses;
+		}
+	}
+	if (inlinecachehits || inlinecachemisses)
+		LOG(LOG_INFO,"callproperty inline caches: "<<inlinecachehits<<" hits, "<<inlinecachemisses<<" misses");
+	if(m_sys->tieringProfileOutput.numBytes())
+	{
+		ofstream f(m_sys->tieringProfileOutput.raw_buf());
+		f << "function;calls;tier;promotions;deoptimizations;inlinecachehits;inlinecachemisses;argumenttypes" << endl;
+		for(size_t i=0;i<contexts.size();++i)
+			contexts[i]->dumpTieringProfile(f);
+		f.close();
+	}
 	std::unordered_set<std::unordered_set<uint32_t>*> overriddenmethods;
 	for(size_t i=0;i<contexts.size();++i)
 	{
@@ -1138,6 +1191,8 @@ void ABCVm::handleEvent(std::pair<_NR<EventDispatcher>, _R<Event> > e)
 				// DisplayObjects that are removed from the display list keep their Parent set until all removedFromStage events are handled
 				// see http://www.senocular.com/flash/tutorials/orderofoperations/#ObjectDestruction
 				m_sys->resetParentList();
+				if (m_sys->cycleCollector)
+					m_sys->cycleCollector->collect();
 				{
 					Locker l(event_queue_mutex);
 					while (!idleevents_queue.empty())
@@ -1153,6 +1208,8 @@ void ABCVm::handleEvent(std::pair<_NR<EventDispatcher>, _R<Event> > e)
 				}
 				break;
 			}
+			case SYNC:
+				break;
 			case FLUSH_INVALIDATION_QUEUE:
 			{
 				//Flush the invalidation queue
@@ -1672,7 +1729,10 @@ int ABCVm::Run(void* d)
 		Chronometer chronometer;
 
 		th->handleFrontEvent();
-		profile->accountTime(chronometer.checkpoint());
+		uint32_t elapsed=chronometer.checkpoint();
+		profile->accountTime(elapsed);
+		if(th->m_sys->benchmark)
+			th->m_sys->benchmark->accountTime(FrameBenchmark::SCRIPT,elapsed);
 #ifdef MEMORY_USAGE_PROFILING
 		if((snapshotCount%100)==0)
 			th->m_sys->saveMemoryUsageInformation(memoryProfile, snapshotCount);
@@ -30,6 +30,7 @@
 #include "swf.h"
 #include "scripting/abcutils.h"
 #include "scripting/abctypes.h"
+#include "scripting/abc_preloadcache.h"
 
 #ifdef LLVM_ENABLED
 namespace llvm {
@@ -187,11 +188,12 @@ enum OPERANDTYPES {
 	OP_FALSE=0x0a, OP_TRUE=0x0b, OP_NULL=0x0c, OP_NAN=0x0d,
 	OP_LOCAL=0x10, OP_BYTE=0x20, OP_SHORT=0x30, OP_CACHED_CONSTANT=0x40, OP_CACHED_SLOT=0x80};
 
+#define ABC_OP_POLYMORPHIC 0x0800 // polycache1 is used instead of cacheobj1/cacheobj3
 #define ABC_OP_FORCEINT 0x1000 // forces the result of the arithmetic operation to be coerced to int
 #define ABC_OP_CACHED 0x2000
 #define ABC_OP_NOTCACHEABLE 0x4000
 #define ABC_OP_COERCED 0x8000 //indicates that the method call doesn't have to coerce the arguments to the expected type
-#define ABC_OP_BITMASK_USED 0xf000 // indicates all bits that are occupied by the flags
+#define ABC_OP_BITMASK_USED 0xf800 // indicates all bits that are occupied by the flags
 
 struct typed_opcode_handler
 {
@@ -231,6 +233,8 @@ public:
 	std::vector<script_info, reporter_allocator<script_info>> scripts;
 	u30 method_body_count;
 	std::vector<method_body_info, reporter_allocator<method_body_info>> method_body;
+	//Persistent preload analysis of the method bodies, nullptr if disabled
+	ABCPreloadCache* preloadcache;
 	//Base for namespaces in this context
 	uint32_t namespaceBaseId;
 
@@ -300,6 +304,8 @@ public:
 	void exec(bool lazy);
 
 	bool isinstance(ASObject* obj, multiname* name);
+	// writes call counters and tiers of all called methods, see SyntheticFunction::updateTier
+	void dumpTieringProfile(std::ostream& f) const;
 #ifdef PROFILING_SUPPORT
 	void dumpProfilingData(std::ostream& f) const;
 #endif
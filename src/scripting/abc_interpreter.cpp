@@ -3090,51 +3090,23 @@ void removeInitializeLocalToConstant(preloadstate& state,int32_t value)
 	}
 }
 
-void ABCVm::preloadFunction(SyntheticFunction* function, ASWorker* wrk)
+// first pass of preloadFunction:
+// - store all jump target points
+// - detect kill opcodes that can be skipped and simple getter/setter functions
+// the result only depends on the abc data, so it is stored in the preload cache
+void preloadFunctionFirstPass(preloadstate& state, preloadanalysis& analysis)
 {
-	method_info* mi=function->mi;
-
+	method_info* mi=state.mi;
+	ASWorker* wrk=state.worker;
 	const int code_len=mi->body->code.size();
-	preloadstate state(function,wrk);
-	std::map<int32_t,int32_t> jumppositions;
-	std::map<int32_t,int32_t> jumpstartpositions;
-	std::map<int32_t,int32_t> switchpositions;
-	std::map<int32_t,int32_t> switchstartpositions;
-	
 	// this is used in a simple mechanism to detect if kill opcodes can be skipped
 	// we just check if no getlocal opcode occurs after the kill
-	std::set<uint32_t> skippablekills;
+	std::set<uint32_t>& skippablekills=analysis.skippablekills;
 
-	// first pass:
-	// - store all jump target points
 	std::multimap<int32_t,int32_t> jumppoints;
 	std::set<int32_t> exceptionjumptargets;
 	std::map<int32_t,int32_t> unreachabletargets;
 
-	for (int32_t i = 0; i < (int32_t)(mi->numArgs()-mi->numOptions())+1; i++)
-	{
-		state.unchangedlocals.insert(i);
-	}
-	if (!function->getMethodInfo()->returnType)
-		function->checkParamTypes();
-	state.localtypes.push_back(function->inClass);
-	state.defaultlocaltypes.push_back(function->inClass);
-	state.defaultlocaltypescacheable.push_back(true);
-	for (uint32_t i = 1; i < mi->body->getReturnValuePos(); i++)
-	{
-		state.localtypes.push_back(nullptr);
-		state.defaultlocaltypes.push_back(nullptr);
-		state.defaultlocaltypescacheable.push_back(true);
-		if (mi->needsArgs() && i == mi->numArgs()+1) // don't cache argument array
-			state.defaultlocaltypescacheable[i]=false;
-		if (i > 0 && i <= mi->paramTypes.size() && dynamic_cast<const Class_base*>(mi->paramTypes[i-1]))
-			state.defaultlocaltypes[i]= (Class_base*)mi->paramTypes[i-1]; // cache types of arguments
-	}
-	for (uint32_t i = state.mi->numArgs()+1; i < state.mi->body->local_count; i++)
-	{
-		state.canlocalinitialize.push_back(true);
-	}
-
 	auto itex = mi->body->exceptions.begin();
 	while (itex != mi->body->exceptions.end())
 	{
@@ -3249,31 +3221,31 @@ void ABCVm::preloadFunction(SyntheticFunction* function, ASWorker* wrk)
 			case 0x2c://pushstring
 			{
 				uint32_t value = codejumps.readu30();
-				constantsstack.push_back(*function->mi->context->getConstantAtom(OP_STRING,value));
+				constantsstack.push_back(*mi->context->getConstantAtom(OP_STRING,value));
 				break;
 			}
 			case 0x2d://pushint
 			{
 				uint32_t value = codejumps.readu30();
-				constantsstack.push_back(*function->mi->context->getConstantAtom(OP_INTEGER,value));
+				constantsstack.push_back(*mi->context->getConstantAtom(OP_INTEGER,value));
 				break;
 			}
 			case 0x2e://pushuint
 			{
 				uint32_t value = codejumps.readu30();
-				constantsstack.push_back(*function->mi->context->getConstantAtom(OP_UINTEGER,value));
+				constantsstack.push_back(*mi->context->getConstantAtom(OP_UINTEGER,value));
 				break;
 			}
 			case 0x2f://pushdouble
 			{
 				uint32_t value = codejumps.readu30();
-				constantsstack.push_back(*function->mi->context->getConstantAtom(OP_DOUBLE,value));
+				constantsstack.push_back(*mi->context->getConstantAtom(OP_DOUBLE,value));
 				break;
 			}
 			case 0x31://pushnamespace
 			{
 				uint32_t value = codejumps.readu30();
-				constantsstack.push_back(*function->mi->context->getConstantAtom(OP_NAMESPACE,value));
+				constantsstack.push_back(*mi->context->getConstantAtom(OP_NAMESPACE,value));
 				break;
 			}
 			case 0x10://jump
@@ -3538,6 +3510,65 @@ void ABCVm::preloadFunction(SyntheticFunction* function, ASWorker* wrk)
 		it++;
 	}
 #endif
+	analysis.simplegetter = simple_getter_opcode_pos != UINT32_MAX;
+	analysis.simplesetter = simple_setter_opcode_pos != UINT32_MAX;
+	analysis.jumptargets = state.jumptargets;
+}
+
+void ABCVm::preloadFunction(SyntheticFunction* function, ASWorker* wrk)
+{
+	method_info* mi=function->mi;
+
+	const int code_len=mi->body->code.size();
+	preloadstate state(function,wrk);
+	std::map<int32_t,int32_t> jumppositions;
+	std::map<int32_t,int32_t> jumpstartpositions;
+	std::map<int32_t,int32_t> switchpositions;
+	std::map<int32_t,int32_t> switchstartpositions;
+	
+	preloadanalysis analysis;
+	uint32_t bodyindex = mi->body-mi->context->method_body.data();
+
+	for (int32_t i = 0; i < (int32_t)(mi->numArgs()-mi->numOptions())+1; i++)
+	{
+		state.unchangedlocals.insert(i);
+	}
+	if (!function->getMethodInfo()->returnType)
+		function->checkParamTypes();
+	state.localtypes.push_back(function->inClass);
+	state.defaultlocaltypes.push_back(function->inClass);
+	state.defaultlocaltypescacheable.push_back(true);
+	for (uint32_t i = 1; i < mi->body->getReturnValuePos(); i++)
+	{
+		state.localtypes.push_back(nullptr);
+		state.defaultlocaltypes.push_back(nullptr);
+		state.defaultlocaltypescacheable.push_back(true);
+		if (mi->needsArgs() && i == mi->numArgs()+1) // don't cache argument array
+			state.defaultlocaltypescacheable[i]=false;
+		if (i > 0 && i <= mi->paramTypes.size() && dynamic_cast<const Class_base*>(mi->paramTypes[i-1]))
+			state.defaultlocaltypes[i]= (Class_base*)mi->paramTypes[i-1]; // cache types of arguments
+		else if (mi->body->tier == method_body_info::TIER_SPECIALIZED && i <= mi->body->argumenttypes.size())
+			state.defaultlocaltypes[i]= mi->body->argumenttypes[i-1].type; // types of untyped arguments of hot methods, checked on every call in SyntheticFunction::call
+	}
+	for (uint32_t i = state.mi->numArgs()+1; i < state.mi->body->local_count; i++)
+	{
+		state.canlocalinitialize.push_back(true);
+	}
+
+	if (!mi->context->preloadcache || !mi->context->preloadcache->get(bodyindex,analysis))
+	{
+		uint64_t starttime = mi->context->preloadcache ? compat_get_thread_cputime_us() : 0;
+		preloadFunctionFirstPass(state,analysis);
+		if (mi->context->preloadcache)
+		{
+			analysis.firstpasstime = compat_get_thread_cputime_us()-starttime;
+			mi->context->preloadcache->put(bodyindex,analysis);
+		}
+	}
+	else
+		state.jumptargets = analysis.jumptargets;
+	std::set<uint32_t>& skippablekills=analysis.skippablekills;
+	uint8_t opcode=0;
 	// second pass:
 	// - compute types of the locals and detect if they don't change during execution
 #ifdef ENABLE_OPTIMIZATION
@@ -4539,7 +4570,7 @@ void ABCVm::preloadFunction(SyntheticFunction* function, ASWorker* wrk)
 							}
 						}
 					}
-					if ((simple_getter_opcode_pos != UINT32_MAX) // function is simple getter
+					if (analysis.simplegetter // function is simple getter
 							&& function->inClass->isFinal // TODO also enable optimization for classes where it is guarranteed that the method is not overridden in derived classes
 							&& function->inClass->getInterfaces().empty()) // class doesn't implement any interfaces
 					{
@@ -4782,7 +4813,7 @@ void ABCVm::preloadFunction(SyntheticFunction* function, ASWorker* wrk)
 										}
 										bool getslotisvalue = state.preloadedcode.size() && state.preloadedcode.at(state.preloadedcode.size()-1).operator_start==ABC_OP_OPTIMZED_GETSLOT;
 										setupInstructionTwoArgumentsNoResult(state,operator_start,opcode,code);
-										if (getslotisvalue && state.preloadedcode.size() > 1 && v->slotid < ABC_OP_BITMASK_USED
+										if (getslotisvalue && state.preloadedcode.size() > 1 && ((v->slotid-1) & ABC_OP_BITMASK_USED)==0
 											&& state.preloadedcode.at(state.preloadedcode.size()-1).pcode.func == abc_setslotNoCoerce_local_local
 											&& state.preloadedcode.at(state.preloadedcode.size()-1).pcode.local_pos1 <0xffff // only optimize if local_pos1 fits in uint16_t
 											&& state.preloadedcode.at(state.preloadedcode.size()-2).operator_setslot != UINT32_MAX)
@@ -4830,7 +4861,7 @@ void ABCVm::preloadFunction(SyntheticFunction* function, ASWorker* wrk)
 							}
 							state.preloadedcode.at(state.preloadedcode.size()-1).pcode.cachedmultiname2 =name;
 							state.preloadedcode.at(state.preloadedcode.size()-1).pcode.local3.pos = opcode; // use local3.pos as indicator for setproperty/initproperty
-							if ((simple_setter_opcode_pos != UINT32_MAX) // function is simple setter
+							if (analysis.simplesetter // function is simple setter
 									&& function->inClass->isFinal // TODO also enable optimization for classes where it is guarranteed that the method is not overridden in derived classes
 									&& function->inClass->getInterfaces().empty()) // class doesn't implement any interfaces
 							{
@@ -4915,7 +4946,7 @@ void ABCVm::preloadFunction(SyntheticFunction* function, ASWorker* wrk)
 							state.preloadedcode.push_back((uint32_t)ABC_OP_OPTIMZED_SETPROPERTY_STATICNAME_SIMPLE);
 							state.preloadedcode.at(state.preloadedcode.size()-1).pcode.cachedmultiname2 =name;
 							state.preloadedcode.at(state.preloadedcode.size()-1).pcode.local3.pos = opcode; // use local3.pos as indicator for setproperty/initproperty
-							if ((simple_setter_opcode_pos != UINT32_MAX) // function is simple setter
+							if (analysis.simplesetter // function is simple setter
 									&& function->inClass->isFinal // TODO also enable optimization for classes where it is guarranteed that the method is not overridden in derived classes
 									&& function->inClass->getInterfaces().empty()) // class doesn't implement any interfaces
 							{
@@ -1154,49 +1154,83 @@ void ABCVm::abc_construct_local_localresult(call_context* context)
 	ASATOM_DECREF(oldres);
 	++(context->exec_pos);
 }
+FORCE_INLINE void callprop_cached(call_context* context,asAtom& ret,asAtom& obj,asAtom* args, uint32_t argsnum,multiname* name,ASObject* func,bool refcounted, bool needreturn, bool coercearguments)
+{
+	asAtom o = asAtomHandler::fromObjectNoPrimitive(func);
+	LOG_CALL( "callProperty from cache:"<<*name<<" "<<asAtomHandler::toDebugString(obj)<<" "<<asAtomHandler::toDebugString(o)<<" "<<coercearguments);
+	if(asAtomHandler::is<IFunction>(o))
+		asAtomHandler::callFunction(o,context->worker,ret,obj,args,argsnum,refcounted,needreturn && coercearguments,coercearguments);
+	else if(asAtomHandler::is<Class_base>(o))
+	{
+		asAtomHandler::as<Class_base>(o)->generator(context->worker,ret,args,argsnum);
+		if (refcounted)
+		{
+			for(uint32_t i=0;i<argsnum;i++)
+				ASATOM_DECREF(args[i]);
+			ASATOM_DECREF(obj);
+		}
+	}
+	else if(asAtomHandler::is<RegExp>(o))
+		RegExp::exec(ret,context->worker,o,args,argsnum);
+	else
+	{
+		LOG(LOG_ERROR,"trying to call an object as a function:"<<asAtomHandler::toDebugString(o) <<" on "<<asAtomHandler::toDebugString(obj));
+		throwError<TypeError>(kCallOfNonFunctionError, "Object");
+	}
+	if (needreturn && asAtomHandler::isInvalid(ret))
+		ret = asAtomHandler::undefinedAtom;
+	LOG_CALL("End of calling cached property "<<*name<<" "<<asAtomHandler::toDebugString(ret));
+}
 FORCE_INLINE void callprop_intern(call_context* context,asAtom& ret,asAtom& obj,asAtom* args, uint32_t argsnum,multiname* name,preloadedcodedata* cacheptr,bool refcounted, bool needreturn, bool coercearguments)
 {
 	assert(context->worker==getWorker());
-	if ((cacheptr->local2.flags&ABC_OP_CACHED) == ABC_OP_CACHED)
+	if ((cacheptr->local2.flags&ABC_OP_POLYMORPHIC) == ABC_OP_POLYMORPHIC)
 	{
-		if (asAtomHandler::isObject(obj) &&
-				((asAtomHandler::is<Class_base>(obj) && asAtomHandler::getObjectNoCheck(obj) == cacheptr->cacheobj1)
-				|| asAtomHandler::getObjectNoCheck(obj)->getClass() == cacheptr->cacheobj1))
+		if (asAtomHandler::isObject(obj))
 		{
-			asAtom o = asAtomHandler::fromObjectNoPrimitive(cacheptr->cacheobj3);
-			LOG_CALL( "callProperty from cache:"<<*name<<" "<<asAtomHandler::toDebugString(obj)<<" "<<asAtomHandler::toDebugString(o)<<" "<<coercearguments);
-			if(asAtomHandler::is<IFunction>(o))
-				asAtomHandler::callFunction(o,context->worker,ret,obj,args,argsnum,refcounted,needreturn && coercearguments,coercearguments);
-			else if(asAtomHandler::is<Class_base>(o))
+			ASObject* pobj = asAtomHandler::getObjectNoCheck(obj);
+			ASObject* type = pobj->is<Class_base>() ? pobj : pobj->getClass();
+			polymorphiccache* pc = cacheptr->polycache1;
+			for (uint32_t i = 0; i < pc->count; i++)
 			{
-				asAtomHandler::as<Class_base>(o)->generator(context->worker,ret,args,argsnum);
-				if (refcounted)
+				if (pc->type[i] == type)
 				{
-					for(uint32_t i=0;i<argsnum;i++)
-						ASATOM_DECREF(args[i]);
-					ASATOM_DECREF(obj);
+					context->mi->body->inlinecachehits++;
+					callprop_cached(context,ret,obj,args,argsnum,name,pc->func[i],refcounted,needreturn,coercearguments);
+					return;
 				}
 			}
-			else if(asAtomHandler::is<RegExp>(o))
-				RegExp::exec(ret,context->worker,o,args,argsnum);
-			else
-			{
-				LOG(LOG_ERROR,"trying to call an object as a function:"<<asAtomHandler::toDebugString(o) <<" on "<<asAtomHandler::toDebugString(obj));
-				throwError<TypeError>(kCallOfNonFunctionError, "Object");
-			}
-			if (needreturn && asAtomHandler::isInvalid(ret))
-				ret = asAtomHandler::undefinedAtom;
-			LOG_CALL("End of calling cached property "<<*name<<" "<<asAtomHandler::toDebugString(ret));
+		}
+	}
+	else if ((cacheptr->local2.flags&ABC_OP_CACHED) == ABC_OP_CACHED)
+	{
+		if (asAtomHandler::isObject(obj) &&
+				((asAtomHandler::is<Class_base>(obj) && asAtomHandler::getObjectNoCheck(obj) == cacheptr->cacheobj1)
+				|| asAtomHandler::getObjectNoCheck(obj)->getClass() == cacheptr->cacheobj1))
+		{
+			context->mi->body->inlinecachehits++;
+			callprop_cached(context,ret,obj,args,argsnum,name,cacheptr->cacheobj3,refcounted,needreturn,coercearguments);
 			return;
 		}
 		else
 		{
-			if (cacheptr->cacheobj3 && cacheptr->cacheobj3->is<Function>() && cacheptr->cacheobj3->as<IFunction>()->clonedFrom)
-				cacheptr->cacheobj3->decRef();
-			cacheptr->local2.flags |= ABC_OP_NOTCACHEABLE;
+			// the receiver has a different class than the cached one, switch to a polymorphic cache
+			context->mi->body->polymorphiccaches.emplace_back();
+			polymorphiccache* pc = &context->mi->body->polymorphiccaches.back();
+			pc->type[0] = cacheptr->cacheobj1;
+			pc->func[0] = cacheptr->cacheobj3;
+			pc->count = 1;
+			cacheptr->polycache1 = pc;
+			// the reference to the cached function is moved to the polymorphic cache
+			cacheptr->cacheobj3 = nullptr;
 			cacheptr->local2.flags &= ~ABC_OP_CACHED;
+			cacheptr->local2.flags |= ABC_OP_POLYMORPHIC;
+			// skipping the coercion was only verified for the monomorphic function
+			cacheptr->local2.flags &= ~ABC_OP_COERCED;
+			coercearguments = true;
 		}
 	}
+	context->mi->body->inlinecachemisses++;
 	if(asAtomHandler::is<Null>(obj))
 	{
 		LOG(LOG_ERROR,"trying to call property on null:"<<*name);
@@ -1243,13 +1277,27 @@ FORCE_INLINE void callprop_intern(call_context* context,asAtom& ret,asAtom& obj,
 	{
 		if(asAtomHandler::is<IFunction>(o))
 		{
-			if (canCache
-					&& (cacheptr->local2.flags & ABC_OP_NOTCACHEABLE)==0
+			bool polymorphic = (cacheptr->local2.flags & ABC_OP_POLYMORPHIC)==ABC_OP_POLYMORPHIC;
+			bool cacheable = canCache
+					&& (polymorphic || (cacheptr->local2.flags & ABC_OP_NOTCACHEABLE)==0)
 					&& asAtomHandler::canCacheMethod(obj,name)
 					&& asAtomHandler::isObject(o)
 					&& !asAtomHandler::as<IFunction>(o)->clonedFrom
 					&& ((asAtomHandler::is<Class_base>(obj) && asAtomHandler::as<IFunction>(o)->inClass == asAtomHandler::as<Class_base>(obj)) 
-						|| (asAtomHandler::as<IFunction>(o)->inClass && asAtomHandler::getClass(obj,context->sys)->isSubClass(asAtomHandler::as<IFunction>(o)->inClass))))
+						|| (asAtomHandler::as<IFunction>(o)->inClass && asAtomHandler::getClass(obj,context->sys)->isSubClass(asAtomHandler::as<IFunction>(o)->inClass)));
+			if (polymorphic)
+			{
+				// add the class to the polymorphic cache, if the cache is full all other classes use the lookup
+				polymorphiccache* pc = cacheptr->polycache1;
+				if (cacheable && asAtomHandler::isObject(obj) && pc->count < POLYMORPHIC_CACHE_SIZE)
+				{
+					pc->type[pc->count] = asAtomHandler::getClass(obj,context->sys);
+					pc->func[pc->count] = asAtomHandler::getObject(o);
+					LOG_CALL("caching polymorphic callproperty:"<<*name<<" "<<pc->count<<" "<<pc->type[pc->count]->toDebugString()<<" "<<pc->func[pc->count]->toDebugString());
+					pc->count++;
+				}
+			}
+			else if (cacheable)
 			{
 				// cache method if multiname is static and it is a method of a sealed class
 				cacheptr->local2.flags |= ABC_OP_CACHED;
@@ -1278,7 +1326,7 @@ FORCE_INLINE void callprop_intern(call_context* context,asAtom& ret,asAtom& obj,
 			}
 			obj = asAtomHandler::getClosureAtom(o,obj);
 			asAtomHandler::callFunction(o,context->worker,ret,obj,args,argsnum,refcounted,needreturn && coercearguments,coercearguments);
-			if (!(cacheptr->local2.flags & ABC_OP_CACHED) && asAtomHandler::as<IFunction>(o)->clonedFrom)
+			if ((polymorphic || !(cacheptr->local2.flags & ABC_OP_CACHED)) && asAtomHandler::as<IFunction>(o)->clonedFrom)
 				asAtomHandler::as<IFunction>(o)->decRef();
 			if (needreturn && asAtomHandler::isInvalid(ret))
 				ret = asAtomHandler::undefinedAtom;
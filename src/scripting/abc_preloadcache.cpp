@@ -0,0 +1,261 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#include <fstream>
+#include <glib/gstdio.h>
+#include "scripting/abc_preloadcache.h"
+#include "scripting/abc.h"
+#include "backends/config.h"
+#include "logger.h"
+#include "version.h"
+
+using namespace std;
+using namespace lightspark;
+
+// increase this whenever the layout of the cache file or the first pass of preloadFunction changes
+#define PRELOADCACHE_FORMAT_VERSION 3
+static const char preloadcache_magic[4] = { 'L','S','P','C' };
+
+template<class T>
+static void checksumValue(GChecksum* c, const T& v)
+{
+	g_checksum_update(c,(const guchar*)&v,sizeof(T));
+}
+
+ABCPreloadCache::ABCPreloadCache(ABCContext* _context):context(_context),method_body_count(_context->method_body.size()),hits(0),misses(0),
+	hashtime(0),savedtime(0),missedtime(0),loaded(false),modified(false)
+{
+}
+
+ABCPreloadCache::~ABCPreloadCache()
+{
+	if (hits || misses)
+		LOG(LOG_INFO,"preload cache "<<filename<<": "<<hits<<" hits, "<<misses<<" misses, hashing took "<<hashtime
+			<<"us, hits saved "<<savedtime<<"us of first pass time, misses spent "<<missedtime<<"us");
+}
+
+void ABCPreloadCache::computeFilename()
+{
+	uint64_t starttime = compat_get_thread_cputime_us();
+	GChecksum* c = g_checksum_new(G_CHECKSUM_SHA1);
+	g_checksum_update(c,(const guchar*)VERSION,strlen(VERSION));
+	checksumValue(c,(uint32_t)PRELOADCACHE_FORMAT_VERSION);
+	checksumValue(c,(uint32_t)context->major);
+	checksumValue(c,(uint32_t)context->minor);
+	// the first pass only looks at the code of the method bodies, the exception targets and the constants pushed on the stack,
+	// the rest of the constant pool is hashed too, so that ABC blocks differing only in names don't share a file
+	checksumValue(c,(uint32_t)context->constant_pool.integer.size());
+	for (auto it = context->constant_pool.integer.begin(); it != context->constant_pool.integer.end(); it++)
+		checksumValue(c,(int32_t)*it);
+	checksumValue(c,(uint32_t)context->constant_pool.uinteger.size());
+	for (auto it = context->constant_pool.uinteger.begin(); it != context->constant_pool.uinteger.end(); it++)
+		checksumValue(c,(uint32_t)*it);
+	checksumValue(c,(uint32_t)context->constant_pool.doubles.size());
+	for (auto it = context->constant_pool.doubles.begin(); it != context->constant_pool.doubles.end(); it++)
+		checksumValue(c,(double)*it);
+	SystemState* sys = context->root->getSystemState();
+	checksumValue(c,(uint32_t)context->constant_pool.strings.size());
+	for (auto it = context->constant_pool.strings.begin(); it != context->constant_pool.strings.end(); it++)
+	{
+		const tiny_string& s = sys->getStringFromUniqueId(*it);
+		checksumValue(c,s.numBytes());
+		g_checksum_update(c,(const guchar*)s.raw_buf(),s.numBytes());
+	}
+	// namespaces, namespace sets and multinames only contain kinds and indices into the constant pools
+	checksumValue(c,(uint32_t)context->constant_pool.namespaces.size());
+	for (auto it = context->constant_pool.namespaces.begin(); it != context->constant_pool.namespaces.end(); it++)
+	{
+		checksumValue(c,(uint8_t)it->kind);
+		checksumValue(c,(uint32_t)it->name);
+	}
+	checksumValue(c,(uint32_t)context->constant_pool.ns_sets.size());
+	for (auto it = context->constant_pool.ns_sets.begin(); it != context->constant_pool.ns_sets.end(); it++)
+	{
+		checksumValue(c,(uint32_t)it->ns.size());
+		for (auto itns = it->ns.begin(); itns != it->ns.end(); itns++)
+			checksumValue(c,(uint32_t)*itns);
+	}
+	checksumValue(c,(uint32_t)context->constant_pool.multinames.size());
+	for (auto it = context->constant_pool.multinames.begin(); it != context->constant_pool.multinames.end(); it++)
+	{
+		checksumValue(c,(uint8_t)it->kind);
+		checksumValue(c,(uint32_t)it->name);
+		checksumValue(c,(uint32_t)it->ns);
+		checksumValue(c,(uint32_t)it->ns_set);
+		checksumValue(c,(uint32_t)it->type_definition);
+		checksumValue(c,(uint32_t)it->param_types.size());
+		for (auto itp = it->param_types.begin(); itp != it->param_types.end(); itp++)
+			checksumValue(c,(uint32_t)*itp);
+	}
+	for (auto it = context->method_body.begin(); it != context->method_body.end(); it++)
+	{
+		checksumValue(c,(uint32_t)it->code.size());
+		g_checksum_update(c,(const guchar*)it->code.data(),it->code.size());
+		checksumValue(c,(uint32_t)it->exceptions.size());
+		for (auto itex = it->exceptions.begin(); itex != it->exceptions.end(); itex++)
+			checksumValue(c,itex->target);
+	}
+	filename = Config::getConfig()->getCacheDirectory();
+	filename += G_DIR_SEPARATOR_S;
+	filename += "abc";
+	filename += G_DIR_SEPARATOR_S;
+	filename += g_checksum_get_string(c);
+	g_checksum_free(c);
+	hashtime += compat_get_thread_cputime_us()-starttime;
+}
+
+void ABCPreloadCache::load()
+{
+	ifstream f(filename.c_str(),ios::in|ios::binary);
+	if (!f.is_open())
+		return;
+	char magic[4];
+	uint32_t version=0;
+	uint32_t count=0;
+	f.read(magic,4);
+	f.read((char*)&version,sizeof(version));
+	f.read((char*)&count,sizeof(count));
+	if (f.fail() || memcmp(magic,preloadcache_magic,4) || version != PRELOADCACHE_FORMAT_VERSION || count != method_body_count)
+	{
+		LOG(LOG_ERROR,"invalid preload cache file:"<<filename);
+		return;
+	}
+	uint32_t entrycount=0;
+	f.read((char*)&entrycount,sizeof(entrycount));
+	for (uint32_t i = 0; i < entrycount && !f.fail(); i++)
+	{
+		uint32_t bodyindex=0;
+		uint8_t flags=0;
+		uint32_t n=0;
+		preloadanalysis res;
+		f.read((char*)&bodyindex,sizeof(bodyindex));
+		f.read((char*)&flags,sizeof(flags));
+		f.read((char*)&res.firstpasstime,sizeof(res.firstpasstime));
+		res.simplegetter = flags&0x01;
+		res.simplesetter = flags&0x02;
+		f.read((char*)&n,sizeof(n));
+		for (uint32_t j = 0; j < n && !f.fail(); j++)
+		{
+			int32_t target[2];
+			f.read((char*)target,sizeof(target));
+			res.jumptargets[target[0]]=target[1];
+		}
+		f.read((char*)&n,sizeof(n));
+		for (uint32_t j = 0; j < n && !f.fail(); j++)
+		{
+			uint32_t t=0;
+			f.read((char*)&t,sizeof(t));
+			res.skippablekills.insert(t);
+		}
+		if (f.fail() || bodyindex >= method_body_count)
+			break;
+		entries[bodyindex]=res;
+	}
+	if (f.fail())
+	{
+		LOG(LOG_ERROR,"truncated preload cache file:"<<filename);
+		entries.clear();
+	}
+	else
+		LOG(LOG_INFO,"loaded "<<entries.size()<<" methods from preload cache "<<filename);
+}
+
+bool ABCPreloadCache::get(uint32_t bodyindex, preloadanalysis& res)
+{
+	Locker l(mutex);
+	if (!loaded)
+	{
+		computeFilename();
+		load();
+		loaded=true;
+	}
+	auto it = entries.find(bodyindex);
+	if (it == entries.end())
+	{
+		misses++;
+		return false;
+	}
+	hits++;
+	savedtime += it->second.firstpasstime;
+	res = it->second;
+	return true;
+}
+
+void ABCPreloadCache::put(uint32_t bodyindex, const preloadanalysis& res)
+{
+	Locker l(mutex);
+	entries[bodyindex]=res;
+	missedtime += res.firstpasstime;
+	modified=true;
+}
+
+void ABCPreloadCache::save()
+{
+	Locker l(mutex);
+	if (!modified || !loaded)
+		return;
+	gchar* dir = g_path_get_dirname(filename.c_str());
+	int res = g_mkdir_with_parents(dir,0700);
+	g_free(dir);
+	if (res)
+	{
+		LOG(LOG_ERROR,"could not create preload cache directory for "<<filename);
+		return;
+	}
+	// write to a temporary file first, so that other instances never see a partially written cache
+	string tmpname = filename+".tmp";
+	ofstream f(tmpname.c_str(),ios::out|ios::binary|ios::trunc);
+	if (!f.is_open())
+	{
+		LOG(LOG_ERROR,"could not write preload cache file:"<<tmpname);
+		return;
+	}
+	uint32_t version=PRELOADCACHE_FORMAT_VERSION;
+	uint32_t entrycount=entries.size();
+	f.write(preloadcache_magic,4);
+	f.write((const char*)&version,sizeof(version));
+	f.write((const char*)&method_body_count,sizeof(method_body_count));
+	f.write((const char*)&entrycount,sizeof(entrycount));
+	for (auto it = entries.begin(); it != entries.end(); it++)
+	{
+		uint8_t flags = (it->second.simplegetter ? 0x01 : 0) | (it->second.simplesetter ? 0x02 : 0);
+		uint32_t n = it->second.jumptargets.size();
+		f.write((const char*)&it->first,sizeof(it->first));
+		f.write((const char*)&flags,sizeof(flags));
+		f.write((const char*)&it->second.firstpasstime,sizeof(it->second.firstpasstime));
+		f.write((const char*)&n,sizeof(n));
+		for (auto itj = it->second.jumptargets.begin(); itj != it->second.jumptargets.end(); itj++)
+		{
+			int32_t target[2] = { itj->first, itj->second };
+			f.write((const char*)target,sizeof(target));
+		}
+		n = it->second.skippablekills.size();
+		f.write((const char*)&n,sizeof(n));
+		for (auto itk = it->second.skippablekills.begin(); itk != it->second.skippablekills.end(); itk++)
+			f.write((const char*)&(*itk),sizeof(uint32_t));
+	}
+	f.close();
+	if (f.fail() || g_rename(tmpname.c_str(),filename.c_str()))
+	{
+		LOG(LOG_ERROR,"could not write preload cache file:"<<filename);
+		g_unlink(tmpname.c_str());
+		return;
+	}
+	modified=false;
+}
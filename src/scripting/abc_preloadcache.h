@@ -0,0 +1,88 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#ifndef SCRIPTING_ABC_PRELOADCACHE_H
+#define SCRIPTING_ABC_PRELOADCACHE_H 1
+
+#include "compat.h"
+#include "threading.h"
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+
+namespace lightspark
+{
+class ABCContext;
+
+/*
+ * Result of the first pass of ABCVm::preloadFunction. It only depends on the
+ * bytes of the ABC block, so it can be reused across runs
+ */
+struct preloadanalysis
+{
+	// jump targets (and the number of jumps to them) after removal of unreachable code
+	std::map<int32_t,int32_t> jumptargets;
+	// kill opcodes that are not followed by a getlocal of the same local
+	std::set<uint32_t> skippablekills;
+	bool simplegetter;
+	bool simplesetter;
+	// thread cpu time in microseconds the first pass took when the entry was computed
+	uint32_t firstpasstime;
+	preloadanalysis():simplegetter(false),simplesetter(false),firstpasstime(0) {}
+};
+
+/*
+ * Persistent cache of the preload analysis of all method bodies of an ABCContext.
+ * The cache file is named after a hash of the ABC data and the engine version
+ * and is written back when the context is destroyed, if new methods were analyzed.
+ * The hash is only computed when the first method of the context is preloaded,
+ * so ABC blocks whose code never runs don't pay for it. The time spent hashing
+ * and the first pass time saved by hits are logged when the cache is destroyed
+ */
+class ABCPreloadCache
+{
+private:
+	Mutex mutex;
+	ABCContext* context;
+	std::unordered_map<uint32_t,preloadanalysis> entries;
+	std::string filename;
+	uint32_t method_body_count;
+	uint32_t hits;
+	uint32_t misses;
+	// thread cpu times in microseconds, for the statistics logged on destruction
+	uint64_t hashtime;
+	uint64_t savedtime;
+	uint64_t missedtime;
+	bool loaded;
+	bool modified;
+	void computeFilename();
+	void load();
+public:
+	ABCPreloadCache(ABCContext* context);
+	~ABCPreloadCache();
+	// returns false if the method body at bodyindex was not analyzed yet
+	bool get(uint32_t bodyindex, preloadanalysis& res);
+	// res.firstpasstime has to be set by the caller
+	void put(uint32_t bodyindex, const preloadanalysis& res);
+	void save();
+};
+
+}
+#endif /* SCRIPTING_ABC_PRELOADCACHE_H */
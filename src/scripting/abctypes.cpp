@@ -19,6 +19,7 @@
 
 #include "scripting/abctypes.h"
 #include "swf.h"
+#include "scripting/toplevel/toplevel.h"
 
 using namespace std;
 using namespace lightspark;
@@ -404,8 +405,35 @@ cpool_info::cpool_info(MemoryAccount* m):
 {
 }
 
+polymorphiccache::~polymorphiccache()
+{
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (func[i]->is<Function>() && func[i]->as<IFunction>()->clonedFrom)
+			func[i]->decRef();
+	}
+}
+
+preloadedmethodcode::~preloadedmethodcode()
+{
+	if (localsinitialvalues)
+		delete[] localsinitialvalues;
+}
+
 method_body_info::~method_body_info()
 {
 	if (localsinitialvalues)
 		delete[] localsinitialvalues;
+	delete inactivecode;
+}
+
+void method_body_info::swapPreloadedCode(preloadedmethodcode& c)
+{
+	exceptions.swap(c.exceptions);
+	polymorphiccaches.swap(c.polymorphiccaches);
+	localconstantslots.swap(c.localconstantslots);
+	preloadedcode.swap(c.preloadedcode);
+	std::swap(localsinitialvalues,c.localsinitialvalues);
+	std::swap(localresultcount,c.localresultcount);
+	std::swap(specializedcode,c.specializedcode);
 }
@@ -23,12 +23,14 @@
 #include "swftypes.h"
 #include "memory_support.h"
 #include <unordered_set>
+#include <list>
 
 class memorystream;
 
 namespace lightspark
 {
 struct variable;
+class Class_base;
 
 class u8
 {
@@ -264,12 +266,28 @@ struct method_info_simple
 };
 typedef void (*abc_function)(struct call_context*);
 
+#define POLYMORPHIC_CACHE_SIZE 4
+// inline cache of a callproperty site that was called with receivers of different classes
+// getproperty/setproperty sites have no class keyed cache: their operands use all three slots
+// of preloadedcodedata and properties are looked up per object, not at a fixed offset per class
+struct polymorphiccache
+{
+	// class of the receiver (or the class itself for static methods)
+	ASObject* type[POLYMORPHIC_CACHE_SIZE];
+	ASObject* func[POLYMORPHIC_CACHE_SIZE];
+	uint32_t count;
+	polymorphiccache():count(0) {}
+	// releases the functions that were moved here from cacheobj3 of a monomorphic cache
+	~polymorphiccache();
+};
+
 struct preloadedcodedata
 {
 	abc_function func;
 	union
 	{
 		ASObject* cacheobj1;
+		polymorphiccache* polycache1;
 		asAtom* arg1_constant;
 		uint32_t local_pos1;
 		int32_t arg1_int;
@@ -311,9 +329,31 @@ struct localconstantslot
 	uint32_t slot_number;
 };
 
+// class of an untyped argument seen in all calls of a method so far
+struct argumenttypefeedback
+{
+	Class_base* type;
+	bool polymorphic;
+	argumenttypefeedback():type(nullptr),polymorphic(false) {}
+};
+
+// the parts of a method body created by ABCVm::preloadFunction, see method_body_info::swapPreloadedCode
+struct preloadedmethodcode
+{
+	std::vector<exception_info_abc> exceptions;
+	std::list<polymorphiccache> polymorphiccaches;
+	std::vector<localconstantslot> localconstantslots;
+	std::vector<preloadedcodedata> preloadedcode;
+	asAtom* localsinitialvalues;
+	uint16_t localresultcount;
+	bool specializedcode;
+	preloadedmethodcode():localsinitialvalues(nullptr),localresultcount(0),specializedcode(false) {}
+	~preloadedmethodcode();
+};
+
 struct method_body_info
 {
-	method_body_info():localresultcount(0),hit_count(0),codeStatus(ORIGINAL),localsinitialvalues(nullptr){}
+	method_body_info():hit_count(0),localresultcount(0),codeStatus(ORIGINAL),tier(TIER_GENERIC),promotions(0),deoptimizations(0),functionname(0),inlinecachehits(0),inlinecachemisses(0),localsinitialvalues(nullptr),specializedcode(false),inactivecode(nullptr){}
 	~method_body_info();
 	u30 method;
 	u30 max_stack;
@@ -324,17 +364,39 @@ struct method_body_info
 	std::vector<exception_info_abc> exceptions;
 	u30 trait_count;
 	std::vector<traits_info> traits;
-	uint16_t localresultcount;
 	//The hit_count belongs here, since it is used to manipulate the code
-	uint16_t hit_count;
+	uint32_t hit_count;
+	uint16_t localresultcount;
 	uint16_t returnvaluepos;
 	//The code status
 	enum CODE_STATUS { ORIGINAL = 0, USED, OPTIMIZED, JITTED, PRELOADING, PRELOADED };
 	CODE_STATUS codeStatus;
+	//The tier of the preloaded code, see SyntheticFunction::updateTier
+	enum CODE_TIER { TIER_GENERIC = 0, TIER_SPECIALIZED, TIER_FINAL };
+	CODE_TIER tier;
+	uint16_t promotions;
+	uint16_t deoptimizations;
+	//Name of the function that first called this method, only used for the tiering profile
+	uint32_t functionname;
+	//Types of the arguments seen while running the generic code, indexed by argument
+	std::vector<argumenttypefeedback> argumenttypes;
+	//The exceptions as read from the abc data, preloading rewrites the positions in exceptions
+	std::vector<exception_info_abc> originalexceptions;
+	//Storage for the polymorphic inline caches of the preloaded code
+	std::list<polymorphiccache> polymorphiccaches;
+	//Number of calls of properties that were found in an inline cache and of calls that needed a lookup
+	uint64_t inlinecachehits;
+	uint64_t inlinecachemisses;
 	// list of local/slot pairs that were optimized away
 	std::vector<localconstantslot> localconstantslots;
 	std::vector<preloadedcodedata> preloadedcode;
 	asAtom* localsinitialvalues;
+	//True if the preloaded code above was specialized for the types in argumenttypes
+	bool specializedcode;
+	//The generic code while the specialized code is in use, see SyntheticFunction::updateTier
+	preloadedmethodcode* inactivecode;
+	//Exchanges the preloaded code with c, pointers into both codes stay valid
+	void swapPreloadedCode(preloadedmethodcode& c);
 	inline uint16_t getReturnValuePos() const { return returnvaluepos; }
 };
 
@@ -23,6 +23,7 @@
 #include "scripting/flash/filters/flashfilters.h"
 #include "backends/rendering.h"
 #include "backends/image.h"
+#include "platforms/pixelkernels.h"
 #include "swf.h"
 
 using namespace std;
@@ -45,26 +46,6 @@ BitmapContainer::~BitmapContainer()
 		}
 }
 
-uint8_t* BitmapContainer::getRectangleData(const RECT& sourceRect)
-{
-	RECT clippedSourceRect;
-	clipRect(sourceRect, clippedSourceRect);
-
-	int copyWidth = clippedSourceRect.Xmax - clippedSourceRect.Xmin;
-	int copyHeight = clippedSourceRect.Ymax - clippedSourceRect.Ymin;
-
-	int sx = clippedSourceRect.Xmin;
-	int sy = clippedSourceRect.Ymin;
-	uint8_t* res = new uint8_t[copyWidth * copyHeight * 4];
-	for (int i=0; i<copyHeight; i++)
-	{
-		memcpy(&res[i*copyWidth*4],
-				&data[(sy+i)*stride + 4*sx],
-				4*copyWidth);
-	}
-	return res;
-}
-
 bool BitmapContainer::fromRGB(uint8_t* rgb, uint32_t w, uint32_t h, BITMAP_FORMAT format, bool frompng)
 {
 	if(!rgb)
@@ -273,22 +254,23 @@ void BitmapContainer::copyRectangle(_R<BitmapContainer> source,
 	}
 	else
 	{
-		uint8_t* sourcedata = &source->data[0];
-		bool needsdeletion = false;
-		if (sourcedata == &data[0])
+		bool sameBuffer = source.getPtr() == this;
+		std::vector<uint32_t> row;
+		for (int n=0; n<copyHeight; n++)
 		{
-			// cairo doesn't work if source and destination buffers are the same 
-			sourcedata = new uint8_t[data.size()];
-			memcpy (sourcedata,&data[0],data.size());
-			needsdeletion = true;
+			//Set the copy direction so that we don't
+			//blend source rows that were already overwritten
+			int i = (sameBuffer && clippedY > sy) ? copyHeight - n - 1 : n;
+			uint32_t* dst = (uint32_t*)&data[(clippedY+i)*stride + 4*clippedX];
+			const uint32_t* src = (const uint32_t*)&source->data[(sy+i)*source->stride + 4*sx];
+			if (sameBuffer)
+			{
+				// source and destination rows may overlap
+				row.assign(src, src+copyWidth);
+				src = row.data();
+			}
+			pixelBlendOver(dst, src, copyWidth);
 		}
-		//Slow path using Cairo
-		CairoRenderContext ctxt(&data[0], width, height,false);
-		ctxt.simpleBlit(clippedX, clippedY, sourcedata,
-				source->getWidth(), source->getHeight(),
-				sx, sy, copyWidth, copyHeight);
-		if (needsdeletion)
-			delete[] sourcedata;
 	}
 }
 
@@ -54,11 +54,9 @@ public:
 	const uint8_t* getData() const { return &data[0]; }
 	uint8_t* getDataColorTransformed() 
 	{
-		data_colortransformed.reserve(data.size());
+		data_colortransformed.resize(data.size());
 		return &data_colortransformed[0];
 	}
-	// this creates a new byte array that has to be deleted by the caller
-	uint8_t* getRectangleData(const RECT& sourceRect);
 	bool fromRGB(uint8_t* rgb, uint32_t width, uint32_t height, BITMAP_FORMAT format, bool frompng = false);
 	bool fromJPEG(uint8_t* data, int len, const uint8_t *tablesData=NULL, int tablesLen=0);
 	bool fromJPEG(std::istream& s);
@@ -224,7 +224,7 @@ ASFUNCTIONBODY_ATOM(BitmapData,dispose)
 	th->notifyUsers();
 }
 
-void BitmapData::drawDisplayObject(DisplayObject* d, const MATRIX& initialMatrix, bool smoothing, bool forCachedBitmap)
+void BitmapData::drawDisplayObject(DisplayObject* d, const MATRIX& initialMatrix, bool smoothing, bool forCachedBitmap, const RECT* clipRect)
 {
 	if (forCachedBitmap)
 		d->incRef();
@@ -238,6 +238,8 @@ void BitmapData::drawDisplayObject(DisplayObject* d, const MATRIX& initialMatrix
 		memset(p,0,pixels->getWidth()*pixels->getHeight()*4);
 	}
 	CairoRenderContext ctxt(pixels->getData(), pixels->getWidth(), pixels->getHeight(),smoothing);
+	if (clipRect)
+		ctxt.setClipRect(*clipRect);
 	for(auto it=queue.queue.begin();it!=queue.queue.end();it++)
 	{
 		DisplayObject* target=(*it).getPtr();
@@ -315,8 +317,11 @@ ASFUNCTIONBODY_ATOM(BitmapData,draw)
 				      drawable->getClassName(),
 				      "IBitmapDrawable");
 
-	if(!(blendMode.empty() || blendMode == "null") || !clipRect.isNull())
-		LOG(LOG_NOT_IMPLEMENTED,"BitmapData.draw does not support many parameters:"<<ctransform.isNull()<<" "<<clipRect.isNull()<<" "<<blendMode);
+	if(!(blendMode.empty() || blendMode == "null"))
+		LOG(LOG_NOT_IMPLEMENTED,"BitmapData.draw does not support blendMode:"<<blendMode);
+	RECT cliprect;
+	if(!clipRect.isNull())
+		cliprect=clipRect->getRect();
 
 	if(drawable->is<BitmapData>())
 	{
@@ -326,6 +331,8 @@ ASFUNCTIONBODY_ATOM(BitmapData,draw)
 		if(!matrix.isNull())
 			initialMatrix=matrix->getMATRIX();
 		CairoRenderContext ctxt(th->pixels->getData(), th->pixels->getWidth(), th->pixels->getHeight(),smoothing);
+		if(!clipRect.isNull())
+			ctxt.setClipRect(cliprect);
 		//Blit the data while transforming it
 		ctxt.transformedBlit(initialMatrix, data->pixels->getData(),
 				data->pixels->getWidth(), data->pixels->getHeight(),
@@ -340,7 +347,7 @@ ASFUNCTIONBODY_ATOM(BitmapData,draw)
 		MATRIX initialMatrix;
 		if(!matrix.isNull())
 			initialMatrix=matrix->getMATRIX();
-		d->DrawToBitmap(th,initialMatrix,smoothing,false);
+		d->DrawToBitmap(th,initialMatrix,smoothing,false,clipRect.isNull() ? nullptr : &cliprect);
 		if (ctransform)
 			ctransform->applyTransformation(th->pixels->getData(),th->getBitmapContainer()->getWidth()*th->getBitmapContainer()->getHeight()*4);
 	}
@@ -129,6 +129,7 @@ void DisplayObject::finalize()
 	getSystemState()->unregisterFrameListener(this);
 	EventDispatcher::finalize();
 	cachedBitmap.reset();
+	cachedBitmapFilters.clear();
 	cachedAsBitmapOf=nullptr;
 	parent=nullptr;
 	eventparentmap.clear();
@@ -162,6 +163,7 @@ bool DisplayObject::destruct()
 	// TODO make all DisplayObject derived classes reusable
 	getSystemState()->unregisterFrameListener(this);
 	cachedBitmap.reset();
+	cachedBitmapFilters.clear();
 	cachedAsBitmapOf=nullptr;
 	ismask=false;
 	parent=nullptr;
@@ -763,6 +765,8 @@ void DisplayObject::updateCachedSurface(IDrawable *d)
 	cachedSurface.alphaOffset=d->getAlphaOffset();
 	cachedSurface.matrix=d->getMatrix();
 	cachedSurface.isValid=true;
+	if (d->getRasterEntry())
+		cachedSurface.setSharedTexture(&d->getRasterEntry()->chunk,getSystemState()->getRenderThread());
 }
 //TODO: Fix precision issues, Adobe seems to do the matrix mult with twips and rounds the results, 
 //this way they have less pb with precision.
@@ -1687,7 +1691,7 @@ void DisplayObject::computeMasksAndMatrix(const DisplayObject* target, std::vect
 		cur=cur->getParent();
 	}
 }
-void DisplayObject::DrawToBitmap(BitmapData* bm,const MATRIX& initialMatrix,bool smoothing, bool forcachedbitmap)
+void DisplayObject::DrawToBitmap(BitmapData* bm,const MATRIX& initialMatrix,bool smoothing, bool forcachedbitmap, const RECT* clipRect)
 {
 	DisplayObjectContainer* origparent=this->parent;
 	number_t origrotation = this->rotation;
@@ -1702,7 +1706,7 @@ void DisplayObject::DrawToBitmap(BitmapData* bm,const MATRIX& initialMatrix,bool
 	this->sy=1;
 	this->tx=0;
 	this->ty=0;
-	bm->drawDisplayObject(this, initialMatrix,smoothing,forcachedbitmap);
+	bm->drawDisplayObject(this, initialMatrix,smoothing,forcachedbitmap,clipRect);
 	// reset position to original settings
 	this->parent=origparent;
 	this->rotation=origrotation;
@@ -1720,6 +1724,54 @@ string DisplayObject::toDebugString() const
 	res += buf;
 	return res;
 }
+// returns true if the filters changed since cachedBitmap was drawn
+bool DisplayObject::updateCachedBitmapFilters()
+{
+	bool changed = false;
+	uint32_t count = 0;
+	if (filters)
+	{
+		for (uint32_t i = 0; i < filters->size(); i++)
+		{
+			asAtom f = asAtomHandler::invalidAtom;
+			filters->at_nocheck(f,i);
+			if (!asAtomHandler::is<BitmapFilter>(f))
+				continue;
+			BitmapFilter* filter = asAtomHandler::as<BitmapFilter>(f);
+			if (count == cachedBitmapFilters.size())
+			{
+				cachedBitmapFilters.emplace_back(filter,filter->getVersion());
+				changed = true;
+			}
+			else if (cachedBitmapFilters[count].first != filter || cachedBitmapFilters[count].second != filter->getVersion())
+			{
+				cachedBitmapFilters[count] = make_pair(filter,filter->getVersion());
+				changed = true;
+			}
+			count++;
+		}
+	}
+	if (count != cachedBitmapFilters.size())
+	{
+		cachedBitmapFilters.resize(count);
+		changed = true;
+	}
+	return changed;
+}
+
+void DisplayObject::applyFilters(BitmapContainer* bc, uint32_t w, uint32_t h)
+{
+	if (!filters)
+		return;
+	for (uint32_t i = 0; i < filters->size(); i++)
+	{
+		asAtom f = asAtomHandler::invalidAtom;
+		filters->at_nocheck(f,i);
+		if (asAtomHandler::is<BitmapFilter>(f))
+			asAtomHandler::as<BitmapFilter>(f)->applyFilter(bc,nullptr,RECT(0,w,0,h),0,0);
+	}
+}
+
 IDrawable* DisplayObject::getCachedBitmapDrawable(DisplayObject* target,const MATRIX& initialMatrix,_NR<DisplayObject>* pcachedBitmap)
 {
 	if (!computeCacheAsBitmap())
@@ -1743,7 +1795,15 @@ IDrawable* DisplayObject::getCachedBitmapDrawable(DisplayObject* target,const MA
 	}
 	uint32_t w=ceil(xmax-xmin)+maxfilterborder*2;
 	uint32_t h=ceil(ymax-ymin)+maxfilterborder*2;
-	if (needsTextureRecalculation|| !cachedBitmap)
+	MATRIX m0=m;
+	m0.translate(-(xmin-maxfilterborder) ,-(ymin-maxfilterborder));
+	// the filters only run again if the content, the filters or the scale/rotation changed, a move only moves cachedBitmap
+	bool filterschanged = updateCachedBitmapFilters();
+	if (needsTextureRecalculation || !cachedBitmap || filterschanged
+			|| cachedBitmap->getBitmapSize().width != w
+			|| cachedBitmap->getBitmapSize().height != h
+			|| m0.xx != cachedBitmapMatrix.xx || m0.yx != cachedBitmapMatrix.yx
+			|| m0.xy != cachedBitmapMatrix.xy || m0.yy != cachedBitmapMatrix.yy)
 	{
 		if (!cachedBitmap
 				|| cachedBitmap->getBitmapSize().width != w
@@ -1752,19 +1812,9 @@ IDrawable* DisplayObject::getCachedBitmapDrawable(DisplayObject* target,const MA
 			_R<BitmapData> data(Class<BitmapData>::getInstanceS(getInstanceWorker(),w,h));
 			cachedBitmap=_MR(Class<Bitmap>::getInstanceS(getInstanceWorker(),data));
 		}
-		MATRIX m0=m;
-		m0.translate(-(xmin-maxfilterborder) ,-(ymin-maxfilterborder));
+		cachedBitmapMatrix=m0;
 		DrawToBitmap(cachedBitmap->bitmapData.getPtr(),m0,true,true);
-		if (filters)
-		{
-			for (uint32_t i = 0; i < filters->size(); i++)
-			{
-				asAtom f = asAtomHandler::invalidAtom;
-				filters->at_nocheck(f,i);
-				if (asAtomHandler::is<BitmapFilter>(f))
-					asAtomHandler::as<BitmapFilter>(f)->applyFilter(cachedBitmap->bitmapData->getBitmapContainer().getPtr(),nullptr,RECT(0,w,0,h),0,0);
-			}
-		}
+		applyFilters(cachedBitmap->bitmapData->getBitmapContainer().getPtr(),w,h);
 		// apply colortransform for cached bitmap after the filters are applied
 		ColorTransform* ct = colorTransform.getPtr();
 		if (ct)
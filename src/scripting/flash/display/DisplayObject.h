@@ -30,6 +30,7 @@ namespace lightspark
 {
 
 class AccessibilityProperties;
+class BitmapFilter;
 class DisplayObjectContainer;
 class LoaderInfo;
 class RenderContext;
@@ -84,6 +85,14 @@ private:
 	 * It is the cached version of the object for fast draw on the Stage
 	 */
 	CachedSurface cachedSurface;
+	/* the filters (and their versions) and the matrix cachedBitmap was drawn with.
+	 * The filtered cachedBitmap is reused as long as they and the content don't change,
+	 * so moving the object only moves the bitmap
+	 */
+	std::vector<std::pair<const BitmapFilter*,uint32_t>> cachedBitmapFilters;
+	MATRIX cachedBitmapMatrix;
+	bool updateCachedBitmapFilters();
+	void applyFilters(BitmapContainer* bc, uint32_t w, uint32_t h);
 	/*
 	 * Utility function to set internal MATRIX
 	 * Also used by Transform
@@ -331,7 +340,7 @@ public:
 	void setVariableBinding(tiny_string& name, _NR<DisplayObject> obj);
 	void AVM1SetFunction(uint32_t nameID, _NR<AVM1Function> obj);
 	AVM1Function *AVM1GetFunction(uint32_t nameID);
-	void DrawToBitmap(BitmapData* bm, const MATRIX& initialMatrix, bool smoothing, bool forcachedbitmap);
+	void DrawToBitmap(BitmapData* bm, const MATRIX& initialMatrix, bool smoothing, bool forcachedbitmap, const RECT* clipRect=nullptr);
 	std::string toDebugString() const override;
 };
 }
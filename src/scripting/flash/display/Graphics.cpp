@@ -1353,10 +1353,8 @@ ASFUNCTIONBODY_ATOM(Graphics,copyFrom)
 	if (source.isNull())
 		return;
 
-	th->tokens.filltokens.assign(source->tokens.filltokens.begin(),
-				 source->tokens.filltokens.end());
-	th->tokens.stroketokens.assign(source->tokens.stroketokens.begin(),
-				 source->tokens.stroketokens.end());
+	th->tokens.filltokens=source->tokens.filltokens;
+	th->tokens.stroketokens=source->tokens.stroketokens;
 	th->tokens.canRenderToGL=source->tokens.canRenderToGL;
 	th->hasChanged = true;
 }
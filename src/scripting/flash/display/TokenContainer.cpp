@@ -23,6 +23,8 @@
 #include "scripting/flash/display/BitmapData.h"
 #include "parsing/tags.h"
 #include "backends/rendering.h"
+#include "backends/config.h"
+#include "backends/tessellator.h"
 #include "scripting/flash/geom/flashgeom.h"
 #include "backends/lsopengl.h"
 #include "3rdparty/nanovg/src/nanovg.h"
@@ -33,24 +35,104 @@ using namespace lightspark;
 using namespace std;
 
 
-TokenContainer::TokenContainer(DisplayObject* _o) : owner(_o), scaling(1.0f)
+TokenContainer::TokenContainer(DisplayObject* _o) : owner(_o), scaling(1.0f), renderAsMesh(false),
+	rasterCache(nullptr), rasterEntry(nullptr), rasterRatio(0)
 {
 }
 
 TokenContainer::TokenContainer(DisplayObject* _o, const tokensVector& _tokens, float _scaling) :
-	owner(_o), scaling(_scaling)
+	owner(_o), scaling(_scaling), renderAsMesh(false),
+	rasterCache(nullptr), rasterEntry(nullptr), rasterRatio(0)
 
 {
-	tokens.filltokens.assign(_tokens.filltokens.begin(),_tokens.filltokens.end());
-	tokens.stroketokens.assign(_tokens.stroketokens.begin(),_tokens.stroketokens.end());
+	tokens.filltokens=_tokens.filltokens;
+	tokens.stroketokens=_tokens.stroketokens;
 	tokens.canRenderToGL = _tokens.canRenderToGL;
 }
 
+bool TokenContainer::canRenderAsMesh() const
+{
+	if (!Config::getConfig()->isShapeTessellationEnabled() || tokens.empty() || tokens.canRenderToGL)
+		return false;
+	// masks and clipping are only implemented for cached surfaces
+	for (const DisplayObject* o = owner; o; o = o->getParent())
+	{
+		if (o->computeCacheAsBitmap() || o->ClipDepth || o->ismask || !o->mask.isNull())
+			return false;
+	}
+	// overlapping triangles of a stroke would be blended twice
+	if (!tokens.stroketokens.empty() && owner->getConcatenatedAlpha() != 1.0)
+		return false;
+	return ShapeTessellator::canTessellate(tokens);
+}
+
+bool TokenContainer::renderMeshImpl(RenderContext& ctxt) const
+{
+	RenderThread* rt = owner->getSystemState()->getRenderThread();
+	MATRIX m = owner->getConcatenatedMatrix(true);
+	if (m.getScaleX()==0 || m.getScaleY()==0)
+		return true;
+	int offsetX;
+	int offsetY;
+	float scaleX;
+	float scaleY;
+	owner->getSystemState()->stageCoordinateMapping(rt->windowWidth, rt->windowHeight, offsetX, offsetY, scaleX, scaleY);
+	m.scale(scaleX, scaleY);
+	const ShapeMesh* mesh = rt->getShapeMesh(tokens, scaling, max(abs(m.getScaleX()), abs(m.getScaleY())));
+	if (!mesh)
+		return false;
+	float ct[8] = { 1.0, 1.0, 1.0, 1.0, 0.0, 0.0, 0.0, 0.0 };
+	bool hasColorTransform = false;
+	for (const DisplayObject* o = owner; o; o = o->getParent())
+	{
+		const ColorTransform* c = o->colorTransform.getPtr();
+		if (!c)
+			continue;
+		if (!hasColorTransform)
+		{
+			ct[4]=c->redOffset;
+			ct[5]=c->greenOffset;
+			ct[6]=c->blueOffset;
+			ct[7]=c->alphaOffset;
+		}
+		else
+		{
+			ct[4]+=c->redOffset;
+			ct[5]+=c->greenOffset;
+			ct[6]+=c->blueOffset;
+			ct[7]+=c->alphaOffset;
+		}
+		ct[0]*=c->redMultiplier;
+		ct[1]*=c->greenMultiplier;
+		ct[2]*=c->blueMultiplier;
+		ct[3]*=c->alphaMultiplier;
+		hasColorTransform = true;
+	}
+	AS_BLENDMODE bl = owner->getBlendMode();
+	for (const DisplayObject* o = owner->getParent(); o && bl == BLENDMODE_NORMAL; o = o->getParent())
+		bl = o->getBlendMode();
+	ctxt.setProperties(bl);
+	((GLRenderContext&)ctxt).renderMesh(*mesh, owner->getConcatenatedAlpha(),
+			ct[0], ct[1], ct[2], ct[3], ct[4], ct[5], ct[6], ct[7], m);
+	return true;
+}
+
 bool TokenContainer::renderImpl(RenderContext& ctxt) const
 {
+	if (ctxt.contextType== RenderContext::GL && renderAsMesh && owner->mask.isNull() && !owner->ismask)
+	{
+		if (renderMeshImpl(ctxt))
+			return false;
+	}
 	if (ctxt.contextType== RenderContext::GL && !tokens.empty() && tokens.shouldRenderToGL())
 	{
 		NVGcontext* nvgctxt = owner->getSystemState()->getEngineData()->nvgcontext;
+		if (nvgctxt && ((GLRenderContext&)ctxt).isCollectingQuads())
+		{
+			// nanovg can't be compared between frames, the whole stage will be drawn again
+			((GLRenderContext&)ctxt).markDirectDrawing();
+			return false;
+		}
 		if (nvgctxt)
 		{
 			int offsetX;
@@ -387,6 +469,12 @@ void TokenContainer::requestInvalidation(InvalidateQueue* q, bool forceTextureRe
 		return;
 	if (q && !q->isSoftwareQueue && !tokens.empty() && tokens.canRenderToGL)
 		return;
+	if (q && !q->isSoftwareQueue)
+	{
+		renderAsMesh = canRenderAsMesh();
+		if (renderAsMesh)
+			return;
+	}
 	owner->incRef();
 	if (forceTextureRefresh)
 		owner->setNeedsTextureRecalculation();
@@ -399,7 +487,7 @@ IDrawable* TokenContainer::invalidate(DisplayObject* target, const MATRIX& initi
 	{
 		return owner->getCachedBitmapDrawable(target, initialMatrix, cachedBitmap);
 	}
-	if (q && !q->isSoftwareQueue && tokens.canRenderToGL)
+	if (q && !q->isSoftwareQueue && (tokens.canRenderToGL || renderAsMesh))
 		return nullptr;
 	number_t x,y,rx,ry;
 	number_t width,height;
@@ -426,6 +514,21 @@ IDrawable* TokenContainer::invalidate(DisplayObject* target, const MATRIX& initi
 		totalMatrix.x0 = 0;
 		totalMatrix.y0 = 0;
 	}
+	ShapeRasterCache::Entry* sharedEntry=nullptr;
+	bool rasterNeeded=false;
+	// instances drawn on stage without baked in masks share the rasterization of their tag
+	if (rasterCache && target && !q && !fromgraphics && masks.empty() && !isMask && mask.isNull()
+		&& totalMatrix.xy==0 && totalMatrix.yx==0)
+	{
+		float xscale=totalMatrix.xx;
+		float yscale=totalMatrix.yy;
+		sharedEntry=rasterCache->acquire(rasterRatio,xscale,yscale,smoothing,rasterEntry,owner->getSystemState()->getRenderThread(),rasterNeeded);
+		rasterEntry=sharedEntry;
+		totalMatrix.xx=xscale;
+		totalMatrix.yy=yscale;
+	}
+	else if (rasterEntry && !q)
+		releaseSharedRaster();
 	owner->computeBoundsForTransformedRect(bxmin,bxmax,bymin,bymax,x,y,width,height,totalMatrix);
 
 	if (isnan(width) || isnan(height))
@@ -454,7 +557,11 @@ IDrawable* TokenContainer::invalidate(DisplayObject* target, const MATRIX& initi
 	ColorTransform* ct = owner->colorTransform.getPtr();
 	DisplayObjectContainer* p = owner->getParent();
 	if(width==0 || height==0)
+	{
+		if (rasterNeeded)
+			rasterCache->rasterFailed(sharedEntry);
 		return nullptr;
+	}
 	if (ct)
 	{
 		redMultiplier=ct->redMultiplier;
@@ -506,7 +613,7 @@ IDrawable* TokenContainer::invalidate(DisplayObject* target, const MATRIX& initi
 		regpointy=bymin;
 	}
 	owner->cachedSurface.isValid=true;
-	return new CairoTokenRenderer(tokens,totalMatrix2
+	IDrawable* ret=new CairoTokenRenderer(tokens,totalMatrix2
 				, x, y, ceil(width), ceil(height)
 				, rx, ry, ceil(rwidth), ceil(rheight), 0
 				, totalMatrix.getScaleX(), totalMatrix.getScaleY()
@@ -515,6 +622,23 @@ IDrawable* TokenContainer::invalidate(DisplayObject* target, const MATRIX& initi
 				, redMultiplier,greenMultiplier,blueMultiplier,alphaMultiplier
 				, redOffset,greenOffset,blueOffset,alphaOffset
 				, smoothing, regpointx, regpointy);
+	if (sharedEntry)
+		ret->setSharedRaster(rasterCache,sharedEntry,rasterNeeded);
+	return ret;
+}
+
+void TokenContainer::releaseSharedRaster()
+{
+	if (!rasterEntry)
+		return;
+	// the tags may already be gone on shutdown
+	if (!owner->getSystemState()->isShuttingDown())
+		rasterCache->release(rasterEntry);
+	rasterEntry=nullptr;
+	// don't draw into the shared chunk
+	if (!owner->cachedSurface.isChunkOwner)
+		owner->cachedSurface.tex=nullptr;
+	owner->cachedSurface.isChunkOwner=true;
 }
 
 _NR<DisplayObject> TokenContainer::hitTestImpl(_NR<DisplayObject> last, number_t x, number_t y, DisplayObject::HIT_TYPE type) const
@@ -60,6 +60,20 @@ public:
 	uint16_t getCurrentLineWidth() const;
 	float scaling;
 protected:
+	/* set by requestInvalidation if the tokens are drawn as a tessellated mesh
+	 * instead of a cached surface, only read by the render thread */
+	bool renderAsMesh;
+	bool canRenderAsMesh() const;
+	// returns false if the tokens could not be tessellated and the cached surface has to be used
+	bool renderMeshImpl(RenderContext& ctxt) const;
+	/* rasterizations shared with the other instances of the tag the tokens
+	 * were generated from, nullptr if the tokens may be changed */
+	ShapeRasterCache* rasterCache;
+	ShapeRasterCache::Entry* rasterEntry;
+	// the ratio of morph shapes, 0 otherwise
+	uint32_t rasterRatio;
+	// stops using the shared rasterization, the cached surface will be drawn again
+	void releaseSharedRaster();
 	TokenContainer(DisplayObject* _o);
 	TokenContainer(DisplayObject* _o, const tokensVector& _tokens, float _scaling);
 	IDrawable* invalidate(DisplayObject* target, const MATRIX& initialMatrix, bool smoothing, InvalidateQueue* q, _NR<DisplayObject>* cachedBitmap, bool fromgraphics);
@@ -2833,6 +2833,39 @@ void DisplayObjectContainer::finalize()
 	InteractiveObject::finalize();
 }
 
+void DisplayObjectContainer::gcChildren(std::vector<ASObject*>& children)
+{
+	InteractiveObject::gcChildren(children);
+	Locker l(mutexDisplayList);
+	for (auto it = dynamicDisplayList.begin(); it != dynamicDisplayList.end(); it++)
+		children.push_back(it->getPtr());
+	for (auto it = namedRemovedLegacyChildren.begin(); it != namedRemovedLegacyChildren.end(); it++)
+	{
+		if ((*it).second)
+			children.push_back((*it).second.getPtr());
+	}
+}
+
+void DisplayObjectContainer::gcClearReferences()
+{
+	// the children are released after the display list is unlocked
+	std::vector<_R<DisplayObject>> children;
+	map<int32_t,_NR<DisplayObject>> removedchildren;
+	{
+		Locker l(mutexDisplayList);
+		for (auto it = dynamicDisplayList.begin(); it != dynamicDisplayList.end(); it++)
+			(*it)->setParent(nullptr);
+		children.swap(dynamicDisplayList);
+		removedchildren.swap(namedRemovedLegacyChildren);
+		legacyChildrenMarkedForDeletion.clear();
+		mapDepthToLegacyChild.clear();
+		mapLegacyChildToDepth.clear();
+	}
+	children.clear();
+	removedchildren.clear();
+	InteractiveObject::gcClearReferences();
+}
+
 void DisplayObjectContainer::prepareShutdown()
 {
 	if (this->preparedforshutdown)
@@ -3561,17 +3594,15 @@ Shape::Shape(ASWorker* wrk, Class_base* c, float scaling, DefineShapeTag* tag):
 	DisplayObject(wrk,c),TokenContainer(this, *tag->tokens, scaling),graphics(NullRef),fromTag(tag)
 {
 	subtype=SUBTYPE_SHAPE;
+	rasterCache=&tag->rasterCache;
 }
 
 void Shape::setupShape(DefineShapeTag* tag, float _scaling)
 {
-	tokens.filltokens.assign(tag->tokens->filltokens.begin(),tag->tokens->filltokens.end());
-	tokens.stroketokens.assign(tag->tokens->stroketokens.begin(),tag->tokens->stroketokens.end());
+	tokens.filltokens=tag->tokens->filltokens;
+	tokens.stroketokens=tag->tokens->stroketokens;
 	fromTag = tag;
-	cachedSurface.isChunkOwner=false;
-	cachedSurface.tex=&tag->chunk;
-	if (tag->chunk.isValid()) // Shape texture was already created, so we don't have to redo it
-		resetNeedsTextureRecalculation();
+	rasterCache=&tag->rasterCache;
 	scaling=_scaling;
 }
 
@@ -3584,12 +3615,15 @@ bool Shape::destruct()
 {
 	graphics.reset();
 	fromTag=nullptr;
+	releaseSharedRaster();
+	rasterCache=nullptr;
 	return 	DisplayObject::destruct();
 }
 
 void Shape::finalize()
 {
 	graphics.reset();
+	releaseSharedRaster();
 	DisplayObject::finalize();
 }
 
@@ -3649,7 +3683,22 @@ MorphShape::MorphShape(ASWorker* wrk,Class_base *c, DefineMorphShapeTag* _morphs
 	subtype=SUBTYPE_MORPHSHAPE;
 	scaling = 1.0f/20.0f;
 	if (this->morphshapetag)
+	{
 		this->morphshapetag->getTokensForRatio(tokens,0);
+		rasterCache=&this->morphshapetag->rasterCache;
+	}
+}
+
+bool MorphShape::destruct()
+{
+	releaseSharedRaster();
+	return DisplayObject::destruct();
+}
+
+void MorphShape::finalize()
+{
+	releaseSharedRaster();
+	DisplayObject::finalize();
 }
 
 void MorphShape::sinit(Class_base* c)
@@ -3692,6 +3741,7 @@ void MorphShape::checkRatio(uint32_t ratio, bool inskipping)
 	if (inskipping)
 		return;
 	currentratio = ratio;
+	rasterRatio = ratio;
 	if (this->morphshapetag)
 		this->morphshapetag->getTokensForRatio(tokens,ratio);
 	this->hasChanged = true;
@@ -143,6 +143,8 @@ public:
 	bool destruct() override;
 	void finalize() override;
 	void prepareShutdown() override;
+	void gcChildren(std::vector<ASObject*>& children) override;
+	void gcClearReferences() override;
 	bool hasLegacyChildAt(int32_t depth);
 	// this does not test if a DisplayObject exists at the provided depth
 	DisplayObject* getLegacyChildAt(int32_t depth);
@@ -298,6 +300,8 @@ protected:
 public:
 	MorphShape(ASWorker* wrk,Class_base* c);
 	MorphShape(ASWorker* wrk, Class_base* c, DefineMorphShapeTag* _morphshapetag);
+	bool destruct() override;
+	void finalize() override;
 	static void sinit(Class_base* c);
 	void requestInvalidation(InvalidateQueue* q, bool forceTextureRefresh=false) override { TokenContainer::requestInvalidation(q,forceTextureRefresh); }
 	IDrawable* invalidate(DisplayObject* target, const MATRIX& initialMatrix, bool smoothing, InvalidateQueue* q, _NR<DisplayObject>* cachedBitmap) override;
@@ -632,6 +632,40 @@ void EventDispatcher::prepareShutdown()
 		it++;
 	}
 }
+void EventDispatcher::gcChildren(std::vector<ASObject*>& children)
+{
+	ASObject::gcChildren(children);
+	Locker l(handlersMutex);
+	for (auto it=handlers.begin(); it!=handlers.end(); ++it)
+	{
+		for (auto it2=it->second.begin(); it2!=it->second.end(); ++it2)
+		{
+			ASObject* f = asAtomHandler::getObject((*it2).f);
+			if (f)
+				children.push_back(f);
+		}
+	}
+}
+void EventDispatcher::gcClearReferences()
+{
+	{
+		Locker l(handlersMutex);
+		auto it=handlers.begin();
+		while(it!=handlers.end())
+		{
+			auto it2 = it->second.begin();
+			while (it2 != it->second.end())
+			{
+				IFunction* f = asAtomHandler::as<IFunction>((*it2).f);
+				getSystemState()->unregisterListenerFunction(f);
+				f->decRef();
+				it2 = it->second.erase(it2);
+			}
+			it = handlers.erase(it);
+		}
+	}
+	ASObject::gcClearReferences();
+}
 void EventDispatcher::sinit(Class_base* c)
 {
 	CLASS_SETUP(c, ASObject, _constructor, CLASS_SEALED);
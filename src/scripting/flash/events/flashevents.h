@@ -334,6 +334,8 @@ public:
 	void finalize() override;
 	bool destruct() override;
 	void prepareShutdown() override;
+	void gcChildren(std::vector<ASObject*>& children) override;
+	void gcClearReferences() override;
 	// is called when a new event is added to the event queue
 	virtual void onNewEvent(Event* ev){}
 	// is called after an event was handled by the event queue
@@ -518,6 +520,14 @@ public:
 	EVENT_TYPE getEventType() const override { return IDLE_EVENT; }
 };
 
+//Handled after all events queued before it, used to wait for the VM
+class SynchronizationEvent: public WaitableEvent
+{
+public:
+	SynchronizationEvent(): WaitableEvent("SynchronizationEvent") {}
+	EVENT_TYPE getEventType() const override { return SYNC; }
+};
+
 //Event to flush the invalidation queue
 class FlushInvalidationQueueEvent: public Event
 {
@@ -0,0 +1,357 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#include <vector>
+#include <SDL2/SDL_cpuinfo.h>
+#include "scripting/flash/filters/filterengine.h"
+#include "platforms/pixelkernels.h"
+#include "swf.h"
+#include "thread_pool.h"
+
+using namespace std;
+using namespace lightspark;
+
+// the radius of the previous stack blur implementation was limited by the size of its tables
+#define FILTER_MAX_BLUR_RADIUS 255
+// width of the bands of columns blurred by one thread, the column sums of a band stay in the L1 cache
+#define FILTER_BLUR_BAND_WIDTH 256
+// number of pixels below which work is not split between threads
+#define FILTER_MIN_PARALLEL_PIXELS 16384
+// scratch buffers larger than this are released if a much smaller one is requested
+#define FILTER_SCRATCH_KEEP_SIZE (16*1024*1024)
+
+namespace
+{
+// reusable buffers of the thread running a filter
+struct filterScratch
+{
+	vector<uint8_t> source;
+	vector<uint32_t> blur;
+	vector<int32_t> sums;
+};
+thread_local filterScratch scratch;
+
+template<class T>
+T* scratchBuffer(vector<T>& buf, size_t size)
+{
+	if (buf.capacity()*sizeof(T) > FILTER_SCRATCH_KEEP_SIZE && size*4 < buf.capacity())
+		vector<T>().swap(buf);
+	if (buf.size() < size)
+		buf.resize(size);
+	return buf.data();
+}
+
+uint32_t blurRadius(number_t blur)
+{
+	if (!(blur > 0))
+		return 0;
+	return min(uint32_t(FILTER_MAX_BLUR_RADIUS),uint32_t(round(min(blur,number_t(4*FILTER_MAX_BLUR_RADIUS))))>>1);
+}
+
+// rows of width pixels processed per slice of parallelFor
+uint32_t rowGrain(uint32_t width)
+{
+	return max(1u,FILTER_MIN_PARALLEL_PIXELS/max(1u,width));
+}
+
+// clips the rows and columns of a width x height buffer drawn at xpos,ypos to the target
+bool clipToTarget(uint32_t targetwidth, uint32_t targetheight, uint32_t width, uint32_t height, int xpos, int ypos,
+		  uint32_t& x0, uint32_t& x1, uint32_t& y0, uint32_t& y1)
+{
+	x0 = uint32_t(max(0,-xpos));
+	y0 = uint32_t(max(0,-ypos));
+	x1 = uint32_t(max(0,int(min(int64_t(width),int64_t(targetwidth)-xpos))));
+	y1 = uint32_t(max(0,int(min(int64_t(height),int64_t(targetheight)-ypos))));
+	return x0 < x1 && y0 < y1;
+}
+
+/*
+ * Composites a glow of color with the given glow alpha into the premultiplied pixel d.
+ * Inner glows are drawn on the opaque parts of the target, outer glows behind them.
+ * With knockout the target itself is removed
+ */
+inline void glowPixel(uint8_t* d, number_t glowalpha, number_t alpha, uint32_t color, number_t strength, bool inner, bool knockout)
+{
+	number_t srcalpha = max(0.0,min(1.0,glowalpha*alpha*strength/255.0));
+	number_t dstalpha = number_t(d[3])/255.0;
+	number_t coverage = inner ? dstalpha : 1.0-dstalpha;
+	number_t keep = knockout ? 0.0 : (inner ? 1.0-srcalpha : 1.0);
+	const uint32_t c[4] = { color&0xff, (color>>8)&0xff, (color>>16)&0xff, 0xff };
+	for (uint32_t i = 0; i < 4; i++)
+		d[i] = min(uint32_t(0xff),uint32_t(number_t(c[i])*srcalpha*coverage+number_t(d[i])*keep));
+}
+
+}
+
+void (*FilterEngine::launchHelper)(IThreadJob* job) = nullptr;
+
+void FilterEngine::parallelFor(uint32_t count, uint32_t grain, const std::function<void(uint32_t,uint32_t)>& f)
+{
+	uint32_t sliceCount = min(uint32_t(max(SDL_GetCPUCount(),1)),count/max(1u,grain));
+	lightspark::parallelFor(count,sliceCount,f,launchHelper);
+}
+
+uint8_t* FilterEngine::copyRect(const uint8_t* data, uint32_t width, uint32_t height, const RECT& rect)
+{
+	uint32_t rectwidth = uint32_t(max(0,rect.Xmax-rect.Xmin));
+	uint32_t rectheight = uint32_t(max(0,rect.Ymax-rect.Ymin));
+	uint8_t* ret = scratchBuffer(scratch.source,max(1u,rectwidth*rectheight*4));
+	uint32_t x0,x1,y0,y1;
+	if (!clipToTarget(width,height,rectwidth,rectheight,rect.Xmin,rect.Ymin,x0,x1,y0,y1))
+	{
+		memset(ret,0,rectwidth*rectheight*4);
+		return ret;
+	}
+	for (uint32_t y = 0; y < rectheight; y++)
+	{
+		uint8_t* row = ret+y*rectwidth*4;
+		if (y < y0 || y >= y1)
+		{
+			memset(row,0,rectwidth*4);
+			continue;
+		}
+		memset(row,0,x0*4);
+		memcpy(row+x0*4,data+((rect.Ymin+y)*width+rect.Xmin+x0)*4,(x1-x0)*4);
+		memset(row+x1*4,0,(rectwidth-x1)*4);
+	}
+	return ret;
+}
+
+void FilterEngine::blur(uint8_t* data, uint32_t width, uint32_t height, number_t blurx, number_t blury, int quality)
+{
+	uint32_t radiusX = blurRadius(blurx);
+	uint32_t radiusY = blurRadius(blury);
+	if ((radiusX == 0 && radiusY == 0) || width == 0 || height == 0)
+		return;
+	// a box blur repeated three times is close to a gaussian blur, flash allows up to 15 passes
+	quality = min(quality,15);
+	uint32_t* pixels = (uint32_t*)data;
+	uint32_t* tmp = scratchBuffer(scratch.blur,size_t(width)*height);
+	uint32_t bands = (width+FILTER_BLUR_BAND_WIDTH-1)/FILTER_BLUR_BAND_WIDTH;
+	for (int pass = 0; pass < quality; pass++)
+	{
+		// the horizontal pass writes to tmp, the vertical pass back to data
+		parallelFor(height,rowGrain(width),[=](uint32_t y0, uint32_t y1)
+		{
+			for (uint32_t y = y0; y < y1; y++)
+				pixelBoxBlurRow(tmp+y*width,pixels+y*width,width,radiusX);
+		});
+		parallelFor(bands,max(1u,FILTER_MIN_PARALLEL_PIXELS/(FILTER_BLUR_BAND_WIDTH*height)),[=](uint32_t b0, uint32_t b1)
+		{
+			int32_t* sums = scratchBuffer(scratch.sums,FILTER_BLUR_BAND_WIDTH*4);
+			for (uint32_t b = b0; b < b1; b++)
+			{
+				uint32_t x = b*FILTER_BLUR_BAND_WIDTH;
+				pixelBoxBlurColumns(pixels+x,tmp+x,width,min(uint32_t(FILTER_BLUR_BAND_WIDTH),width-x),height,radiusY,sums);
+			}
+		});
+	}
+}
+
+void FilterEngine::dropShadow(uint8_t* target, uint32_t targetwidth, uint32_t targetheight, const uint8_t* src, uint32_t width, uint32_t height,
+			      int xpos, int ypos, number_t strength, number_t alpha, uint32_t color, bool inner, bool knockout)
+{
+	uint32_t x0,x1,y0,y1;
+	if (!clipToTarget(targetwidth,targetheight,width,height,xpos,ypos,x0,x1,y0,y1))
+		return;
+	parallelFor(y1-y0,rowGrain(x1-x0),[&](uint32_t r0, uint32_t r1)
+	{
+		for (uint32_t y = y0+r0; y < y0+r1; y++)
+		{
+			const uint8_t* s = src+(y*width+x0)*4;
+			uint8_t* d = target+((ypos+y)*targetwidth+xpos+x0)*4;
+			for (uint32_t x = x0; x < x1; x++, s+=4, d+=4)
+				glowPixel(d,inner ? 0xff-s[3] : s[3],alpha,color,strength,inner,knockout);
+		}
+	});
+}
+
+void FilterEngine::gradientGlow(uint8_t* target, uint32_t targetwidth, uint32_t targetheight, const uint8_t* src, uint32_t width, uint32_t height,
+				int xpos, int ypos, number_t strength, const number_t* alphas, const uint32_t* colors, bool inner, bool knockout)
+{
+	uint32_t x0,x1,y0,y1;
+	if (!clipToTarget(targetwidth,targetheight,width,height,xpos,ypos,x0,x1,y0,y1))
+		return;
+	parallelFor(y1-y0,rowGrain(x1-x0),[&](uint32_t r0, uint32_t r1)
+	{
+		for (uint32_t y = y0+r0; y < y0+r1; y++)
+		{
+			const uint8_t* s = src+(y*width+x0)*4;
+			uint8_t* d = target+((ypos+y)*targetwidth+xpos+x0)*4;
+			for (uint32_t x = x0; x < x1; x++, s+=4, d+=4)
+			{
+				uint32_t glowalpha = inner ? 0xff-s[3] : s[3];
+				glowPixel(d,glowalpha,alphas[glowalpha],colors[glowalpha],strength,inner,knockout);
+			}
+		}
+	});
+}
+
+void FilterEngine::colorMatrix(uint8_t* target, uint32_t targetwidth, uint32_t targetheight, const uint8_t* src, uint32_t width, uint32_t height,
+			       int xpos, int ypos, const number_t* m)
+{
+	uint32_t x0,x1,y0,y1;
+	if (!clipToTarget(targetwidth,targetheight,width,height,xpos,ypos,x0,x1,y0,y1))
+		return;
+	parallelFor(y1-y0,rowGrain(x1-x0),[&](uint32_t r0, uint32_t r1)
+	{
+		for (uint32_t y = y0+r0; y < y0+r1; y++)
+		{
+			const uint8_t* s = src+(y*width+x0)*4;
+			uint8_t* d = target+((ypos+y)*targetwidth+xpos+x0)*4;
+			for (uint32_t x = x0; x < x1; x++, s+=4, d+=4)
+			{
+				number_t srcA = number_t(s[3]);
+				number_t srcR = number_t(s[2])*srcA/255.0;
+				number_t srcG = number_t(s[1])*srcA/255.0;
+				number_t srcB = number_t(s[0])*srcA/255.0;
+				number_t redResult   = (m[0 ]*srcR) + (m[1 ]*srcG) + (m[2 ]*srcB) + (m[3 ]*srcA) + m[4 ];
+				number_t greenResult = (m[5 ]*srcR) + (m[6 ]*srcG) + (m[7 ]*srcB) + (m[8 ]*srcA) + m[9 ];
+				number_t blueResult  = (m[10]*srcR) + (m[11]*srcG) + (m[12]*srcB) + (m[13]*srcA) + m[14];
+				number_t alphaResult = (m[15]*srcR) + (m[16]*srcG) + (m[17]*srcB) + (m[18]*srcA) + m[19];
+				d[0] = max(int32_t(0),min(int32_t(0xff),int32_t(blueResult *alphaResult/255.0)));
+				d[1] = max(int32_t(0),min(int32_t(0xff),int32_t(greenResult*alphaResult/255.0)));
+				d[2] = max(int32_t(0),min(int32_t(0xff),int32_t(redResult  *alphaResult/255.0)));
+				d[3] = max(int32_t(0),min(int32_t(0xff),int32_t(alphaResult)));
+			}
+		}
+	});
+}
+
+void FilterEngine::convolution(uint8_t* target, uint32_t targetwidth, uint32_t targetheight, const uint8_t* src, uint32_t width, uint32_t height,
+			       int xpos, int ypos, const number_t* matrix, uint32_t matrixx, uint32_t matrixy, number_t divisor, number_t bias,
+			       bool preserveAlpha, bool clamp, uint32_t color, number_t alpha)
+{
+	uint32_t x0,x1,y0,y1;
+	if (!clipToTarget(targetwidth,targetheight,width,height,xpos,ypos,x0,x1,y0,y1) || matrixx == 0 || matrixy == 0)
+		return;
+	// the result is written to the target, so the filter must not read its own output
+	assert(target != src);
+	const number_t outside[4] = { number_t(color&0xff), number_t((color>>8)&0xff), number_t((color>>16)&0xff), alpha*255.0 };
+	const number_t realdivisor = divisor==0 ? 1.0 : divisor;
+	parallelFor(y1-y0,max(1u,rowGrain(x1-x0)/(matrixx*matrixy)),[&](uint32_t r0, uint32_t r1)
+	{
+		for (uint32_t y = y0+r0; y < y0+r1; y++)
+		{
+			uint8_t* d = target+((ypos+y)*targetwidth+xpos+x0)*4;
+			for (uint32_t x = x0; x < x1; x++, d+=4)
+			{
+				number_t result[4] = { 0, 0, 0, 0 };
+				for (uint32_t my = 0; my < matrixy; my++)
+				{
+					int32_t sy = int32_t(y+my)-int32_t(matrixy/2);
+					for (uint32_t mx = 0; mx < matrixx; mx++)
+					{
+						int32_t sx = int32_t(x+mx)-int32_t(matrixx/2);
+						number_t f = matrix[my*matrixx+mx];
+						if (sx >= 0 && sy >= 0 && sx < int32_t(width) && sy < int32_t(height))
+						{
+							const uint8_t* s = src+(sy*width+sx)*4;
+							for (uint32_t c = 0; c < 4; c++)
+								result[c] += number_t(s[c])*f;
+						}
+						else if (clamp)
+						{
+							const uint8_t* s = src+(max(0,min(int32_t(height)-1,sy))*width+max(0,min(int32_t(width)-1,sx)))*4;
+							for (uint32_t c = 0; c < 4; c++)
+								result[c] += number_t(s[c])*f;
+						}
+						else
+						{
+							for (uint32_t c = 0; c < 4; c++)
+								result[c] += outside[c]*f;
+						}
+					}
+				}
+				int32_t a = preserveAlpha ? src[(y*width+x)*4+3] : max(int32_t(0),min(int32_t(0xff),int32_t(result[3]/realdivisor+bias)));
+				// keep the pixel premultiplied
+				for (uint32_t c = 0; c < 3; c++)
+					d[c] = max(int32_t(0),min(a,int32_t(result[c]/realdivisor+bias)));
+				d[3] = a;
+			}
+		}
+	});
+}
+
+void FilterEngine::displacementMap(uint8_t* target, uint32_t targetwidth, uint32_t targetheight, const uint8_t* src, uint32_t width, uint32_t height,
+				   int xpos, int ypos, const uint8_t* map, uint32_t mapwidth, uint32_t mapheight, int mapx, int mapy,
+				   uint32_t componentx, uint32_t componenty, number_t scalex, number_t scaley, DISPLACEMENT_MODE mode, uint32_t color, number_t alpha)
+{
+	uint32_t x0,x1,y0,y1;
+	if (!clipToTarget(targetwidth,targetheight,width,height,xpos,ypos,x0,x1,y0,y1))
+		return;
+	assert(target != src);
+	uint32_t a = uint32_t(max(0.0,min(1.0,alpha))*255.0);
+	// premultiplied color used for pixels from outside of src in DISPLACEMENT_COLOR mode
+	uint8_t outside[4] = { uint8_t((color&0xff)*a/255), uint8_t(((color>>8)&0xff)*a/255), uint8_t(((color>>16)&0xff)*a/255), uint8_t(a) };
+	parallelFor(y1-y0,rowGrain(x1-x0),[&](uint32_t r0, uint32_t r1)
+	{
+		for (uint32_t y = y0+r0; y < y0+r1; y++)
+		{
+			uint8_t* d = target+((ypos+y)*targetwidth+xpos+x0)*4;
+			for (uint32_t x = x0; x < x1; x++, d+=4)
+			{
+				int32_t sx = x;
+				int32_t sy = y;
+				int32_t mx = int32_t(x)-mapx;
+				int32_t my = int32_t(y)-mapy;
+				// pixels not covered by the map are not displaced
+				if (mx >= 0 && my >= 0 && mx < int32_t(mapwidth) && my < int32_t(mapheight))
+				{
+					const uint8_t* m = map+(my*mapwidth+mx)*4;
+					sx += int32_t(floor((number_t(m[componentx])-128.0)*scalex/256.0));
+					sy += int32_t(floor((number_t(m[componenty])-128.0)*scaley/256.0));
+				}
+				const uint8_t* s = nullptr;
+				if (sx >= 0 && sy >= 0 && sx < int32_t(width) && sy < int32_t(height))
+					s = src+(sy*width+sx)*4;
+				else
+				{
+					switch (mode)
+					{
+						case DISPLACEMENT_WRAP:
+							sx %= int32_t(width);
+							sy %= int32_t(height);
+							s = src+((sy < 0 ? sy+height : sy)*width+(sx < 0 ? sx+width : sx))*4;
+							break;
+						case DISPLACEMENT_CLAMP:
+							s = src+(max(0,min(int32_t(height)-1,sy))*width+max(0,min(int32_t(width)-1,sx)))*4;
+							break;
+						case DISPLACEMENT_IGNORE:
+							s = src+(y*width+x)*4;
+							break;
+						case DISPLACEMENT_COLOR:
+							s = outside;
+							break;
+					}
+				}
+				memcpy(d,s,4);
+			}
+		}
+	});
+}
+
+void FilterEngine::copy(uint8_t* target, uint32_t targetwidth, uint32_t targetheight, const uint8_t* src, uint32_t width, uint32_t height, int xpos, int ypos)
+{
+	uint32_t x0,x1,y0,y1;
+	if (!clipToTarget(targetwidth,targetheight,width,height,xpos,ypos,x0,x1,y0,y1))
+		return;
+	for (uint32_t y = y0; y < y1; y++)
+		memcpy(target+((ypos+y)*targetwidth+xpos+x0)*4,src+(y*width+x0)*4,(x1-x0)*4);
+}
@@ -0,0 +1,93 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#ifndef SCRIPTING_FLASH_FILTERS_FILTERENGINE_H
+#define SCRIPTING_FLASH_FILTERS_FILTERENGINE_H 1
+
+#include "compat.h"
+#include "swftypes.h"
+#include <functional>
+
+namespace lightspark
+{
+class IThreadJob;
+
+/*
+ * Pixel pipelines of the flash.filters classes. All buffers hold premultiplied
+ * 32 bit pixels without padding between the rows, like BitmapContainer.
+ * Large images are split into bands of rows or columns that are processed by
+ * the calling thread and helper jobs of the ThreadPool. The temporary buffers
+ * are kept per thread and reused by the following filters
+ */
+class FilterEngine
+{
+public:
+	// how DisplacementMapFilter handles pixels displaced from outside of the source
+	enum DISPLACEMENT_MODE { DISPLACEMENT_WRAP=0, DISPLACEMENT_CLAMP, DISPLACEMENT_IGNORE, DISPLACEMENT_COLOR };
+	/*
+	 * Calls f(begin,end) for slices of [0,count), the slices are at least
+	 * grain long and may run in parallel. Returns when all slices are done
+	 */
+	static void parallelFor(uint32_t count, uint32_t grain, const std::function<void(uint32_t,uint32_t)>& f);
+	/*
+	 * Starts a helper job of parallelFor, nullptr (the default) adds the job
+	 * to the ThreadPool of the current SystemState. Tools running without a
+	 * SystemState may replace it
+	 */
+	static void (*launchHelper)(IThreadJob* job);
+	/*
+	 * Copies rect of a width x height bitmap to a buffer owned by the calling
+	 * thread, pixels outside of the bitmap are transparent. The buffer is
+	 * valid until the next call of copyRect on the same thread
+	 */
+	static uint8_t* copyRect(const uint8_t* data, uint32_t width, uint32_t height, const RECT& rect);
+	// blurs data in place, blurx and blury are the box sizes of the flash filters
+	static void blur(uint8_t* data, uint32_t width, uint32_t height, number_t blurx, number_t blury, int quality);
+	/*
+	 * The compositing functions draw a width x height src buffer at xpos,ypos
+	 * in a targetwidth x targetheight target buffer, clipped to the target.
+	 * dropShadow fills the alpha channel of src (or its inverse, if inner is set) with color
+	 */
+	static void dropShadow(uint8_t* target, uint32_t targetwidth, uint32_t targetheight, const uint8_t* src, uint32_t width, uint32_t height,
+			       int xpos, int ypos, number_t strength, number_t alpha, uint32_t color, bool inner, bool knockout);
+	// like dropShadow, but the alpha and color are looked up in the 256 entry gradient tables
+	static void gradientGlow(uint8_t* target, uint32_t targetwidth, uint32_t targetheight, const uint8_t* src, uint32_t width, uint32_t height,
+				 int xpos, int ypos, number_t strength, const number_t* alphas, const uint32_t* colors, bool inner, bool knockout);
+	// matrix is the 4x5 matrix of ColorMatrixFilter
+	static void colorMatrix(uint8_t* target, uint32_t targetwidth, uint32_t targetheight, const uint8_t* src, uint32_t width, uint32_t height,
+				int xpos, int ypos, const number_t* matrix);
+	/*
+	 * matrix has matrixx*matrixy entries, the result is divided by divisor and bias is added.
+	 * Pixels outside of src are clamped to the edges or replaced by color and alpha
+	 */
+	static void convolution(uint8_t* target, uint32_t targetwidth, uint32_t targetheight, const uint8_t* src, uint32_t width, uint32_t height,
+				int xpos, int ypos, const number_t* matrix, uint32_t matrixx, uint32_t matrixy, number_t divisor, number_t bias,
+				bool preserveAlpha, bool clamp, uint32_t color, number_t alpha);
+	/*
+	 * The pixels of src are displaced by the channels componentx and componenty (byte offsets
+	 * in a pixel) of a mapwidth x mapheight map, which is placed at mapx,mapy in src
+	 */
+	static void displacementMap(uint8_t* target, uint32_t targetwidth, uint32_t targetheight, const uint8_t* src, uint32_t width, uint32_t height,
+				    int xpos, int ypos, const uint8_t* map, uint32_t mapwidth, uint32_t mapheight, int mapx, int mapy,
+				    uint32_t componentx, uint32_t componenty, number_t scalex, number_t scaley, DISPLACEMENT_MODE mode, uint32_t color, number_t alpha);
+	static void copy(uint8_t* target, uint32_t targetwidth, uint32_t targetheight, const uint8_t* src, uint32_t width, uint32_t height, int xpos, int ypos);
+};
+
+}
+#endif /* SCRIPTING_FLASH_FILTERS_FILTERENGINE_H */
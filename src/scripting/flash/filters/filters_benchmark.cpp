@@ -0,0 +1,228 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+/*
+ * Benchmark of the pixel pipelines of the BitmapFilter subclasses. Every
+ * filter is applied the same way as its applyFilter implementation, with
+ * helper jobs run inline (single threaded) and on separate threads, at every
+ * pixel kernel level supported by the cpu. All outputs must be identical to
+ * the single threaded scalar output.
+ * ShaderFilter is not covered, it has no pixel pipeline yet.
+ * Usage: filters_benchmark [width] [height] [iterations]
+ */
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#include "threading.h"
+#include "scripting/flash/filters/filterengine.h"
+#include "platforms/pixelkernels.h"
+
+using namespace std;
+using namespace lightspark;
+
+static void runHelperInline(IThreadJob* job)
+{
+	job->execute();
+	job->jobFence();
+}
+
+static void runHelperThread(IThreadJob* job)
+{
+	thread([job]() { job->execute(); job->jobFence(); }).detach();
+}
+
+struct filterInput
+{
+	uint32_t width;
+	uint32_t height;
+	vector<uint8_t> source;
+	vector<uint8_t> map;
+	number_t gradientalphas[256];
+	uint32_t gradientcolors[256];
+};
+
+// random premultiplied pixels, with transparent and opaque areas like in rendered shapes
+static vector<uint8_t> makeImage(mt19937& rng, uint32_t width, uint32_t height)
+{
+	vector<uint8_t> image(width*height*4);
+	for (uint32_t y = 0; y < height; y++)
+	{
+		for (uint32_t x = 0; x < width; x++)
+		{
+			uint8_t* p = &image[(y*width+x)*4];
+			uint32_t area = ((x/64)+(y/64))%3;
+			uint8_t a = area == 0 ? 0 : (area == 1 ? 0xff : uint8_t(rng()));
+			for (uint32_t c = 0; c < 3; c++)
+				p[c] = uint8_t(rng()%(uint32_t(a)+1));
+			p[3] = a;
+		}
+	}
+	return image;
+}
+
+int main(int argc, char* argv[])
+{
+	uint32_t width = argc > 1 ? atoi(argv[1]) : 1024;
+	uint32_t height = argc > 2 ? atoi(argv[2]) : 768;
+	uint32_t iterations = argc > 3 ? atoi(argv[3]) : 10;
+	if (width == 0 || height == 0 || iterations == 0)
+	{
+		cerr << "usage: " << argv[0] << " [width] [height] [iterations]" << endl;
+		return 1;
+	}
+
+	mt19937 rng(42);
+	filterInput in;
+	in.width = width;
+	in.height = height;
+	in.source = makeImage(rng,width,height);
+	in.map = makeImage(rng,width,height);
+	for (uint32_t i = 0; i < 256; i++)
+	{
+		in.gradientalphas[i] = i < 128 ? 0.5 : 1.0;
+		in.gradientcolors[i] = i < 128 ? 0xff0000 : 0x0000ff;
+	}
+	// the filters are drawn on a copy of the source, like the filters of a DisplayObject
+	const RECT rect(0,width,0,height);
+	const int offsetx = int(cos(M_PI/4)*4);
+	const int offsety = int(sin(M_PI/4)*4);
+
+	struct benchmark
+	{
+		const char* name;
+		void (*filter)(uint8_t* target, const filterInput& in, const RECT& rect, int offsetx, int offsety);
+	};
+	const benchmark benchmarks[] =
+	{
+		{ "BlurFilter", [](uint8_t* t, const filterInput& in, const RECT& r, int, int)
+			{
+				uint8_t* tmp = FilterEngine::copyRect(t,in.width,in.height,r);
+				FilterEngine::blur(tmp,in.width,in.height,4.0,4.0,1);
+				FilterEngine::copy(t,in.width,in.height,tmp,in.width,in.height,0,0);
+			} },
+		{ "BlurFilter high quality", [](uint8_t* t, const filterInput& in, const RECT& r, int, int)
+			{
+				uint8_t* tmp = FilterEngine::copyRect(t,in.width,in.height,r);
+				FilterEngine::blur(tmp,in.width,in.height,32.0,16.0,3);
+				FilterEngine::copy(t,in.width,in.height,tmp,in.width,in.height,0,0);
+			} },
+		{ "GlowFilter", [](uint8_t* t, const filterInput& in, const RECT& r, int, int)
+			{
+				uint8_t* tmp = FilterEngine::copyRect(t,in.width,in.height,r);
+				FilterEngine::blur(tmp,in.width,in.height,6.0,6.0,2);
+				FilterEngine::dropShadow(t,in.width,in.height,tmp,in.width,in.height,0,0,2.0,1.0,0xff0000,false,false);
+			} },
+		{ "DropShadowFilter", [](uint8_t* t, const filterInput& in, const RECT& r, int ox, int oy)
+			{
+				uint8_t* tmp = FilterEngine::copyRect(t,in.width,in.height,r);
+				FilterEngine::blur(tmp,in.width,in.height,4.0,4.0,1);
+				FilterEngine::dropShadow(t,in.width,in.height,tmp,in.width,in.height,ox,oy,1.0,1.0,0,false,false);
+			} },
+		{ "GradientGlowFilter", [](uint8_t* t, const filterInput& in, const RECT& r, int, int)
+			{
+				uint8_t* tmp = FilterEngine::copyRect(t,in.width,in.height,r);
+				FilterEngine::blur(tmp,in.width,in.height,4.0,4.0,1);
+				FilterEngine::gradientGlow(t,in.width,in.height,tmp,in.width,in.height,0,0,1.0,in.gradientalphas,in.gradientcolors,false,false);
+			} },
+		{ "BevelFilter", [](uint8_t* t, const filterInput& in, const RECT& r, int ox, int oy)
+			{
+				uint8_t* tmp = FilterEngine::copyRect(t,in.width,in.height,r);
+				FilterEngine::blur(tmp,in.width,in.height,4.0,4.0,1);
+				FilterEngine::dropShadow(t,in.width,in.height,tmp,in.width,in.height,ox,oy,1.0,1.0,0,true,false);
+				FilterEngine::dropShadow(t,in.width,in.height,tmp,in.width,in.height,-ox,-oy,1.0,1.0,0xffffff,true,false);
+			} },
+		{ "GradientBevelFilter", [](uint8_t* t, const filterInput& in, const RECT& r, int ox, int oy)
+			{
+				uint8_t* tmp = FilterEngine::copyRect(t,in.width,in.height,r);
+				FilterEngine::blur(tmp,in.width,in.height,4.0,4.0,1);
+				FilterEngine::gradientGlow(t,in.width,in.height,tmp,in.width,in.height,ox,oy,1.0,in.gradientalphas,in.gradientcolors,true,false);
+				FilterEngine::gradientGlow(t,in.width,in.height,tmp,in.width,in.height,-ox,-oy,1.0,in.gradientalphas,in.gradientcolors,true,false);
+			} },
+		{ "ColorMatrixFilter", [](uint8_t* t, const filterInput& in, const RECT& r, int, int)
+			{
+				// grayscale
+				const number_t m[20] = { 0.3,0.59,0.11,0,0, 0.3,0.59,0.11,0,0, 0.3,0.59,0.11,0,0, 0,0,0,1,0 };
+				uint8_t* tmp = FilterEngine::copyRect(t,in.width,in.height,r);
+				FilterEngine::colorMatrix(t,in.width,in.height,tmp,in.width,in.height,0,0,m);
+			} },
+		{ "ConvolutionFilter", [](uint8_t* t, const filterInput& in, const RECT& r, int, int)
+			{
+				// sharpen
+				const number_t m[9] = { 0,-1,0, -1,5,-1, 0,-1,0 };
+				uint8_t* tmp = FilterEngine::copyRect(t,in.width,in.height,r);
+				FilterEngine::convolution(t,in.width,in.height,tmp,in.width,in.height,0,0,m,3,3,1.0,0.0,false,true,0,0.0);
+			} },
+		{ "DisplacementMapFilter", [](uint8_t* t, const filterInput& in, const RECT& r, int, int)
+			{
+				uint8_t* tmp = FilterEngine::copyRect(t,in.width,in.height,r);
+				FilterEngine::displacementMap(t,in.width,in.height,tmp,in.width,in.height,0,0,in.map.data(),in.width,in.height,0,0,
+							      2,1,16.0,16.0,FilterEngine::DISPLACEMENT_WRAP,0,0.0);
+			} },
+	};
+
+	bool failed = false;
+	cout << "filter,level,threads,mpixels/s,speedup" << endl;
+	for (const benchmark& b : benchmarks)
+	{
+		vector<uint8_t> reference;
+		double referencespeed = 0;
+		for (int l = PIXELKERNEL_SCALAR; l <= PIXELKERNEL_NEON; l++)
+		{
+			PIXELKERNEL_LEVEL level = PIXELKERNEL_LEVEL(l);
+			if (!setPixelKernelLevel(level))
+				continue;
+			for (int threaded = 0; threaded < 2; threaded++)
+			{
+				FilterEngine::launchHelper = threaded ? runHelperThread : runHelperInline;
+				// first call is not timed, it also provides the output used for comparison
+				vector<uint8_t> output = in.source;
+				b.filter(output.data(),in,rect,offsetx,offsety);
+				vector<uint8_t> work = in.source;
+				auto start = chrono::steady_clock::now();
+				for (uint32_t i = 0; i < iterations; i++)
+				{
+					memcpy(work.data(),in.source.data(),work.size());
+					b.filter(work.data(),in,rect,offsetx,offsety);
+				}
+				double seconds = chrono::duration<double>(chrono::steady_clock::now()-start).count();
+				double speed = seconds > 0 ? double(width)*height*iterations/seconds/1e6 : 0;
+				if (reference.empty())
+				{
+					reference = output;
+					referencespeed = speed;
+				}
+				cout << b.name << "," << getPixelKernelLevelName(level) << "," << (threaded ? "all" : "1") << ","
+				     << speed << "," << (referencespeed > 0 ? speed/referencespeed : 0) << endl;
+				if (output != reference)
+				{
+					cerr << b.name << ": " << getPixelKernelLevelName(level) << (threaded ? " multithreaded" : "")
+					     << " output differs from single threaded scalar output" << endl;
+					failed = true;
+				}
+			}
+		}
+	}
+	return failed ? 1 : 0;
+}
@@ -18,6 +18,7 @@
 **************************************************************************/
 
 #include "scripting/flash/filters/flashfilters.h"
+#include "scripting/flash/filters/filterengine.h"
 #include "scripting/class.h"
 #include "scripting/argconv.h"
 #include "scripting/flash/display/BitmapData.h"
@@ -42,295 +43,26 @@ BitmapFilter* BitmapFilter::cloneImpl() const
 	return Class<BitmapFilter>::getInstanceS(getInstanceWorker());
 }
 
-// blur algorithm taken from haxe https://github.com/haxelime/lime/blob/develop/src/lime/_internal/graphics/StackBlur.hx
-int MUL_TABLE[] =
-{
-	1, 171, 205, 293, 57, 373, 79, 137, 241, 27, 391, 357, 41, 19, 283, 265, 497, 469, 443, 421, 25, 191, 365, 349, 335, 161, 155, 149, 9, 278, 269, 261,
-	505, 245, 475, 231, 449, 437, 213, 415, 405, 395, 193, 377, 369, 361, 353, 345, 169, 331, 325, 319, 313, 307, 301, 37, 145, 285, 281, 69, 271, 267,
-	263, 259, 509, 501, 493, 243, 479, 118, 465, 459, 113, 446, 55, 435, 429, 423, 209, 413, 51, 403, 199, 393, 97, 3, 379, 375, 371, 367, 363, 359, 355,
-	351, 347, 43, 85, 337, 333, 165, 327, 323, 5, 317, 157, 311, 77, 305, 303, 75, 297, 294, 73, 289, 287, 71, 141, 279, 277, 275, 68, 135, 67, 133, 33,
-	262, 260, 129, 511, 507, 503, 499, 495, 491, 61, 121, 481, 477, 237, 235, 467, 232, 115, 457, 227, 451, 7, 445, 221, 439, 218, 433, 215, 427, 425,
-	211, 419, 417, 207, 411, 409, 203, 202, 401, 399, 396, 197, 49, 389, 387, 385, 383, 95, 189, 47, 187, 93, 185, 23, 183, 91, 181, 45, 179, 89, 177, 11,
-	175, 87, 173, 345, 343, 341, 339, 337, 21, 167, 83, 331, 329, 327, 163, 81, 323, 321, 319, 159, 79, 315, 313, 39, 155, 309, 307, 153, 305, 303, 151,
-	75, 299, 149, 37, 295, 147, 73, 291, 145, 289, 287, 143, 285, 71, 141, 281, 35, 279, 139, 69, 275, 137, 273, 17, 271, 135, 269, 267, 133, 265, 33,
-	263, 131, 261, 130, 259, 129, 257, 1
-};
-int SHG_TABLE[] =
-{
-	0, 9, 10, 11, 9, 12, 10, 11, 12, 9, 13, 13, 10, 9, 13, 13, 14, 14, 14, 14, 10, 13, 14, 14, 14, 13, 13, 13, 9, 14, 14, 14, 15, 14, 15, 14, 15, 15, 14,
-	15, 15, 15, 14, 15, 15, 15, 15, 15, 14, 15, 15, 15, 15, 15, 15, 12, 14, 15, 15, 13, 15, 15, 15, 15, 16, 16, 16, 15, 16, 14, 16, 16, 14, 16, 13, 16,
-	16, 16, 15, 16, 13, 16, 15, 16, 14, 9, 16, 16, 16, 16, 16, 16, 16, 16, 16, 13, 14, 16, 16, 15, 16, 16, 10, 16, 15, 16, 14, 16, 16, 14, 16, 16, 14, 16,
-	16, 14, 15, 16, 16, 16, 14, 15, 14, 15, 13, 16, 16, 15, 17, 17, 17, 17, 17, 17, 14, 15, 17, 17, 16, 16, 17, 16, 15, 17, 16, 17, 11, 17, 16, 17, 16,
-	17, 16, 17, 17, 16, 17, 17, 16, 17, 17, 16, 16, 17, 17, 17, 16, 14, 17, 17, 17, 17, 15, 16, 14, 16, 15, 16, 13, 16, 15, 16, 14, 16, 15, 16, 12, 16,
-	15, 16, 17, 17, 17, 17, 17, 13, 16, 15, 17, 17, 17, 16, 15, 17, 17, 17, 16, 15, 17, 17, 14, 16, 17, 17, 16, 17, 17, 16, 15, 17, 16, 14, 17, 16, 15,
-	17, 16, 17, 17, 16, 17, 15, 16, 17, 14, 17, 16, 15, 17, 16, 17, 13, 17, 16, 17, 17, 16, 17, 14, 17, 16, 17, 16, 17, 16, 17, 9
-};
+ATOMIC_INT32(BitmapFilter::lastVersion);
 
-void BitmapFilter::applyBlur(uint8_t* data, uint32_t width, uint32_t height, number_t blurx, number_t blury, int quality)
+uint32_t BitmapFilter::nextVersion()
 {
-	int radiusX = int(round(blurx)) >> 1;
-	int radiusY = int(round(blury)) >> 1;
-	if (radiusX >= int(sizeof(MUL_TABLE)/sizeof(int)))
-		radiusX = sizeof(MUL_TABLE)/sizeof(int)-1;
-	if (radiusY >= int(sizeof(MUL_TABLE)/sizeof(int)))
-		radiusY = sizeof(MUL_TABLE)/sizeof(int)-1;
-	if (radiusX<=0 || radiusY <= 0)
-		return;
-
-	int iterations = quality;
-
-	uint8_t* px = data;
-	int x, y, i, p, yp, yi, yw;
-	int r, g, b, a, pr, pg, pb, pa;
-
-	int divx = (radiusX + radiusX + 1);
-	int divy = (radiusY + radiusY + 1);
-	int w = width;
-	int h = height;
-
-	int w1 = w - 1;
-	int h1 = h - 1;
-	int rxp1 = radiusX + 1;
-	int ryp1 = radiusY + 1;
-
-	std::vector<RGBA> ssx;
-	ssx.resize(divx);
-	std::vector<RGBA> ssy;
-	ssy.resize(divy);
-
-	int mtx = MUL_TABLE[radiusX];
-	int stx = SHG_TABLE[radiusX];
-	int mty = MUL_TABLE[radiusY];
-	int sty = SHG_TABLE[radiusY];
+	return ++lastVersion;
+}
 
-	while (iterations > 0)
-	{
-		iterations--;
-		yw = yi = 0;
-		int ms = mtx;
-		int ss = stx;
-		y = h;
-		do
-		{
-			r = rxp1 * (pr = px[yi]);
-			g = rxp1 * (pg = px[yi + 1]);
-			b = rxp1 * (pb = px[yi + 2]);
-			a = rxp1 * (pa = px[yi + 3]);
-			auto sx = ssx.begin();
-			i = rxp1;
-			do
-			{
-				(*sx).Red = pr;
-				(*sx).Green = pg;
-				(*sx).Blue = pb;
-				(*sx).Alpha = pa;
-				sx++;
-				if (sx == ssx.end())
-					sx = ssx.begin();
-			}
-			while (--i > -1);
-			
-			for (i = 1; i < rxp1; i++)
-			{
-				p = yi + ((w1 < i ? w1 : i) << 2);
-				r += ((*sx).Red = px[p]);
-				g += ((*sx).Green = px[p + 1]);
-				b += ((*sx).Blue = px[p + 2]);
-				a += ((*sx).Alpha = px[p + 3]);
-				sx++;
-				if (sx == ssx.end())
-					sx = ssx.begin();
-			}
-			
-			auto si = ssx.begin();
-			for (x = 0; x < w; x++)
-			{
-				px[yi++] = uint32_t(r * ms) >> ss;
-				px[yi++] = uint32_t(g * ms) >> ss;
-				px[yi++] = uint32_t(b * ms) >> ss;
-				px[yi++] = uint32_t(a * ms) >> ss;
-				p = x + radiusX + 1;
-				p = (yw + (p < w1 ? p : w1)) << 2;
-				r -= (*si).Red;
-				r += ((*si).Red = px[p]);
-				g -= (*si).Green;
-				g += ((*si).Green = px[p + 1]);
-				b -= (*si).Blue;
-				b += ((*si).Blue = px[p + 2]);
-				a -= (*si).Alpha;
-				a += ((*si).Alpha = px[p + 3]);
-				si++;
-				if (si == ssx.end())
-					si = ssx.begin();
-			}
-			yw += w;
-		}
-		while (--y > 0);
-		
-		ms = mty;
-		ss = sty;
-		for (x = 0; x < w; x++)
-		{
-			yi = x << 2;
-			r = ryp1 * (pr = px[yi]);
-			g = ryp1 * (pg = px[yi + 1]);
-			b = ryp1 * (pb = px[yi + 2]);
-			a = ryp1 * (pa = px[yi + 3]);
-			auto sy = ssy.begin();
-			for (i = 0; i< ryp1; i++)
-			{
-				(*sy).Red = pr;
-				(*sy).Green = pg;
-				(*sy).Blue = pb;
-				(*sy).Alpha = pa;
-				sy++;
-				if (sy == ssy.end())
-					sy = ssy.begin();
-			}
-			yp = w;
-			for (i = 1; i < (radiusY + 1); i++)
-			{
-				yi = (yp + x) << 2;
-				r += ((*sy).Red = px[yi]);
-				g += ((*sy).Green = px[yi + 1]);
-				b += ((*sy).Blue = px[yi + 2]);
-				a += ((*sy).Alpha = px[yi + 3]);
-				sy++;
-				if (sy == ssy.end())
-					sy = ssy.begin();
-				if (i < h1)
-				{
-					yp += w;
-				}
-			}
-			yi = x;
-			auto si = ssy.begin();
-			
-			if (iterations > 0)
-			{
-				for (y = 0; y<h; y++)
-				{
-					p = yi << 2;
-					pa = uint32_t(a * ms) >> ss;
-					px[p + 3] = pa;
-					if (pa > 0)
-					{
-						px[p] = (uint32_t(r * ms) >> ss);
-						px[p + 1] = (uint32_t(g * ms) >> ss);
-						px[p + 2] = (uint32_t(b * ms) >> ss);
-					}
-					else
-					{
-						px[p] = px[p + 1] = px[p + 2] = 0;
-					}
-					p = y + ryp1;
-					p = (x + ((p < h1 ? p : h1) * w)) << 2;
-					r -= (*si).Red;
-					r += ((*si).Red = px[p]);
-					g -= (*si).Green;
-					g += ((*si).Green = px[p + 1]);
-					b -= (*si).Blue;
-					b += ((*si).Blue = px[p + 2]);
-					a -= (*si).Alpha;
-					a += ((*si).Alpha = px[p + 3]);
-					si++;
-					if (si == ssy.end())
-						si = ssy.begin();
-					yi += w;
-				}
-			}
-			else
-			{
-				for (y = 0; y < h; y++)
-				{
-					p = yi << 2;
-					px[p + 3] = pa = uint32_t(a * ms) >> ss;
-					if (pa > 0)
-					{
-						pr = (uint32_t(r * ms) >> ss);
-						pg = (uint32_t(g * ms) >> ss);
-						pb = (uint32_t(b * ms) >> ss);
-						px[p] = pr > 255 ? 255 : pr;
-						px[p + 1] = pg > 255 ? 255 : pg;
-						px[p + 2] = pb > 255 ? 255 : pb;
-					}
-					else
-					{
-						px[p] = px[p + 1] = px[p + 2] = 0;
-					}
-					p = y + ryp1;
-					p = (x + ((p < h1 ? p : h1) * w)) << 2;
-					r -= (*si).Red - ((*si).Red = px[p]);
-					g -= (*si).Green - ((*si).Green = px[p + 1]);
-					b -= (*si).Blue - ((*si).Blue = px[p + 2]);
-					a -= (*si).Alpha - ((*si).Alpha = px[p + 3]);
-					si++;
-					if (si == ssy.end())
-						si = ssy.begin();
-					yi += w;
-				}
-			}
-		}
-	}
+uint8_t* BitmapFilter::getSourceData(BitmapContainer* target, BitmapContainer* source, const RECT& sourceRect)
+{
+	BitmapContainer* bc = source ? source : target;
+	return FilterEngine::copyRect(bc->getData(),bc->getWidth(),bc->getHeight(),sourceRect);
+}
+void BitmapFilter::applyBlur(uint8_t* data, uint32_t width, uint32_t height, number_t blurx, number_t blury, int quality)
+{
+	FilterEngine::blur(data,width,height,blurx,blury,quality);
 }
 void BitmapFilter::applyDropShadowFilter(BitmapContainer* target, uint8_t* tmpdata, const RECT& sourceRect, int xpos, int ypos, number_t strength, number_t alpha, uint32_t color, bool inner, bool knockout)
 {
-	uint32_t width = sourceRect.Xmax-sourceRect.Xmin;
-	uint32_t height = sourceRect.Ymax-sourceRect.Ymin;
-	uint32_t size = width*height;
-
-	uint8_t* data = target->getData();
-	int32_t startpos = ypos*target->getWidth();
-	int32_t targetsize = target->getWidth()*target->getHeight()*4;
-	for (uint32_t i = 0; i < size*4; i+=4)
-	{
-		if (i && i%(width*4)==0)
-			startpos+=target->getWidth();
-		if (startpos < 0)
-			continue;
-		int32_t targetpos = (xpos+startpos)*4+i%(width*4);
-		if (targetpos < 0)
-			continue;
-		if (targetpos+3 >= targetsize)
-			break;
-		number_t glowalpha = (inner ? 0xff - tmpdata[i+3] : tmpdata[i+3]);
-		number_t srcalpha = max(0.0,min(1.0,glowalpha*alpha*strength/255.0));
-		number_t dstalpha = number_t(data[targetpos+3])/255.0;
-		if (inner)
-		{
-			if (knockout)
-			{
-				data[targetpos  ] = min(uint32_t(0xff),uint32_t(number_t((color    )&0xff)*srcalpha*dstalpha));
-				data[targetpos+1] = min(uint32_t(0xff),uint32_t(number_t((color>> 8)&0xff)*srcalpha*dstalpha));
-				data[targetpos+2] = min(uint32_t(0xff),uint32_t(number_t((color>>16)&0xff)*srcalpha*dstalpha));
-				data[targetpos+3] = min(uint32_t(0xff),uint32_t(number_t(0xff            )*srcalpha*dstalpha));
-			}
-			else
-			{
-				data[targetpos  ] = min(uint32_t(0xff),uint32_t(number_t((color    )&0xff)*srcalpha*dstalpha+number_t(data[targetpos  ])*(1.0-srcalpha)));
-				data[targetpos+1] = min(uint32_t(0xff),uint32_t(number_t((color>> 8)&0xff)*srcalpha*dstalpha+number_t(data[targetpos+1])*(1.0-srcalpha)));
-				data[targetpos+2] = min(uint32_t(0xff),uint32_t(number_t((color>>16)&0xff)*srcalpha*dstalpha+number_t(data[targetpos+2])*(1.0-srcalpha)));
-				data[targetpos+3] = min(uint32_t(0xff),uint32_t(number_t(0xff            )*srcalpha*dstalpha+number_t(data[targetpos+3])*(1.0-srcalpha)));
-			}
-		}
-		else
-		{
-			if (knockout)
-			{
-				data[targetpos  ] = min(uint32_t(0xff),uint32_t(number_t((color    )&0xff)*srcalpha*(1.0-dstalpha)));
-				data[targetpos+1] = min(uint32_t(0xff),uint32_t(number_t((color>> 8)&0xff)*srcalpha*(1.0-dstalpha)));
-				data[targetpos+2] = min(uint32_t(0xff),uint32_t(number_t((color>>16)&0xff)*srcalpha*(1.0-dstalpha)));
-				data[targetpos+3] = min(uint32_t(0xff),uint32_t(number_t(0xff            )*srcalpha*(1.0-dstalpha)));
-			}
-			else
-			{
-				data[targetpos  ] = min(uint32_t(0xff),uint32_t(number_t((color    )&0xff)*srcalpha*(1.0-dstalpha)+number_t(data[targetpos  ])));
-				data[targetpos+1] = min(uint32_t(0xff),uint32_t(number_t((color>> 8)&0xff)*srcalpha*(1.0-dstalpha)+number_t(data[targetpos+1])));
-				data[targetpos+2] = min(uint32_t(0xff),uint32_t(number_t((color>>16)&0xff)*srcalpha*(1.0-dstalpha)+number_t(data[targetpos+2])));
-				data[targetpos+3] = min(uint32_t(0xff),uint32_t(number_t(0xff            )*srcalpha*(1.0-dstalpha)+number_t(data[targetpos+3])));
-			}
-		}
-	}
+	FilterEngine::dropShadow(target->getData(),target->getWidth(),target->getHeight(),tmpdata,sourceRect.Xmax-sourceRect.Xmin,sourceRect.Ymax-sourceRect.Ymin,
+				 xpos,ypos,strength,alpha,color,inner,knockout);
 }
 void BitmapFilter::fillGradientColors(number_t* gradientalphas, uint32_t* gradientcolors,Array* ratios,Array* alphas,Array* colors)
 {
@@ -370,60 +102,8 @@ void BitmapFilter::fillGradientColors(number_t* gradientalphas, uint32_t* gradie
 }
 void BitmapFilter::applyGradientFilter(BitmapContainer* target, uint8_t* tmpdata, const RECT& sourceRect, int xpos, int ypos, number_t strength, number_t* alphas, uint32_t* colors, bool inner, bool knockout)
 {
-	uint32_t width = sourceRect.Xmax-sourceRect.Xmin;
-	uint32_t height = sourceRect.Ymax-sourceRect.Ymin;
-	uint32_t size = width*height;
-
-	uint8_t* data = target->getData();
-	uint32_t startpos = ypos*target->getWidth();
-	uint32_t targetsize = target->getWidth()*target->getHeight()*4;
-	for (uint32_t i = 0; i < size*4; i+=4)
-	{
-		if (i && i%(width*4)==0)
-			startpos+=target->getWidth();
-		uint32_t targetpos = (xpos+startpos)*4+i%(width*4);
-		if (targetpos+3 >= targetsize)
-			break;
-		number_t glowalpha = (inner ? 0xff - tmpdata[i+3] : tmpdata[i+3]);
-		number_t alpha = alphas[uint32_t(glowalpha)];
-		number_t srcalpha = max(0.0,min(1.0,glowalpha*alpha*strength/255.0));
-		number_t dstalpha = number_t(data[targetpos+3])/255.0;
-		uint32_t color = colors[uint32_t(glowalpha)];
-		if (inner)
-		{
-			if (knockout)
-			{
-				data[targetpos  ] = min(uint32_t(0xff),uint32_t(number_t((color    )&0xff)*srcalpha*dstalpha));
-				data[targetpos+1] = min(uint32_t(0xff),uint32_t(number_t((color>> 8)&0xff)*srcalpha*dstalpha));
-				data[targetpos+2] = min(uint32_t(0xff),uint32_t(number_t((color>>16)&0xff)*srcalpha*dstalpha));
-				data[targetpos+3] = min(uint32_t(0xff),uint32_t(number_t(0xff            )*srcalpha*dstalpha));
-			}
-			else
-			{
-				data[targetpos  ] = min(uint32_t(0xff),uint32_t(number_t((color    )&0xff)*srcalpha*dstalpha+number_t(data[targetpos  ])*(1.0-srcalpha)));
-				data[targetpos+1] = min(uint32_t(0xff),uint32_t(number_t((color>> 8)&0xff)*srcalpha*dstalpha+number_t(data[targetpos+1])*(1.0-srcalpha)));
-				data[targetpos+2] = min(uint32_t(0xff),uint32_t(number_t((color>>16)&0xff)*srcalpha*dstalpha+number_t(data[targetpos+2])*(1.0-srcalpha)));
-				data[targetpos+3] = min(uint32_t(0xff),uint32_t(number_t(0xff            )*srcalpha*dstalpha+number_t(data[targetpos+3])*(1.0-srcalpha)));
-			}
-		}
-		else
-		{
-			if (knockout)
-			{
-				data[targetpos  ] = min(uint32_t(0xff),uint32_t(number_t((color    )&0xff)*srcalpha*(1.0-dstalpha)));
-				data[targetpos+1] = min(uint32_t(0xff),uint32_t(number_t((color>> 8)&0xff)*srcalpha*(1.0-dstalpha)));
-				data[targetpos+2] = min(uint32_t(0xff),uint32_t(number_t((color>>16)&0xff)*srcalpha*(1.0-dstalpha)));
-				data[targetpos+3] = min(uint32_t(0xff),uint32_t(number_t(0xff            )*srcalpha*(1.0-dstalpha)));
-			}
-			else
-			{
-				data[targetpos  ] = min(uint32_t(0xff),uint32_t(number_t((color    )&0xff)*srcalpha*(1.0-dstalpha)+number_t(data[targetpos  ])));
-				data[targetpos+1] = min(uint32_t(0xff),uint32_t(number_t((color>> 8)&0xff)*srcalpha*(1.0-dstalpha)+number_t(data[targetpos+1])));
-				data[targetpos+2] = min(uint32_t(0xff),uint32_t(number_t((color>>16)&0xff)*srcalpha*(1.0-dstalpha)+number_t(data[targetpos+2])));
-				data[targetpos+3] = min(uint32_t(0xff),uint32_t(number_t(0xff            )*srcalpha*(1.0-dstalpha)+number_t(data[targetpos+3])));
-			}
-		}
-	}
+	FilterEngine::gradientGlow(target->getData(),target->getWidth(),target->getHeight(),tmpdata,sourceRect.Xmax-sourceRect.Xmin,sourceRect.Ymax-sourceRect.Ymin,
+				   xpos,ypos,strength,alphas,colors,inner,knockout);
 }
 
 ASFUNCTIONBODY_ATOM(BitmapFilter,clone)
@@ -456,14 +136,14 @@ void GlowFilter::sinit(Class_base* c)
 	REGISTER_GETTER_SETTER(c, strength);
 }
 
-ASFUNCTIONBODY_GETTER_SETTER(GlowFilter, alpha)
-ASFUNCTIONBODY_GETTER_SETTER(GlowFilter, blurX)
-ASFUNCTIONBODY_GETTER_SETTER(GlowFilter, blurY)
-ASFUNCTIONBODY_GETTER_SETTER(GlowFilter, color)
-ASFUNCTIONBODY_GETTER_SETTER(GlowFilter, inner)
-ASFUNCTIONBODY_GETTER_SETTER(GlowFilter, knockout)
-ASFUNCTIONBODY_GETTER_SETTER(GlowFilter, quality)
-ASFUNCTIONBODY_GETTER_SETTER(GlowFilter, strength)
+ASFUNCTIONBODY_GETTER_SETTER_CB(GlowFilter,alpha,parameterChanged)
+ASFUNCTIONBODY_GETTER_SETTER_CB(GlowFilter,blurX,parameterChanged)
+ASFUNCTIONBODY_GETTER_SETTER_CB(GlowFilter,blurY,parameterChanged)
+ASFUNCTIONBODY_GETTER_SETTER_CB(GlowFilter,color,parameterChanged)
+ASFUNCTIONBODY_GETTER_SETTER_CB(GlowFilter,inner,parameterChanged)
+ASFUNCTIONBODY_GETTER_SETTER_CB(GlowFilter,knockout,parameterChanged)
+ASFUNCTIONBODY_GETTER_SETTER_CB(GlowFilter,quality,parameterChanged)
+ASFUNCTIONBODY_GETTER_SETTER_CB(GlowFilter,strength,parameterChanged)
 
 ASFUNCTIONBODY_ATOM(GlowFilter,_constructor)
 {
@@ -493,15 +173,10 @@ BitmapFilter* GlowFilter::cloneImpl() const
 }
 void GlowFilter::applyFilter(BitmapContainer* target, BitmapContainer* source, const RECT& sourceRect, int xpos, int ypos)
 {
-	uint8_t* tmpdata = nullptr;
-	if (source)
-		tmpdata = source->getRectangleData(sourceRect);
-	else
-		tmpdata = target->getRectangleData(sourceRect);
+	uint8_t* tmpdata = getSourceData(target,source,sourceRect);
 
 	applyBlur(tmpdata,sourceRect.Xmax-sourceRect.Xmin,sourceRect.Ymax-sourceRect.Ymin,blurX,blurY,quality);
 	applyDropShadowFilter(target, tmpdata, sourceRect, xpos, ypos, strength, alpha, color, inner, knockout);
-	delete[] tmpdata;
 }
 
 DropShadowFilter::DropShadowFilter(ASWorker* wrk,Class_base* c):
@@ -522,15 +197,10 @@ void DropShadowFilter::applyFilter(BitmapContainer* target, BitmapContainer* sou
 	ypos +=	sin(angle) * distance;
 	if (hideObject)
 		LOG(LOG_NOT_IMPLEMENTED,"DropShadowFilter.hideObject");
-	uint8_t* tmpdata = nullptr;
-	if (source)
-		tmpdata = source->getRectangleData(sourceRect);
-	else
-		tmpdata = target->getRectangleData(sourceRect);
+	uint8_t* tmpdata = getSourceData(target,source,sourceRect);
 
 	applyBlur(tmpdata,sourceRect.Xmax-sourceRect.Xmin,sourceRect.Ymax-sourceRect.Ymin,blurX,blurY,quality);
 	applyDropShadowFilter(target, tmpdata, sourceRect, xpos, ypos, strength, alpha, color, inner, knockout);
-	delete[] tmpdata;
 }
 
 
@@ -550,17 +220,17 @@ void DropShadowFilter::sinit(Class_base* c)
 	REGISTER_GETTER_SETTER(c, strength);
 }
 
-ASFUNCTIONBODY_GETTER_SETTER(DropShadowFilter, alpha)
-ASFUNCTIONBODY_GETTER_SETTER(DropShadowFilter, angle)
-ASFUNCTIONBODY_GETTER_SETTER(DropShadowFilter, blurX)
-ASFUNCTIONBODY_GETTER_SETTER(DropShadowFilter, blurY)
-ASFUNCTIONBODY_GETTER_SETTER(DropShadowFilter, color)
-ASFUNCTIONBODY_GETTER_SETTER(DropShadowFilter, distance)
-ASFUNCTIONBODY_GETTER_SETTER(DropShadowFilter, hideObject)
-ASFUNCTIONBODY_GETTER_SETTER(DropShadowFilter, inner)
-ASFUNCTIONBODY_GETTER_SETTER(DropShadowFilter, knockout)
-ASFUNCTIONBODY_GETTER_SETTER(DropShadowFilter, quality)
-ASFUNCTIONBODY_GETTER_SETTER(DropShadowFilter, strength)
+ASFUNCTIONBODY_GETTER_SETTER_CB(DropShadowFilter,alpha,parameterChanged)
+ASFUNCTIONBODY_GETTER_SETTER_CB(DropShadowFilter,angle,parameterChanged)
+ASFUNCTIONBODY_GETTER_SETTER_CB(DropShadowFilter,blurX,parameterChanged)
+ASFUNCTIONBODY_GETTER_SETTER_CB(DropShadowFilter,blurY,parameterChanged)
+ASFUNCTIONBODY_GETTER_SETTER_CB(DropShadowFilter,color,parameterChanged)
+ASFUNCTIONBODY_GETTER_SETTER_CB(DropShadowFilter,distance,parameterChanged)
+ASFUNCTIONBODY_GETTER_SETTER_CB(DropShadowFilter,hideObject,parameterChanged)
+ASFUNCTIONBODY_GETTER_SETTER_CB(DropShadowFilter,inner,parameterChanged)
+ASFUNCTIONBODY_GETTER_SETTER_CB(DropShadowFilter,knockout,parameterChanged)
+ASFUNCTIONBODY_GETTER_SETTER_CB(DropShadowFilter,quality,parameterChanged)
+ASFUNCTIONBODY_GETTER_SETTER_CB(DropShadowFilter,strength,parameterChanged)
 
 ASFUNCTIONBODY_ATOM(DropShadowFilter,_constructor)
 {
@@ -648,31 +318,26 @@ void GradientGlowFilter::sinit(Class_base* c)
 
 void GradientGlowFilter::applyFilter(BitmapContainer* target, BitmapContainer* source, const RECT& sourceRect, int xpos, int ypos)
 {
-	uint8_t* tmpdata = nullptr;
-	if (source)
-		tmpdata = source->getRectangleData(sourceRect);
-	else
-		tmpdata = target->getRectangleData(sourceRect);
+	uint8_t* tmpdata = getSourceData(target,source,sourceRect);
 
 	number_t gradientalphas[256];
 	uint32_t gradientcolors[256];
 	fillGradientColors(gradientalphas,gradientcolors,this->ratios.getPtr(), this->alphas.getPtr(), this->colors.getPtr());
 	applyBlur(tmpdata,sourceRect.Xmax-sourceRect.Xmin,sourceRect.Ymax-sourceRect.Ymin,blurX,blurY,quality);
 	applyGradientFilter(target, tmpdata, sourceRect, xpos, ypos, strength, gradientalphas, gradientcolors, type=="inner", knockout);
-	delete[] tmpdata;
 }
 
-ASFUNCTIONBODY_GETTER_SETTER(GradientGlowFilter, distance)
-ASFUNCTIONBODY_GETTER_SETTER(GradientGlowFilter, angle)
-ASFUNCTIONBODY_GETTER_SETTER(GradientGlowFilter, colors)
-ASFUNCTIONBODY_GETTER_SETTER(GradientGlowFilter, alphas)
-ASFUNCTIONBODY_GETTER_SETTER(GradientGlowFilter, ratios)
-ASFUNCTIONBODY_GETTER_SETTER(GradientGlowFilter, blurX)
-ASFUNCTIONBODY_GETTER_SETTER(GradientGlowFilter, blurY)
-ASFUNCTIONBODY_GETTER_SETTER(GradientGlowFilter, strength)
-ASFUNCTIONBODY_GETTER_SETTER(GradientGlowFilter, quality)
-ASFUNCTIONBODY_GETTER_SETTER(GradientGlowFilter, type)
-ASFUNCTIONBODY_GETTER_SETTER(GradientGlowFilter, knockout)
+ASFUNCTIONBODY_GETTER_SETTER_CB(GradientGlowFilter,distance,parameterChanged)
+ASFUNCTIONBODY_GETTER_SETTER_CB(GradientGlowFilter,angle,parameterChanged)
+ASFUNCTIONBODY_GETTER_SETTER_CB(GradientGlowFilter,colors,parameterChanged)
+ASFUNCTIONBODY_GETTER_SETTER_CB(GradientGlowFilter,alphas,parameterChanged)
+ASFUNCTIONBODY_GETTER_SETTER_CB(GradientGlowFilter,ratios,parameterChanged)
+ASFUNCTIONBODY_GETTER_SETTER_CB(GradientGlowFilter,blurX,parameterChanged)
+ASFUNCTIONBODY_GETTER_SETTER_CB(GradientGlowFilter,blurY,parameterChanged)
+ASFUNCTIONBODY_GETTER_SETTER_CB(GradientGlowFilter,strength,parameterChanged)
+ASFUNCTIONBODY_GETTER_SETTER_CB(GradientGlowFilter,quality,parameterChanged)
+ASFUNCTIONBODY_GETTER_SETTER_CB(GradientGlowFilter,type,parameterChanged)
+ASFUNCTIONBODY_GETTER_SETTER_CB(GradientGlowFilter,knockout,parameterChanged)
 
 ASFUNCTIONBODY_ATOM(GradientGlowFilter,_constructor)
 {
@@ -750,17 +415,12 @@ void BevelFilter::applyFilter(BitmapContainer* target, BitmapContainer* source,
 {
 	if (type=="full")
 		LOG(LOG_NOT_IMPLEMENTED,"BevelFilter type 'full'");
-	uint8_t* tmpdata = nullptr;
-	if (source)
-		tmpdata = source->getRectangleData(sourceRect);
-	else
-		tmpdata = target->getRectangleData(sourceRect);
+	uint8_t* tmpdata = getSourceData(target,source,sourceRect);
 
 	applyBlur(tmpdata,sourceRect.Xmax-sourceRect.Xmin,sourceRect.Ymax-sourceRect.Ymin,blurX,blurY,quality);
 	// TODO I've not found any useful documentation how BevelFilter should be implemented, so we just apply two dropShadowFilters with different angles and colors
 	applyDropShadowFilter(target, tmpdata, sourceRect, xpos+cos(angle     ) * distance, ypos+sin(angle     ) * distance, strength, shadowAlpha   , shadowColor   , type=="inner", knockout);
 	applyDropShadowFilter(target, tmpdata, sourceRect, xpos+cos(angle+M_PI) * distance, ypos+sin(angle+M_PI) * distance, strength, highlightAlpha, highlightColor, type=="inner", knockout);
-	delete[] tmpdata;
 
 }
 
@@ -816,44 +476,11 @@ void ColorMatrixFilter::applyFilter(BitmapContainer* target, BitmapContainer* so
 	{
 		m[i] = asAtomHandler::toNumber(matrix->at(i));
 	}
-	uint32_t width = sourceRect.Xmax-sourceRect.Xmin;
-	uint32_t height = sourceRect.Ymax-sourceRect.Ymin;
-	uint32_t size = width*height;
-	uint8_t* tmpdata = nullptr;
-	if (source)
-		tmpdata = source->getRectangleData(sourceRect);
-	else
-		tmpdata = target->getRectangleData(sourceRect);
-	
-	uint8_t* data = target->getData();
-	uint32_t startpos = ypos*target->getWidth();
-	uint32_t targetsize = target->getWidth()*target->getHeight()*4;
-	for (uint32_t i = 0; i < size*4; i+=4)
-	{
-		if (i && i%(width*4)==0)
-			startpos+=target->getWidth();
-		uint32_t targetpos = (xpos+startpos)*4+i%(width*4);
-		if (targetpos+3 >= targetsize)
-			break;
-
-		number_t srcA = number_t(tmpdata[i+3]);
-		number_t srcR = number_t(tmpdata[i+2])*srcA/255.0;
-		number_t srcG = number_t(tmpdata[i+1])*srcA/255.0;
-		number_t srcB = number_t(tmpdata[i  ])*srcA/255.0;
-		number_t redResult   = (m[0 ]*srcR) + (m[1 ]*srcG) + (m[2 ]*srcB) + (m[3 ]*srcA) + m[4 ];
-		number_t greenResult = (m[5 ]*srcR) + (m[6 ]*srcG) + (m[7 ]*srcB) + (m[8 ]*srcA) + m[9 ];
-		number_t blueResult  = (m[10]*srcR) + (m[11]*srcG) + (m[12]*srcB) + (m[13]*srcA) + m[14];
-		number_t alphaResult = (m[15]*srcR) + (m[16]*srcG) + (m[17]*srcB) + (m[18]*srcA) + m[19];
-
-		data[targetpos  ] = (max(int32_t(0),min(int32_t(0xff),int32_t(blueResult *alphaResult/255.0))));
-		data[targetpos+1] = (max(int32_t(0),min(int32_t(0xff),int32_t(greenResult*alphaResult/255.0))));
-		data[targetpos+2] = (max(int32_t(0),min(int32_t(0xff),int32_t(redResult  *alphaResult/255.0))));
-		data[targetpos+3] = (max(int32_t(0),min(int32_t(0xff),int32_t(alphaResult))));
-	}
-	delete[] tmpdata;
+	uint8_t* tmpdata = getSourceData(target,source,sourceRect);
+	FilterEngine::colorMatrix(target->getData(),target->getWidth(),target->getHeight(),tmpdata,sourceRect.Xmax-sourceRect.Xmin,sourceRect.Ymax-sourceRect.Ymin,xpos,ypos,m);
 }
 
-ASFUNCTIONBODY_GETTER_SETTER(ColorMatrixFilter, matrix)
+ASFUNCTIONBODY_GETTER_SETTER_CB(ColorMatrixFilter,matrix,parameterChanged)
 
 ASFUNCTIONBODY_ATOM(ColorMatrixFilter,_constructor)
 {
@@ -888,9 +515,9 @@ void BlurFilter::sinit(Class_base* c)
 	REGISTER_GETTER_SETTER(c, quality);
 }
 
-ASFUNCTIONBODY_GETTER_SETTER(BlurFilter, blurX)
-ASFUNCTIONBODY_GETTER_SETTER(BlurFilter, blurY)
-ASFUNCTIONBODY_GETTER_SETTER(BlurFilter, quality)
+ASFUNCTIONBODY_GETTER_SETTER_CB(BlurFilter,blurX,parameterChanged)
+ASFUNCTIONBODY_GETTER_SETTER_CB(BlurFilter,blurY,parameterChanged)
+ASFUNCTIONBODY_GETTER_SETTER_CB(BlurFilter,quality,parameterChanged)
 
 ASFUNCTIONBODY_ATOM(BlurFilter,_constructor)
 {
@@ -899,21 +526,11 @@ ASFUNCTIONBODY_ATOM(BlurFilter,_constructor)
 }
 void BlurFilter::applyFilter(BitmapContainer* target, BitmapContainer* source, const RECT& sourceRect, int xpos, int ypos)
 {
-	uint8_t* tmpdata = nullptr;
-	if (source)
-		tmpdata = source->getRectangleData(sourceRect);
-	else
-		tmpdata = target->getRectangleData(sourceRect);
-	applyBlur(tmpdata,sourceRect.Xmax-sourceRect.Xmin,sourceRect.Ymax-sourceRect.Ymin,blurX,blurY,quality);
-
+	uint8_t* tmpdata = getSourceData(target,source,sourceRect);
 	uint32_t width = sourceRect.Xmax-sourceRect.Xmin;
 	uint32_t height = sourceRect.Ymax-sourceRect.Ymin;
-	uint8_t* data = target->getData();
-	for (uint32_t i = 0; i < height; i++)
-	{
-		memcpy(data+((ypos+i)*width+xpos)*4, tmpdata+i*width*4,width*4);
-	}
-	delete[] tmpdata;
+	applyBlur(tmpdata,width,height,blurX,blurY,quality);
+	FilterEngine::copy(target->getData(),target->getWidth(),target->getHeight(),tmpdata,width,height,xpos,ypos);
 }
 BitmapFilter* BlurFilter::cloneImpl() const
 {
@@ -984,83 +601,15 @@ void ConvolutionFilter::applyFilter(BitmapContainer* target, BitmapContainer* so
 	// "
 	uint32_t mX = matrixX;
 	uint32_t mY = matrixY;
-	number_t* m =new number_t[mX*mY];
-	for (uint32_t y=0; y < mY ; y++)
+	std::vector<number_t> m(mX*mY);
+	for (uint32_t i=0; i < mX*mY; i++)
 	{
-		for (uint32_t x=0; x < mX ; x++)
-		{
-			m[y*mX+x] = matrix->size() < y*mX+x ? asAtomHandler::toNumber(matrix->at(y*mX+x)) : 0;
-		}
+		if (!matrix.isNull() && i < matrix->size())
+			m[i] = asAtomHandler::toNumber(matrix->at(i));
 	}
-	uint32_t width = sourceRect.Xmax-sourceRect.Xmin;
-	uint32_t height = sourceRect.Ymax-sourceRect.Ymin;
-	uint32_t size = width*height;
-	uint8_t* tmpdata = nullptr;
-	if (source)
-		tmpdata = source->getRectangleData(sourceRect);
-	else
-		tmpdata = target->getRectangleData(sourceRect);
-	
-	uint8_t* data = target->getData();
-	uint32_t startpos = ypos*target->getWidth();
-	int32_t mstartpos=-(mY/2*width*4+mX/2);
-	uint32_t targetsize = target->getWidth()*target->getHeight()*4;
-	number_t realdivisor = divisor==0 ? 1.0 : divisor;
-	for (uint32_t i = 0; i < size*4; i+=4)
-	{
-		if (i && i%(width*4)==0)
-			startpos+=target->getWidth();
-		uint32_t targetpos = (xpos+startpos)*4+i%(width*4);
-		if (targetpos+3 >= targetsize)
-			break;
-
-		number_t redResult   = 0;
-		number_t greenResult = 0;
-		number_t blueResult  = 0;
-		number_t alphaResult = 0;
-		for (uint32_t y=0; y <mY; y++)
-		{
-			for (uint32_t x=0; x <mX; x++)
-			{
-				if (
-						(i%(width*4) <= mX/2
-						|| i%(width*4) >= (width-mX/2)*4
-						|| i/(width*4) <= mY/2
-						|| i/(width*4) >= height-mY/2))
-				{
-					if (clamp)
-					{
-						alphaResult += number_t(tmpdata[i+3])*m[y*mX+x];
-						redResult   += number_t(tmpdata[i+2])*m[y*mX+x];
-						greenResult += number_t(tmpdata[i+1])*m[y*mX+x];
-						blueResult  += number_t(tmpdata[i  ])*m[y*mX+x];
-					}
-					else
-					{
-						alphaResult += ((alpha*255)     )*m[y*mX+x];
-						redResult   += ((color>>16)&0xff)*m[y*mX+x];
-						greenResult += ((color>> 8)&0xff)*m[y*mX+x];
-						blueResult  += ((color    )&0xff)*m[y*mX+x];
-					}
-				}
-				else
-				{
-					alphaResult += number_t(tmpdata[mstartpos + y*mY +x+3])*m[y*mX+x];
-					redResult   += number_t(tmpdata[mstartpos + y*mY +x+2])*m[y*mX+x];
-					greenResult += number_t(tmpdata[mstartpos + y*mY +x+1])*m[y*mX+x];
-					blueResult  += number_t(tmpdata[mstartpos + y*mY +x  ])*m[y*mX+x];
-				}
-			}
-		}
-		data[targetpos  ] = (max(int32_t(0),min(int32_t(0xff),int32_t(blueResult  / realdivisor + bias))));
-		data[targetpos+1] = (max(int32_t(0),min(int32_t(0xff),int32_t(greenResult / realdivisor + bias))));
-		data[targetpos+2] = (max(int32_t(0),min(int32_t(0xff),int32_t(redResult   / realdivisor + bias))));
-		if (!preserveAlpha)
-			data[targetpos+3] = (max(int32_t(0),min(int32_t(0xff),int32_t(alphaResult / realdivisor + bias))));
-		mstartpos+=4;
-	}
-	delete[] m;
-	delete[] tmpdata;
+	uint8_t* tmpdata = getSourceData(target,source,sourceRect);
+	FilterEngine::convolution(target->getData(),target->getWidth(),target->getHeight(),tmpdata,sourceRect.Xmax-sourceRect.Xmin,sourceRect.Ymax-sourceRect.Ymin,
+				  xpos,ypos,m.data(),mX,mY,divisor,bias,preserveAlpha,clamp,color,alpha);
 }
 
 ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(ConvolutionFilter,alpha)
@@ -1115,24 +664,11 @@ void DisplacementMapFilter::sinit(Class_base* c)
 
 void DisplacementMapFilter::applyFilter(BitmapContainer* target, BitmapContainer* source, const RECT& sourceRect, int xpos, int ypos)
 {
-	uint32_t width = sourceRect.Xmax-sourceRect.Xmin;
-	uint32_t height = sourceRect.Ymax-sourceRect.Ymin;
-	uint32_t size = width*height;
-	uint32_t mapx = mapPoint ? uint32_t(mapPoint->getX()) : 0;
-	uint32_t mapy = mapPoint ? uint32_t(mapPoint->getX()) : 0;
-	if (mapBitmap.isNull() || mapBitmap->getBitmapContainer().isNull() || (mapBitmap->getBitmapContainer()->getWidth()-mapx)*(mapBitmap->getBitmapContainer()->getHeight()-mapy) > size)
+	if (mapBitmap.isNull() || mapBitmap->getBitmapContainer().isNull() || mapBitmap->getBitmapContainer()->isEmpty())
 		return;
-	uint8_t* tmpdata = nullptr;
-	if (source)
-		tmpdata = source->getRectangleData(sourceRect);
-	else
-		tmpdata = target->getRectangleData(sourceRect);
-	
-	uint8_t* data = target->getData();
-	uint32_t startpos = ypos*target->getWidth();
-	uint32_t targetsize = target->getWidth()*target->getHeight()*4;
-	uint32_t mapPointstartpos = mapPoint ? (mapx+mapy*mapBitmap->getWidth())*4 : 0;
-	uint8_t* mapbitmapdata=mapBitmap->getBitmapContainer()->getData();
+	BitmapContainer* map = mapBitmap->getBitmapContainer().getPtr();
+	int mapx = mapPoint ? int(mapPoint->getX()) : 0;
+	int mapy = mapPoint ? int(mapPoint->getY()) : 0;
 	uint32_t mapchannelindexX = 0;
 	uint32_t mapchannelindexY = 0;
 	switch (componentX)
@@ -1165,30 +701,17 @@ void DisplacementMapFilter::applyFilter(BitmapContainer* target, BitmapContainer
 			mapchannelindexY=0;
 			break;
 	}
-
-	for (uint32_t i = 0; i < size*4; i+=4)
-	{
-		if (i && i%(width*4)==0)
-		{
-			startpos+=target->getWidth();
-			mapPointstartpos+=mapBitmap->getWidth();
-		}
-		uint32_t targetpos = (xpos+startpos)*4+i%(width*4);
-		uint32_t mappointpos = (mapPointstartpos)*4+i%(width*4);
-		if (targetpos+3 >= targetsize)
-			break;
-
-		int32_t alphaResult = tmpdata[i+3 + int32_t((mapbitmapdata[mappointpos+mapchannelindexX]-128)*scaleX/256 + (mapbitmapdata[mappointpos+mapchannelindexY]-128)*scaleY/256)];
-		int32_t redResult   = tmpdata[i+2 + int32_t((mapbitmapdata[mappointpos+mapchannelindexX]-128)*scaleX/256 + (mapbitmapdata[mappointpos+mapchannelindexY]-128)*scaleY/256)];
-		int32_t greenResult = tmpdata[i+1 + int32_t((mapbitmapdata[mappointpos+mapchannelindexX]-128)*scaleX/256 + (mapbitmapdata[mappointpos+mapchannelindexY]-128)*scaleY/256)];
-		int32_t blueResult  = tmpdata[i   + int32_t((mapbitmapdata[mappointpos+mapchannelindexX]-128)*scaleX/256 + (mapbitmapdata[mappointpos+mapchannelindexY]-128)*scaleY/256)];
-
-		data[targetpos  ] = max(int32_t(0),min(int32_t(0xff),blueResult ));
-		data[targetpos+1] = max(int32_t(0),min(int32_t(0xff),greenResult));
-		data[targetpos+2] = max(int32_t(0),min(int32_t(0xff),redResult  ));
-		data[targetpos+3] = max(int32_t(0),min(int32_t(0xff),alphaResult));
-	}
-	delete[] tmpdata;
+	FilterEngine::DISPLACEMENT_MODE m = FilterEngine::DISPLACEMENT_WRAP;
+	if (mode=="clamp")
+		m = FilterEngine::DISPLACEMENT_CLAMP;
+	else if (mode=="ignore")
+		m = FilterEngine::DISPLACEMENT_IGNORE;
+	else if (mode=="color")
+		m = FilterEngine::DISPLACEMENT_COLOR;
+	uint8_t* tmpdata = getSourceData(target,source,sourceRect);
+	FilterEngine::displacementMap(target->getData(),target->getWidth(),target->getHeight(),tmpdata,sourceRect.Xmax-sourceRect.Xmin,sourceRect.Ymax-sourceRect.Ymin,
+				      xpos,ypos,map->getData(),map->getWidth(),map->getHeight(),mapx,mapy,
+				      mapchannelindexX,mapchannelindexY,scaleX,scaleY,m,color,alpha);
 }
 
 ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(DisplacementMapFilter,alpha)
@@ -1304,11 +827,7 @@ void GradientBevelFilter::applyFilter(BitmapContainer* target, BitmapContainer*
 {
 	if (type=="full")
 		LOG(LOG_NOT_IMPLEMENTED,"GradientBevelFilter type 'full'");
-	uint8_t* tmpdata = nullptr;
-	if (source)
-		tmpdata = source->getRectangleData(sourceRect);
-	else
-		tmpdata = target->getRectangleData(sourceRect);
+	uint8_t* tmpdata = getSourceData(target,source,sourceRect);
 
 	number_t gradientalphas[256];
 	uint32_t gradientcolors[256];
@@ -1317,7 +836,6 @@ void GradientBevelFilter::applyFilter(BitmapContainer* target, BitmapContainer*
 	// TODO I've not found any useful documentation how BevelFilter should be implemented, so we just apply two dropShadowFilters with different angles
 	applyGradientFilter(target, tmpdata, sourceRect, xpos+cos(angle     ) * distance, ypos+sin(angle     ) * distance, strength, gradientalphas, gradientcolors, type=="inner", knockout);
 	applyGradientFilter(target, tmpdata, sourceRect, xpos+cos(angle+M_PI) * distance, ypos+sin(angle+M_PI) * distance, strength, gradientalphas, gradientcolors, type=="inner", knockout);
-	delete[] tmpdata;
 }
 
 ASFUNCTIONBODY_ATOM(GradientBevelFilter,_constructor)
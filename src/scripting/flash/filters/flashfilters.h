@@ -30,17 +30,27 @@ class BitmapFilter: public ASObject
 {
 private:
 	virtual BitmapFilter* cloneImpl() const;
+	static ATOMIC_INT32(lastVersion);
+	static uint32_t nextVersion();
+	// unique among all filters, renewed by every property setter
+	uint32_t version;
 protected:
+	// copy of sourceRect of source (or of target, if source is null), it is owned by the FilterEngine
+	static uint8_t* getSourceData(BitmapContainer* target, BitmapContainer* source, const RECT& sourceRect);
 	static void applyBlur(uint8_t* data, uint32_t width, uint32_t height, number_t blurx, number_t blury, int quality);
 	static void applyDropShadowFilter(BitmapContainer* target, uint8_t* tmpdata, const RECT& sourceRect, int xpos, int ypos, number_t strength, number_t alpha, uint32_t color, bool inner, bool knockout);
 	static void fillGradientColors(number_t* gradientalphas, uint32_t* gradientcolors, Array* ratios, Array* alphas, Array* colors);
 	static void applyGradientFilter(BitmapContainer* target, uint8_t* tmpdata, const RECT& sourceRect, int xpos, int ypos, number_t strength, number_t* alphas, uint32_t* colors, bool inner, bool knockout);
 public:
-	BitmapFilter(ASWorker* wrk,Class_base* c, CLASS_SUBTYPE st=SUBTYPE_BITMAPFILTER):ASObject(wrk,c,T_OBJECT,st){}
+	BitmapFilter(ASWorker* wrk,Class_base* c, CLASS_SUBTYPE st=SUBTYPE_BITMAPFILTER):ASObject(wrk,c,T_OBJECT,st),version(nextVersion()){}
 	static void sinit(Class_base* c);
 	ASFUNCTION_ATOM(clone);
 	virtual void applyFilter(BitmapContainer* target, BitmapContainer* source,const RECT& sourceRect, int xpos, int ypos);
 	virtual uint32_t getMaxFilterBorder() const { return 0; }
+	// called by the property setters, DisplayObjects redraw their cached bitmap if the version of one of their filters changed
+	template<class T>
+	void parameterChanged(const T& /*oldValue*/) { version=nextVersion(); }
+	uint32_t getVersion() const { return version; }
 };
 
 class GlowFilter: public BitmapFilter
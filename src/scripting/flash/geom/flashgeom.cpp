@@ -24,6 +24,7 @@
 #include "scripting/toplevel/UInteger.h"
 #include "scripting/toplevel/Vector.h"
 #include "scripting/flash/display/BitmapContainer.h"
+#include "platforms/pixelkernels.h"
 
 using namespace lightspark;
 using namespace std;
@@ -533,16 +534,9 @@ uint8_t *ColorTransform::applyTransformation(BitmapContainer* bm)
 	uint32_t* src = (uint32_t*)bm->getData();
 	uint32_t* dst = (uint32_t*)bm->getDataColorTransformed();
 	uint32_t size = bm->getWidth()*bm->getHeight();
-	for (uint32_t i = 0; i < size; i++)
-	{
-		uint32_t color = *src;
-		*dst =  max(0,min(255,(((int)((color>>24)&0xff) * (int)alphaMultiplier)/256 + (int)alphaOffset)))<<24 |
-				max(0,min(255,(((int)((color>>16)&0xff) * (int)  redMultiplier)/256 + (int)  redOffset)))<<16 |
-				max(0,min(255,(((int)((color>> 8)&0xff) * (int)greenMultiplier)/256 + (int)greenOffset)))<<8 |
-				max(0,min(255,(((int)((color    )&0xff) * (int) blueMultiplier)/256 + (int) blueOffset)));
-		dst++;
-		src++;
-	}
+	pixelColorTransform ct(redMultiplier, greenMultiplier, blueMultiplier, alphaMultiplier,
+			       redOffset, greenOffset, blueOffset, alphaOffset);
+	pixelColorTransformStraight(dst, src, size, ct);
 	return (uint8_t*)bm->getDataColorTransformed();
 }
 
@@ -558,13 +552,10 @@ void ColorTransform::applyTransformation(uint8_t* bm, uint32_t size)
 		alphaOffset==0.0)
 		return;
 
-	for (uint32_t i = 0; i < size; i+=4)
-	{
-		bm[i+3] = max(0,min(255,int(((number_t(bm[i+3]) * alphaMultiplier) + alphaOffset))));
-		bm[i+2] = max(0,min(255,int(((number_t(bm[i+2]) *  blueMultiplier) +  blueOffset)*(number_t(bm[i+3])/255.0))));
-		bm[i+1] = max(0,min(255,int(((number_t(bm[i+1]) * greenMultiplier) + greenOffset)*(number_t(bm[i+3])/255.0))));
-		bm[i  ] = max(0,min(255,int(((number_t(bm[i  ]) *   redMultiplier) +   redOffset)*(number_t(bm[i+3])/255.0))));
-	}
+	// the pixels are premultiplied, so the transformation is applied to the unmultiplied colors
+	pixelColorTransform ct(redMultiplier, greenMultiplier, blueMultiplier, alphaMultiplier,
+			       redOffset, greenOffset, blueOffset, alphaOffset);
+	pixelColorTransformPremultiplied((uint32_t*)bm, (const uint32_t*)bm, size/4, ct);
 }
 
 void ColorTransform::setProperties(const CXFORMWITHALPHA &cx)
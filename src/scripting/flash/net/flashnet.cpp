@@ -1374,8 +1374,9 @@ ASFUNCTIONBODY_ATOM(NetStream,_getInfo)
 	}
 	else
 		LOG(LOG_NOT_IMPLEMENTED,"NetStreamInfo.currentBytesPerSecond/maxBytesPerSecond/dataBytesPerSecond is only implemented for data generation mode");
-	if (th->videoDecoder)
-		res->droppedFrames = th->videoDecoder->framesdropped;
+	th->countermutex.lock();
+	res->droppedFrames = th->decoderMetrics.droppedVideoFrames;
+	th->countermutex.unlock();
 	res->playbackBytesPerSecond = th->playbackBytesPerSecond;
 	res->audioBufferLength = th->bufferLength;
 	res->videoBufferLength = th->bufferLength;
@@ -1968,6 +1969,7 @@ void NetStream::execute()
 		videoDecoder = nullptr;
 		this->prevstreamtime = streamTime;
 		this->bufferLength = 0;
+		decoderMetrics = StreamDecoderMetrics();
 		countermutex.unlock();
 		bool done=false;
 		bool bufferfull = true;
@@ -1982,13 +1984,13 @@ void NetStream::execute()
 			bool decodingSuccess= bufferfull && streamDecoder->decodeNextFrame();
 			if(!decodingSuccess && bufferfull)
 			{
-				if (s.tellg() == -1)
+				if (streamDecoder->getStreamPosition() == -1)
 				{
 					done = true;
 					continue;
 				}
 
-				LOG(LOG_INFO,"decoding failed:"<<s.tellg()<<" "<<this->getReceivedLength());
+				LOG(LOG_INFO,"decoding failed:"<<streamDecoder->getStreamPosition()<<" "<<this->getReceivedLength());
 				bufferfull = false;
 			}
 			else
@@ -2007,7 +2009,7 @@ void NetStream::execute()
 						}
 						if (frameRate)
 						{
-							this->playbackBytesPerSecond = s.tellg() / (framesdecoded / frameRate);
+							this->playbackBytesPerSecond = streamDecoder->getStreamPosition() / (framesdecoded / frameRate);
 							this->bufferLength = (framesdecoded / frameRate) - (streamTime-prevstreamtime)/1000.0;
 						}
 						countermutex.unlock();
@@ -2022,6 +2024,10 @@ void NetStream::execute()
 				}
 			}
 			
+			countermutex.lock();
+			streamDecoder->getMetrics(decoderMetrics);
+			countermutex.unlock();
+
 			if(videoDecoder==nullptr && streamDecoder->videoDecoder)
 			{
 				videoDecoder=streamDecoder->videoDecoder;
@@ -2112,6 +2118,13 @@ void NetStream::execute()
 	}
 	if (streamDecoder)
 	{
+		countermutex.lock();
+		streamDecoder->getMetrics(decoderMetrics);
+		LOG(LOG_INFO,"NetStream "<<url<<": at most "<<decoderMetrics.maxQueuedPackets<<" queued packets, "
+			<<decoderMetrics.queuedPackets<<" packets left and "<<decoderMetrics.droppedPackets<<" packets skipped, "
+			<<decoderMetrics.droppedVideoFrames<<" dropped frames, "
+			<<decoderMetrics.inPlacePackets<<" packets decoded in place and "<<decoderMetrics.copiedPackets<<" copied");
+		countermutex.unlock();
 		delete streamDecoder;
 		streamDecoder = nullptr;
 	}
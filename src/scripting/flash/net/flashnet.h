@@ -319,6 +319,8 @@ private:
 	uint32_t prevstreamtime;
 	number_t playbackBytesPerSecond;
 	number_t maxBytesPerSecond;
+	// backpressure statistics of the running stream decoder, protected by countermutex
+	StreamDecoderMetrics decoderMetrics;
 
 	struct bytespertime {
 		uint64_t timestamp;
@@ -1782,7 +1782,7 @@ bool TextField::renderImpl(RenderContext& ctxt) const
 		{
 			number_t bxmin,bxmax,bymin,bymax;
 			boundsRect(bxmin,bxmax,bymin,bymax);
-			TextureChunk tex=getSystemState()->getRenderThread()->allocateTexture(1, 1, true);
+			const TextureChunk& tex=getSystemState()->getRenderThread()->getSolidColorTexture();
 
 			bool isMask;
 			_NR<DisplayObject> mask;
@@ -85,6 +85,39 @@ void Array::prepareShutdown()
 	}
 }
 
+void Array::gcChildren(std::vector<ASObject*>& children)
+{
+	ASObject::gcChildren(children);
+	for (auto it=data_first.begin() ; it != data_first.end(); ++it)
+	{
+		ASObject* o = asAtomHandler::getObject(*it);
+		if (o)
+			children.push_back(o);
+	}
+	for (auto it=data_second.begin() ; it != data_second.end(); ++it)
+	{
+		ASObject* o = asAtomHandler::getObject(it->second);
+		if (o)
+			children.push_back(o);
+	}
+}
+
+void Array::gcClearReferences()
+{
+	for (auto it=data_first.begin() ; it != data_first.end(); ++it)
+	{
+		ASATOM_DECREF_POINTER(it);
+	}
+	for (auto it=data_second.begin() ; it != data_second.end(); ++it)
+	{
+		ASATOM_DECREF(it->second);
+	}
+	data_first.clear();
+	data_second.clear();
+	currentsize=0;
+	ASObject::gcClearReferences();
+}
+
 void Array::sinit(Class_base* c)
 {
 	CLASS_SETUP(c, ASObject, _constructor, CLASS_DYNAMIC_NOT_FINAL);
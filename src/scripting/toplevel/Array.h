@@ -94,6 +94,8 @@ public:
 	void finalize() override;
 	bool destruct() override;
 	void prepareShutdown() override;
+	void gcChildren(std::vector<ASObject*>& children) override;
+	void gcClearReferences() override;
 	
 	//These utility methods are also used by ByteArray
 	static bool isValidMultiname(SystemState* sys,const multiname& name, uint32_t& index);
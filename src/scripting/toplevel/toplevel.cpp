@@ -172,6 +172,22 @@ void IFunction::prepareShutdown()
 	prototype.reset();
 }
 
+void IFunction::gcChildren(std::vector<ASObject*>& children)
+{
+	ASObject::gcChildren(children);
+	if (closure_this)
+		children.push_back(closure_this.getPtr());
+	if (prototype)
+		children.push_back(prototype.getPtr());
+}
+
+void IFunction::gcClearReferences()
+{
+	closure_this.reset();
+	prototype.reset();
+	ASObject::gcClearReferences();
+}
+
 ASFUNCTIONBODY_GETTER_SETTER(IFunction,prototype)
 ASFUNCTIONBODY_ATOM(IFunction,_length)
 {
@@ -381,6 +397,178 @@ IFunction* SyntheticFunction::clone(ASWorker* wrk)
 	return ret;
 }
 
+void SyntheticFunction::preload(ASWorker* wrk)
+{
+	method_body_info* body = mi->body;
+	if (mi->cc.locals == nullptr)
+	{
+		// first call of the method
+		body->originalexceptions = body->exceptions;
+		body->functionname = functionname;
+	}
+	else
+	{
+		// recompilation, reset everything preloadFunction adds to the method body
+		body->preloadedcode.clear();
+		body->exceptions = body->originalexceptions;
+		body->localconstantslots.clear();
+		body->polymorphiccaches.clear();
+		body->localresultcount=0;
+		if (body->localsinitialvalues)
+		{
+			delete[] body->localsinitialvalues;
+			body->localsinitialvalues=nullptr;
+		}
+	}
+	body->codeStatus = method_body_info::PRELOADING;
+	mi->cc.sys = getSystemState();
+	mi->cc.worker=wrk;
+	ABCVm::preloadFunction(this,wrk);
+	body->codeStatus = method_body_info::PRELOADED;
+	body->specializedcode = body->tier == method_body_info::TIER_SPECIALIZED;
+	setupCallContext();
+}
+
+void SyntheticFunction::setupCallContext()
+{
+	method_body_info* body = mi->body;
+	delete[] mi->cc.locals;
+	delete[] mi->cc.stack;
+	delete[] mi->cc.scope_stack;
+	delete[] mi->cc.scope_stack_dynamic;
+	delete[] mi->cc.localslots;
+	mi->cc.exec_pos = body->preloadedcode.data();
+	mi->cc.locals = new asAtom[body->getReturnValuePos()+1+body->localresultcount];
+	mi->cc.stack = new asAtom[body->max_stack+1];
+	mi->cc.scope_stack = new asAtom[body->max_scope_depth];
+	mi->cc.scope_stack_dynamic = new bool[body->max_scope_depth];
+	mi->cc.max_stackp=mi->cc.stack+body->max_stack;
+	mi->cc.lastlocal = mi->cc.locals+body->getReturnValuePos()+1+body->localresultcount;
+	mi->cc.localslots = new asAtom*[body->localconstantslots.size()+body->getReturnValuePos()+1+body->localresultcount];
+	for (uint32_t i = 0; i < uint32_t(body->getReturnValuePos()+1+body->localresultcount); i++)
+	{
+		mi->cc.localslots[i] = &mi->cc.locals[i];
+	}
+}
+
+bool SyntheticFunction::matchesSpecializedTypes(asAtom* args, uint32_t numArgs)
+{
+	method_body_info* body = mi->body;
+	for (uint32_t i = 0; i < body->argumenttypes.size(); i++)
+	{
+		Class_base* c = body->argumenttypes[i].type;
+		if (c && (i >= numArgs || asAtomHandler::getClass(args[i],getSystemState(),false) != c))
+		{
+			LOG(LOG_CALLS,"argument "<<i<<" of method "<<getSystemState()->getStringFromUniqueId(functionname)<<" does not match the specialized code");
+			return false;
+		}
+	}
+	return true;
+}
+
+void SyntheticFunction::deoptimize()
+{
+	method_body_info* body = mi->body;
+	LOG(LOG_CALLS,"deoptimizing method "<<getSystemState()->getStringFromUniqueId(functionname));
+	body->tier = method_body_info::TIER_FINAL;
+	body->deoptimizations++;
+}
+
+/**
+ * Methods start with preloaded code that only uses the declared types of the arguments (TIER_GENERIC).
+ * While running the generic code the classes of the untyped arguments are recorded.
+ * If a method gets hot and some untyped arguments always had the same class, the method is preloaded again
+ * using these classes as the types of the arguments (TIER_SPECIALIZED). The generic code is kept in
+ * method_body_info::inactivecode. The specialized code is only valid as long as the arguments keep their
+ * classes, so the method goes back to the generic code on the first call with different classes (TIER_FINAL).
+ * Methods in TIER_FINAL are not profiled anymore.
+ * This is only called if the method is not executing, recursive calls are handled in call()
+ */
+void SyntheticFunction::updateTier(ASWorker* wrk, asAtom* args, uint32_t numArgs)
+{
+	const uint32_t tierup_hit_threshold=1000;
+	method_body_info* body = mi->body;
+	switch (body->tier)
+	{
+		case method_body_info::TIER_GENERIC:
+		{
+			if (body->argumenttypes.empty())
+				body->argumenttypes.resize(mi->numArgs());
+			for (uint32_t i = 0; i < mi->numArgs(); i++)
+			{
+				argumenttypefeedback& f = body->argumenttypes[i];
+				if (f.polymorphic || mi->paramTypes[i] != Type::anyType)
+					continue;
+				Class_base* c = i < numArgs ? asAtomHandler::getClass(args[i],getSystemState(),false) : nullptr;
+				if (c == nullptr || (f.type && f.type != c))
+				{
+					f.type=nullptr;
+					f.polymorphic=true;
+				}
+				else
+					f.type=c;
+			}
+			if (body->hit_count < tierup_hit_threshold)
+				break;
+			bool specialize=false;
+			for (auto it = body->argumenttypes.begin(); it != body->argumenttypes.end(); it++)
+			{
+				if (it->type)
+					specialize=true;
+			}
+			if (!specialize)
+			{
+				body->tier = method_body_info::TIER_FINAL;
+				break;
+			}
+			LOG(LOG_CALLS,"promoting hot method "<<getSystemState()->getStringFromUniqueId(functionname)<<" after "<<body->hit_count<<" calls");
+			body->tier = method_body_info::TIER_SPECIALIZED;
+			body->promotions++;
+			body->inactivecode = new preloadedmethodcode();
+			body->swapPreloadedCode(*body->inactivecode);
+			preload(wrk);
+			break;
+		}
+		case method_body_info::TIER_SPECIALIZED:
+			if (matchesSpecializedTypes(args,numArgs))
+				break;
+			deoptimize();
+			// fall through
+		case method_body_info::TIER_FINAL:
+			// a recursive call may have deoptimized the method while the specialized code was executing
+			if (body->inactivecode)
+			{
+				if (body->specializedcode)
+					body->swapPreloadedCode(*body->inactivecode);
+				delete body->inactivecode;
+				body->inactivecode=nullptr;
+				setupCallContext();
+			}
+			break;
+	}
+}
+
+/*
+ * Lets a recursive call execute the generic code of a method while the callers execute its specialized code
+ */
+class genericCodeSwitch
+{
+private:
+	method_body_info* body;
+public:
+	genericCodeSwitch():body(nullptr) {}
+	void activate(method_body_info* b)
+	{
+		body=b;
+		body->swapPreloadedCode(*body->inactivecode);
+	}
+	~genericCodeSwitch()
+	{
+		if (body)
+			body->swapPreloadedCode(*body->inactivecode);
+	}
+};
+
 /**
  * This prepares a new call_context and then executes the ABC bytecode function
  * by ABCVm::executeFunction() or through JIT.
@@ -397,24 +585,21 @@ void SyntheticFunction::call(ASWorker* wrk,asAtom& ret, asAtom& obj, asAtom *arg
 	assert(wrk == getWorker());
 	call_context* saved_cc = wrk->incStack(obj,this->functionname);
 	if (codeStatus != method_body_info::PRELOADED && codeStatus != method_body_info::USED)
+		preload(wrk);
+	genericCodeSwitch genericcode;
+	// the code can't be replaced while it is executed, so recursive calls are not counted
+	if (codeStatus == method_body_info::PRELOADED)
 	{
-		mi->body->codeStatus = method_body_info::PRELOADING;
-		mi->cc.sys = getSystemState();
-		mi->cc.worker=wrk;
-		ABCVm::preloadFunction(this,wrk);
-		mi->body->codeStatus = method_body_info::PRELOADED;
-		mi->cc.exec_pos = mi->body->preloadedcode.data();
-		mi->cc.locals = new asAtom[mi->body->getReturnValuePos()+1+mi->body->localresultcount];
-		mi->cc.stack = new asAtom[mi->body->max_stack+1];
-		mi->cc.scope_stack = new asAtom[mi->body->max_scope_depth];
-		mi->cc.scope_stack_dynamic = new bool[mi->body->max_scope_depth];
-		mi->cc.max_stackp=mi->cc.stack+mi->cc.mi->body->max_stack;
-		mi->cc.lastlocal = mi->cc.locals+mi->cc.mi->body->getReturnValuePos()+1+mi->body->localresultcount;
-		mi->cc.localslots = new asAtom*[mi->body->localconstantslots.size()+mi->body->getReturnValuePos()+1+mi->body->localresultcount];
-		for (uint32_t i = 0; i < uint32_t(mi->body->getReturnValuePos()+1+mi->body->localresultcount); i++)
-		{
-			mi->cc.localslots[i] = &mi->cc.locals[i];
-		}
+		++mi->body->hit_count;
+		if (mi->body->tier != method_body_info::TIER_FINAL || mi->body->inactivecode)
+			updateTier(wrk,args,numArgs);
+	}
+	else if (mi->body->specializedcode && !matchesSpecializedTypes(args,numArgs))
+	{
+		// recursive call into the specialized code with other argument types, run it with the generic code
+		if (mi->body->tier == method_body_info::TIER_SPECIALIZED)
+			deoptimize();
+		genericcode.activate(mi->body);
 	}
 
 	/* resolve argument and return types */
@@ -447,7 +632,6 @@ void SyntheticFunction::call(ASWorker* wrk,asAtom& ret, asAtom& obj, asAtom *arg
 		val=mi->synt_method(getSystemState());
 		assert(val);
 	}
-	++mi->body->hit_count;
 #endif
 
 	//Prepare arguments
@@ -783,6 +967,44 @@ bool SyntheticFunction::destruct()
 	return IFunction::destruct();
 }
 
+void SyntheticFunction::gcChildren(std::vector<ASObject*>& children)
+{
+	IFunction::gcChildren(children);
+	// the objects in the scope of a closure are referenced by it, unless the scope is shared with a clone
+	if (!func_scope.isNull() && fromNewFunction && func_scope->getRefCount()==1)
+	{
+		for (auto it = func_scope->scope.begin();it != func_scope->scope.end(); it++)
+		{
+			ASObject* o = asAtomHandler::getObject(it->object);
+			if (o && !o->is<Global>())
+				children.push_back(o);
+		}
+	}
+	children.insert(children.end(),dynamicreferencedobjects.begin(),dynamicreferencedobjects.end());
+}
+
+void SyntheticFunction::gcClearReferences()
+{
+	if (!func_scope.isNull() && fromNewFunction && func_scope->getRefCount()==1)
+	{
+		for (auto it = func_scope->scope.begin();it != func_scope->scope.end(); it++)
+		{
+			ASObject* o = asAtomHandler::getObject(it->object);
+			if (o && !o->is<Global>())
+			{
+				if (o->is<Activation_object>())
+					o->as<Activation_object>()->removeDynamicFunctionUsage(this);
+				o->decRef();
+			}
+		}
+		func_scope.reset();
+	}
+	for (auto it = dynamicreferencedobjects.begin();it != dynamicreferencedobjects.end(); it++)
+		(*it)->decRef();
+	dynamicreferencedobjects.clear();
+	IFunction::gcClearReferences();
+}
+
 bool SyntheticFunction::isEqual(ASObject *r)
 {
 	return r == this || 
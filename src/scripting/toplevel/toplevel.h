@@ -496,6 +496,8 @@ public:
 		ret->setActivationCount(this->getActivationCount());
 		return ret;
 	}
+	void gcChildren(std::vector<ASObject*>& children) override;
+	void gcClearReferences() override;
 	IFunction* createFunctionInstance(ASWorker* wrk)
 	{
 		IFunction* ret=nullptr;
@@ -620,12 +622,23 @@ private:
 	multiname* simpleGetterOrSetterName;
 	bool fromNewFunction;
 	SyntheticFunction(ASWorker* wrk,Class_base* c,method_info* m);
+	/* (Re-)create the preloaded code and the call_context of the method */
+	void preload(ASWorker* wrk);
+	/* (Re-)allocate the call_context for the current preloaded code */
+	void setupCallContext();
+	/* Gather type feedback and promote or deoptimize the preloaded code */
+	void updateTier(ASWorker* wrk, asAtom* args, uint32_t numArgs);
+	/* Check the arguments against the types the code was specialized for */
+	bool matchesSpecializedTypes(asAtom* args, uint32_t numArgs);
+	void deoptimize();
 protected:
 	IFunction* clone(ASWorker* wrk) override;
 public:
 	~SyntheticFunction() {}
 	void call(ASWorker* wrk, asAtom &ret, asAtom& obj, asAtom *args, uint32_t num_args, bool coerceresult, bool coercearguments);
 	bool destruct() override;
+	void gcChildren(std::vector<ASObject*>& children) override;
+	void gcClearReferences() override;
 	method_info* getMethodInfo() const override { return mi; }
 	
 	_NR<scope_entry_list> func_scope;
@@ -33,8 +33,14 @@ private:
 	bool isConstant:1;
 	bool inDestruction:1;
 	bool cached:1;
+	bool gctracked:1;
+	// set by the CycleCollector while this object is in its candidate list, not a bit field as it is written from several threads
+	bool gcbuffered;
 protected:
-	RefCountable() : ref_count(1),activation_refcount(1),isConstant(false),inDestruction(false),cached(false) {}
+	RefCountable() : ref_count(1),activation_refcount(1),isConstant(false),inDestruction(false),cached(false),gctracked(false),gcbuffered(false) {}
+	inline void setGCTracked() { gctracked=true; }
+	// called when the reference count of an object tracked by the cycle collector is decremented to a nonzero value
+	virtual void gcCandidate() {}
 
 public:
 	virtual ~RefCountable() {}
@@ -50,6 +56,9 @@ public:
 	inline bool getCached() const { return cached; }
 	inline void setCached() { cached=true; }
 	inline void resetCached() { cached=false; }
+	inline bool getGCTracked() const { return gctracked; }
+	inline bool getGCBuffered() const { return gcbuffered; }
+	inline void setGCBuffered(bool b) { gcbuffered=b; }
 	inline void incActivationCount() { activation_refcount++; }
 	inline void decActivationCount() { activation_refcount--; }
 	inline void setActivationCount(int32_t c) { activation_refcount=c; }
@@ -85,7 +94,11 @@ public:
 			if (ref_count == activation_refcount)
 				return handleDestruction();
 			else
+			{
 				--ref_count;
+				if (gctracked && !gcbuffered)
+					gcCandidate();
+			}
 		}
 		return cached;
 	}
@@ -44,7 +44,9 @@
 #include "backends/locale.h"
 #include "backends/currency.h"
 #include "memory_support.h"
+#include "cyclecollector.h"
 #include "parsing/tags.h"
+#include "parsing/tagindex.h"
 
 #ifdef ENABLE_CURL
 #include <curl/curl.h>
@@ -256,9 +258,9 @@ SystemState::SystemState(uint32_t fileSize, FLASH_MODE mode):
 	renderThread(nullptr),inputThread(nullptr),engineData(nullptr),dumpedSWFPathAvailable(0),
 	vmVersion(VMNONE),childPid(0),
 	parameters(NullRef),
-	invalidateQueueHead(NullRef),invalidateQueueTail(NullRef),lastUsedStringId(0),lastUsedNamespaceId(0x7fffffff),
+	invalidateQueueHead(NullRef),invalidateQueueTail(NullRef),drawJobsScheduled(0),drawJobsCancelled(0),drawJobsDiscarded(0),lastUsedStringId(0),lastUsedNamespaceId(0x7fffffff),
 	showProfilingData(false),allowFullscreen(false),flashMode(mode),swffilesize(fileSize),avm1global(nullptr),
-	currentVm(nullptr),builtinClasses(nullptr),useInterpreter(true),useFastInterpreter(false),useJit(false),ignoreUnhandledExceptions(false),exitOnError(ERROR_NONE),
+	benchmark(nullptr),cycleCollector(nullptr),currentVm(nullptr),builtinClasses(nullptr),useInterpreter(true),useFastInterpreter(false),useJit(false),usePreloadCache(false),ignoreUnhandledExceptions(false),exitOnError(ERROR_NONE),
 	systemDomain(nullptr),worker(nullptr),workerDomain(nullptr),singleworker(true),
 	downloadManager(nullptr),extScriptObject(nullptr),scaleMode(SHOW_ALL),unaccountedMemory(nullptr),tagsMemory(nullptr),stringMemory(nullptr),textTokenMemory(nullptr),shapeTokenMemory(nullptr),morphShapeTokenMemory(nullptr),bitmapTokenMemory(nullptr),spriteTokenMemory(nullptr),
 	static_SoundMixer_bufferTime(0),static_Multitouch_inputMode("gesture"),isinitialized(false)
@@ -564,6 +566,9 @@ void SystemState::stopEngines()
 		downloadThreadPool->forceStop();
 	if(threadPool)
 		threadPool->forceStop();
+	if(drawJobsScheduled)
+		LOG(LOG_INFO,"draw jobs: "<<drawJobsScheduled<<" scheduled, "<<drawJobsCancelled<<" superseded before rasterization, "
+			<<drawJobsDiscarded<<" superseded after rasterization");
 	timerThread->wait();
 	frameTimerThread->wait();
 	/* first shutdown the vm, because it can use all the others */
@@ -628,7 +633,12 @@ void SystemState::saveMemoryUsageInformation(ofstream& out, int snapshotCount) c
 		}
 	}
 
-	out << "mem_heap_B=" << totalMem << "\nmem_heap_extra_B=0\nmem_stacks_B=0\nheap_tree=detailed" << endl;
+	// memory reserved by the slab allocator that is not used by any object
+	slab_statistics slabstats;
+	slab_get_statistics(slabstats);
+	uint64_t slabUnused = slabstats.reservedbytes-slabstats.usedbytes;
+
+	out << "mem_heap_B=" << totalMem << "\nmem_heap_extra_B=" << slabUnused << "\nmem_stacks_B=0\nheap_tree=detailed" << endl;
 	out << "n" << totalCount << ": " << totalMem << " ActionScript_objects" << endl;
 	it=memoryAccounts.begin();
 	for(;it!=memoryAccounts.end();++it)
@@ -659,6 +669,7 @@ extern std::set<ASObject*> memcheckset;
 #endif
 SystemState::~SystemState()
 {
+	delete benchmark;
 	// 1) set all not removed event listeners to constant
 	for (auto it = listenerfunctionlist.begin(); it != listenerfunctionlist.end(); it++)
 	{
@@ -742,6 +753,9 @@ void SystemState::destroy()
 	if(threadPool)
 		threadPool->forceStop();
 	stopEngines();
+	//The VM thread is stopped, so no more cycles are collected
+	setCycleCollectorBudget(0);
+	slab_log_statistics();
 
 	delete extScriptObject;
 	delete intervalManager;
@@ -1229,6 +1243,36 @@ void SystemState::setRenderRate(float rate)
 	}
 }
 
+void SystemState::enableBenchmark(uint32_t frames, const string& output)
+{
+	benchmark=new FrameBenchmark(frames,output);
+	//The frames are run back to back, the timers follow the frames
+	timerThread->useVirtualClock();
+}
+
+void SystemState::synchronizeWithVm()
+{
+	if(currentVm==nullptr)
+		return;
+	_R<SynchronizationEvent> sync=_MR(new (unaccountedMemory) SynchronizationEvent());
+	if (currentVm->addEvent(NullRef, sync))
+		sync->wait();
+}
+
+void SystemState::setCycleCollectorBudget(uint32_t ms)
+{
+	CycleCollector* c = cycleCollector;
+	cycleCollector = ms ? new CycleCollector(ms*1000) : nullptr;
+	delete c;
+}
+
+uint64_t SystemState::getElapsedTime()
+{
+	if(benchmark)
+		return timerThread->getVirtualTime();
+	return compat_msectiming() - startTime;
+}
+
 void SystemState::addJob(IThreadJob* j)
 {
 	threadPool->addJob(j);
@@ -1284,10 +1328,63 @@ void SystemState::addToInvalidateQueue(_R<DisplayObject> d)
 	}
 }
 
+static void supersedeDrawJobs(std::unordered_set<AsyncDrawJob*>& jobs, DisplayObject* o)
+{
+	for (auto it = jobs.begin(); it != jobs.end(); it++)
+	{
+		if ((*it)->getOwner() != o)
+			continue;
+		if ((*it)->isSharedRaster())
+		{
+			// other instances may wait for the shared rasterization, only keep it from updating the owner
+			(*it)->detachOwner();
+			continue;
+		}
+		// older drawjob currently running for this DisplayObject, abort it
+		(*it)->threadAborting=true;
+		jobs.erase(it);
+		break;
+	}
+}
+
+// area of the drawable inside the window
+static uint64_t visibleDrawableArea(IDrawable* d, int offx, int offy, int windowWidth, int windowHeight)
+{
+	int32_t x0=max(d->getXOffsetTransformed()+offx,0);
+	int32_t y0=max(d->getYOffsetTransformed()+offy,0);
+	int32_t x1=min(d->getXOffsetTransformed()+offx+d->getWidthTransformed(),windowWidth);
+	int32_t y1=min(d->getYOffsetTransformed()+offy+d->getHeightTransformed(),windowHeight);
+	if(x1<=x0 || y1<=y0)
+		return 0;
+	return uint64_t(x1-x0)*uint64_t(y1-y0);
+}
+
+void SystemState::submitDrawJobs()
+{
+	// largest visible surfaces first. addJob queues the jobs round-robin on the workers also
+	// while all of them are busy, and every queue is processed in FIFO order
+	stable_sort(drawJobsFrame.begin(),drawJobsFrame.end(),
+		[](const pair<uint64_t,AsyncDrawJob*>& a, const pair<uint64_t,AsyncDrawJob*>& b) { return a.first>b.first; });
+	for (auto it = drawJobsFrame.begin(); it != drawJobsFrame.end(); it++)
+	{
+		drawJobsScheduled++;
+		if (it->second->threadAborting)
+		{
+			// superseded by a later invalidation during the same flush, i.e. another child of a cacheAsBitmap object
+			AsyncDrawJobSuperseded(false);
+			it->second->jobFence();
+		}
+		else
+			addJob(it->second);
+	}
+	drawJobsFrame.clear();
+}
+
 void SystemState::flushInvalidationQueue()
 {
 	if (isShuttingDown())
 		return;
+	Chronometer chronometer;
 	Locker l(invalidateQueueLock);
 	_NR<DisplayObject> cur=invalidateQueueHead;
 	while(!cur.isNull())
@@ -1306,39 +1403,32 @@ void SystemState::flushInvalidationQueue()
 			{
 				if (cachedBitmap)
 					drawobj = cachedBitmap;
-				if (drawobj->getNeedsTextureRecalculation() || !d->isCachedSurfaceUsable(drawobj.getPtr()))
+				// shared rasterizations only depend on the cache entry, which is drawn by the first instance needing it
+				bool sharedRaster = d->getRasterEntry()!=nullptr;
+				if (sharedRaster ? d->isRasterNeeded() : (drawobj->getNeedsTextureRecalculation() || !d->isCachedSurfaceUsable(drawobj.getPtr())))
 				{
 					drawjobLock.lock();
 					AsyncDrawJob* j = new AsyncDrawJob(d,drawobj);
 					if (!drawobj->getTextureRecalculationSkippable())
 					{
-						for (auto it = drawJobsPending.begin(); it != drawJobsPending.end(); it++)
-						{
-							if ((*it)->getOwner() == drawobj.getPtr())
-							{
-								// older drawjob currently running for this DisplayObject, abort it
-								(*it)->threadAborting=true;
-								drawJobsPending.erase(it);
-								break;
-							}
-						}
-						for (auto it = drawJobsNew.begin(); it != drawJobsNew.end(); it++)
-						{
-							if ((*it)->getOwner() == drawobj.getPtr())
-							{
-								// older drawjob currently running for this DisplayObject, abort it
-								(*it)->threadAborting=true;
-								drawJobsNew.erase(it);
-								break;
-							}
-						}
+						supersedeDrawJobs(drawJobsPending,drawobj.getPtr());
+						supersedeDrawJobs(drawJobsNew,drawobj.getPtr());
 						drawJobsNew.insert(j);
 					}
-					addJob(j);
 					drawjobLock.unlock();
+					drawJobsFrame.emplace_back(visibleDrawableArea(d,offx,offy,renderThread->windowWidth,renderThread->windowHeight),j);
 				}
 				else
+				{
+					if (sharedRaster)
+					{
+						drawjobLock.lock();
+						supersedeDrawJobs(drawJobsPending,drawobj.getPtr());
+						supersedeDrawJobs(drawJobsNew,drawobj.getPtr());
+						drawjobLock.unlock();
+					}
 					renderThread->addRefreshableSurface(d,drawobj);
+				}
 			}
 			drawobj->hasChanged=false;
 			if (getRenderThread()->isStarted())
@@ -1348,9 +1438,15 @@ void SystemState::flushInvalidationQueue()
 		cur->invalidateQueueNext=NullRef;
 		cur=next;
 	}
+	submitDrawJobs();
 	renderThread->signalSurfaceRefresh();
 	invalidateQueueHead=NullRef;
 	invalidateQueueTail=NullRef;
+	if (benchmark)
+	{
+		benchmark->accountTime(FrameBenchmark::LAYOUT,chronometer.checkpoint());
+		benchmark->layoutCompleted();
+	}
 }
 void SystemState::AsyncDrawJobCompleted(AsyncDrawJob *j)
 {
@@ -1385,6 +1481,139 @@ const tiny_string& SystemState::getProfilingOutput() const
 }
 #endif
 
+FrameBenchmark::FrameBenchmark(uint32_t n, const string& output):maxFrames(n),layoutFrame(NO_FRAME),frameStart(0),outputFile(output),format(CSV)
+{
+	if(outputFile.size()>5 && outputFile.compare(outputFile.size()-5,5,".json")==0)
+		format=JSON;
+	frames.reserve(maxFrames);
+}
+
+void FrameBenchmark::accountTime(PHASE phase, uint32_t time)
+{
+	Locker locker(mutex);
+	if(frames.empty())
+		return;
+	frames.back().timing[phase]+=time;
+}
+
+void FrameBenchmark::accountTime(PHASE phase, uint32_t time, uint32_t frame)
+{
+	Locker locker(mutex);
+	if(frame==NO_FRAME)
+		frame=layoutFrame;
+	if(frame>=frames.size())
+		return;
+	frames[frame].timing[phase]+=time;
+}
+
+bool FrameBenchmark::nextFrame(uint64_t virtualTime)
+{
+	Locker locker(mutex);
+	gint64 now=g_get_monotonic_time();
+	if(!frames.empty())
+		frames.back().wallTime=now-frameStart;
+	frameStart=now;
+	if(frames.size()>=maxFrames)
+		return false;
+	frames.push_back(FrameData(frames.size(),virtualTime));
+	return true;
+}
+
+uint32_t FrameBenchmark::getCurrentFrame()
+{
+	Locker locker(mutex);
+	return frames.empty() ? NO_FRAME : frames.size()-1;
+}
+
+void FrameBenchmark::layoutCompleted()
+{
+	Locker locker(mutex);
+	if(!frames.empty())
+		layoutFrame=frames.size()-1;
+}
+
+uint32_t FrameBenchmark::getLayoutFrame()
+{
+	Locker locker(mutex);
+	return layoutFrame;
+}
+
+void FrameBenchmark::setTextureStatistics(uint32_t frame, const TextureStatistics& stats)
+{
+	Locker locker(mutex);
+	if(frame==NO_FRAME)
+		frame=layoutFrame;
+	if(frame>=frames.size())
+		return;
+	FrameData& d=frames[frame];
+	d.hasTextureStatistics=true;
+	d.textureOccupancy=stats.occupancy;
+	d.textureFragmentation=stats.fragmentation;
+	d.textureEvictions=stats.evictions;
+}
+
+void FrameBenchmark::save()
+{
+	Locker locker(mutex);
+	ofstream file;
+	if(!outputFile.empty())
+	{
+		file.open(outputFile.c_str(), ios_base::out | ios_base::trunc);
+		if(!file)
+		{
+			LOG(LOG_ERROR,"Unable to write benchmark output to "<<outputFile);
+			return;
+		}
+	}
+	ostream& f = outputFile.empty() ? cout : file;
+	static const char* phaseNames[PHASE_COUNT] = { "script", "layout", "render", "upload" };
+	uint64_t totalWallTime=0;
+	if(format==JSON)
+		f << "{\"frames\":[" << endl;
+	else
+	{
+		f << "frame,virtual_time_ms,wall_time_us";
+		for(uint32_t j=0;j<PHASE_COUNT;j++)
+			f << "," << phaseNames[j] << "_us";
+		f << ",texture_occupancy,texture_fragmentation,texture_evictions" << endl;
+	}
+	for(uint32_t i=0;i<frames.size();i++)
+	{
+		FrameData& d=frames[i];
+		if(!d.hasTextureStatistics && i>0)
+		{
+			d.textureOccupancy=frames[i-1].textureOccupancy;
+			d.textureFragmentation=frames[i-1].textureFragmentation;
+			d.textureEvictions=frames[i-1].textureEvictions;
+		}
+		totalWallTime+=d.wallTime;
+		uint32_t timing[PHASE_COUNT];
+		for(uint32_t j=0;j<PHASE_COUNT;j++)
+			timing[j]=d.timing[j];
+		//layout is done by the VM thread, so it is included in the script time
+		timing[SCRIPT]-= timing[SCRIPT] > timing[LAYOUT] ? timing[LAYOUT] : timing[SCRIPT];
+		if(format==JSON)
+		{
+			f << "{\"frame\":" << d.index << ",\"virtual_time_ms\":" << d.virtualTime << ",\"wall_time_us\":" << d.wallTime;
+			for(uint32_t j=0;j<PHASE_COUNT;j++)
+				f << ",\"" << phaseNames[j] << "_us\":" << timing[j];
+			f << ",\"texture_occupancy\":" << d.textureOccupancy << ",\"texture_fragmentation\":" << d.textureFragmentation;
+			f << ",\"texture_evictions\":" << d.textureEvictions;
+			f << "}" << (i+1<frames.size() ? "," : "") << endl;
+		}
+		else
+		{
+			f << d.index << "," << d.virtualTime << "," << d.wallTime;
+			for(uint32_t j=0;j<PHASE_COUNT;j++)
+				f << "," << timing[j];
+			f << "," << d.textureOccupancy << "," << d.textureFragmentation << "," << d.textureEvictions << endl;
+		}
+	}
+	if(format==JSON)
+		f << "],\"total_wall_time_us\":" << totalWallTime << "}" << endl;
+	LOG(LOG_INFO,"Benchmark: " << frames.size() << " frames in " << totalWallTime/1000 << "ms");
+}
+
 void ThreadProfile::setTag(const std::string& t)
 {
 	Locker locker(mutex);
@@ -1495,7 +1724,7 @@ void ThreadProfile::plot(uint32_t maxTime, cairo_t *cr)
 
 ParseThread::ParseThread(istream& in, _R<ApplicationDomain> appDomain, _R<SecurityDomain> secDomain, Loader *_loader, tiny_string srcurl)
   : version(0),applicationDomain(appDomain),securityDomain(secDomain),
-    f(in),uncompressingFilter(nullptr),backend(nullptr),bytearraybuf(nullptr),loader(_loader),
+    f(in),uncompressingFilter(nullptr),uncompressedBuffer(nullptr),backend(nullptr),bytearraybuf(nullptr),loader(_loader),
     parsedObject(NullRef),url(srcurl),fileType(FT_UNKNOWN)
 {
 	f.exceptions ( istream::eofbit | istream::failbit | istream::badbit );
@@ -1503,7 +1732,7 @@ ParseThread::ParseThread(istream& in, _R<ApplicationDomain> appDomain, _R<Securi
 
 ParseThread::ParseThread(std::istream& in, RootMovieClip *root)
   : version(0),applicationDomain(NullRef),securityDomain(NullRef), //The domains are not needed since the system state create them itself
-    f(in),uncompressingFilter(nullptr),backend(nullptr),bytearraybuf(nullptr),loader(nullptr),
+    f(in),uncompressingFilter(nullptr),uncompressedBuffer(nullptr),backend(nullptr),bytearraybuf(nullptr),loader(nullptr),
     parsedObject(NullRef),url(),fileType(FT_UNKNOWN)
 {
 	f.exceptions ( istream::eofbit | istream::failbit | istream::badbit );
@@ -1522,6 +1751,7 @@ ParseThread::~ParseThread()
 		//Restore the istream
 		f.rdbuf(backend);
 		delete uncompressingFilter;
+		delete uncompressedBuffer;
 	}
 	parsedObject.reset();
 }
@@ -1582,6 +1812,35 @@ void ParseThread::parseSWFHeader(RootMovieClip *root, UI8 ver)
 		f.rdbuf(uncompressingFilter);
 		// the first 8 bytes from the header are always uncompressed (magic bytes + FileLength)
 		root->loaderInfo->setBytesTotal(FileLength-8);
+		if(dynamic_cast<bytes_buf*>(backend))
+		{
+			// the whole file is in memory, so it is uncompressed at once and the tags are read
+			// from one buffer instead of going through the filter. Tags copy their payloads, so the
+			// buffer is freed when parsing is finished
+			uint8_t* data=FileLength>8 ? new(nothrow) uint8_t[FileLength-8] : nullptr;
+			if(data)
+			{
+				std::shared_ptr<const uint8_t> shareddata(data,std::default_delete<uint8_t[]>());
+				uint32_t len=0;
+				try
+				{
+					// read in large chunks, so the tags before a truncation are still parsed
+					while(len<FileLength-8)
+					{
+						streamsize count=uncompressingFilter->sgetn((char*)data+len,min(uint32_t(FileLength-8)-len,uint32_t(1024*1024)));
+						if(count<=0)
+							break;
+						len+=count;
+					}
+				}
+				catch(ParseException& e)
+				{
+					LOG(LOG_ERROR,"truncated compressed SWF file after "<<len<<" bytes");
+				}
+				uncompressedBuffer=new bytes_buf(shareddata,len);
+				f.rdbuf(uncompressedBuffer);
+			}
+		}
 	}
 
 	f >> FrameSize >> FrameRate >> FrameCount;
@@ -1604,6 +1863,7 @@ void ParseThread::parseSWFHeader(RootMovieClip *root, UI8 ver)
 
 void ParseThread::execute()
 {
+	void* previous=tls_get(parse_thread_tls);
 	tls_set(parse_thread_tls,this);
 	try
 	{
@@ -1644,7 +1904,34 @@ void ParseThread::execute()
 	{
 		LOG(LOG_ERROR,"Stream exception in ParseThread " << e.what());
 	}
+	// the main ParseThread lives as long as its movie, the inflated file is not needed anymore
+	if(uncompressedBuffer)
+	{
+		f.rdbuf(backend);
+		delete uncompressedBuffer;
+		uncompressedBuffer=nullptr;
+	}
+	// the ThreadPool worker or the LoaderThread may outlive this ParseThread
+	tls_set(parse_thread_tls,previous);
+}
+// takes the next tag from the prefetcher if a helper already constructed it
+static Tag* readNextTag(TagFactory& factory, TagPrefetcher* prefetcher, std::istream& f, RootMovieClip* root)
+{
+	if(prefetcher)
+	{
+		uint32_t offset=f.tellg();
+		uint32_t length;
+		Tag* tag=prefetcher->take(offset,length);
+		if(tag)
+		{
+			f.seekg(offset+length);
+			root->loaderInfo->setBytesLoaded(f.tellg());
+			return tag;
+		}
+	}
+	return factory.readTag(root);
 }
+
 void ParseThread::parseSWF(UI8 ver)
 {
 	if (loader && !loader->allowLoadingSWF())
@@ -1705,8 +1992,13 @@ void ParseThread::parseSWF(UI8 ver)
 			}
 		}
 
+		// if the whole file is in memory, the dictionary tags that don't depend on other tags
+		// are constructed ahead on the ThreadPool, all other tags are still handled in order
+		unique_ptr<TagPrefetcher> prefetcher;
+		if(bytes_buf* buf=dynamic_cast<bytes_buf*>(f.rdbuf()))
+			prefetcher.reset(new TagPrefetcher(buf,f.tellg(),root));
 		TagFactory factory(f);
-		Tag* tag=factory.readTag(root);
+		Tag* tag=readNextTag(factory,prefetcher.get(),f,root);
 
 		if (root->version >= 8)
 		{
@@ -1880,8 +2172,11 @@ void ParseThread::parseSWF(UI8 ver)
 				break;
 
 			if (!done)
-				tag=factory.readTag(root);
+				tag=readNextTag(factory,prefetcher.get(),f,root);
 		}// end while
+		char* dumpfile=getenv("LIGHTSPARK_DUMP_TAG_INDEX");
+		if(prefetcher && dumpfile && root == root->getSystemState()->mainClip)
+			prefetcher->dump(dumpfile);
 	}
 	catch(std::exception& e)
 	{
@@ -2304,6 +2599,13 @@ void SystemState::tick()
 	}
 	if(currentVm==nullptr)
 		return;
+	if(benchmark && !benchmark->nextFrame(timerThread->getVirtualTime()))
+	{
+		stopMe=true;
+		benchmark->save();
+		setShutdownFlag();
+		return;
+	}
 	/* See http://www.senocular.com/flash/tutorials/orderofoperations/
 	 * for the description of steps.
 	 */
@@ -33,12 +33,14 @@
 #include "memory_support.h"
 
 class uncompressing_filter;
+class bytes_buf;
 
 namespace lightspark
 {
 
 class ABCVm;
 class AudioManager;
+class CycleCollector;
 class Config;
 class ControlTag;
 class DownloadManager;
@@ -50,6 +52,7 @@ class IntervalManager;
 class ParseThread;
 class PluginManager;
 class RenderThread;
+struct TextureStatistics;
 class SecurityManager;
 class LocaleManager;
 class CurrencyManager;
@@ -196,6 +199,77 @@ public:
 	void plot(uint32_t max, cairo_t *cr);
 };
 
+/*
+ * Per frame timings collected when running a fixed number of frames as fast as possible
+ * (--benchmark-frames). The TimerThread runs by a virtual clock, so the frames, Timers and
+ * timeouts are not paced by the wall clock and the scripts see the same times in every run
+ */
+class FrameBenchmark
+{
+public:
+	enum PHASE { SCRIPT=0, LAYOUT, RENDER, UPLOAD, PHASE_COUNT };
+	enum FORMAT { CSV=0, JSON };
+	static const uint32_t NO_FRAME=UINT32_MAX;
+private:
+	Mutex mutex;
+	class FrameData
+	{
+	public:
+		uint32_t index;
+		uint64_t virtualTime;
+		// wall clock duration of the frame in microseconds
+		uint64_t wallTime;
+		// thread time in microseconds spent in every PHASE
+		uint32_t timing[PHASE_COUNT];
+		// texture usage after the frame has been rendered, copied from the previous frame if it was not rendered
+		bool hasTextureStatistics;
+		float textureOccupancy;
+		float textureFragmentation;
+		uint32_t textureEvictions;
+		FrameData(uint32_t i, uint64_t v):index(i),virtualTime(v),wallTime(0),hasTextureStatistics(false),
+			textureOccupancy(0),textureFragmentation(0),textureEvictions(0)
+		{
+			for(uint32_t j=0;j<PHASE_COUNT;j++)
+				timing[j]=0;
+		}
+	};
+	std::vector<FrameData> frames;
+	uint32_t maxFrames;
+	// the last frame whose display list has been laid out, it is the one the RenderThread draws
+	uint32_t layoutFrame;
+	gint64 frameStart;
+	std::string outputFile;
+	FORMAT format;
+public:
+	/*
+	 * @param n The number of frames to run
+	 * @param output The file the timings are written to, the format is JSON
+	 * if the name ends with ".json", CSV otherwise. Empty for stdout in CSV format
+	 */
+	FrameBenchmark(uint32_t n, const std::string& output);
+	// adds time to the running frame
+	void accountTime(PHASE phase, uint32_t time);
+	/*
+	 * adds time to the given frame, used for the work done asynchronously after the frame has ended.
+	 * NO_FRAME adds it to the frame laid out last
+	 */
+	void accountTime(PHASE phase, uint32_t time, uint32_t frame);
+	/*
+	 * Starts the next frame
+	 * @param virtualTime The time of the virtual clock in milliseconds
+	 * @return false if all frames have been run
+	 */
+	bool nextFrame(uint64_t virtualTime);
+	// index of the running frame, NO_FRAME before the first one
+	uint32_t getCurrentFrame();
+	// called when the display list of the running frame has been laid out
+	void layoutCompleted();
+	uint32_t getLayoutFrame();
+	// called by the RenderThread after it has drawn the given frame
+	void setTextureStatistics(uint32_t frame, const TextureStatistics& stats);
+	void save();
+};
+
 class SystemState: public ITickJob, public InvalidateQueue
 {
 private:
@@ -292,6 +366,16 @@ private:
 	Mutex drawjobLock;
 	std::unordered_set<AsyncDrawJob*> drawJobsNew;
 	std::unordered_set<AsyncDrawJob*> drawJobsPending;
+	/*
+	   The jobs created by the current flushInvalidationQueue and their visible
+	   area in pixels. They are only added to the ThreadPool at the end of the flush
+	*/
+	std::vector<std::pair<uint64_t,AsyncDrawJob*>> drawJobsFrame;
+	void submitDrawJobs();
+	// statistics of the draw jobs, logged on shutdown
+	std::atomic<uint64_t> drawJobsScheduled;
+	std::atomic<uint64_t> drawJobsCancelled;
+	std::atomic<uint64_t> drawJobsDiscarded;
 #ifdef PROFILING_SUPPORT
 	/*
 	   Output file for the profiling data
@@ -384,6 +468,18 @@ public:
 	//Performance profiling
 	ThreadProfile* allocateProfiler(const RGB& color);
 	std::list<ThreadProfile*> profilingData;
+	//Headless benchmarking, nullptr unless a fixed number of frames is run
+	FrameBenchmark* benchmark;
+	//Collector of reference cycles between ASObjects, nullptr if disabled
+	CycleCollector* cycleCollector;
+	//enables the cycle collector with the given time budget per frame in milliseconds, 0 disables it
+	void setCycleCollectorBudget(uint32_t ms);
+	// runs the given number of frames by the virtual clock of the timers, see FrameBenchmark
+	void enableBenchmark(uint32_t frames, const std::string& output);
+	// milliseconds elapsed since startup, as seen by getTimer()
+	uint64_t getElapsedTime();
+	// waits until the VM has handled all events queued before
+	void synchronizeWithVm();
 	
 	inline Null* getNullRef() const
 	{
@@ -426,6 +522,9 @@ public:
 	bool useInterpreter;
 	bool useFastInterpreter;
 	bool useJit;
+	bool usePreloadCache;
+	//File the method call counters and tiers are written to on exit, empty if disabled
+	tiny_string tieringProfileOutput;
 	bool ignoreUnhandledExceptions;
 	ERROR_TYPE exitOnError;
 
@@ -502,6 +601,8 @@ public:
 	void addToInvalidateQueue(_R<DisplayObject> d) override;
 	void flushInvalidationQueue();
 	void AsyncDrawJobCompleted(AsyncDrawJob* j);
+	// called when a superseded draw job is dropped before (or after) its rasterization
+	void AsyncDrawJobSuperseded(bool rasterized) { if (rasterized) drawJobsDiscarded++; else drawJobsCancelled++; }
 	void swapAsyncDrawJobQueue();
 
 	//Resize support
@@ -645,6 +746,8 @@ private:
 	std::vector<tiny_string> extensions;
 	std::istream& f;
 	uncompressing_filter* uncompressingFilter;
+	// the whole uncompressed file, if it was available in memory
+	bytes_buf* uncompressedBuffer;
 	std::streambuf* backend;
 	std::streambuf* bytearraybuf;
 	Loader *loader;
@@ -854,6 +854,12 @@ inline RGBA medianColor(const RGBA& a, const RGBA& b, float factor)
 		a.Alpha+(b.Alpha-a.Alpha)*factor);
 }
 
+static const int off_parse_thread_index=std::ios_base::xalloc();
+void lightspark::setOffParseThread(std::istream& s)
+{
+	s.iword(off_parse_thread_index)=1;
+}
+
 std::istream& lightspark::operator>>(std::istream& s, FILLSTYLE& v)
 {
 	UI8 tmp;
@@ -889,6 +895,9 @@ std::istream& lightspark::operator>>(std::istream& s, FILLSTYLE& v)
 		{
 			try
 			{
+				// the dictionary is only complete up to this tag on the ParseThread
+				if(s.iword(off_parse_thread_index))
+					throw ParseException("bitmap fill outside of the ParseThread");
 				const DictionaryTag* dict=getParseThread()->getRootMovie()->dictionaryLookup(bitmapId);
 				const BitmapTag* b = dynamic_cast<const BitmapTag*>(dict);
 				if(!b)
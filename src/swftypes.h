@@ -1630,6 +1630,9 @@ std::istream& operator>>(std::istream& stream, LINESTYLE2& v);
 std::istream& operator>>(std::istream& stream, MORPHLINESTYLE& v);
 std::istream& operator>>(std::istream& stream, MORPHLINESTYLE2& v);
 std::istream& operator>>(std::istream& stream, FILLSTYLE& v);
+/* Marks a stream that is read outside of the ParseThread. Bitmap fills can't be looked up
+ * in the dictionary while reading from it, so they throw a ParseException */
+void setOffParseThread(std::istream& stream);
 std::istream& operator>>(std::istream& stream, MORPHFILLSTYLE& v);
 std::istream& operator>>(std::istream& stream, SHAPERECORD& v);
 std::istream& operator>>(std::istream& stream, TEXTRECORD& v);
@@ -16,7 +16,11 @@
     You should have received a copy of the GNU Lesser General Public License
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 **************************************************************************/
+#include <atomic>
 #include <cassert>
+#include <memory>
+#include <SDL2/SDL_cpuinfo.h>
+#include <SDL2/SDL_timer.h>
 
 #include "thread_pool.h"
 #include "exceptions.h"
@@ -27,63 +31,212 @@
 
 using namespace lightspark;
 
-ThreadPool::ThreadPool(SystemState* s):num_jobs(0),stopFlag(false),runcount(0)
+//Pool data of the worker running on this thread, if any
+DEFINE_AND_INITIALIZE_TLS(tls_pool_worker);
+
+template<class T>
+static void updateMaximum(std::atomic<T>& maximum, T value)
+{
+	T cur=maximum.load();
+	while(value>cur && !maximum.compare_exchange_weak(cur,value));
+}
+
+ThreadPool::ThreadPool(SystemState* s, uint32_t threadcount):stopFlag(false),runcount(0),queuedcount(0),nextQueue(0),
+	maxQueueDepth(0),jobsExecuted(0),steals(0),additionalThreads(0),totalWaitTime(0),maxWaitTime(0),stallThreadRunning(false)
 {
 	m_sys=s;
-	for(uint32_t i=0;i<NUM_THREADS;i++)
+	numThreads=threadcount;
+	if(numThreads==0)
 	{
-		curJobs[i]=nullptr;
-		data[i].index=i;
-		data[i].pool = this;
-		threads[i] = SDL_CreateThread(job_worker,"ThreadPool",&data[i]);
+		//Some jobs (ParseThread, NetStream, ...) keep a worker busy for a long time,
+		//so don't go below a few threads even on small machines
+		int cpus=SDL_GetCPUCount();
+		numThreads=cpus > 4 ? cpus : 4;
 	}
+	data.resize(numThreads);
+	for(uint32_t i=0;i<numThreads;i++)
+	{
+		data[i]=new ThreadPoolData();
+		data[i]->curJob=nullptr;
+		data[i]->index=i;
+		data[i]->pool = this;
+	}
+	stallData.curJob=nullptr;
+	stallData.index=numThreads;
+	stallData.pool=this;
+	stallData.thread=nullptr;
+	//Only start the threads when all the queues exist, they may be stolen from right away
+	for(uint32_t i=0;i<numThreads;i++)
+		data[i]->thread = SDL_CreateThread(job_worker,"ThreadPool",data[i]);
 }
 
 void ThreadPool::forceStop()
 {
 	if(!stopFlag)
 	{
-		stopFlag=true;
-		//Signal an event for all the threads
-		for(int i=0;i<NUM_THREADS;i++)
-			num_jobs.signal();
+		{
+			Locker l(idleMutex);
+			stopFlag=true;
+			//Wake up all the idle threads
+			idleCond.broadcast();
+		}
+		{
+			Locker l(stallMutex);
+			stallCond.signal();
+		}
 
+		for(uint32_t i=0;i<=numThreads;i++)
 		{
-			Locker l(mutex);
+			ThreadPoolData* d=i<numThreads ? data[i] : &stallData;
+			Locker l(d->mutex);
 			//Now abort any job that is still executing
-			for(int i=0;i<NUM_THREADS;i++)
+			if(d->curJob)
 			{
-				if(curJobs[i])
-				{
-					curJobs[i]->threadAborting = true;
-					curJobs[i]->threadAbort();
-				}
+				d->curJob->threadAborting = true;
+				d->curJob->threadAbort();
 			}
 			//Fence all the non executed jobs
-			std::deque<IThreadJob*>::iterator it=jobs.begin();
-			for(;it!=jobs.end();++it)
-				(*it)->jobFence();
-			jobs.clear();
+			for(uint32_t p=0;p<JOB_PRIORITY_COUNT;p++)
+			{
+				std::deque<IThreadJob*>::iterator it=d->jobs[p].begin();
+				for(;it!=d->jobs[p].end();++it)
+					(*it)->jobFence();
+				queuedcount-=d->jobs[p].size();
+				d->jobs[p].clear();
+			}
 		}
 
-		for(int i=0;i<NUM_THREADS;i++)
+		for(uint32_t i=0;i<numThreads;i++)
 		{
-			SDL_WaitThread(threads[i],nullptr);
+			SDL_WaitThread(data[i]->thread,nullptr);
 		}
+		//startStallThread checks stopFlag with stallMutex locked, so no new thread is created after this
+		SDL_Thread* stallThread;
+		{
+			Locker l(stallMutex);
+			stallThread=stallData.thread;
+			stallData.thread=nullptr;
+		}
+		if(stallThread)
+			SDL_WaitThread(stallThread,nullptr);
+		ThreadPoolStatistics st;
+		getStatistics(st);
+		LOG(LOG_INFO,"ThreadPool statistics: threads "<<st.numThreads<<" jobs "<<st.jobsExecuted<<" steals "<<st.steals
+			<<" additional threads "<<st.additionalThreads<<" max queue depth "<<st.maxQueueDepth
+			<<" average wait "<<(st.jobsExecuted ? st.totalWaitTime/st.jobsExecuted : 0)<<"us max wait "<<st.maxWaitTime<<"us");
 	}
 }
 
 ThreadPool::~ThreadPool()
 {
 	forceStop();
+	for(uint32_t i=0;i<numThreads;i++)
+		delete data[i];
+}
+
+IThreadJob* ThreadPool::takeJob(ThreadPoolData* d)
+{
+	for(uint32_t p=0;p<JOB_PRIORITY_COUNT;p++)
+	{
+		//Our own queue first, then steal from the others. Everybody pops from the front,
+		//so the oldest jobs run first
+		for(uint32_t i=0;i<numThreads;i++)
+		{
+			ThreadPoolData* victim=data[(d->index+i)%numThreads];
+			IThreadJob* ret=nullptr;
+			{
+				Locker l(victim->mutex);
+				if(victim->jobs[p].empty())
+					continue;
+				ret=victim->jobs[p].front();
+				victim->jobs[p].pop_front();
+			}
+			queuedcount--;
+			if(victim!=d)
+				steals++;
+			Locker l(d->mutex);
+			d->curJob=ret;
+			return ret;
+		}
+	}
+	return nullptr;
+}
+
+IThreadJob* ThreadPool::getNextJob(ThreadPoolData* d)
+{
+	while(true)
+	{
+		IThreadJob* ret=takeJob(d);
+		if(ret)
+			return ret;
+		Locker l(idleMutex);
+		if(stopFlag)
+			return nullptr;
+		//A job queued after we looked has already incremented queuedcount, or it
+		//will signal idleCond once we are waiting
+		if(queuedcount<=0)
+			idleCond.wait(idleMutex);
+	}
+}
+
+bool ThreadPool::runJob(ThreadPoolData* d, IThreadJob* myJob)
+{
+	uint64_t waited=g_get_monotonic_time()-myJob->queuedTime;
+	jobsExecuted++;
+	totalWaitTime+=waited;
+	updateMaximum(maxWaitTime,waited);
+
+	// it's possible that a job was added and will be executed while forcestop() has been called
+	if(stopFlag)
+	{
+		//forceStop() must not abort the job after it is fenced
+		{
+			Locker l(d->mutex);
+			d->curJob=nullptr;
+		}
+		myJob->jobFence();
+		return false;
+	}
+	runcount++;
+	setTLSWorker(myJob->fromWorker);
+	try
+	{
+		myJob->execute();
+	}
+	catch(JobTerminationException& ex)
+	{
+		LOG(LOG_NOT_IMPLEMENTED,"Job terminated");
+	}
+	catch(LightsparkException& e)
+	{
+		LOG(LOG_ERROR,"Exception in ThreadPool " << e.what());
+		m_sys->setError(e.cause);
+	}
+	catch(std::exception& e)
+	{
+		LOG(LOG_ERROR,"std Exception in ThreadPool:"<<myJob<<" "<<e.what());
+		m_sys->setError(e.what());
+	}
+
+	{
+		Locker l(d->mutex);
+		d->curJob=nullptr;
+	}
+	runcount--;
+
+	//jobFencing is allowed to happen outside the mutex
+	myJob->jobFence();
+	return true;
 }
 
 int ThreadPool::job_worker(void *d)
 {
 	ThreadPoolData* data = (ThreadPoolData*)d;
-	setTLSSys(data->pool->m_sys);
+	ThreadPool* pool = data->pool;
+	setTLSSys(pool->m_sys);
+	tls_set(tls_pool_worker,data);
 
-	ThreadProfile* profile=data->pool->m_sys->allocateProfiler(RGB(200,200,0));
+	ThreadProfile* profile=pool->m_sys->allocateProfiler(RGB(200,200,0));
 	char buf[16];
 	snprintf(buf,16,"Thread %u",data->index);
 	profile->setTag(buf);
@@ -91,104 +244,192 @@ int ThreadPool::job_worker(void *d)
 	Chronometer chronometer;
 	while(1)
 	{
-		data->pool->num_jobs.wait();
-		if(data->pool->stopFlag)
+		IThreadJob* myJob=pool->getNextJob(data);
+		if(myJob==nullptr)
 			return 0;
-		Locker l(data->pool->mutex);
-		IThreadJob* myJob=data->pool->jobs.front();
-		data->pool->jobs.pop_front();
-		data->pool->curJobs[data->index]=myJob;
-		data->pool->runcount++;
-		l.release();
-
-		setTLSWorker(myJob->fromWorker);
 		chronometer.checkpoint();
-		try
-		{
-			// it's possible that a job was added and will be executed while forcestop() has been called
-			if(data->pool->stopFlag)
-				return 0;
-			myJob->execute();
-		}
-		catch(JobTerminationException& ex)
-		{
-			LOG(LOG_NOT_IMPLEMENTED,"Job terminated");
-		}
-		catch(LightsparkException& e)
-		{
-			LOG(LOG_ERROR,"Exception in ThreadPool " << e.what());
-			data->pool->m_sys->setError(e.cause);
-		}
-		catch(std::exception& e)
-		{
-			LOG(LOG_ERROR,"std Exception in ThreadPool:"<<myJob<<" "<<e.what());
-			data->pool->m_sys->setError(e.what());
-		}
-		
+		if(!pool->runJob(data,myJob))
+			return 0;
 		profile->accountTime(chronometer.checkpoint());
-
-		l.acquire();
-		data->pool->curJobs[data->index]=nullptr;
-		data->pool->runcount--;
-		l.release();
-
-		//jobFencing is allowed to happen outside the mutex
-		myJob->jobFence();
 	}
 	return 0;
 }
 
 void ThreadPool::addJob(IThreadJob* j)
 {
-	Locker l(mutex);
+	assert(j);
 	j->setWorker(getWorker());
 	if(stopFlag)
 	{
 		j->jobFence();
 		return;
 	}
-	assert(j);
-	if (runcount == NUM_THREADS)
+	//Jobs created by a worker of this pool go to its own queue,
+	//everything else is distributed among the workers
+	ThreadPoolData* target=(ThreadPoolData*)tls_get(tls_pool_worker);
+	if(target==nullptr || target->pool!=this)
+		target=data[uint32_t(nextQueue++)%numThreads];
+	JOB_PRIORITY prio=j->getJobPriority();
+	assert(prio<JOB_PRIORITY_COUNT);
+	bool stopped;
 	{
-		// no slot available, we create an additional thread
-		runAdditionalThread(j);
+		Locker l(target->mutex);
+		//stopFlag has to be checked again with the queue locked, forceStop
+		//may already have fenced the jobs of this queue
+		stopped=stopFlag;
+		if(!stopped)
+		{
+			j->queuedTime=g_get_monotonic_time();
+			target->jobs[prio].push_back(j);
+		}
 	}
-	else
+	if(stopped)
 	{
-		jobs.push_back(j);
-		num_jobs.signal();
+		j->jobFence();
+		return;
+	}
+	updateMaximum(maxQueueDepth,int32_t(++queuedcount));
+	{
+		Locker l(idleMutex);
+		idleCond.signal();
 	}
+	if(runcount>=(int32_t)numThreads)
+		startStallThread();
 }
-void ThreadPool::runAdditionalThread(IThreadJob* j)
+
+void ThreadPool::getStatistics(ThreadPoolStatistics& s) const
 {
-	SDL_Thread* t = SDL_CreateThread(additional_job_worker,"additionalThread",j);
-	SDL_DetachThread(t);
+	s.numThreads=numThreads;
+	s.queueDepth=queuedcount > 0 ? queuedcount.load() : 0;
+	s.maxQueueDepth=maxQueueDepth;
+	s.jobsExecuted=jobsExecuted;
+	s.steals=steals;
+	s.additionalThreads=additionalThreads;
+	s.totalWaitTime=totalWaitTime;
+	s.maxWaitTime=maxWaitTime;
 }
 
-int ThreadPool::additional_job_worker(void* d)
+void ThreadPool::startStallThread()
 {
-	IThreadJob* myJob=(IThreadJob*)d;
+	Locker l(stallMutex);
+	if(stallThreadRunning || stopFlag)
+		return;
+	//The previous stall thread has already decided to exit
+	if(stallData.thread)
+		SDL_WaitThread(stallData.thread,nullptr);
+	stallThreadRunning=true;
+	stallData.thread=SDL_CreateThread(stall_worker,"ThreadPoolStall",this);
+}
 
-	setTLSSys(myJob->fromWorker->getSystemState());
-	setTLSWorker(myJob->fromWorker);
-	try
-	{
-		myJob->execute();
-	}
-	catch(JobTerminationException& ex)
+int ThreadPool::stall_worker(void* d)
+{
+	ThreadPool* pool=(ThreadPool*)d;
+	setTLSSys(pool->m_sys);
+	while(true)
 	{
-		LOG(LOG_NOT_IMPLEMENTED,"Job terminated");
+		//Give the workers some time to get to the queued jobs
+		{
+			CondTime timeout(THREADPOOL_STALL_TIMEOUT);
+			Locker l(pool->stallMutex);
+			while(!pool->stopFlag && timeout.isInTheFuture())
+				timeout.wait(pool->stallMutex,pool->stallCond);
+		}
+		//Only step in while all workers are still busy, the jobs are taken from the
+		//queues in the usual order
+		IThreadJob* myJob=nullptr;
+		if(!pool->stopFlag && pool->runcount>=(int32_t)pool->numThreads)
+			myJob=pool->takeJob(&pool->stallData);
+		if(myJob)
+		{
+			pool->additionalThreads++;
+			if(!pool->runJob(&pool->stallData,myJob))
+				break;
+			continue;
+		}
+		//addJob only starts a new stall thread after queuedcount is incremented, so
+		//a job queued while we are exiting is either seen here or starts a new thread
+		Locker l(pool->stallMutex);
+		if(pool->stopFlag || pool->queuedcount<=0 || pool->runcount<(int32_t)pool->numThreads)
+		{
+			pool->stallThreadRunning=false;
+			return 0;
+		}
 	}
-	catch(LightsparkException& e)
+	//Stopping, forceStop waits for this thread
+	pool->stallThreadRunning=false;
+	return 0;
+}
+
+namespace
+{
+/* The state shared by the threads working on the slices of one parallelFor */
+class ParallelForSlices
+{
+private:
+	const std::function<void(uint32_t,uint32_t)>* func;
+	uint32_t count;
+	uint32_t sliceSize;
+	uint32_t sliceCount;
+	std::atomic<uint32_t> nextSlice;
+	std::atomic<uint32_t> slicesDone;
+	Semaphore finished;
+public:
+	ParallelForSlices(const std::function<void(uint32_t,uint32_t)>* f, uint32_t c, uint32_t n):func(f),count(c),sliceSize((c+n-1)/n),sliceCount(n),nextSlice(0),slicesDone(0),finished(0) {}
+	// processes slices until none is left
+	void run()
 	{
-		LOG(LOG_ERROR,"Exception in AdditionalThread " << e.what());
-		myJob->fromWorker->getSystemState()->setError(e.cause);
+		uint32_t slice;
+		while((slice=nextSlice++)<sliceCount)
+		{
+			uint32_t begin=std::min(count,slice*sliceSize);
+			uint32_t end=std::min(count,begin+sliceSize);
+			if(begin<end)
+				(*func)(begin,end);
+			if(++slicesDone==sliceCount)
+				finished.signal();
+		}
 	}
-	catch(std::exception& e)
+	void wait() { finished.wait(); }
+};
+
+/* A helper job of parallelFor. It may run after all slices are done,
+ * so it only holds a reference to the shared state */
+class ParallelForJob: public IThreadJob
+{
+private:
+	std::shared_ptr<ParallelForSlices> slices;
+public:
+	ParallelForJob(std::shared_ptr<ParallelForSlices> s):slices(s) {}
+	void execute() override { slices->run(); }
+	void jobFence() override { delete this; }
+	JOB_PRIORITY getJobPriority() const override { return JOB_PRIORITY_HIGH; }
+};
+
+void addJobToCurrentPool(IThreadJob* job)
+{
+	SystemState* sys=getSys();
+	if(sys)
+		sys->addJob(job);
+	else
+		job->jobFence();
+}
+}
+
+void lightspark::parallelFor(uint32_t count, uint32_t sliceCount, const std::function<void(uint32_t,uint32_t)>& f, void (*launch)(IThreadJob* job))
+{
+	if(count==0)
+		return;
+	sliceCount=std::min(sliceCount,count);
+	if(sliceCount<=1)
 	{
-		LOG(LOG_ERROR,"std Exception in AdditionalThread:"<<myJob<<" "<<e.what());
-		myJob->fromWorker->getSystemState()->setError(e.what());
+		f(0,count);
+		return;
 	}
-	myJob->jobFence();
-	return 0;
+	if(launch==nullptr)
+		launch=addJobToCurrentPool;
+	auto slices=std::make_shared<ParallelForSlices>(&f,count,sliceCount);
+	for(uint32_t i=1;i<sliceCount;i++)
+		launch(new ParallelForJob(slices));
+	slices->run();
+	slices->wait();
 }
@@ -22,16 +22,42 @@
 
 #include "compat.h"
 #include <deque>
+#include <vector>
 #include <cstdlib>
+#include <functional>
 #include "threading.h"
 
 namespace lightspark
 {
 
-#define NUM_THREADS 20
-
 class SystemState;
 
+struct ThreadPoolStatistics
+{
+	uint32_t numThreads;
+	// number of jobs currently queued and not yet picked up by a worker
+	uint32_t queueDepth;
+	uint32_t maxQueueDepth;
+	uint64_t jobsExecuted;
+	// jobs taken by a worker from the queue of another worker
+	uint64_t steals;
+	// jobs run by the stall thread because all workers were busy for THREADPOOL_STALL_TIMEOUT
+	uint64_t additionalThreads;
+	// time (in microseconds) jobs spent queued before execution started
+	uint64_t totalWaitTime;
+	uint64_t maxWaitTime;
+	ThreadPoolStatistics():numThreads(0),queueDepth(0),maxQueueDepth(0),jobsExecuted(0),steals(0),additionalThreads(0),totalWaitTime(0),maxWaitTime(0) {}
+};
+
+/*
+ * Work-stealing pool of threads. Every worker owns one job queue per JOB_PRIORITY,
+ * jobs added from a worker go to its own queue, other jobs are distributed round-robin.
+ * Idle workers sleep until a job is added and then steal from the queues of the others,
+ * so no single lock is shared by all threads while jobs are running.
+ * Some jobs block for a long time, so if all workers are busy and jobs are still
+ * queued after THREADPOOL_STALL_TIMEOUT milliseconds, an additional thread runs them
+ */
+#define THREADPOOL_STALL_TIMEOUT 50
 class ThreadPool
 {
 private:
@@ -39,26 +65,61 @@ private:
 	{
 		ThreadPool* pool;
 		int index;
+		SDL_Thread* thread;
+		IThreadJob* volatile curJob;
+		// protects jobs, both the owner and thieves pop from the front to keep the FIFO order
+		Mutex mutex;
+		std::deque<IThreadJob*> jobs[JOB_PRIORITY_COUNT];
 	};
-	Mutex mutex;
-	SDL_Thread* threads[NUM_THREADS];
-	ThreadPoolData data[NUM_THREADS];
-	IThreadJob* volatile curJobs[NUM_THREADS];
-	std::deque<IThreadJob*> jobs;
-	Semaphore num_jobs;
+	uint32_t numThreads;
+	std::vector<ThreadPoolData*> data;
+	// idle workers wait on idleCond, addJob signals it after queuedcount is incremented
+	Mutex idleMutex;
+	Cond idleCond;
 	static int job_worker(void* d);
 	SystemState* m_sys;
 	volatile bool stopFlag;
-	uint32_t runcount;
-	void runAdditionalThread(IThreadJob* j);
-	static int additional_job_worker(void* d);
+	ATOMIC_INT32(runcount);
+	ATOMIC_INT32(queuedcount);
+	ATOMIC_INT32(nextQueue);
+	// statistics
+	ATOMIC_INT32(maxQueueDepth);
+	std::atomic<uint64_t> jobsExecuted;
+	std::atomic<uint64_t> steals;
+	std::atomic<uint64_t> additionalThreads;
+	std::atomic<uint64_t> totalWaitTime;
+	std::atomic<uint64_t> maxWaitTime;
+	// the thread running queued jobs while all workers are busy, its queues stay empty
+	ThreadPoolData stallData;
+	Mutex stallMutex;
+	Cond stallCond;
+	std::atomic<bool> stallThreadRunning;
+	IThreadJob* takeJob(ThreadPoolData* d);
+	IThreadJob* getNextJob(ThreadPoolData* d);
+	// returns false if the pool is stopping
+	bool runJob(ThreadPoolData* d, IThreadJob* j);
+	void startStallThread();
+	static int stall_worker(void* d);
 public:
-	ThreadPool(SystemState* s);
+	/*
+	 * @param threadcount The number of worker threads, 0 to size the pool from the number of CPUs
+	 */
+	ThreadPool(SystemState* s, uint32_t threadcount=0);
 	~ThreadPool();
 	void addJob(IThreadJob* j);
 	void forceStop();
+	void getStatistics(ThreadPoolStatistics& s) const;
 };
 
+/*
+ * Calls f(begin,end) for sliceCount slices of [0,count) of about equal size.
+ * The calling thread works on the slices together with sliceCount-1 helper jobs,
+ * so it also finishes if the pool is busy. Returns when all slices are done.
+ * The helper jobs are started with launch, nullptr adds them to the ThreadPool
+ * of the current SystemState
+ */
+void parallelFor(uint32_t count, uint32_t sliceCount, const std::function<void(uint32_t,uint32_t)>& f, void (*launch)(IThreadJob* job)=nullptr);
+
 }
 
 #endif /* THREAD_POOL_H */
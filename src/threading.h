@@ -145,11 +145,19 @@ public:
 };
 class ASWorker;
 
+/*
+ * Scheduling priority of an IThreadJob. Jobs with a higher priority are
+ * picked up by the ThreadPool workers before any queued job of a lower priority
+ */
+enum JOB_PRIORITY { JOB_PRIORITY_HIGH=0, JOB_PRIORITY_NORMAL, JOB_PRIORITY_LOW, JOB_PRIORITY_COUNT };
+
 class IThreadJob
 {
 friend class ThreadPool;
 private:
 	ASWorker* fromWorker;
+	// monotonic time (in microseconds) this job was queued in the ThreadPool
+	gint64 queuedTime;
 public:
 	/*
 	 * Set to true by the ThreadPool just before threadAbort()
@@ -180,7 +188,13 @@ public:
 	 * 'delete this'.
 	 */
 	virtual void jobFence()=0;
-	IThreadJob() : fromWorker(nullptr),threadAborting(false) {}
+	/*
+	 * Short jobs the user is waiting on (i.e. rasterization) should
+	 * return JOB_PRIORITY_HIGH, long running or blocking jobs
+	 * (i.e. downloads) should return JOB_PRIORITY_LOW
+	 */
+	virtual JOB_PRIORITY getJobPriority() const { return JOB_PRIORITY_NORMAL; }
+	IThreadJob() : fromWorker(nullptr),queuedTime(0),threadAborting(false) {}
 	virtual ~IThreadJob() {}
 	void setWorker(ASWorker* w) { fromWorker = w;}
 };
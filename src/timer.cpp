@@ -27,7 +27,7 @@
 using namespace lightspark;
 using namespace std;
 
-TimerThread::TimerThread(SystemState* s):m_sys(s),stopped(false),joined(false)
+TimerThread::TimerThread(SystemState* s):m_sys(s),stopped(false),joined(false),virtualClock(false),virtualTime(0)
 {
 	t = SDL_CreateThread(&TimerThread::worker,"TimerThread",this);
 }
@@ -59,11 +59,18 @@ TimerThread::~TimerThread()
 		delete *it;
 }
 
+bool TimerThread::isEarlier(TimingEvent* a, TimingEvent* b) const
+{
+	if(virtualClock)
+		return a->virtualWakeUpTime < b->virtualWakeUpTime;
+	return a->wakeUpTime < b->wakeUpTime;
+}
+
 void TimerThread::insertNewEvent_nolock(TimingEvent* e)
 {
 	list<TimingEvent*>::iterator it=pendingEvents.begin();
 	//If there are no events pending, or this is earlier than the first, signal newEvent
-	if(pendingEvents.empty() || (*it)->wakeUpTime > e->wakeUpTime)
+	if(pendingEvents.empty() || isEarlier(e,*it))
 	{
 		pendingEvents.insert(it, e);
 		newEvent.signal();
@@ -73,7 +80,7 @@ void TimerThread::insertNewEvent_nolock(TimingEvent* e)
 
 	for(;it!=pendingEvents.end();++it)
 	{
-		if((*it)->wakeUpTime > e->wakeUpTime)
+		if(isEarlier(e,*it))
 		{
 			pendingEvents.insert(it, e);
 			return;
@@ -83,9 +90,10 @@ void TimerThread::insertNewEvent_nolock(TimingEvent* e)
 	pendingEvents.insert(pendingEvents.end(), e);
 }
 
-void TimerThread::insertNewEvent(TimingEvent* e)
+void TimerThread::insertNewEvent(TimingEvent* e, uint32_t delay)
 {
 	Locker l(mutex);
+	e->virtualWakeUpTime=virtualTime+delay;
 	insertNewEvent_nolock(e);
 }
 
@@ -113,6 +121,8 @@ int TimerThread::worker(void *d)
 	setTLSSys(th->m_sys);
 
 	Locker l(th->mutex);
+	//The VM has handled the events queued by the jobs run at the current virtual time
+	bool vmSynchronized=false;
 	while(1)
 	{
 		/* Wait until the first event appears */
@@ -123,26 +133,47 @@ int TimerThread::worker(void *d)
 				return 0;
 		}
 
-		/* Get expiration of first event */
-		CondTime timing=th->pendingEvents.front()->wakeUpTime;
-		/* Wait for the absolute time or a newEvent signal
-		 * this unlocks the mutex and relocks it before returing
-		 */
-		timing.wait(th->mutex,th->newEvent);
+		if(th->virtualClock)
+		{
+			if(th->stopped)
+				return 0;
+			uint64_t wakeUpTime=th->pendingEvents.front()->virtualWakeUpTime;
+			if(wakeUpTime>th->virtualTime)
+			{
+				if(!vmSynchronized)
+				{
+					l.release();
+					th->m_sys->synchronizeWithVm();
+					l.acquire();
+					vmSynchronized=true;
+					//The pending events may have changed meanwhile
+					continue;
+				}
+				th->virtualTime=wakeUpTime;
+			}
+		}
+		else
+		{
+			/* Get expiration of first event */
+			CondTime timing=th->pendingEvents.front()->wakeUpTime;
+			/* Wait for the absolute time or a newEvent signal
+			 * this unlocks the mutex and relocks it before returing
+			 */
+			timing.wait(th->mutex,th->newEvent);
 
-		if(th->stopped)
-			return 0;
+			if(th->stopped)
+				return 0;
 
-		if(th->pendingEvents.empty())
-			continue;
+			if(th->pendingEvents.empty())
+				continue;
 
-		TimingEvent* e=th->pendingEvents.front();
-
-		/* check if the top event is due now. It could be have been removed/inserted
-		 * while we slept */
-		if(e->wakeUpTime.isInTheFuture())
-			continue;
+			/* check if the top event is due now. It could be have been removed/inserted
+			 * while we slept */
+			if(th->pendingEvents.front()->wakeUpTime.isInTheFuture())
+				continue;
+		}
 
+		TimingEvent* e=th->pendingEvents.front();
 		th->pendingEvents.pop_front();
 
 		if(e->job->stopMe)
@@ -155,7 +186,10 @@ int TimerThread::worker(void *d)
 		if(e->isTick)
 		{
 			/* re-enqueue*/
-			e->wakeUpTime.addMilliseconds(e->tickTime);
+			if(th->virtualClock)
+				e->virtualWakeUpTime+=max(e->tickTime,1U);
+			else
+				e->wakeUpTime.addMilliseconds(e->tickTime);
 			th->insertNewEvent_nolock(e);
 		}
 
@@ -171,6 +205,7 @@ int TimerThread::worker(void *d)
 		job->tick();
 
 		l.acquire();
+		vmSynchronized=false;
 
 		/* Cleanup */
 		if(!isTick)
@@ -182,16 +217,28 @@ int TimerThread::worker(void *d)
 	return 0;
 }
 
+void TimerThread::useVirtualClock()
+{
+	Locker l(mutex);
+	virtualClock=true;
+}
+
+uint64_t TimerThread::getVirtualTime()
+{
+	Locker l(mutex);
+	return virtualTime;
+}
+
 void TimerThread::addTick(uint32_t tickTime, ITickJob* job)
 {
 	TimingEvent* e=new TimingEvent(job, true, tickTime, 0);
-	insertNewEvent(e);
+	insertNewEvent(e,tickTime);
 }
 
 void TimerThread::addWait(uint32_t waitTime, ITickJob* job)
 {
 	TimingEvent* e=new TimingEvent(job, false, 0, waitTime);
-	insertNewEvent(e);
+	insertNewEvent(e,waitTime);
 }
 
 /*
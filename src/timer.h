@@ -56,9 +56,11 @@ private:
 	{
 	public:
 		TimingEvent(ITickJob* _job, bool _isTick, uint32_t _tickTime, uint32_t _waitTime) 
-			: job(_job),wakeUpTime(_isTick ? _tickTime : _waitTime),tickTime(_tickTime),isTick(_isTick) {}
+			: job(_job),wakeUpTime(_isTick ? _tickTime : _waitTime),virtualWakeUpTime(0),tickTime(_tickTime),isTick(_isTick) {}
 		ITickJob* job;
 		CondTime wakeUpTime;
+		// used instead of wakeUpTime by the virtual clock
+		uint64_t virtualWakeUpTime;
 		uint32_t tickTime;
 		bool isTick;
 	};
@@ -69,8 +71,12 @@ private:
 	SystemState* m_sys;
 	volatile bool stopped;
 	bool joined;
+	// the events are run by virtualTime instead of the wall clock
+	bool virtualClock;
+	uint64_t virtualTime;
 	static int worker(void* d);
-	void insertNewEvent(TimingEvent* e);
+	bool isEarlier(TimingEvent* a, TimingEvent* b) const;
+	void insertNewEvent(TimingEvent* e, uint32_t delay);
 	void insertNewEvent_nolock(TimingEvent* e);
 	void dumpJobs();
 public:
@@ -91,6 +97,13 @@ public:
 	 */
 	void removeJob(ITickJob* job);
 	void removeJob_noLock(ITickJob* job);
+	/*
+	 * Runs the events by a virtual clock in milliseconds instead of the wall clock. The events are run
+	 * back to back in the order of their virtual time. Before the clock jumps to the time of the next event
+	 * the VM handles the events queued so far, so the scripts see the same times in every run
+	 */
+	void useVirtualClock();
+	uint64_t getVirtualTime();
 };
 
 class Chronometer
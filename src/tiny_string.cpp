@@ -17,13 +17,26 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 **************************************************************************/
 
+#include <atomic>
+#include <new>
 #include "tiny_string.h"
 #include "exceptions.h"
 #include "swf.h"
 
 using namespace lightspark;
 
-tiny_string::tiny_string(std::istream& in, int len):buf(_buf_static),stringSize(len+1),type(STATIC)
+namespace lightspark
+{
+/* header of the buffer of DYNAMIC strings, the string data follows it */
+struct tiny_string_buffer
+{
+	std::atomic<uint32_t> refcount;
+	uint32_t capacity;
+	char* data() { return (char*)(this+1); }
+};
+}
+
+tiny_string::tiny_string(std::istream& in, int len):buf(_buf_static),sharedbuf(nullptr),stringSize(len+1),type(STATIC)
 {
 	if(stringSize > STATIC_SIZE)
 		createBuffer(stringSize);
@@ -32,7 +45,7 @@ tiny_string::tiny_string(std::istream& in, int len):buf(_buf_static),stringSize(
 	init();
 }
 
-tiny_string::tiny_string(const char* s,bool copy):_buf_static(),buf(_buf_static),type(READONLY)
+tiny_string::tiny_string(const char* s,bool copy):_buf_static(),buf(_buf_static),sharedbuf(nullptr),type(READONLY)
 {
 	if(copy)
 		makePrivateCopy(s);
@@ -45,7 +58,7 @@ tiny_string::tiny_string(const char* s,bool copy):_buf_static(),buf(_buf_static)
 }
 
 tiny_string::tiny_string(const tiny_string& r):
-	_buf_static(),buf(_buf_static),stringSize(r.stringSize),numchars(r.numchars),type(STATIC),isASCII(r.isASCII),hasNull(r.hasNull)
+	_buf_static(),buf(_buf_static),sharedbuf(nullptr),stringSize(r.stringSize),numchars(r.numchars),type(STATIC),isASCII(r.isASCII),hasNull(r.hasNull)
 {
 	//Fast path for static read-only strings
 	if(r.type==READONLY)
@@ -54,12 +67,15 @@ tiny_string::tiny_string(const tiny_string& r):
 		buf=r.buf;
 		return;
 	}
-	if(stringSize > STATIC_SIZE)
-		createBuffer(stringSize);
+	if(r.type==DYNAMIC)
+	{
+		shareBuffer(r);
+		return;
+	}
 	memcpy(buf,r.buf,stringSize);
 }
 
-tiny_string::tiny_string(const std::string& r):_buf_static(),buf(_buf_static),stringSize(r.size()+1),type(STATIC)
+tiny_string::tiny_string(const std::string& r):_buf_static(),buf(_buf_static),sharedbuf(nullptr),stringSize(r.size()+1),type(STATIC)
 {
 	if(stringSize > STATIC_SIZE)
 		createBuffer(stringSize);
@@ -74,6 +90,8 @@ tiny_string::~tiny_string()
 
 tiny_string& tiny_string::operator=(const tiny_string& s)
 {
+	if(this==&s)
+		return *this;
 	resetToStatic();
 	stringSize=s.stringSize;
 	//Fast path for static read-only strings
@@ -82,12 +100,10 @@ tiny_string& tiny_string::operator=(const tiny_string& s)
 		type=READONLY;
 		buf=s.buf;
 	}
+	else if(s.type==DYNAMIC)
+		shareBuffer(s);
 	else
-	{
-		if(stringSize > STATIC_SIZE)
-			createBuffer(stringSize);
 		memcpy(buf,s.buf,stringSize);
-	}
 	this->isASCII = s.isASCII;
 	this->hasNull = s.hasNull;
 	this->numchars = s.numchars;
@@ -114,21 +130,13 @@ tiny_string& tiny_string::operator=(const char* s)
 
 tiny_string& tiny_string::operator+=(const char* s)
 {	//deprecated, cannot handle '\0' inside string
-	if(type==READONLY)
-	{
-		char* tmp=buf;
-		makePrivateCopy(tmp);
-	}
 	uint32_t addedLen=strlen(s);
+	if(addedLen==0)
+		return *this;
+	if(s>=buf && s<buf+stringSize)
+		return *this += tiny_string(s,true);
 	uint32_t newStringSize=stringSize + addedLen;
-	if(type==STATIC && newStringSize > STATIC_SIZE)
-	{
-		createBuffer(newStringSize);
-		//don't copy trailing \0
-		memcpy(buf,_buf_static,stringSize-1);
-	}
-	else if(type==DYNAMIC && addedLen!=0)
-		resizeBuffer(newStringSize);
+	reserveForAppend(newStringSize);
 	//also copy \0 at the end
 	memcpy(buf+stringSize-1,s,addedLen+1);
 	stringSize=newStringSize;
@@ -138,20 +146,16 @@ tiny_string& tiny_string::operator+=(const char* s)
 
 tiny_string& tiny_string::operator+=(const tiny_string& r)
 {
-	if(type==READONLY)
+	if(r.stringSize==1)
+		return *this;
+	if(&r==this)
 	{
-		char* tmp=buf;
-		makePrivateCopy(tmp);
+		// the copy shares the buffer, so it stays valid while this is reallocated
+		tiny_string tmp(r);
+		return *this += tmp;
 	}
 	uint32_t newStringSize=stringSize + r.stringSize-1;
-	if(type==STATIC && newStringSize > STATIC_SIZE)
-	{
-		createBuffer(newStringSize);
-		//don't copy trailing \0
-		memcpy(buf,_buf_static,stringSize-1);
-	}
-	else if(type==DYNAMIC && r.stringSize>1)
-		resizeBuffer(newStringSize);
+	reserveForAppend(newStringSize);
 	//start position is where the \0 was
 	memcpy(buf+stringSize-1,r.buf,r.stringSize);
 	stringSize=newStringSize;
@@ -334,27 +338,64 @@ void tiny_string::createBuffer(uint32_t s)
 {
 	type=DYNAMIC;
 	reportMemoryChange(s);
-	buf=new char[s];
+	sharedbuf=(tiny_string_buffer*)malloc(sizeof(tiny_string_buffer)+s);
+	if(!sharedbuf)
+		throw std::bad_alloc();
+	new (&sharedbuf->refcount) std::atomic<uint32_t>(1);
+	sharedbuf->capacity=s;
+	buf=sharedbuf->data();
+}
+
+void tiny_string::reserveForAppend(uint32_t newStringSize)
+{
+	if(type==STATIC && newStringSize <= STATIC_SIZE)
+		return;
+	if(type==DYNAMIC && sharedbuf->refcount==1 && (buf-sharedbuf->data())+newStringSize <= sharedbuf->capacity)
+		return;
+	char* oldbuf=buf;
+	tiny_string_buffer* oldshared = type==DYNAMIC ? sharedbuf : nullptr;
+	if(newStringSize <= STATIC_SIZE)
+	{
+		memcpy(_buf_static,oldbuf,stringSize);
+		buf=_buf_static;
+		type=STATIC;
+		sharedbuf=nullptr;
+	}
+	else
+	{
+		// grow geometrically, so that repeated appends take amortized linear time
+		createBuffer(std::max(newStringSize,2*stringSize));
+		memcpy(buf,oldbuf,stringSize);
+	}
+	if(oldshared && --oldshared->refcount==0)
+	{
+		reportMemoryChange(-oldshared->capacity);
+		free(oldshared);
+	}
 }
 
-void tiny_string::resizeBuffer(uint32_t s)
+void tiny_string::shareBuffer(const tiny_string& r)
 {
-	assert(type==DYNAMIC);
-	char* oldBuf=buf;
-	reportMemoryChange(s-stringSize);
-	buf=new char[s];
-	assert(s >= stringSize);
-	memcpy(buf,oldBuf,stringSize);
-	delete[] oldBuf;
+	assert(r.type==DYNAMIC && type!=DYNAMIC);
+	r.sharedbuf->refcount++;
+	sharedbuf=r.sharedbuf;
+	buf=r.buf;
+	type=DYNAMIC;
 }
 
-void tiny_string::resetToStatic()
+void tiny_string::releaseBuffer()
 {
-	if(type==DYNAMIC)
+	if(type==DYNAMIC && --sharedbuf->refcount==0)
 	{
-		reportMemoryChange(-stringSize);
-		delete[] buf;
+		reportMemoryChange(-sharedbuf->capacity);
+		free(sharedbuf);
 	}
+	sharedbuf=nullptr;
+}
+
+void tiny_string::resetToStatic()
+{
+	releaseBuffer();
 	stringSize=1;
 	_buf_static[0] = '\0';
 	buf=_buf_static;
@@ -437,6 +478,26 @@ tiny_string tiny_string::substr_bytes(uint32_t start, uint32_t len) const
 	if ((len == UINT32_MAX) || (start+len >= stringSize))
 		len =stringSize-(start+1);
 	assert(start+len < stringSize);
+	if(start+len+1 == stringSize && type != STATIC && len+1 > STATIC_SIZE)
+	{
+		// substrings at the end of the string are null terminated, so they can use the same buffer
+		if(type==READONLY)
+		{
+			ret.type=READONLY;
+			ret.buf=buf+start;
+		}
+		else
+		{
+			ret.shareBuffer(*this);
+			ret.buf+=start;
+		}
+		ret.stringSize = len+1;
+		if (this->isASCII && !this->hasNull)
+			ret.numchars = len;
+		else
+			ret.init();
+		return ret;
+	}
 	if(len+1 > STATIC_SIZE)
 		ret.createBuffer(len+1);
 	memcpy(ret.buf,buf+start,len);
@@ -33,6 +33,7 @@ typedef unsigned char xmlChar;
 
 namespace lightspark
 {
+struct tiny_string_buffer;
 
 /* Iterates over utf8 characters */
 class CharIterator /*: public forward_iterator<uint32_t>*/
@@ -84,6 +85,9 @@ public:
  * String class.
  * The string can contain '\0's, so don't use raw_buf().
  * Use len() to determine actual size.
+ * DYNAMIC strings share a reference counted buffer that is only copied
+ * when it is modified, so copies and substrings at the end of a string are cheap.
+ * The buffer grows geometrically, so that appending in a loop takes linear time
  */
 class DLL_PUBLIC tiny_string
 {
@@ -94,6 +98,8 @@ private:
 	#define STATIC_SIZE 64
 	char _buf_static[STATIC_SIZE];
 	char* buf;
+	// only valid for DYNAMIC strings, buf points into its data
+	tiny_string_buffer* sharedbuf;
 	/*
 	   stringSize includes the trailing \0
 	*/
@@ -110,7 +116,10 @@ private:
 	//TODO: use static buffer again if reassigning to short string
 	void makePrivateCopy(const char* s);
 	void createBuffer(uint32_t s);
-	void resizeBuffer(uint32_t s);
+	// makes sure the buffer is not shared and can hold newStringSize bytes
+	void reserveForAppend(uint32_t newStringSize);
+	void shareBuffer(const tiny_string& r);
+	void releaseBuffer();
 	void resetToStatic();
 	void init();
 	bool isASCII:1;
@@ -118,7 +127,7 @@ private:
 public:
 	static const uint32_t npos = (uint32_t)(-1);
 
-	tiny_string():_buf_static(),buf(_buf_static),stringSize(1),numchars(0),type(STATIC),isASCII(true),hasNull(false){buf[0]=0;}
+	tiny_string():_buf_static(),buf(_buf_static),sharedbuf(nullptr),stringSize(1),numchars(0),type(STATIC),isASCII(true),hasNull(false){buf[0]=0;}
 	/* construct from utf character */
 	static tiny_string fromChar(uint32_t c);
 	tiny_string(const char* s,bool copy=false);